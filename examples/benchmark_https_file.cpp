@@ -0,0 +1,96 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <httpserver.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+using namespace httpserver;
+
+class file_resource : public http_resource {
+    public:
+        file_resource(const std::string& path):
+            path(path)
+        {
+        }
+
+        const std::shared_ptr<http_response> render_GET(const http_request&) {
+            return std::shared_ptr<http_response>(new file_response(path, 200, "application/octet-stream"));
+        }
+
+    private:
+        std::string path;
+};
+
+class stats_resource : public http_resource {
+    public:
+        stats_resource(webserver* ws):
+            ws(ws)
+        {
+        }
+
+        const std::shared_ptr<http_response> render_GET(const http_request& req) {
+            tls_stats stats = ws->get_tls_stats();
+            std::stringstream ss;
+            ss << "full_handshakes " << stats.full_handshakes << std::endl
+               << "resumed_handshakes " << stats.resumed_handshakes << std::endl
+               << "ktls_connections " << stats.ktls_connections << std::endl
+               << "this_connection_ktls " << (req.is_kernel_tls() ? 1 : 0) << std::endl;
+            return std::shared_ptr<http_response>(new string_response(ss.str(), 200));
+        }
+
+    private:
+        webserver* ws;
+};
+
+// Serves a file over HTTPS to measure the download throughput, e.g.:
+//   head -c 1G /dev/urandom > payload.bin
+//   ./benchmark_https_file 8080 payload.bin 4
+//   wrk -t4 -c32 -d30s https://localhost:8080/file
+//   curl -k https://localhost:8080/stats
+// Run it once with the default gnutls configuration and once with kTLS enabled
+// (see "kTLS" in the README) to compare encryption in userspace and in the kernel.
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <port> <file> [threads] [key.pem] [cert.pem]" << std::endl;
+        return 1;
+    }
+
+    int threads = argc > 3 ? atoi(argv[3]) : 4;
+    webserver ws = create_webserver(atoi(argv[1]))
+        .start_method(http::http_utils::INTERNAL_SELECT)
+        .max_threads(threads)
+        .use_ssl()
+        .https_mem_key(argc > 4 ? argv[4] : "key.pem")
+        .https_mem_cert(argc > 5 ? argv[5] : "cert.pem");
+
+    file_resource fr(argv[2]);
+    stats_resource sr(&ws);
+    ws.register_resource("/file", &fr);
+    ws.register_resource("/stats", &sr);
+
+    ws.start(true);
+
+    return 0;
+}
@@ -0,0 +1,579 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <httpserver.hpp>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#ifdef HAVE_GNUTLS
+#include <gnutls/gnutls.h>
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace httpserver;
+
+// Self-contained load test: starts the server in process, drives it over loopback with
+// keep-alive HTTP/1.1 clients and prints the results of each scenario as JSON, e.g.:
+//   ./benchmark_load --clients 8 --duration 10 > results.json
+//   ./benchmark_load --scenario tiny_get --scenario post_1mb
+// Each client thread keeps one connection busy (closed loop); the requests sent during the
+// warmup are not counted.
+
+static const size_t POST_SIZE = 1 << 20;
+static const size_t FILE_SIZE = 1 << 20;
+static const size_t STREAM_SIZE = 256 * 1024;
+
+static uint64_t now_microseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+class hello_resource : public http_resource {
+    public:
+        const std::shared_ptr<http_response> render_GET(const http_request&) {
+            return std::shared_ptr<http_response>(new string_response("Hello, World!", 200, "text/plain"));
+        }
+};
+
+class param_resource : public http_resource {
+    public:
+        const std::shared_ptr<http_response> render_GET(const http_request& req) {
+            return std::shared_ptr<http_response>(new string_response(
+                        req.get_arg("user") + "/" + req.get_arg("post"), 200, "text/plain"
+            ));
+        }
+};
+
+class upload_resource : public http_resource {
+    public:
+        const std::shared_ptr<http_response> render_POST(const http_request& req) {
+            std::stringstream ss;
+            ss << req.get_content().size();
+            return std::shared_ptr<http_response>(new string_response(ss.str(), 200, "text/plain"));
+        }
+};
+
+class file_resource : public http_resource {
+    public:
+        explicit file_resource(const std::string& path):
+            path(path)
+        {
+        }
+
+        const std::shared_ptr<http_response> render_GET(const http_request&) {
+            return std::shared_ptr<http_response>(new file_response(path, 200, "application/octet-stream"));
+        }
+
+    private:
+        std::string path;
+};
+
+static ssize_t stream_callback(std::shared_ptr<size_t> remaining, char* buf, size_t max) {
+    if(*remaining == 0)
+        return -1;
+    size_t size = std::min(max, *remaining);
+    memset(buf, 'x', size);
+    *remaining -= size;
+    return size;
+}
+
+class stream_resource : public http_resource {
+    public:
+        const std::shared_ptr<http_response> render_GET(const http_request&) {
+            return std::shared_ptr<http_response>(new deferred_response<size_t>(
+                        stream_callback, std::shared_ptr<size_t>(new size_t(STREAM_SIZE))
+            ));
+        }
+};
+
+// Client side of a connection, in clear text or over TLS.
+class client_connection {
+    public:
+        client_connection(int port, bool tls):
+            port(port),
+            tls(tls),
+            fd(-1)
+        {
+#ifdef HAVE_GNUTLS
+            session = 0x0;
+            credentials = 0x0;
+#endif
+        }
+
+        ~client_connection() {
+            close();
+        }
+
+        bool open() {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            if(fd < 0)
+                return false;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if(connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+                close();
+                return false;
+            }
+            if(!tls)
+                return true;
+#ifdef HAVE_GNUTLS
+            // The server certificate is not verified: both ends are this process.
+            gnutls_certificate_allocate_credentials(&credentials);
+            gnutls_init(&session, GNUTLS_CLIENT);
+            gnutls_set_default_priority(session);
+            gnutls_credentials_set(session, GNUTLS_CRD_CERTIFICATE, credentials);
+            gnutls_transport_set_int(session, fd);
+            int ret;
+            do {
+                ret = gnutls_handshake(session);
+            } while(ret < 0 && gnutls_error_is_fatal(ret) == 0);
+            if(ret < 0) {
+                close();
+                return false;
+            }
+            return true;
+#else
+            close();
+            return false;
+#endif
+        }
+
+        void close() {
+#ifdef HAVE_GNUTLS
+            if(session != 0x0) {
+                gnutls_deinit(session);
+                session = 0x0;
+            }
+            if(credentials != 0x0) {
+                gnutls_certificate_free_credentials(credentials);
+                credentials = 0x0;
+            }
+#endif
+            if(fd >= 0)
+                ::close(fd);
+            fd = -1;
+            buffer.clear();
+        }
+
+        bool is_open() const {
+            return fd >= 0;
+        }
+
+        bool write_all(const std::string& data) {
+            size_t sent = 0;
+            while(sent < data.size()) {
+                ssize_t r;
+#ifdef HAVE_GNUTLS
+                if(session != 0x0)
+                    r = gnutls_record_send(session, data.data() + sent, data.size() - sent);
+                else
+#endif
+                    r = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if(r <= 0)
+                    return false;
+                sent += r;
+            }
+            return true;
+        }
+
+        // Reads a response, discarding its body.
+        // @return the status code (or -1 if the connection failed)
+        int read_response(uint64_t& body_size, bool& keep_alive) {
+            size_t end;
+            while((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                if(!fill())
+                    return -1;
+            }
+            std::string head = buffer.substr(0, end + 2);
+            buffer.erase(0, end + 4);
+            if(head.compare(0, 5, "HTTP/") != 0 || head.size() < 12)
+                return -1;
+            int status = atoi(head.c_str() + 9);
+
+            for(size_t i = 0; i < head.size(); i++)
+                head[i] = tolower(head[i]);
+            keep_alive = head.find("\r\nconnection: close\r\n") == std::string::npos;
+            body_size = 0;
+
+            size_t header = head.find("\r\ncontent-length:");
+            if(header != std::string::npos) {
+                body_size = strtoull(head.c_str() + header + 17, 0x0, 10);
+                return skip(body_size) ? status : -1;
+            }
+            if(head.find("\r\ntransfer-encoding: chunked\r\n") == std::string::npos)
+                return status;
+
+            while(true) {
+                std::string line;
+                if(!read_line(line))
+                    return -1;
+                uint64_t chunk = strtoull(line.c_str(), 0x0, 16);
+                if(chunk == 0)
+                    break;
+                if(!skip(chunk + 2))
+                    return -1;
+                body_size += chunk;
+            }
+            // Trailers, up to the empty line.
+            std::string line;
+            do {
+                if(!read_line(line))
+                    return -1;
+            } while(!line.empty());
+            return status;
+        }
+
+    private:
+        int port;
+        bool tls;
+        int fd;
+        std::string buffer;
+#ifdef HAVE_GNUTLS
+        gnutls_session_t session;
+        gnutls_certificate_credentials_t credentials;
+#endif
+
+        bool fill() {
+            char chunk[16384];
+            ssize_t r;
+#ifdef HAVE_GNUTLS
+            if(session != 0x0) {
+                do {
+                    r = gnutls_record_recv(session, chunk, sizeof(chunk));
+                } while(r == GNUTLS_E_AGAIN || r == GNUTLS_E_INTERRUPTED);
+            }
+            else
+#endif
+            {
+                do {
+                    r = recv(fd, chunk, sizeof(chunk), 0);
+                } while(r < 0 && errno == EINTR);
+            }
+            if(r <= 0)
+                return false;
+            buffer.append(chunk, r);
+            return true;
+        }
+
+        bool skip(uint64_t size) {
+            while(buffer.size() < size) {
+                size -= buffer.size();
+                buffer.clear();
+                if(!fill())
+                    return false;
+            }
+            buffer.erase(0, size);
+            return true;
+        }
+
+        bool read_line(std::string& line) {
+            size_t end;
+            while((end = buffer.find("\r\n")) == std::string::npos) {
+                if(!fill())
+                    return false;
+            }
+            line = buffer.substr(0, end);
+            buffer.erase(0, end + 2);
+            return true;
+        }
+};
+
+struct scenario {
+    std::string name;
+    std::string request;
+    bool tls;
+};
+
+struct client_state {
+    const scenario* sc;
+    int port;
+    uint64_t warmup_end;
+    uint64_t end;
+
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t bytes;
+    std::vector<uint32_t> latencies;
+};
+
+static void* run_client(void* arg) {
+    client_state* state = static_cast<client_state*>(arg);
+    client_connection connection(state->port, state->sc->tls);
+
+    uint64_t now;
+    while((now = now_microseconds()) < state->end) {
+        bool measured = now >= state->warmup_end;
+        if(!connection.is_open() && !connection.open()) {
+            if(measured)
+                state->errors++;
+            usleep(1000);
+            continue;
+        }
+
+        uint64_t body_size = 0;
+        bool keep_alive = false;
+        int status = -1;
+        uint64_t started = now_microseconds();
+        if(connection.write_all(state->sc->request))
+            status = connection.read_response(body_size, keep_alive);
+        uint64_t latency = now_microseconds() - started;
+
+        if(status < 0)
+            connection.close();
+        else if(!keep_alive)
+            connection.close();
+
+        if(!measured)
+            continue;
+        if(status != 200) {
+            state->errors++;
+            continue;
+        }
+        state->requests++;
+        state->bytes += body_size;
+        state->latencies.push_back(latency > 0xffffffffULL ? 0xffffffffU : static_cast<uint32_t>(latency));
+    }
+    return 0x0;
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+    if(sorted.empty())
+        return 0;
+    size_t index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static std::string run_scenario(const webserver& ws, const scenario& sc, int port, int clients, int warmup, int duration) {
+    alloc_stats allocs_before = ws.get_alloc_stats();
+    std::vector<client_state> states(clients);
+    std::vector<pthread_t> threads(clients);
+    uint64_t started = now_microseconds();
+    for(int i = 0; i < clients; i++) {
+        states[i].sc = &sc;
+        states[i].port = port;
+        states[i].warmup_end = started + static_cast<uint64_t>(warmup) * 1000000;
+        states[i].end = states[i].warmup_end + static_cast<uint64_t>(duration) * 1000000;
+        states[i].requests = 0;
+        states[i].errors = 0;
+        states[i].bytes = 0;
+        pthread_create(&threads[i], 0x0, &run_client, &states[i]);
+    }
+
+    uint64_t requests = 0, errors = 0, bytes = 0;
+    std::vector<uint32_t> latencies;
+    for(int i = 0; i < clients; i++) {
+        pthread_join(threads[i], 0x0);
+        requests += states[i].requests;
+        errors += states[i].errors;
+        bytes += states[i].bytes;
+        latencies.insert(latencies.end(), states[i].latencies.begin(), states[i].latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    alloc_stats allocs_after = ws.get_alloc_stats();
+
+    char throughput[32];
+    snprintf(throughput, sizeof(throughput), "%.1f", static_cast<double>(requests) / duration);
+    std::stringstream ss;
+    ss << "{\"name\": \"" << sc.name << "\""
+       << ", \"requests\": " << requests
+       << ", \"errors\": " << errors
+       << ", \"requests_per_second\": " << throughput
+       << ", \"body_bytes\": " << bytes
+       << ", \"latency_us\": {"
+       << "\"p50\": " << percentile(latencies, 50)
+       << ", \"p99\": " << percentile(latencies, 99)
+       << ", \"p999\": " << percentile(latencies, 99.9)
+       << ", \"max\": " << (latencies.empty() ? 0 : latencies.back())
+       << "}";
+    // Only with a library configured with --enable-alloc-accounting; warmup requests included.
+    unsigned long long served = allocs_after.requests - allocs_before.requests;
+    if(allocs_after.enabled && served > 0) {
+        char per_request[64];
+        snprintf(per_request, sizeof(per_request), "%.1f, \"allocated_bytes_per_request\": %.1f",
+                static_cast<double>(allocs_after.allocations - allocs_before.allocations) / served,
+                static_cast<double>(allocs_after.allocated_bytes - allocs_before.allocated_bytes) / served);
+        ss << ", \"allocations_per_request\": " << per_request;
+    }
+    ss << "}";
+    return ss.str();
+}
+
+static std::string get_request(const std::string& path) {
+    return "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+}
+
+static void usage(const char* name) {
+    std::cerr << "usage: " << name << " [--port <port>] [--server-threads <n>] [--clients <n>]" << std::endl
+              << "       [--warmup <seconds>] [--duration <seconds>] [--key <key.pem>] [--cert <cert.pem>]" << std::endl
+              << "       [--scenario <name>]..." << std::endl
+              << "scenarios: tiny_get param_route post_1mb file_download deferred_stream tls_get" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int port = 8080;
+    int server_threads = 4;
+    int clients = 4;
+    int warmup = 1;
+    int duration = 5;
+    std::string key = "key.pem";
+    std::string cert = "cert.pem";
+    std::vector<std::string> selected;
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if(i + 1 == argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        if(arg == "--port") port = atoi(value.c_str());
+        else if(arg == "--server-threads") server_threads = atoi(value.c_str());
+        else if(arg == "--clients") clients = atoi(value.c_str());
+        else if(arg == "--warmup") warmup = atoi(value.c_str());
+        else if(arg == "--duration") duration = atoi(value.c_str());
+        else if(arg == "--key") key = value;
+        else if(arg == "--cert") cert = value;
+        else if(arg == "--scenario") selected.push_back(value);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(clients < 1 || duration < 1 || warmup < 0 || server_threads < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string body(POST_SIZE, 'x');
+    std::vector<scenario> scenarios;
+    scenario tiny_get = { "tiny_get", get_request("/hello"), false };
+    scenario param_route = { "param_route", get_request("/users/42/posts/7"), false };
+    scenario post_1mb = { "post_1mb",
+        "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/octet-stream\r\n"
+        "Content-Length: " + std::to_string(POST_SIZE) + "\r\n\r\n" + body, false };
+    scenario file_download = { "file_download", get_request("/file"), false };
+    scenario deferred_stream = { "deferred_stream", get_request("/stream"), false };
+    scenario tls_get = { "tls_get", get_request("/hello"), true };
+    scenario all[] = { tiny_get, param_route, post_1mb, file_download, deferred_stream, tls_get };
+    for(size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if(selected.empty() || std::find(selected.begin(), selected.end(), all[i].name) != selected.end())
+            scenarios.push_back(all[i]);
+    }
+
+    char path[] = "/tmp/benchmark_loadXXXXXX";
+    int file = mkstemp(path);
+    if(file < 0) {
+        std::cerr << "cannot create the file to download" << std::endl;
+        return 1;
+    }
+    std::string content(FILE_SIZE, 'f');
+    bool written = write(file, content.data(), content.size()) == static_cast<ssize_t>(content.size());
+    ::close(file);
+    if(!written) {
+        unlink(path);
+        std::cerr << "cannot write the file to download" << std::endl;
+        return 1;
+    }
+
+    hello_resource hello;
+    param_resource param;
+    upload_resource upload;
+    file_resource download(path);
+    stream_resource stream;
+
+    webserver ws = create_webserver(port)
+        .start_method(http::http_utils::INTERNAL_SELECT)
+        .max_threads(server_threads);
+    ws.register_resource("/hello", &hello);
+    ws.register_resource("/users/{user}/posts/{post}", &param);
+    ws.register_resource("/upload", &upload);
+    ws.register_resource("/file", &download);
+    ws.register_resource("/stream", &stream);
+    ws.start(false);
+
+#ifdef HAVE_GNUTLS
+    gnutls_global_init();
+#endif
+
+    std::cout << "{\"server_threads\": " << server_threads
+              << ", \"clients\": " << clients
+              << ", \"warmup_seconds\": " << warmup
+              << ", \"duration_seconds\": " << duration
+              << ", \"scenarios\": [";
+    bool first = true;
+    for(std::vector<scenario>::const_iterator it = scenarios.begin(); it != scenarios.end(); ++it) {
+        std::string result;
+        if(it->tls) {
+#ifdef HAVE_GNUTLS
+            try {
+                webserver tls_ws = create_webserver(port + 1)
+                    .start_method(http::http_utils::INTERNAL_SELECT)
+                    .max_threads(server_threads)
+                    .use_ssl()
+                    .https_mem_key(key)
+                    .https_mem_cert(cert);
+                tls_ws.register_resource("/hello", &hello);
+                tls_ws.start(false);
+                result = run_scenario(tls_ws, *it, port + 1, clients, warmup, duration);
+                tls_ws.stop();
+            }
+            catch(const std::exception& e) {
+                std::cerr << it->name << ": " << e.what() << std::endl;
+            }
+#endif
+            if(result.empty())
+                result = "{\"name\": \"" + it->name + "\", \"skipped\": true}";
+        }
+        else {
+            result = run_scenario(ws, *it, port, clients, warmup, duration);
+        }
+        std::cout << (first ? "" : ", ") << std::endl << "  " << result;
+        first = false;
+    }
+    std::cout << std::endl << "]}" << std::endl;
+
+    ws.stop();
+#ifdef HAVE_GNUTLS
+    gnutls_global_deinit();
+#endif
+    unlink(path);
+    return 0;
+}
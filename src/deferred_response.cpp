@@ -18,7 +18,11 @@
      USA
 */
 
+#include <string.h>
+#include <algorithm>
 #include "deferred_response.hpp"
+#include "http_request.hpp"
+#include "details/compressor.hpp"
 
 using namespace std;
 
@@ -28,9 +32,103 @@ namespace httpserver
 namespace details
 {
 
-MHD_Response* get_raw_response_helper(void* cls, ssize_t (*cb)(void*, uint64_t, char*, size_t))
+const watched_request* request_watch(const http_request& req)
 {
-    return MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 1024, cb, cls, NULL);
+    return req.watched;
+}
+
+MHD_Response* get_raw_response_helper(void* cls, ssize_t (*cb)(void*, uint64_t, char*, size_t), void (*free_cb)(void*))
+{
+    return MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 1024, cb, cls, free_cb);
+}
+
+namespace
+{
+
+// Wraps the callback of a deferred_response compressing its output as it is produced.
+struct encoded_stream
+{
+    void* cls;
+    ssize_t (*cb)(void*, uint64_t, char*, size_t);
+    void (*free_cb)(void*);
+    std::unique_ptr<compression_stream> stream;
+    std::string chunk;
+    std::string pending;
+    size_t pending_pos;
+    uint64_t raw_pos;
+    bool finished;
+};
+
+ssize_t encoded_stream_reader(void* cls, uint64_t pos, char* buf, size_t max)
+{
+    encoded_stream* es = static_cast<encoded_stream*>(cls);
+
+    while(es->pending_pos == es->pending.size())
+    {
+        if(es->finished) return MHD_CONTENT_READER_END_OF_STREAM;
+
+        es->pending.clear();
+        es->pending_pos = 0;
+        es->chunk.resize(max);
+
+        ssize_t r = es->cb(es->cls, es->raw_pos, &es->chunk[0], max);
+        if(r == MHD_CONTENT_READER_END_OF_STREAM)
+        {
+            if(!es->stream->compress(0x0, 0, true, es->pending))
+                return MHD_CONTENT_READER_END_WITH_ERROR;
+            es->finished = true;
+        }
+        else if(r <= 0)
+        {
+            // nothing available yet or error: let MHD handle it
+            return r;
+        }
+        else
+        {
+            es->raw_pos += r;
+            // every chunk is flushed so that streamed data is not held back by the encoder
+            if(!es->stream->compress(es->chunk.data(), r, false, es->pending))
+                return MHD_CONTENT_READER_END_WITH_ERROR;
+        }
+    }
+
+    size_t len = std::min(max, es->pending.size() - es->pending_pos);
+    memcpy(buf, es->pending.data() + es->pending_pos, len);
+    es->pending_pos += len;
+    return len;
+}
+
+void encoded_stream_free(void* cls)
+{
+    encoded_stream* es = static_cast<encoded_stream*>(cls);
+    es->free_cb(es->cls);
+    delete es;
+}
+
+}
+
+MHD_Response* get_encoded_response_helper(void* cls, ssize_t (*cb)(void*, uint64_t, char*, size_t), void (*free_cb)(void*),
+        const std::string& encoding)
+{
+    compression_stream* stream = compression_stream::create(encoding);
+    if(stream == 0x0)
+    {
+        free_cb(cls);
+        return 0x0;
+    }
+
+    encoded_stream* es = new encoded_stream();
+    es->cls = cls;
+    es->cb = cb;
+    es->free_cb = free_cb;
+    es->stream.reset(stream);
+    es->pending_pos = 0;
+    es->raw_pos = 0;
+    es->finished = false;
+
+    return MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 1024,
+            &encoded_stream_reader, es, &encoded_stream_free
+    );
 }
 
 }
@@ -0,0 +1,279 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <chrono>
+#include <random>
+#include "details/abuse_tracker.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+const size_t PROBE_LENGTH = 8;
+const size_t SKETCH_WIDTH = 4096;
+const size_t BAN_TABLE_SIZE = 4096;
+
+uint64_t steady_ms()
+{
+    return chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+size_t round_up(size_t size)
+{
+    size_t rounded = PROBE_LENGTH;
+    while(rounded < size) rounded <<= 1;
+    return rounded;
+}
+
+uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+sliding_sketch::sliding_sketch(size_t width, uint64_t window_ms):
+    mask(round_up(width) - 1),
+    window_ms(window_ms == 0 ? 1 : window_ms)
+{
+    // Rows hashed from independent seeds: keys sharing a counter in one row rarely share it in the others.
+    std::random_device rd;
+    for(int row = 0; row < DEPTH; row++)
+        seeds[row] = ((uint64_t) rd() << 32) | rd();
+
+    for(int i = 0; i < 2; i++)
+    {
+        generations[i].window.store(0);
+        generations[i].counters = new std::atomic<uint32_t>[DEPTH * (mask + 1)];
+        for(size_t j = 0; j < DEPTH * (mask + 1); j++)
+            generations[i].counters[j].store(0, memory_order_relaxed);
+    }
+}
+
+sliding_sketch::~sliding_sketch()
+{
+    delete[] generations[0].counters;
+    delete[] generations[1].counters;
+}
+
+sliding_sketch::generation& sliding_sketch::current(uint64_t window)
+{
+    generation& g = generations[window & 1];
+    uint64_t seen = g.window.load(memory_order_acquire);
+    // The first thread noticing that a new window started recycles the sketch of two windows
+    // ago. Increments racing with the reset may be lost, which only makes the count lower.
+    if(seen < window && g.window.compare_exchange_strong(seen, window))
+    {
+        for(size_t j = 0; j < DEPTH * (mask + 1); j++)
+            g.counters[j].store(0, memory_order_relaxed);
+    }
+    return g;
+}
+
+size_t sliding_sketch::index(uint64_t key, int row) const
+{
+    return row * (mask + 1) + (mix(key ^ seeds[row]) & mask);
+}
+
+uint32_t sliding_sketch::estimate(const generation& g, uint64_t key) const
+{
+    uint32_t result = UINT32_MAX;
+    for(int row = 0; row < DEPTH; row++)
+    {
+        uint32_t v = g.counters[index(key, row)].load(memory_order_relaxed);
+        if(v < result) result = v;
+    }
+    return result;
+}
+
+unsigned int sliding_sketch::add(uint64_t key, uint64_t now)
+{
+    uint64_t window = now / window_ms;
+    generation& g = current(window);
+
+    uint32_t count = UINT32_MAX;
+    for(int row = 0; row < DEPTH; row++)
+    {
+        uint32_t v = g.counters[index(key, row)].fetch_add(1, memory_order_relaxed) + 1;
+        if(v < count) count = v;
+    }
+
+    const generation& previous = generations[(window + 1) & 1];
+    if(previous.window.load(memory_order_acquire) == window - 1)
+    {
+        double overlap = 1.0 - (double) (now % window_ms) / window_ms;
+        count += (uint32_t) (estimate(previous, key) * overlap);
+    }
+    return count;
+}
+
+temporary_bans::temporary_bans(size_t capacity):
+    mask(round_up(capacity) - 1)
+{
+    entries = new entry[mask + 1];
+    for(size_t i = 0; i <= mask; i++)
+    {
+        entries[i].key.store(0, memory_order_relaxed);
+        entries[i].until.store(0, memory_order_relaxed);
+    }
+}
+
+temporary_bans::~temporary_bans()
+{
+    delete[] entries;
+}
+
+void temporary_bans::ban(uint64_t key, uint64_t now, uint64_t until)
+{
+    size_t home = key & mask;
+    for(size_t i = 0; i < PROBE_LENGTH; i++)
+    {
+        entry& e = entries[(home + i) & mask];
+        if(e.key.load(memory_order_acquire) == key)
+        {
+            e.until.store(until, memory_order_release);
+            return;
+        }
+    }
+
+    for(;;)
+    {
+        entry* victim = &entries[home];
+        uint64_t victim_until = UINT64_MAX;
+        for(size_t i = 0; i < PROBE_LENGTH; i++)
+        {
+            entry& e = entries[(home + i) & mask];
+            uint64_t u = e.until.load(memory_order_acquire);
+            if(u < victim_until)
+            {
+                victim = &e;
+                victim_until = u;
+            }
+            if(u <= now) break;
+        }
+
+        uint64_t old_key = victim->key.load(memory_order_acquire);
+        if(victim->key.compare_exchange_strong(old_key, key))
+        {
+            victim->until.store(until, memory_order_release);
+            return;
+        }
+    }
+}
+
+bool temporary_bans::is_banned(uint64_t key, uint64_t now) const
+{
+    size_t home = key & mask;
+    for(size_t i = 0; i < PROBE_LENGTH; i++)
+    {
+        const entry& e = entries[(home + i) & mask];
+        if(e.key.load(memory_order_acquire) == key && e.until.load(memory_order_acquire) > now)
+            return true;
+    }
+    return false;
+}
+
+size_t temporary_bans::size(uint64_t now) const
+{
+    size_t count = 0;
+    for(size_t i = 0; i <= mask; i++)
+    {
+        if(entries[i].key.load(memory_order_relaxed) != 0 && entries[i].until.load(memory_order_relaxed) > now)
+            count++;
+    }
+    return count;
+}
+
+abuse_tracker::abuse_tracker(const unsigned int thresholds[CATEGORIES], int window_seconds, int ban_seconds):
+    ban_ms((uint64_t) (ban_seconds < 0 ? 0 : ban_seconds) * 1000),
+    start(steady_ms()),
+    bans(BAN_TABLE_SIZE)
+{
+    uint64_t window_ms = (uint64_t) (window_seconds <= 0 ? 1 : window_seconds) * 1000;
+    // Start the clock a couple of windows in so that window numbers never go below 1.
+    start -= 2 * window_ms;
+    for(int i = 0; i < CATEGORIES; i++)
+    {
+        this->thresholds[i] = thresholds[i];
+        sketches[i] = thresholds[i] != 0 ? new sliding_sketch(SKETCH_WIDTH, window_ms) : 0x0;
+    }
+}
+
+abuse_tracker::~abuse_tracker()
+{
+    for(int i = 0; i < CATEGORIES; i++)
+        delete sketches[i];
+}
+
+uint64_t abuse_tracker::now_ms() const
+{
+    return steady_ms() - start;
+}
+
+bool abuse_tracker::is_enabled() const
+{
+    for(int i = 0; i < CATEGORIES; i++)
+    {
+        if(thresholds[i] != 0)
+            return true;
+    }
+    return false;
+}
+
+bool abuse_tracker::record(category_T category, uint64_t key)
+{
+    if(sketches[category] == 0x0)
+        return false;
+
+    uint64_t now = now_ms();
+    if(sketches[category]->add(key, now) < thresholds[category])
+        return false;
+
+    bans.ban(key, now, now + ban_ms);
+    return true;
+}
+
+bool abuse_tracker::is_banned(uint64_t key) const
+{
+    return bans.is_banned(key, now_ms());
+}
+
+size_t abuse_tracker::banned_count() const
+{
+    return bans.size(now_ms());
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,243 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <errno.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <utility>
+#include "details/access_logger.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+// Rings of the current thread, one per logger it logged to.
+struct thread_rings
+{
+    vector<pair<uint64_t, shared_ptr<ring_state> > > rings;
+
+    ~thread_rings()
+    {
+        for(size_t i = 0; i < rings.size(); i++)
+            rings[i].second->orphaned.store(true, std::memory_order_release);
+    }
+};
+
+thread_local thread_rings local_rings;
+
+std::atomic<uint64_t> next_logger_id(1);
+
+} //namespace
+
+template <class T>
+log_ring<T>::log_ring(size_t capacity):
+    head(0),
+    tail(0)
+{
+    size_t size = 1;
+    while(size < capacity)
+        size <<= 1;
+    slots.resize(size);
+    mask = size - 1;
+}
+
+template <class T>
+bool log_ring<T>::push(T& record)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h - tail.load(std::memory_order_acquire) > mask)
+        return false;
+
+    std::swap(slots[h & mask], record);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+template <class T>
+size_t log_ring<T>::drain(vector<T>& records)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    for(size_t i = t; i != h; i++)
+        records.push_back(std::move(slots[i & mask]));
+    tail.store(h, std::memory_order_release);
+    return h - t;
+}
+
+template <class T>
+async_logger<T>::async_logger(sink_ptr sink, size_t ring_size, int flush_interval):
+    sink(sink),
+    ring_size(ring_size > 0 ? ring_size : 1),
+    flush_interval(flush_interval > 0 ? flush_interval : 1),
+    id(next_logger_id.fetch_add(1)),
+    dropped_records(0),
+    running(false)
+{
+    pthread_mutex_init(&rings_lock, NULL);
+    pthread_mutex_init(&flush_lock, NULL);
+    pthread_mutex_init(&state_lock, NULL);
+    pthread_cond_init(&wakeup, NULL);
+}
+
+template <class T>
+async_logger<T>::~async_logger()
+{
+    stop();
+    for(size_t i = 0; i < rings.size(); i++)
+        rings[i]->closed.store(true, std::memory_order_release);
+    pthread_cond_destroy(&wakeup);
+    pthread_mutex_destroy(&state_lock);
+    pthread_mutex_destroy(&flush_lock);
+    pthread_mutex_destroy(&rings_lock);
+}
+
+template <class T>
+log_ring<T>* async_logger<T>::local_ring()
+{
+    vector<pair<uint64_t, shared_ptr<ring_state> > >& owned = local_rings.rings;
+    for(size_t i = 0; i < owned.size(); i++)
+    {
+        // Ids are unique across the loggers of every record type.
+        if(owned[i].first == id)
+            return static_cast<log_ring<T>*>(owned[i].second.get());
+    }
+
+    // First record logged by this thread: forget the rings of the loggers destroyed since.
+    for(size_t i = owned.size(); i > 0; i--)
+    {
+        if(owned[i - 1].second->closed.load(std::memory_order_acquire))
+            owned.erase(owned.begin() + (i - 1));
+    }
+
+    shared_ptr<log_ring<T> > ring(new log_ring<T>(ring_size));
+    pthread_mutex_lock(&rings_lock);
+    rings.push_back(ring);
+    pthread_mutex_unlock(&rings_lock);
+    owned.push_back(make_pair(id, ring));
+    return ring.get();
+}
+
+template <class T>
+void async_logger<T>::log(T& record)
+{
+    if(!local_ring()->push(record))
+        dropped_records.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class T>
+size_t async_logger<T>::flush()
+{
+    pthread_mutex_lock(&flush_lock);
+    vector<shared_ptr<log_ring<T> > > current;
+    pthread_mutex_lock(&rings_lock);
+    current = rings;
+    pthread_mutex_unlock(&rings_lock);
+
+    vector<T> records;
+    bool orphans = false;
+    for(size_t i = 0; i < current.size(); i++)
+    {
+        // A ring is marked orphaned after the last push of its thread, so draining it afterwards gets everything.
+        bool orphaned = current[i]->orphaned.load(std::memory_order_acquire);
+        current[i]->drain(records);
+        orphans = orphans || orphaned;
+    }
+
+    if(orphans)
+    {
+        pthread_mutex_lock(&rings_lock);
+        for(size_t i = rings.size(); i > 0; i--)
+        {
+            if(rings[i - 1]->orphaned.load(std::memory_order_acquire) &&
+                    find(current.begin(), current.end(), rings[i - 1]) != current.end())
+                rings.erase(rings.begin() + (i - 1));
+        }
+        pthread_mutex_unlock(&rings_lock);
+    }
+
+    if(!records.empty() && sink != 0x0)
+        sink(records);
+    pthread_mutex_unlock(&flush_lock);
+    return records.size();
+}
+
+template <class T>
+void* async_logger<T>::drain_loop(void* self)
+{
+    async_logger<T>* logger = static_cast<async_logger<T>*>(self);
+    pthread_mutex_lock(&logger->state_lock);
+    while(logger->running)
+    {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        long long deadline = (now.tv_sec * 1000000LL + now.tv_usec) + logger->flush_interval * 1000LL;
+        struct timespec until;
+        until.tv_sec = deadline / 1000000;
+        until.tv_nsec = (deadline % 1000000) * 1000;
+        int result = 0;
+        while(logger->running && result != ETIMEDOUT)
+            result = pthread_cond_timedwait(&logger->wakeup, &logger->state_lock, &until);
+
+        pthread_mutex_unlock(&logger->state_lock);
+        logger->flush();
+        pthread_mutex_lock(&logger->state_lock);
+    }
+    pthread_mutex_unlock(&logger->state_lock);
+    return 0x0;
+}
+
+template <class T>
+void async_logger<T>::start()
+{
+    pthread_mutex_lock(&state_lock);
+    if(!running && pthread_create(&thread, NULL, &drain_loop, this) == 0)
+        running = true;
+    pthread_mutex_unlock(&state_lock);
+}
+
+template <class T>
+void async_logger<T>::stop()
+{
+    pthread_mutex_lock(&state_lock);
+    bool was_running = running;
+    running = false;
+    pthread_cond_signal(&wakeup);
+    pthread_mutex_unlock(&state_lock);
+
+    if(was_running)
+        pthread_join(thread, NULL);
+    flush();
+}
+
+template class log_ring<access_record>;
+template class async_logger<access_record>;
+template class log_ring<error_record>;
+template class async_logger<error_record>;
+
+} //details
+
+} //httpserver
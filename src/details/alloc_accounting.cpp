@@ -0,0 +1,145 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdlib.h>
+#include <new>
+#include "details/alloc_accounting.hpp"
+
+#ifdef HTTPSERVER_ALLOC_ACCOUNTING
+
+namespace
+{
+
+// Plain data: reading it from operator new needs neither initialization nor allocation.
+thread_local httpserver::details::alloc_counters counters;
+
+void* counted_allocation(size_t size)
+{
+    counters.allocations++;
+    counters.bytes += size;
+    if(size == 0)
+        size = 1;
+    void* p;
+    while((p = malloc(size)) == 0x0)
+    {
+        std::new_handler handler = std::get_new_handler();
+        if(handler == 0x0)
+            throw std::bad_alloc();
+        handler();
+    }
+    return p;
+}
+
+}
+
+void* operator new(size_t size)
+{
+    return counted_allocation(size);
+}
+
+void* operator new[](size_t size)
+{
+    return counted_allocation(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return counted_allocation(size);
+    }
+    catch(...)
+    {
+        return 0x0;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return counted_allocation(size);
+    }
+    catch(...)
+    {
+        return 0x0;
+    }
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
+}
+
+#endif //HTTPSERVER_ALLOC_ACCOUNTING
+
+namespace httpserver
+{
+
+namespace details
+{
+
+bool alloc_accounting_enabled()
+{
+#ifdef HTTPSERVER_ALLOC_ACCOUNTING
+    return true;
+#else
+    return false;
+#endif
+}
+
+alloc_counters thread_alloc_counters()
+{
+#ifdef HTTPSERVER_ALLOC_ACCOUNTING
+    return counters;
+#else
+    alloc_counters none = { 0, 0 };
+    return none;
+#endif
+}
+
+alloc_stats alloc_totals::get() const
+{
+    alloc_stats stats;
+    stats.enabled = alloc_accounting_enabled();
+    stats.requests = requests.get();
+    stats.allocations = allocations.get();
+    stats.allocated_bytes = bytes.get();
+    return stats;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,318 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include "details/compressor.hpp"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define COMPRESSION_CHUNK_SIZE 16384
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+#ifdef HAVE_ZLIB
+class gzip_stream : public compression_stream
+{
+    public:
+        gzip_stream()
+        {
+            memset(&zs, 0, sizeof(zs));
+            initialized = deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                    15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+
+        ~gzip_stream()
+        {
+            if(initialized) deflateEnd(&zs);
+        }
+
+        bool compress(const char* data, size_t size, bool finish, string& out)
+        {
+            if(!initialized) return false;
+
+            zs.next_in = (Bytef*) data;
+            zs.avail_in = size;
+
+            int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+            char buf[COMPRESSION_CHUNK_SIZE];
+            int ret;
+            do
+            {
+                zs.next_out = (Bytef*) buf;
+                zs.avail_out = sizeof(buf);
+                ret = deflate(&zs, flush);
+                if(ret == Z_STREAM_ERROR) return false;
+                out.append(buf, sizeof(buf) - zs.avail_out);
+            } while(zs.avail_out == 0 || (finish && ret != Z_STREAM_END));
+
+            return true;
+        }
+
+    private:
+        z_stream zs;
+        bool initialized;
+};
+#endif
+
+#ifdef HAVE_BROTLI
+class brotli_stream : public compression_stream
+{
+    public:
+        brotli_stream()
+        {
+            state = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+            // favour speed: bodies are compressed while the client waits
+            if(state) BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, 5);
+        }
+
+        ~brotli_stream()
+        {
+            if(state) BrotliEncoderDestroyInstance(state);
+        }
+
+        bool compress(const char* data, size_t size, bool finish, string& out)
+        {
+            if(!state) return false;
+
+            size_t avail_in = size;
+            const uint8_t* next_in = (const uint8_t*) data;
+            BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+
+            uint8_t buf[COMPRESSION_CHUNK_SIZE];
+            while(true)
+            {
+                size_t avail_out = sizeof(buf);
+                uint8_t* next_out = buf;
+                if(!BrotliEncoderCompressStream(state, op, &avail_in, &next_in,
+                            &avail_out, &next_out, NULL))
+                    return false;
+                out.append((const char*) buf, sizeof(buf) - avail_out);
+
+                if(avail_in == 0 && !BrotliEncoderHasMoreOutput(state) &&
+                        (!finish || BrotliEncoderIsFinished(state)))
+                    break;
+            }
+
+            return true;
+        }
+
+    private:
+        BrotliEncoderState* state;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class zstd_stream : public compression_stream
+{
+    public:
+        zstd_stream()
+        {
+            cctx = ZSTD_createCCtx();
+            if(cctx) ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 3);
+        }
+
+        ~zstd_stream()
+        {
+            if(cctx) ZSTD_freeCCtx(cctx);
+        }
+
+        bool compress(const char* data, size_t size, bool finish, string& out)
+        {
+            if(!cctx) return false;
+
+            ZSTD_inBuffer in = { data, size, 0 };
+            ZSTD_EndDirective mode = finish ? ZSTD_e_end : ZSTD_e_flush;
+
+            char buf[COMPRESSION_CHUNK_SIZE];
+            size_t remaining;
+            do
+            {
+                ZSTD_outBuffer output = { buf, sizeof(buf), 0 };
+                remaining = ZSTD_compressStream2(cctx, &output, &in, mode);
+                if(ZSTD_isError(remaining)) return false;
+                out.append(buf, output.pos);
+            } while(remaining != 0);
+
+            return true;
+        }
+
+    private:
+        ZSTD_CCtx* cctx;
+};
+#endif
+
+uint64_t fnv1a(const string& s)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < s.size(); i++)
+    {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+}
+
+compression_stream* compression_stream::create(const string& encoding)
+{
+#ifdef HAVE_ZLIB
+    if(encoding == "gzip") return new gzip_stream();
+#endif
+#ifdef HAVE_BROTLI
+    if(encoding == "br") return new brotli_stream();
+#endif
+#ifdef HAVE_ZSTD
+    if(encoding == "zstd") return new zstd_stream();
+#endif
+    return 0x0;
+}
+
+bool compression_supported(const string& encoding)
+{
+#ifdef HAVE_ZLIB
+    if(encoding == "gzip") return true;
+#endif
+#ifdef HAVE_BROTLI
+    if(encoding == "br") return true;
+#endif
+#ifdef HAVE_ZSTD
+    if(encoding == "zstd") return true;
+#endif
+    return false;
+}
+
+shared_ptr<const string> compress(const string& encoding, const string& content)
+{
+    std::unique_ptr<compression_stream> stream(compression_stream::create(encoding));
+    shared_ptr<string> compressed(new string());
+    compressed->reserve(content.size() / 2);
+    if(!stream || !stream->compress(content.data(), content.size(), true, *compressed))
+        return shared_ptr<const string>();
+    return compressed;
+}
+
+bool compression_cache::cache_key::operator<(const cache_key& b) const
+{
+    if(size != b.size) return size < b.size;
+    if(hash != b.hash) return hash < b.hash;
+    return encoding < b.encoding;
+}
+
+compression_cache::compression_cache(size_t max_bytes):
+    max_bytes(max_bytes),
+    used_bytes(0)
+{
+    pthread_mutex_init(&mutex, NULL);
+}
+
+compression_cache::~compression_cache()
+{
+    clear();
+    pthread_mutex_destroy(&mutex);
+}
+
+void compression_cache::evict()
+{
+    while(used_bytes > max_bytes)
+    {
+        map<cache_key, cached_value>::iterator it = entries.find(lru.back());
+        used_bytes -= it->second.content.size() + it->second.body->size();
+        entries.erase(it);
+        lru.pop_back();
+    }
+}
+
+void compression_cache::clear()
+{
+    pthread_mutex_lock(&mutex);
+    entries.clear();
+    lru.clear();
+    used_bytes = 0;
+    pthread_mutex_unlock(&mutex);
+}
+
+shared_ptr<const string> compression_cache::get(const string& encoding, const string& content)
+{
+    if(!compression_supported(encoding))
+        return shared_ptr<const string>();
+
+    cache_key key;
+    key.encoding = encoding;
+    key.hash = fnv1a(content);
+    key.size = content.size();
+
+    shared_ptr<const string> body;
+
+    pthread_mutex_lock(&mutex);
+    map<cache_key, cached_value>::iterator it = entries.find(key);
+    if(it != entries.end() && it->second.content == content)
+    {
+        body = it->second.body;
+        lru.splice(lru.begin(), lru, it->second.position);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if(!body)
+    {
+        body = compress(encoding, content);
+        if(!body)
+            return shared_ptr<const string>();
+
+        // A content colliding with a cached one is compressed on every request rather than replacing it.
+        pthread_mutex_lock(&mutex);
+        if(content.size() + body->size() <= max_bytes && entries.find(key) == entries.end())
+        {
+            lru.push_front(key);
+            cached_value& value = entries[key];
+            value.content = content;
+            value.body = body;
+            value.position = lru.begin();
+            used_bytes += content.size() + body->size();
+            evict();
+        }
+        pthread_mutex_unlock(&mutex);
+    }
+
+    if(body->size() >= content.size())
+        return shared_ptr<const string>();
+    return body;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,79 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "details/config_cell.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+config_cell::config_cell(const runtime_config& config):
+    sequence(0)
+{
+    pthread_mutex_init(&write_lock, NULL);
+    store(config);
+}
+
+config_cell::~config_cell()
+{
+    pthread_mutex_destroy(&write_lock);
+}
+
+runtime_config config_cell::load() const
+{
+    runtime_config config;
+    while(true)
+    {
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        if(before & 1)
+            continue;
+        config.connection_timeout = connection_timeout.load(std::memory_order_relaxed);
+        config.per_IP_connection_limit = per_IP_connection_limit.load(std::memory_order_relaxed);
+        config.content_size_limit = content_size_limit.load(std::memory_order_relaxed);
+        config.default_policy = static_cast<http::http_utils::policy_T>(default_policy.load(std::memory_order_relaxed));
+        config.log_access = log_access.load(std::memory_order_relaxed);
+        config.log_error = log_error.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(sequence.load(std::memory_order_relaxed) == before)
+            return config;
+    }
+}
+
+void config_cell::store(const runtime_config& config)
+{
+    pthread_mutex_lock(&write_lock);
+    uint64_t current = sequence.load(std::memory_order_relaxed);
+    sequence.store(current + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    connection_timeout.store(config.connection_timeout, std::memory_order_relaxed);
+    per_IP_connection_limit.store(config.per_IP_connection_limit, std::memory_order_relaxed);
+    content_size_limit.store(config.content_size_limit, std::memory_order_relaxed);
+    default_policy.store(config.default_policy, std::memory_order_relaxed);
+    log_access.store(config.log_access, std::memory_order_relaxed);
+    log_error.store(config.log_error, std::memory_order_relaxed);
+    sequence.store(current + 2, std::memory_order_release);
+    pthread_mutex_unlock(&write_lock);
+}
+
+} //details
+
+} //httpserver
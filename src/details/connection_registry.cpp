@@ -0,0 +1,196 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef HAVE_TCP_INFO_BYTES
+#include <linux/tcp.h>
+#endif
+#include "http_utils.hpp"
+#include "details/connection_registry.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+uint64_t now_microseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+}
+
+bool socket_bytes(int socket_fd, uint64_t& received, uint64_t& sent)
+{
+    received = 0;
+    sent = 0;
+#ifdef HAVE_TCP_INFO_BYTES
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+    memset(&info, 0, sizeof(info));
+    if(socket_fd >= 0 && getsockopt(socket_fd, IPPROTO_TCP, TCP_INFO, &info, &length) == 0 &&
+            length >= offsetof(struct tcp_info, tcpi_bytes_received) + sizeof(info.tcpi_bytes_received))
+    {
+        received = info.tcpi_bytes_received;
+        sent = info.tcpi_bytes_acked;
+        return true;
+    }
+#else
+    (void) socket_fd;
+#endif
+    return false;
+}
+
+void connection_entry::set_state(connection_info::state_T state)
+{
+    this->state_since.store(now_microseconds(), std::memory_order_relaxed);
+    this->thread.store(pthread_self(), std::memory_order_relaxed);
+    this->state.store(state, std::memory_order_release);
+}
+
+connection_registry::connection_registry():
+    first(0x0),
+    next_id(1),
+    count(0)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+connection_registry::~connection_registry()
+{
+    while(first != 0x0)
+    {
+        connection_entry* entry = first;
+        first = entry->next;
+        delete entry;
+    }
+    pthread_mutex_destroy(&lock);
+}
+
+connection_entry* connection_registry::add(int socket_fd, const struct sockaddr* client_addr)
+{
+    connection_entry* entry = new connection_entry();
+    entry->socket_fd = socket_fd;
+    entry->peer_port = 0;
+    if(client_addr != 0x0 && (client_addr->sa_family == AF_INET || client_addr->sa_family == AF_INET6))
+    {
+        entry->peer = http::get_ip_str(client_addr);
+        entry->peer_port = http::get_port(client_addr);
+    }
+    clock_gettime(CLOCK_REALTIME, &entry->started);
+    entry->tls_context = 0x0;
+    entry->requests.store(0, std::memory_order_relaxed);
+    entry->set_state(connection_info::IDLE);
+    entry->prev = 0x0;
+
+    pthread_mutex_lock(&lock);
+    entry->id = next_id++;
+    entry->next = first;
+    if(first != 0x0)
+        first->prev = entry;
+    first = entry;
+    count++;
+    pthread_mutex_unlock(&lock);
+    return entry;
+}
+
+void connection_registry::remove(connection_entry* entry)
+{
+    pthread_mutex_lock(&lock);
+    if(entry->prev != 0x0)
+        entry->prev->next = entry->next;
+    else
+        first = entry->next;
+    if(entry->next != 0x0)
+        entry->next->prev = entry->prev;
+    count--;
+    pthread_mutex_unlock(&lock);
+    delete entry;
+}
+
+vector<connection_info> connection_registry::snapshot() const
+{
+    vector<connection_info> connections;
+    uint64_t now = now_microseconds();
+
+    // Entries are only freed once removed, and their sockets are closed after that.
+    pthread_mutex_lock(&lock);
+    connections.reserve(count);
+    for(connection_entry* entry = first; entry != 0x0; entry = entry->next)
+    {
+        connection_info info;
+        info.id = entry->id;
+        info.peer = entry->peer;
+        info.peer_port = entry->peer_port;
+        info.started = entry->started;
+        info.requests = entry->requests.load(std::memory_order_relaxed);
+        info.state = static_cast<connection_info::state_T>(entry->state.load(std::memory_order_acquire));
+        uint64_t since = entry->state_since.load(std::memory_order_relaxed);
+        info.state_age = now > since ? now - since : 0;
+        info.thread = entry->thread.load(std::memory_order_relaxed);
+        socket_bytes(entry->socket_fd, info.bytes_received, info.bytes_sent);
+        connections.push_back(info);
+    }
+    pthread_mutex_unlock(&lock);
+    return connections;
+}
+
+bool connection_registry::close(uint64_t id)
+{
+    bool found = false;
+    pthread_mutex_lock(&lock);
+    for(connection_entry* entry = first; entry != 0x0; entry = entry->next)
+    {
+        if(entry->id == id)
+        {
+            // Shutting the socket down (rather than closing it) leaves the descriptor to libmicrohttpd.
+            shutdown(entry->socket_fd, SHUT_RDWR);
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return found;
+}
+
+size_t connection_registry::size() const
+{
+    pthread_mutex_lock(&lock);
+    size_t current = count;
+    pthread_mutex_unlock(&lock);
+    return current;
+}
+
+} //details
+
+} //httpserver
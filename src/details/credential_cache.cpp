@@ -0,0 +1,202 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include <random>
+#include "details/credential_cache.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+inline uint64_t rotl(uint64_t x, int b)
+{
+    return (x << b) | (x >> (64 - b));
+}
+
+inline void sipround(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+{
+    v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+    v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+}
+
+inline uint64_t load_le64(const unsigned char* p)
+{
+    uint64_t v = 0;
+    for(int i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+}
+
+uint64_t siphash24(uint64_t k0, uint64_t k1, const void* data, size_t len)
+{
+    const unsigned char* in = static_cast<const unsigned char*>(data);
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    size_t blocks = len / 8;
+    for(size_t i = 0; i < blocks; i++)
+    {
+        uint64_t m = load_le64(in + i * 8);
+        v3 ^= m;
+        sipround(v0, v1, v2, v3);
+        sipround(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    uint64_t b = static_cast<uint64_t>(len) << 56;
+    const unsigned char* tail = in + blocks * 8;
+    for(size_t i = 0; i < (len & 7); i++)
+        b |= static_cast<uint64_t>(tail[i]) << (8 * i);
+
+    v3 ^= b;
+    sipround(v0, v1, v2, v3);
+    sipround(v0, v1, v2, v3);
+    v0 ^= b;
+    v2 ^= 0xff;
+    sipround(v0, v1, v2, v3);
+    sipround(v0, v1, v2, v3);
+    sipround(v0, v1, v2, v3);
+    sipround(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+credential_cache::credential_cache(verifier_ptr verifier, size_t max_entries, int ttl):
+    verifier(verifier),
+    shard_capacity((max_entries + SHARDS - 1) / SHARDS),
+    ttl(ttl)
+{
+    random_device rd;
+    for(int i = 0; i < 4; i++)
+        keys[i] = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    for(int i = 0; i < SHARDS; i++)
+        pthread_mutex_init(&shards[i].lock, NULL);
+}
+
+credential_cache::~credential_cache()
+{
+    for(int i = 0; i < SHARDS; i++)
+        pthread_mutex_destroy(&shards[i].lock);
+}
+
+credential_cache::digest credential_cache::hash(const string& user, const string& pass) const
+{
+    // The user name cannot contain ':' in basic authentication, so the joined string is unambiguous.
+    string joined;
+    joined.reserve(user.size() + pass.size() + 1);
+    joined.append(user);
+    joined.push_back(':');
+    joined.append(pass);
+    digest d(
+            siphash24(keys[0], keys[1], joined.data(), joined.size()),
+            siphash24(keys[2], keys[3], joined.data(), joined.size())
+    );
+    // Do not leave the password around in freed memory longer than needed.
+    memset(&joined[0], 0, joined.size());
+    return d;
+}
+
+bool credential_cache::lookup(const digest& d, time_t now)
+{
+    shard& s = shards[d.second % SHARDS];
+    pthread_mutex_lock(&s.lock);
+    unordered_map<digest, time_t, key_hash>::iterator it = s.entries.find(d);
+    bool found = it != s.entries.end() && it->second > now;
+    pthread_mutex_unlock(&s.lock);
+    return found;
+}
+
+void credential_cache::insert(const digest& d, time_t now)
+{
+    shard& s = shards[d.second % SHARDS];
+    time_t expires = now + ttl;
+    pthread_mutex_lock(&s.lock);
+    while(!s.order.empty() && (s.order.front().second <= now || s.entries.size() >= shard_capacity))
+    {
+        unordered_map<digest, time_t, key_hash>::iterator it = s.entries.find(s.order.front().first);
+        // Entries re-inserted after expiring leave a stale record behind: skip it.
+        if(it != s.entries.end() && it->second == s.order.front().second)
+            s.entries.erase(it);
+        s.order.pop_front();
+    }
+    s.entries[d] = expires;
+    s.order.push_back(make_pair(d, expires));
+    pthread_mutex_unlock(&s.lock);
+}
+
+bool credential_cache::check(const string& user, const string& pass)
+{
+    if(verifier == 0x0)
+        return false;
+
+    if(shard_capacity == 0 || ttl <= 0)
+        return verifier(user, pass);
+
+    digest d = hash(user, pass);
+    time_t now = time(0x0);
+    if(lookup(d, now))
+        return true;
+
+    if(!verifier(user, pass))
+        return false;
+
+    insert(d, now);
+    return true;
+}
+
+void credential_cache::clear()
+{
+    for(int i = 0; i < SHARDS; i++)
+    {
+        pthread_mutex_lock(&shards[i].lock);
+        shards[i].entries.clear();
+        shards[i].order.clear();
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+}
+
+size_t credential_cache::size() const
+{
+    size_t total = 0;
+    for(int i = 0; i < SHARDS; i++)
+    {
+        pthread_mutex_lock(&shards[i].lock);
+        total += shards[i].entries.size();
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+    return total;
+}
+
+} //details
+
+} //httpserver
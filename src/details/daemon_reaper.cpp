@@ -0,0 +1,147 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <microhttpd.h>
+#include "details/daemon_reaper.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+const long POLL_INTERVAL = 20; // milliseconds
+
+uint64_t now_milliseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+bool drained(struct MHD_Daemon* daemon)
+{
+    const union MHD_DaemonInfo* info = MHD_get_daemon_info(daemon, MHD_DAEMON_INFO_CURRENT_CONNECTIONS);
+    return info != 0x0 && info->num_connections == 0;
+}
+
+}
+
+daemon_reaper::daemon_reaper():
+    running(false),
+    accepting(0x0)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&wakeup, NULL);
+}
+
+daemon_reaper::~daemon_reaper()
+{
+    stop();
+    pthread_cond_destroy(&wakeup);
+    pthread_mutex_destroy(&lock);
+}
+
+void daemon_reaper::retire(struct MHD_Daemon* daemon, int timeout)
+{
+    retired_daemon retired;
+    retired.daemon = daemon;
+    retired.deadline = now_milliseconds() + (timeout > 0 ? timeout : 0);
+    pthread_mutex_lock(&lock);
+    daemons.push_back(retired);
+    if(!running && pthread_create(&thread, NULL, &reap_loop, this) == 0)
+        running = true;
+    pthread_mutex_unlock(&lock);
+}
+
+void* daemon_reaper::reap_loop(void* self)
+{
+    daemon_reaper* reaper = static_cast<daemon_reaper*>(self);
+    pthread_mutex_lock(&reaper->lock);
+    while(reaper->running)
+    {
+        uint64_t now = now_milliseconds();
+        for(size_t i = 0; i < reaper->daemons.size(); )
+        {
+            retired_daemon retired = reaper->daemons[i];
+            if(now < retired.deadline && !drained(retired.daemon))
+            {
+                i++;
+                continue;
+            }
+            reaper->daemons.erase(reaper->daemons.begin() + i);
+            // Stopping a daemon joins its threads, which may be waiting on callbacks of the server.
+            pthread_mutex_unlock(&reaper->lock);
+            MHD_stop_daemon(retired.daemon);
+            pthread_mutex_lock(&reaper->lock);
+        }
+
+        struct timeval current;
+        gettimeofday(&current, NULL);
+        long long deadline = (current.tv_sec * 1000000LL + current.tv_usec) + POLL_INTERVAL * 1000LL;
+        struct timespec until;
+        until.tv_sec = deadline / 1000000;
+        until.tv_nsec = (deadline % 1000000) * 1000;
+        int result = 0;
+        while(reaper->running && result != ETIMEDOUT)
+            result = pthread_cond_timedwait(&reaper->wakeup, &reaper->lock, &until);
+    }
+    pthread_mutex_unlock(&reaper->lock);
+    return 0x0;
+}
+
+void daemon_reaper::stop()
+{
+    pthread_mutex_lock(&lock);
+    bool was_running = running;
+    running = false;
+    pthread_cond_signal(&wakeup);
+    pthread_mutex_unlock(&lock);
+
+    if(was_running)
+        pthread_join(thread, NULL);
+
+    vector<retired_daemon> remaining;
+    pthread_mutex_lock(&lock);
+    remaining.swap(daemons);
+    pthread_mutex_unlock(&lock);
+    for(size_t i = 0; i < remaining.size(); i++)
+        MHD_stop_daemon(remaining[i].daemon);
+}
+
+size_t daemon_reaper::size() const
+{
+    pthread_mutex_lock(&lock);
+    size_t count = daemons.size();
+    pthread_mutex_unlock(&lock);
+    return count;
+}
+
+} //details
+
+} //httpserver
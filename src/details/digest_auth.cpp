@@ -0,0 +1,482 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdexcept>
+#if defined(HAVE_GNUTLS)
+#include <gnutls/gnutls.h>
+#include <gnutls/crypto.h>
+#elif defined(__MINGW32__) || defined(__CYGWIN32__)
+#include <random>
+#endif
+#include "details/digest_auth.hpp"
+#include "string_utilities.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+inline uint32_t rotl32(uint32_t x, int b)
+{
+    return (x << b) | (x >> (32 - b));
+}
+
+inline uint32_t rotr32(uint32_t x, int b)
+{
+    return (x >> b) | (x << (32 - b));
+}
+
+string to_hex(const unsigned char* data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    string result(len * 2, '0');
+    for(size_t i = 0; i < len; i++)
+    {
+        result[2 * i] = digits[data[i] >> 4];
+        result[2 * i + 1] = digits[data[i] & 0x0f];
+    }
+    return result;
+}
+
+// Message padded as required by MD5 and SHA-256 (which only differ in the byte order of the length).
+string pad_message(const string& data, bool big_endian)
+{
+    string padded(data);
+    uint64_t bits = (uint64_t) data.size() * 8;
+    padded.push_back((char) 0x80);
+    while(padded.size() % 64 != 56)
+        padded.push_back('\0');
+    for(int i = 0; i < 8; i++)
+    {
+        int shift = big_endian ? 56 - 8 * i : 8 * i;
+        padded.push_back((char) ((bits >> shift) & 0xff));
+    }
+    return padded;
+}
+
+const uint32_t MD5_K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+const int MD5_R[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+}
+
+string md5_hex(const string& data)
+{
+    uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    string padded = pad_message(data, false);
+    const unsigned char* p = (const unsigned char*) padded.data();
+
+    for(size_t block = 0; block < padded.size(); block += 64)
+    {
+        uint32_t m[16];
+        for(int i = 0; i < 16; i++)
+        {
+            const unsigned char* w = p + block + 4 * i;
+            m[i] = w[0] | (w[1] << 8) | (w[2] << 16) | ((uint32_t) w[3] << 24);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+        for(int i = 0; i < 64; i++)
+        {
+            uint32_t f;
+            int g;
+            if(i < 16) { f = (b & c) | (~b & d); g = i; }
+            else if(i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) % 16; }
+            else if(i < 48) { f = b ^ c ^ d; g = (3 * i + 5) % 16; }
+            else { f = c ^ (b | ~d); g = (7 * i) % 16; }
+
+            uint32_t tmp = d;
+            d = c;
+            c = b;
+            b = b + rotl32(a + f + MD5_K[i] + m[g], MD5_R[i]);
+            a = tmp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    }
+
+    unsigned char digest[16];
+    for(int i = 0; i < 16; i++)
+        digest[i] = (h[i / 4] >> (8 * (i % 4))) & 0xff;
+    return to_hex(digest, sizeof(digest));
+}
+
+string sha256_hex(const string& data)
+{
+    uint32_t h[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    string padded = pad_message(data, true);
+    const unsigned char* p = (const unsigned char*) padded.data();
+
+    for(size_t block = 0; block < padded.size(); block += 64)
+    {
+        uint32_t w[64];
+        for(int i = 0; i < 16; i++)
+        {
+            const unsigned char* b = p + block + 4 * i;
+            w[i] = ((uint32_t) b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+        }
+        for(int i = 16; i < 64; i++)
+        {
+            uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+        uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+        for(int i = 0; i < 64; i++)
+        {
+            uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = k + s1 + ch + SHA256_K[i] + w[i];
+            uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+            k = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+    }
+
+    unsigned char digest[32];
+    for(int i = 0; i < 32; i++)
+        digest[i] = (h[i / 4] >> (24 - 8 * (i % 4))) & 0xff;
+    return to_hex(digest, sizeof(digest));
+}
+
+sharded_nonce_store::sharded_nonce_store(size_t capacity, int timeout):
+    shard_capacity(capacity / SHARDS + (capacity % SHARDS ? 1 : 0)),
+    timeout(timeout),
+    next_shard(0),
+    issued(0),
+    stale(0),
+    replays(0)
+{
+    for(int i = 0; i < SHARDS; i++)
+        pthread_mutex_init(&shards[i].lock, NULL);
+}
+
+sharded_nonce_store::~sharded_nonce_store()
+{
+    for(int i = 0; i < SHARDS; i++)
+        pthread_mutex_destroy(&shards[i].lock);
+}
+
+void sharded_nonce_store::expire(shard& s, time_t now)
+{
+    while(!s.order.empty() &&
+            (s.order.size() > shard_capacity || now - s.order.front().second > timeout))
+    {
+        // The entry may be gone already (e.g. found stale by check).
+        unordered_map<string, entry>::iterator it = s.entries.find(s.order.front().first);
+        if(it != s.entries.end() && it->second.created == s.order.front().second)
+            s.entries.erase(it);
+        s.order.pop_front();
+    }
+}
+
+string sharded_nonce_store::issue()
+{
+    // The shard is encoded in the first character so that check does not need to hash the nonce.
+    unsigned int index = next_shard++ % SHARDS;
+    shard& s = shards[index];
+    time_t now = time(0);
+
+    // Nonces must not be predictable from the ones already issued.
+    unsigned char bytes[16];
+    if(!secure_random(bytes, sizeof(bytes)))
+        throw std::runtime_error("Unable to generate a nonce");
+
+    pthread_mutex_lock(&s.lock);
+    string nonce = string(1, "0123456789abcdef"[index]) + to_hex(bytes, sizeof(bytes));
+
+    entry e;
+    e.created = now;
+    e.max_nc = 0;
+    e.seen = 0;
+    s.entries[nonce] = e;
+    s.order.push_back(make_pair(nonce, now));
+    expire(s, now);
+    pthread_mutex_unlock(&s.lock);
+
+    issued++;
+    return nonce;
+}
+
+nonce_store::status_T sharded_nonce_store::check(const string& nonce, uint64_t nc)
+{
+    if(nonce.empty() || nc == 0)
+        return INVALID;
+
+    const char* digits = "0123456789abcdef";
+    const char* pos = strchr(digits, nonce[0]);
+    if(pos == 0x0 || *pos == '\0')
+    {
+        stale++;
+        return STALE;
+    }
+    shard& s = shards[pos - digits];
+    time_t now = time(0);
+
+    status_T result;
+    pthread_mutex_lock(&s.lock);
+    unordered_map<string, entry>::iterator it = s.entries.find(nonce);
+    if(it == s.entries.end() || now - it->second.created > timeout)
+    {
+        if(it != s.entries.end())
+            s.entries.erase(it);
+        result = STALE;
+    }
+    else
+    {
+        entry& e = it->second;
+        if(nc > e.max_nc)
+        {
+            uint64_t shift = nc - e.max_nc;
+            e.seen = shift >= WINDOW ? 0 : e.seen << shift;
+            e.seen |= 1;
+            e.max_nc = nc;
+            result = VALID;
+        }
+        else if(e.max_nc - nc < WINDOW && !(e.seen & ((uint64_t) 1 << (e.max_nc - nc))))
+        {
+            e.seen |= (uint64_t) 1 << (e.max_nc - nc);
+            result = VALID;
+        }
+        else
+        {
+            result = INVALID;
+        }
+    }
+    pthread_mutex_unlock(&s.lock);
+
+    if(result == STALE)
+        stale++;
+    else if(result == INVALID)
+        replays++;
+    return result;
+}
+
+nonce_stats sharded_nonce_store::get_stats() const
+{
+    nonce_stats stats;
+    stats.capacity = shard_capacity * SHARDS;
+    stats.size = 0;
+    for(int i = 0; i < SHARDS; i++)
+    {
+        pthread_mutex_lock(&shards[i].lock);
+        stats.size += shards[i].entries.size();
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+    stats.issued = issued.load();
+    stats.stale = stale.load();
+    stats.replays = replays.load();
+    return stats;
+}
+
+namespace
+{
+
+bool is_token_char(char c)
+{
+    return isalnum((unsigned char) c) || strchr("!#$%&'*+-.^_`|~", c) != 0x0;
+}
+
+}
+
+bool parse_digest_authorization(const string& header, digest_credentials& credentials)
+{
+    size_t pos = header.find_first_not_of(" \t");
+    if(pos == string::npos || header.size() - pos < 7 ||
+            string_utilities::to_lower_copy(header.substr(pos, 6)) != "digest" ||
+            (header[pos + 6] != ' ' && header[pos + 6] != '\t'))
+        return false;
+    pos += 7;
+
+    credentials = digest_credentials();
+    while(true)
+    {
+        pos = header.find_first_not_of(" \t,", pos);
+        if(pos == string::npos) break;
+
+        size_t name_end = pos;
+        while(name_end < header.size() && is_token_char(header[name_end])) name_end++;
+        if(name_end == pos) return false;
+        string name = string_utilities::to_lower_copy(header.substr(pos, name_end - pos));
+
+        pos = header.find_first_not_of(" \t", name_end);
+        if(pos == string::npos || header[pos] != '=') return false;
+        pos = header.find_first_not_of(" \t", pos + 1);
+        if(pos == string::npos) return false;
+
+        string value;
+        if(header[pos] == '"')
+        {
+            pos++;
+            while(pos < header.size() && header[pos] != '"')
+            {
+                if(header[pos] == '\\' && pos + 1 < header.size()) pos++;
+                value.push_back(header[pos++]);
+            }
+            if(pos == header.size()) return false;
+            pos++;
+        }
+        else
+        {
+            size_t value_end = pos;
+            while(value_end < header.size() && is_token_char(header[value_end])) value_end++;
+            value = header.substr(pos, value_end - pos);
+            pos = value_end;
+        }
+
+        if(name == "username") credentials.username = value;
+        else if(name == "realm") credentials.realm = value;
+        else if(name == "nonce") credentials.nonce = value;
+        else if(name == "uri") credentials.uri = value;
+        else if(name == "response") credentials.response = value;
+        else if(name == "algorithm") credentials.algorithm = value;
+        else if(name == "cnonce") credentials.cnonce = value;
+        else if(name == "opaque") credentials.opaque = value;
+        else if(name == "qop") credentials.qop = value;
+        else if(name == "nc") credentials.nc = value;
+    }
+
+    return credentials.username != "" && credentials.nonce != "" &&
+        credentials.uri != "" && credentials.response != "";
+}
+
+string digest_response(const digest_credentials& credentials,
+        const string& algorithm, const string& password, const string& method
+)
+{
+    string (*hash)(const string&);
+    string name = string_utilities::to_upper_copy(algorithm);
+    if(name == "" || name == "MD5")
+        hash = &md5_hex;
+    else if(name == "SHA-256")
+        hash = &sha256_hex;
+    else
+        return "";
+
+    string ha1 = hash(credentials.username + ":" + credentials.realm + ":" + password);
+    string ha2 = hash(method + ":" + credentials.uri);
+    return hash(ha1 + ":" + credentials.nonce + ":" + credentials.nc + ":" +
+            credentials.cnonce + ":" + credentials.qop + ":" + ha2
+    );
+}
+
+bool equal_digests(const string& expected, const string& received)
+{
+    if(expected.size() != received.size())
+        return false;
+    unsigned char difference = 0;
+    for(size_t i = 0; i < expected.size(); i++)
+        difference |= expected[i] ^ received[i];
+    return difference == 0;
+}
+
+bool secure_random(unsigned char* buffer, size_t size)
+{
+#if defined(HAVE_GNUTLS)
+    return gnutls_rnd(GNUTLS_RND_NONCE, buffer, size) == 0;
+#elif defined(__MINGW32__) || defined(__CYGWIN32__)
+    // Backed by the system generator (rand_s) on this platform.
+    std::random_device rd;
+    for(size_t i = 0; i < size; i++)
+        buffer[i] = rd() & 0xff;
+    return true;
+#else
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    size_t filled = 0;
+    while(filled < size)
+    {
+        ssize_t n = read(fd, buffer + filled, size - filled);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            break;
+        filled += n;
+    }
+    close(fd);
+    return filled == size;
+#endif
+}
+
+string digest_challenge(const string& realm, const string& nonce,
+        const string& opaque, bool stale
+)
+{
+    string escaped;
+    for(size_t i = 0; i < realm.size(); i++)
+    {
+        if(realm[i] == '"' || realm[i] == '\\') escaped.push_back('\\');
+        escaped.push_back(realm[i]);
+    }
+
+    string params = "realm=\"" + escaped + "\", qop=\"auth\", nonce=\"" + nonce +
+        "\", opaque=\"" + opaque + "\"" + (stale ? ", stale=true" : "");
+    return "Digest " + params + ", algorithm=SHA-256, Digest " + params + ", algorithm=MD5";
+}
+
+}
+
+}
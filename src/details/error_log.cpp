@@ -0,0 +1,163 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "details/error_log.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+const size_t MESSAGE_SIZE = 1024;
+
+thread_local char message_buffer[MESSAGE_SIZE];
+
+struct error_pattern
+{
+    const char* fragment;
+    error_record::severity_T severity;
+    error_record::category_T category;
+};
+
+// First match wins: the messages of libmicrohttpd often mention several of these.
+const error_pattern patterns[] = {
+    { "memory", error_record::ERROR, error_record::RESOURCES },
+    { "connection limit", error_record::ERROR, error_record::RESOURCES },
+    { "resource limit", error_record::ERROR, error_record::RESOURCES },
+    { "FD_SETSIZE", error_record::ERROR, error_record::RESOURCES },
+    { "thread for connection", error_record::ERROR, error_record::RESOURCES },
+    { "x509", error_record::CRITICAL, error_record::TLS },
+    { "TLS", error_record::WARNING, error_record::TLS },
+    { "handshake", error_record::WARNING, error_record::TLS },
+    { "bind", error_record::CRITICAL, error_record::SYSTEM },
+    { "listen", error_record::CRITICAL, error_record::SYSTEM },
+    { "thread", error_record::CRITICAL, error_record::SYSTEM },
+    { "poll", error_record::ERROR, error_record::SYSTEM },
+    { "select", error_record::ERROR, error_record::SYSTEM },
+    { "pplication", error_record::ERROR, error_record::APPLICATION },
+    { "callback", error_record::ERROR, error_record::APPLICATION },
+    { "malformed", error_record::WARNING, error_record::PROTOCOL },
+    { "processing request", error_record::WARNING, error_record::PROTOCOL },
+    { "HTTP", error_record::WARNING, error_record::PROTOCOL },
+    { "ccept", error_record::WARNING, error_record::CONNECTION },
+    { "send", error_record::WARNING, error_record::CONNECTION },
+    { "receiv", error_record::WARNING, error_record::CONNECTION },
+    { "request", error_record::WARNING, error_record::PROTOCOL },
+    { "header", error_record::WARNING, error_record::PROTOCOL },
+    { "onnection", error_record::WARNING, error_record::CONNECTION },
+    { "socket", error_record::ERROR, error_record::SYSTEM }
+};
+
+uint64_t hash_message(const char* message, size_t length)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<unsigned char>(message[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} //namespace
+
+const char* format_error(const char* fmt, va_list ap, size_t& length)
+{
+    int written = vsnprintf(message_buffer, MESSAGE_SIZE, fmt, ap);
+    if(written < 0)
+        written = 0;
+    length = static_cast<size_t>(written) < MESSAGE_SIZE ? written : MESSAGE_SIZE - 1;
+    while(length > 0 && (message_buffer[length - 1] == '\n' || message_buffer[length - 1] == '\r'))
+        length--;
+    message_buffer[length] = '\0';
+    return message_buffer;
+}
+
+void classify_error(const char* fmt, error_record::severity_T& severity, error_record::category_T& category)
+{
+    for(size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++)
+    {
+        if(strstr(fmt, patterns[i].fragment) != 0x0)
+        {
+            severity = patterns[i].severity;
+            category = patterns[i].category;
+            return;
+        }
+    }
+    severity = error_record::ERROR;
+    category = error_record::OTHER;
+}
+
+message_limiter::message_limiter(unsigned int burst, int window):
+    burst(burst),
+    window(window > 0 ? window * 1000ULL : 1000),
+    total(0)
+{
+    for(size_t i = 0; i < ENTRIES; i++)
+    {
+        entries[i].key.store(0, std::memory_order_relaxed);
+        entries[i].window.store(0, std::memory_order_relaxed);
+        entries[i].count.store(0, std::memory_order_relaxed);
+        entries[i].suppressed.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool message_limiter::allow(const char* message, size_t length, uint64_t now, unsigned long long& suppressed)
+{
+    suppressed = 0;
+    if(burst == 0)
+        return true;
+
+    uint64_t hash = hash_message(message, length);
+    entry& e = entries[hash & (ENTRIES - 1)];
+    // Keys are never 0, the value of the unused entries.
+    uint64_t key = hash | 1;
+    uint64_t current = now / window + 1;
+    bool same = e.key.load(std::memory_order_acquire) == key;
+    if(same && e.window.load(std::memory_order_relaxed) == current)
+    {
+        if(e.count.fetch_add(1, std::memory_order_relaxed) < burst)
+            return true;
+        e.suppressed.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // First occurrence of the window, or of a message taking over the entry of another.
+    if(same)
+        suppressed = e.suppressed.exchange(0, std::memory_order_relaxed);
+    else
+        e.suppressed.store(0, std::memory_order_relaxed);
+    e.count.store(1, std::memory_order_relaxed);
+    e.window.store(current, std::memory_order_relaxed);
+    e.key.store(key, std::memory_order_release);
+    return true;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,191 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include "details/file_cache.hpp"
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+file_cache_entry::~file_cache_entry()
+{
+    if(fd != -1) close(fd);
+}
+
+file_cache::file_cache(size_t max_entries, int ttl):
+    max_entries(max_entries),
+    ttl(ttl)
+{
+    pthread_mutex_init(&mutex, NULL);
+}
+
+file_cache::~file_cache()
+{
+    clear();
+    pthread_mutex_destroy(&mutex);
+}
+
+void file_cache::clear()
+{
+    pthread_mutex_lock(&mutex);
+    entries.clear();
+    lru.clear();
+    pthread_mutex_unlock(&mutex);
+}
+
+size_t file_cache::size() const
+{
+    pthread_mutex_lock(&mutex);
+    size_t result = entries.size();
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+shared_ptr<file_cache_entry> file_cache::open_file(const string& path)
+{
+    shared_ptr<file_cache_entry> entry(new file_cache_entry());
+
+    entry->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(entry->fd == -1)
+    {
+        throw std::invalid_argument("Unable to open file: " + path);
+    }
+
+    struct stat st;
+    if(fstat(entry->fd, &st) == -1 || !S_ISREG(st.st_mode))
+    {
+        throw std::invalid_argument("Not a regular file: " + path);
+    }
+
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->inode = st.st_ino;
+    entry->device = st.st_dev;
+    entry->checked_at = time(NULL);
+
+#if defined(POSIX_FADV_WILLNEED) && !defined(DARWIN)
+    // Ask the kernel to start reading the file in background so that
+    // the sendfile performed by the I/O thread finds it in page cache
+    // instead of stalling on a cold disk read.
+    if(entry->size)
+    {
+        posix_fadvise(entry->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(entry->fd, 0, entry->size, POSIX_FADV_WILLNEED);
+    }
+#endif
+
+    return entry;
+}
+
+shared_ptr<file_cache_entry> file_cache::get(const string& path)
+{
+    time_t now = time(NULL);
+    shared_ptr<file_cache_entry> entry;
+    bool fresh = false;
+
+    pthread_mutex_lock(&mutex);
+    map<string, cached_value>::iterator it = entries.find(path);
+    if(it != entries.end())
+    {
+        entry = it->second.first;
+        fresh = now - entry->checked_at < ttl;
+        lru.splice(lru.begin(), lru, it->second.second);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if(fresh) return entry;
+
+    if(entry)
+    {
+        struct stat st;
+        if(stat(path.c_str(), &st) == 0 &&
+                (uint64_t) st.st_size == entry->size &&
+                st.st_mtime == entry->mtime &&
+                st.st_ino == entry->inode &&
+                st.st_dev == entry->device)
+        {
+            pthread_mutex_lock(&mutex);
+            entry->checked_at = now;
+            pthread_mutex_unlock(&mutex);
+            return entry;
+        }
+    }
+
+    try
+    {
+        entry = open_file(path);
+    }
+    catch(...)
+    {
+        pthread_mutex_lock(&mutex);
+        it = entries.find(path);
+        if(it != entries.end())
+        {
+            lru.erase(it->second.second);
+            entries.erase(it);
+        }
+        pthread_mutex_unlock(&mutex);
+        throw;
+    }
+
+    insert(path, entry);
+    return entry;
+}
+
+void file_cache::insert(const string& path, const shared_ptr<file_cache_entry>& entry)
+{
+    if(max_entries == 0)
+        return;
+
+    pthread_mutex_lock(&mutex);
+    map<string, cached_value>::iterator it = entries.find(path);
+    if(it != entries.end())
+    {
+        it->second.first = entry;
+        lru.splice(lru.begin(), lru, it->second.second);
+    }
+    else
+    {
+        lru.push_front(path);
+        entries.insert(make_pair(path, cached_value(entry, lru.begin())));
+        if(lru.size() > max_entries)
+        {
+            entries.erase(lru.back());
+            lru.pop_back();
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+} //details
+
+} //httpserver
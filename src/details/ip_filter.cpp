@@ -0,0 +1,599 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#define _WINDOWS
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x600
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include <stdlib.h>
+#include <sched.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "http_utils.hpp"
+#include "details/ip_filter.hpp"
+
+#define CHECK_BIT(var,pos) ((var) & (1<<(pos)))
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+void pack_key(const unsigned char bytes[16], uint64_t key[2])
+{
+    key[0] = 0;
+    key[1] = 0;
+    for(int i = 0; i < 16; i++)
+        key[i / 8] = (key[i / 8] << 8) | bytes[i];
+}
+
+void mask_key(uint64_t key[2], unsigned int prefix_len)
+{
+    if(prefix_len == 0)
+    {
+        key[0] = key[1] = 0;
+    }
+    else if(prefix_len < 64)
+    {
+        key[0] &= ~0ULL << (64 - prefix_len);
+        key[1] = 0;
+    }
+    else if(prefix_len == 64)
+    {
+        key[1] = 0;
+    }
+    else if(prefix_len < 128)
+    {
+        key[1] &= ~0ULL << (128 - prefix_len);
+    }
+}
+
+inline unsigned int key_bit(const uint64_t key[2], unsigned int pos)
+{
+    return (key[pos >> 6] >> (63 - (pos & 63))) & 1;
+}
+
+inline unsigned int common_prefix(const uint64_t a[2], const uint64_t b[2], unsigned int limit)
+{
+    unsigned int len;
+    uint64_t x = a[0] ^ b[0];
+    if(x)
+    {
+        len = __builtin_clzll(x);
+    }
+    else
+    {
+        x = a[1] ^ b[1];
+        len = x ? 64 + __builtin_clzll(x) : 128;
+    }
+    return len < limit ? len : limit;
+}
+
+// Parses a rule. Returns true if the rule is a prefix (key/prefix_len), false if it
+// needs a per-byte mask (key/mask).
+bool parse_rule(const string& input, uint64_t key[2], uint64_t mask[2], unsigned int& prefix_len)
+{
+    size_t begin = input.find_first_not_of(" \t\r\n");
+    size_t end = input.find_last_not_of(" \t\r\n");
+    if(begin == string::npos) throw std::invalid_argument("Empty IP rule");
+    string rule = input.substr(begin, end - begin + 1);
+
+    size_t slash = rule.find('/');
+    string address = rule.substr(0, slash);
+
+    if(address.find('*') == string::npos)
+    {
+        // fast path for plain addresses, used by large lists
+        unsigned char bytes[16];
+        bool is_v4 = address.find(':') == string::npos;
+        if(is_v4)
+        {
+            std::fill(bytes, bytes + 10, 0);
+            bytes[10] = bytes[11] = 0xFF;
+        }
+        if(inet_pton(is_v4 ? AF_INET : AF_INET6, address.c_str(), is_v4 ? bytes + 12 : bytes) != 1)
+            throw std::invalid_argument("IP is badly formatted: " + address);
+
+        prefix_len = 128;
+        if(slash != string::npos)
+        {
+            string len = rule.substr(slash + 1);
+            if(len.empty() || len.size() > 3 || len.find_first_not_of("0123456789") != string::npos)
+                throw std::invalid_argument("IP is badly formatted. Invalid prefix length.");
+
+            unsigned int value = atoi(len.c_str());
+            if(value > (is_v4 ? 32u : 128u))
+                throw std::invalid_argument("IP is badly formatted. Prefix length out of range.");
+            prefix_len = value + (is_v4 ? 96 : 0);
+        }
+
+        pack_key(bytes, key);
+        mask_key(key, prefix_len);
+        return true;
+    }
+
+    if(slash != string::npos)
+        throw std::invalid_argument("IP is badly formatted. Wildcards cannot be combined with a prefix length.");
+
+    http::ip_representation ip(address);
+
+    bool is_v4 = ip.ip_version == http::http_utils::IPV4;
+    unsigned char bytes[16];
+    unsigned char mask_bytes[16];
+    for(int i = 0; i < 16; i++)
+    {
+        bytes[i] = (unsigned char) ip.pieces[i];
+        mask_bytes[i] = CHECK_BIT(ip.mask, i) ? 0xFF : 0x00;
+    }
+    if(is_v4)
+    {
+        // IPv4 addresses live in the IPv4-mapped range ::ffff:0:0/96
+        std::fill(bytes, bytes + 10, 0);
+        bytes[10] = bytes[11] = 0xFF;
+    }
+
+    int first_wildcard = 16;
+    for(int i = 0; i < 16; i++)
+    {
+        if(!mask_bytes[i])
+        {
+            first_wildcard = i;
+            break;
+        }
+    }
+
+    bool trailing = true;
+    for(int i = first_wildcard; i < 16; i++)
+    {
+        if(mask_bytes[i]) trailing = false;
+    }
+
+    if(trailing)
+    {
+        prefix_len = first_wildcard * 8;
+        pack_key(bytes, key);
+        mask_key(key, prefix_len);
+        return true;
+    }
+
+    for(int i = 0; i < 16; i++) bytes[i] &= mask_bytes[i];
+    pack_key(bytes, key);
+    pack_key(mask_bytes, mask);
+    return false;
+}
+
+bool sockaddr_key(const struct sockaddr* addr, uint64_t key[2])
+{
+    unsigned char bytes[16];
+    if(addr->sa_family == AF_INET)
+    {
+        const unsigned char* a = (const unsigned char*) &((const struct sockaddr_in*) addr)->sin_addr;
+        std::fill(bytes, bytes + 10, 0);
+        bytes[10] = bytes[11] = 0xFF;
+        std::copy(a, a + 4, bytes + 12);
+    }
+    else if(addr->sa_family == AF_INET6)
+    {
+        const unsigned char* a = (const unsigned char*) &((const struct sockaddr_in6*) addr)->sin6_addr;
+        std::copy(a, a + 16, bytes);
+    }
+    else
+    {
+        return false;
+    }
+    pack_key(bytes, key);
+    return true;
+}
+
+}
+
+ip_filter::ip_filter():
+    entries(0)
+{
+    clear();
+}
+
+void ip_filter::reserve(size_t rules)
+{
+    // Every rule adds at most one leaf and one branching node.
+    nodes.reserve(1 + 2 * rules);
+}
+
+void ip_filter::clear()
+{
+    static const uint64_t root_key[2] = { 0, 0 };
+
+    nodes.clear();
+    masked_rules.clear();
+    entries = 0;
+    new_node(root_key, 0, false);
+}
+
+uint32_t ip_filter::new_node(const uint64_t key[2], unsigned int prefix_len, bool terminal)
+{
+    node n;
+    n.key[0] = key[0];
+    n.key[1] = key[1];
+    n.child[0] = n.child[1] = 0;
+    n.prefix_len = prefix_len;
+    n.terminal = terminal;
+    nodes.push_back(n);
+    return nodes.size() - 1;
+}
+
+void ip_filter::insert(const string& rule)
+{
+    uint64_t key[2];
+    uint64_t mask[2];
+    unsigned int len;
+
+    if(!parse_rule(rule, key, mask, len))
+    {
+        masked_rule m;
+        m.key[0] = key[0];
+        m.key[1] = key[1];
+        m.mask[0] = mask[0];
+        m.mask[1] = mask[1];
+        if(std::find(masked_rules.begin(), masked_rules.end(), m) == masked_rules.end())
+        {
+            masked_rules.push_back(m);
+            entries++;
+        }
+        return;
+    }
+
+    // Node 0 is the root (empty prefix); child index 0 therefore means "no child".
+    uint32_t cur = 0;
+    while(true)
+    {
+        if(nodes[cur].prefix_len == len)
+        {
+            if(!nodes[cur].terminal) entries++;
+            nodes[cur].terminal = true;
+            return;
+        }
+
+        unsigned int b = key_bit(key, nodes[cur].prefix_len);
+        uint32_t c = nodes[cur].child[b];
+        if(c == 0)
+        {
+            uint32_t leaf = new_node(key, len, true);
+            nodes[cur].child[b] = leaf;
+            entries++;
+            return;
+        }
+
+        unsigned int child_len = nodes[c].prefix_len;
+        unsigned int cp = common_prefix(key, nodes[c].key, std::min(len, child_len));
+        if(cp == child_len)
+        {
+            cur = c;
+            continue;
+        }
+
+        if(cp == len)
+        {
+            // the new prefix covers the child: insert it in between
+            uint32_t n = new_node(key, len, true);
+            nodes[n].child[key_bit(nodes[c].key, len)] = c;
+            nodes[cur].child[b] = n;
+            entries++;
+            return;
+        }
+
+        // the new prefix and the child diverge at bit cp
+        uint64_t split_key[2] = { key[0], key[1] };
+        mask_key(split_key, cp);
+        uint32_t split = new_node(split_key, cp, false);
+        uint32_t leaf = new_node(key, len, true);
+        nodes[split].child[key_bit(nodes[c].key, cp)] = c;
+        nodes[split].child[key_bit(key, cp)] = leaf;
+        nodes[cur].child[b] = split;
+        entries++;
+        return;
+    }
+}
+
+bool ip_filter::erase(const string& rule)
+{
+    uint64_t key[2];
+    uint64_t mask[2];
+    unsigned int len;
+
+    if(!parse_rule(rule, key, mask, len))
+    {
+        masked_rule m;
+        m.key[0] = key[0];
+        m.key[1] = key[1];
+        m.mask[0] = mask[0];
+        m.mask[1] = mask[1];
+        vector<masked_rule>::iterator it = std::find(masked_rules.begin(), masked_rules.end(), m);
+        if(it == masked_rules.end()) return false;
+        masked_rules.erase(it);
+        entries--;
+        return true;
+    }
+
+    // Nodes are only unmarked; they are dropped when the filter is rebuilt.
+    uint32_t cur = 0;
+    while(nodes[cur].prefix_len < len)
+    {
+        uint32_t c = nodes[cur].child[key_bit(key, nodes[cur].prefix_len)];
+        if(c == 0 || nodes[c].prefix_len > len ||
+                common_prefix(key, nodes[c].key, nodes[c].prefix_len) < nodes[c].prefix_len)
+            return false;
+        cur = c;
+    }
+
+    if(nodes[cur].prefix_len != len || !nodes[cur].terminal) return false;
+    nodes[cur].terminal = false;
+    entries--;
+    return true;
+}
+
+bool ip_filter::lookup(const uint64_t key[2]) const
+{
+    uint32_t cur = 0;
+    while(true)
+    {
+        const node& n = nodes[cur];
+        if(n.terminal) return true;
+        if(n.prefix_len >= 128) break;
+
+        uint32_t c = n.child[key_bit(key, n.prefix_len)];
+        if(c == 0) break;
+        if(common_prefix(key, nodes[c].key, nodes[c].prefix_len) < nodes[c].prefix_len) break;
+        cur = c;
+    }
+
+    for(vector<masked_rule>::const_iterator it = masked_rules.begin(); it != masked_rules.end(); ++it)
+    {
+        if((key[0] & it->mask[0]) == it->key[0] && (key[1] & it->mask[1]) == it->key[1])
+            return true;
+    }
+    return false;
+}
+
+bool ip_filter::contains(const struct sockaddr* addr) const
+{
+    uint64_t key[2];
+    if(!sockaddr_key(addr, key)) return false;
+    return lookup(key);
+}
+
+bool ip_filter::contains(const string& ip) const
+{
+    uint64_t key[2];
+    uint64_t mask[2];
+    unsigned int len;
+    if(!parse_rule(ip, key, mask, len) || len != 128) return false;
+    return lookup(key);
+}
+
+shared_ip_filter::shared_ip_filter():
+    current(new ip_filter()),
+    epoch(0)
+{
+    readers[0] = 0;
+    readers[1] = 0;
+    pthread_mutex_init(&write_lock, NULL);
+}
+
+shared_ip_filter::shared_ip_filter(const shared_ip_filter& other):
+    current(other.copy_current()),
+    epoch(0)
+{
+    readers[0] = 0;
+    readers[1] = 0;
+    pthread_mutex_init(&write_lock, NULL);
+}
+
+shared_ip_filter& shared_ip_filter::operator=(const shared_ip_filter& other)
+{
+    if(this == &other) return *this;
+    ip_filter* next = other.copy_current();
+    pthread_mutex_lock(&write_lock);
+    publish(next);
+    pthread_mutex_unlock(&write_lock);
+    return *this;
+}
+
+shared_ip_filter::~shared_ip_filter()
+{
+    delete current.load();
+    pthread_mutex_destroy(&write_lock);
+}
+
+bool shared_ip_filter::contains(const struct sockaddr* addr) const
+{
+    std::atomic<unsigned int>& slot = readers[epoch.load() & 1];
+    slot.fetch_add(1);
+    bool result = current.load()->contains(addr);
+    slot.fetch_sub(1, std::memory_order_release);
+    return result;
+}
+
+ip_filter* shared_ip_filter::copy_current() const
+{
+    std::atomic<unsigned int>& slot = readers[epoch.load() & 1];
+    slot.fetch_add(1);
+    ip_filter* result;
+    try
+    {
+        result = new ip_filter(*current.load());
+    }
+    catch(...)
+    {
+        slot.fetch_sub(1, std::memory_order_release);
+        throw;
+    }
+    slot.fetch_sub(1, std::memory_order_release);
+    return result;
+}
+
+size_t shared_ip_filter::size() const
+{
+    std::atomic<unsigned int>& slot = readers[epoch.load() & 1];
+    slot.fetch_add(1);
+    size_t result = current.load()->size();
+    slot.fetch_sub(1, std::memory_order_release);
+    return result;
+}
+
+void shared_ip_filter::publish(ip_filter* next)
+{
+    ip_filter* old = current.exchange(next);
+
+    // A reader can hold the old snapshot only if it registered before the exchange above.
+    // Flipping the epoch sends new readers to the other counter, so each counter is bound to
+    // drain even under constant load; once both have been seen empty nobody references old.
+    for(int i = 0; i < 2; i++)
+    {
+        unsigned int e = epoch.fetch_add(1);
+        while(readers[e & 1].load(std::memory_order_acquire) != 0)
+            sched_yield();
+    }
+    delete old;
+}
+
+void shared_ip_filter::insert(const string& rule)
+{
+    pthread_mutex_lock(&write_lock);
+    ip_filter* next = 0x0;
+    try
+    {
+        next = copy_current();
+        next->insert(rule);
+    }
+    catch(...)
+    {
+        delete next;
+        pthread_mutex_unlock(&write_lock);
+        throw;
+    }
+    publish(next);
+    pthread_mutex_unlock(&write_lock);
+}
+
+bool shared_ip_filter::erase(const string& rule)
+{
+    pthread_mutex_lock(&write_lock);
+    ip_filter* next = 0x0;
+    bool found;
+    try
+    {
+        next = copy_current();
+        found = next->erase(rule);
+    }
+    catch(...)
+    {
+        delete next;
+        pthread_mutex_unlock(&write_lock);
+        throw;
+    }
+    if(found)
+        publish(next);
+    else
+        delete next;
+    pthread_mutex_unlock(&write_lock);
+    return found;
+}
+
+void shared_ip_filter::assign(const vector<string>& rules)
+{
+    // Built outside of the write lock: a reload only contends with other writers for the swap.
+    ip_filter* next = new ip_filter();
+    try
+    {
+        next->reserve(rules.size());
+        for(vector<string>::const_iterator it = rules.begin(); it != rules.end(); ++it)
+            next->insert(*it);
+    }
+    catch(...)
+    {
+        delete next;
+        throw;
+    }
+    pthread_mutex_lock(&write_lock);
+    publish(next);
+    pthread_mutex_unlock(&write_lock);
+}
+
+void shared_ip_filter::load(const string& path)
+{
+    ifstream fp(path.c_str());
+    if(!fp)
+        throw invalid_argument("Unable to open IP list: " + path);
+
+    ip_filter* next = new ip_filter();
+    string line;
+    size_t line_number = 0;
+    while(getline(fp, line))
+    {
+        line_number++;
+        size_t comment = line.find('#');
+        if(comment != string::npos)
+            line.erase(comment);
+        size_t first = line.find_first_not_of(" \t\r");
+        if(first == string::npos)
+            continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        try
+        {
+            next->insert(line.substr(first, last - first + 1));
+        }
+        catch(const invalid_argument& e)
+        {
+            delete next;
+            stringstream ss;
+            ss << path << ":" << line_number << ": " << e.what();
+            throw invalid_argument(ss.str());
+        }
+    }
+    if(fp.bad())
+    {
+        delete next;
+        throw invalid_argument("Unable to read IP list: " + path);
+    }
+
+    pthread_mutex_lock(&write_lock);
+    publish(next);
+    pthread_mutex_unlock(&write_lock);
+}
+
+} //details
+
+} //httpserver
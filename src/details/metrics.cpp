@@ -0,0 +1,434 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdio.h>
+#include <vector>
+#include "details/connection_registry.hpp"
+#include "details/metrics.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+const char* known_methods[] = {
+    "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH"
+};
+
+// Prometheus buckets (in microseconds) exposed for the latency histograms.
+const uint64_t exposed_buckets[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+uint64_t hash_bytes(uint64_t hash, const char* data, size_t size)
+{
+    // FNV-1a
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+const string& normalize_method(const string& method)
+{
+    static const string other("OTHER");
+    for(size_t i = 0; i < sizeof(known_methods) / sizeof(known_methods[0]); i++)
+    {
+        if(method == known_methods[i])
+            return method;
+    }
+    return other;
+}
+
+string escape_label(const string& value)
+{
+    string escaped;
+    for(size_t i = 0; i < value.size(); i++)
+    {
+        if(value[i] == '\\' || value[i] == '"')
+        {
+            escaped += '\\';
+            escaped += value[i];
+        }
+        else if(value[i] == '\n')
+        {
+            escaped += "\\n";
+        }
+        else
+        {
+            escaped += value[i];
+        }
+    }
+    return escaped;
+}
+
+string seconds(uint64_t microseconds)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.6f", microseconds / 1000000.0);
+    return buffer;
+}
+
+size_t table_size(size_t max_series)
+{
+    size_t size = 1;
+    while(size < max_series)
+        size <<= 1;
+    return size;
+}
+
+// Finds the series matching a key in an open addressing table, creating it in the first free
+// slot met. Slots are only ever filled, so readers never see a series disappear.
+template <class T, class M>
+T* find_or_create(std::atomic<T*>* table, size_t size, uint64_t hash, const M& matches, T* (*create)(const M&))
+{
+    T* created = 0x0;
+    for(size_t probe = 0; probe < size; probe++)
+    {
+        std::atomic<T*>& slot = table[(hash + probe) & (size - 1)];
+        T* current = slot.load(std::memory_order_acquire);
+        if(current == 0x0)
+        {
+            if(created == 0x0)
+                created = create(matches);
+            if(slot.compare_exchange_strong(current, created, std::memory_order_acq_rel))
+                return created;
+        }
+        if(matches(current))
+        {
+            delete created;
+            return current;
+        }
+    }
+    delete created;
+    return 0x0;
+}
+
+unsigned int next_thread_index()
+{
+    static std::atomic<unsigned int> threads(0);
+    return threads.fetch_add(1, std::memory_order_relaxed);
+}
+
+} //namespace
+
+sharded_counter::sharded_counter()
+{
+    for(int i = 0; i < SHARDS; i++)
+        cells[i].value.store(0, std::memory_order_relaxed);
+}
+
+uint64_t sharded_counter::get() const
+{
+    uint64_t total = 0;
+    for(int i = 0; i < SHARDS; i++)
+        total += cells[i].value.load(std::memory_order_relaxed);
+    return total;
+}
+
+unsigned int sharded_counter::shard_index()
+{
+    static thread_local unsigned int index = next_thread_index();
+    return index;
+}
+
+latency_histogram::latency_histogram()
+{
+    for(int i = 0; i < SHARDS; i++)
+    {
+        for(int j = 0; j < BUCKETS; j++)
+            shards[i].buckets[j].store(0, std::memory_order_relaxed);
+        shards[i].sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+int latency_histogram::bucket_index(uint64_t microseconds)
+{
+    if(microseconds < SUB_BUCKETS)
+        return static_cast<int>(microseconds);
+
+    int exponent = 63 - __builtin_clzll(microseconds);
+    if(exponent >= MAX_EXPONENT)
+        return BUCKETS - 1;
+
+    // The 3 bits following the most significant one select the sub bucket.
+    int sub_bucket = static_cast<int>(microseconds >> (exponent - 3)) - SUB_BUCKETS;
+    return (exponent - 2) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t latency_histogram::bucket_lower_bound(int index)
+{
+    if(index < SUB_BUCKETS)
+        return index;
+    int exponent = index / SUB_BUCKETS + 2;
+    return static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << (exponent - 3);
+}
+
+void latency_histogram::totals(uint64_t* buckets) const
+{
+    for(int j = 0; j < BUCKETS; j++)
+    {
+        buckets[j] = 0;
+        for(int i = 0; i < SHARDS; i++)
+            buckets[j] += shards[i].buckets[j].load(std::memory_order_relaxed);
+    }
+}
+
+uint64_t latency_histogram::count_up_to(uint64_t microseconds) const
+{
+    uint64_t buckets[BUCKETS];
+    totals(buckets);
+    uint64_t total = 0;
+    for(int j = 0; j < BUCKETS - 1 && bucket_lower_bound(j + 1) - 1 <= microseconds; j++)
+        total += buckets[j];
+    return total;
+}
+
+uint64_t latency_histogram::count() const
+{
+    uint64_t buckets[BUCKETS];
+    totals(buckets);
+    uint64_t total = 0;
+    for(int j = 0; j < BUCKETS; j++)
+        total += buckets[j];
+    return total;
+}
+
+uint64_t latency_histogram::sum() const
+{
+    uint64_t total = 0;
+    for(int i = 0; i < SHARDS; i++)
+        total += shards[i].sum.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t latency_histogram::value_at_percentile(double percentile) const
+{
+    uint64_t buckets[BUCKETS];
+    totals(buckets);
+    uint64_t total = 0;
+    for(int j = 0; j < BUCKETS; j++)
+        total += buckets[j];
+    if(total == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+    if(rank == 0)
+        rank = 1;
+    if(rank > total)
+        rank = total;
+
+    uint64_t seen = 0;
+    int j = 0;
+    for(; j < BUCKETS - 1; j++)
+    {
+        seen += buckets[j];
+        if(seen >= rank)
+            break;
+    }
+    return j < BUCKETS - 1 ? bucket_lower_bound(j + 1) - 1 : bucket_lower_bound(j);
+}
+
+metrics_registry::metrics_registry(size_t max_series):
+    capacity(table_size(max_series > 0 ? max_series : 1)),
+    requests(new std::atomic<request_series*>[capacity]),
+    latencies(new std::atomic<latency_series*>[capacity])
+{
+    for(size_t i = 0; i < capacity; i++)
+    {
+        requests[i].store(0x0, std::memory_order_relaxed);
+        latencies[i].store(0x0, std::memory_order_relaxed);
+    }
+}
+
+metrics_registry::~metrics_registry()
+{
+    for(size_t i = 0; i < capacity; i++)
+    {
+        delete requests[i].load();
+        delete latencies[i].load();
+    }
+    delete[] requests;
+    delete[] latencies;
+}
+
+metrics_registry::request_series* metrics_registry::find_request_series(
+        const string& method, const string& route, int status
+)
+{
+    struct matcher
+    {
+        const string& method;
+        const string& route;
+        int status;
+
+        bool operator()(const request_series* series) const
+        {
+            return series->status == status && series->method == method && series->route == route;
+        }
+
+        static request_series* create(const matcher& key)
+        {
+            request_series* series = new request_series;
+            series->method = key.method;
+            series->route = key.route;
+            series->status = key.status;
+            return series;
+        }
+    };
+
+    uint64_t hash = hash_bytes(14695981039346656037ULL, method.data(), method.size());
+    hash = hash_bytes(hash, route.data(), route.size());
+    hash = hash_bytes(hash, reinterpret_cast<const char*>(&status), sizeof(status));
+    matcher key = {method, route, status};
+    return find_or_create(requests, capacity, hash, key, &matcher::create);
+}
+
+metrics_registry::latency_series* metrics_registry::find_latency_series(const string& route)
+{
+    struct matcher
+    {
+        const string& route;
+
+        bool operator()(const latency_series* series) const
+        {
+            return series->route == route;
+        }
+
+        static latency_series* create(const matcher& key)
+        {
+            latency_series* series = new latency_series;
+            series->route = key.route;
+            return series;
+        }
+    };
+
+    matcher key = {route};
+    return find_or_create(latencies, capacity,
+            hash_bytes(14695981039346656037ULL, route.data(), route.size()), key, &matcher::create
+    );
+}
+
+void metrics_registry::record_request(const string& method, const string& route, int status)
+{
+    request_series* series = find_request_series(normalize_method(method), route, status);
+    if(series != 0x0)
+        series->requests.add(1);
+    else
+        dropped_series.add(1);
+}
+
+void metrics_registry::record_latency(const string& route, uint64_t microseconds)
+{
+    latency_series* series = find_latency_series(route);
+    if(series != 0x0)
+        series->latency.record(microseconds);
+    else
+        dropped_series.add(1);
+}
+
+void metrics_registry::connection_opened()
+{
+    active_connections.add(1);
+}
+
+void metrics_registry::connection_closed(int socket_fd)
+{
+    active_connections.add(static_cast<uint64_t>(-1));
+    uint64_t received, sent;
+    if(socket_bytes(socket_fd, received, sent))
+    {
+        received_bytes.add(received);
+        sent_bytes.add(sent);
+    }
+}
+
+void metrics_registry::connection_rejected()
+{
+    rejected_connections.add(1);
+}
+
+string metrics_registry::render() const
+{
+    string out;
+
+    out += "# HELP httpserver_requests_total Requests answered, by method, route and status.\n";
+    out += "# TYPE httpserver_requests_total counter\n";
+    for(size_t i = 0; i < capacity; i++)
+    {
+        const request_series* series = requests[i].load(std::memory_order_acquire);
+        if(series == 0x0)
+            continue;
+        out += "httpserver_requests_total{method=\"" + series->method +
+            "\",route=\"" + escape_label(series->route) +
+            "\",status=\"" + to_string(series->status) + "\"} " +
+            to_string(series->requests.get()) + "\n";
+    }
+
+    out += "# HELP httpserver_request_duration_seconds Time spent in the resource handlers, by route.\n";
+    out += "# TYPE httpserver_request_duration_seconds histogram\n";
+    for(size_t i = 0; i < capacity; i++)
+    {
+        const latency_series* series = latencies[i].load(std::memory_order_acquire);
+        if(series == 0x0)
+            continue;
+        string route = "route=\"" + escape_label(series->route) + "\"";
+        for(size_t j = 0; j < sizeof(exposed_buckets) / sizeof(exposed_buckets[0]); j++)
+        {
+            out += "httpserver_request_duration_seconds_bucket{" + route + ",le=\"" +
+                seconds(exposed_buckets[j]) + "\"} " +
+                to_string(series->latency.count_up_to(exposed_buckets[j])) + "\n";
+        }
+        uint64_t count = series->latency.count();
+        out += "httpserver_request_duration_seconds_bucket{" + route + ",le=\"+Inf\"} " + to_string(count) + "\n";
+        out += "httpserver_request_duration_seconds_sum{" + route + "} " + seconds(series->latency.sum()) + "\n";
+        out += "httpserver_request_duration_seconds_count{" + route + "} " + to_string(count) + "\n";
+    }
+
+    out += "# HELP httpserver_connections_active Connections currently open.\n";
+    out += "# TYPE httpserver_connections_active gauge\n";
+    out += "httpserver_connections_active " + to_string(static_cast<int64_t>(active_connections.get())) + "\n";
+    out += "# HELP httpserver_connections_rejected_total Connections refused by the IP policy or bans.\n";
+    out += "# TYPE httpserver_connections_rejected_total counter\n";
+    out += "httpserver_connections_rejected_total " + to_string(rejected_connections.get()) + "\n";
+    out += "# HELP httpserver_received_bytes_total Bytes received on closed connections.\n";
+    out += "# TYPE httpserver_received_bytes_total counter\n";
+    out += "httpserver_received_bytes_total " + to_string(received_bytes.get()) + "\n";
+    out += "# HELP httpserver_sent_bytes_total Bytes sent (and acknowledged) on closed connections.\n";
+    out += "# TYPE httpserver_sent_bytes_total counter\n";
+    out += "httpserver_sent_bytes_total " + to_string(sent_bytes.get()) + "\n";
+    out += "# HELP httpserver_metrics_dropped_total Updates lost because a series table was full.\n";
+    out += "# TYPE httpserver_metrics_dropped_total counter\n";
+    out += "httpserver_metrics_dropped_total " + to_string(dropped_series.get()) + "\n";
+    return out;
+}
+
+} //details
+
+} //httpserver
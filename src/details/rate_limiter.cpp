@@ -0,0 +1,231 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#define _WINDOWS
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x600
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "details/rate_limiter.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+const unsigned int TOKEN_SHIFT = 24;
+const uint64_t TOKEN_MASK = (1ULL << TOKEN_SHIFT) - 1;
+const uint64_t TOKEN_UNIT = 256;
+const unsigned int MAX_BURST = TOKEN_MASK / TOKEN_UNIT;
+const size_t PROBE_LENGTH = 8;
+
+// Clock origin: a never used bucket (state 0) must look idle for long enough to be full.
+const uint64_t CLOCK_OFFSET = 1ULL << 32;
+
+uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t steady_ms()
+{
+    return chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+}
+
+rate_limiter::rate_limiter(size_t capacity):
+    mask(0),
+    start(steady_ms()),
+    allowed(0),
+    limited(0),
+    evictions(0),
+    overflows(0)
+{
+    size_t size = PROBE_LENGTH;
+    while(size < capacity) size <<= 1;
+    mask = size - 1;
+    buckets = new bucket[size];
+    for(size_t i = 0; i < size; i++)
+    {
+        buckets[i].key.store(0, memory_order_relaxed);
+        buckets[i].state.store(0, memory_order_relaxed);
+        buckets[i].refill_ms.store(0, memory_order_relaxed);
+    }
+}
+
+rate_limiter::~rate_limiter()
+{
+    delete[] buckets;
+}
+
+uint64_t rate_limiter::now_ms() const
+{
+    return steady_ms() - start + CLOCK_OFFSET;
+}
+
+uint64_t rate_limiter::make_key(const void* scope, const struct sockaddr* addr)
+{
+    uint64_t h = mix(reinterpret_cast<uintptr_t>(scope) + 0x9e3779b97f4a7c15ULL);
+    if(addr->sa_family == AF_INET)
+    {
+        const struct sockaddr_in* in = (const struct sockaddr_in*) addr;
+        uint32_t a;
+        memcpy(&a, &in->sin_addr, sizeof(a));
+        h = mix(h ^ a);
+    }
+    else if(addr->sa_family == AF_INET6)
+    {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*) addr;
+        uint64_t a[2];
+        memcpy(a, &in6->sin6_addr, sizeof(a));
+        h = mix(h ^ a[0]);
+        h = mix(h ^ a[1]);
+    }
+    return h == 0 ? 1 : h;
+}
+
+rate_limiter::bucket* rate_limiter::find(uint64_t key, uint64_t now)
+{
+    size_t home = key & mask;
+    for(size_t i = 0; i < PROBE_LENGTH; i++)
+    {
+        bucket& b = buckets[(home + i) & mask];
+        uint64_t current = b.key.load(memory_order_acquire);
+        if(current == key)
+            return &b;
+        if(current == 0)
+        {
+            if(b.key.compare_exchange_strong(current, key) || current == key)
+                return &b;
+        }
+    }
+
+    // No bucket for this key and no free slot: take over one that has been idle long
+    // enough to be full again, its state is then exactly the one of a new bucket.
+    for(size_t i = 0; i < PROBE_LENGTH; i++)
+    {
+        bucket& b = buckets[(home + i) & mask];
+        uint64_t current = b.key.load(memory_order_acquire);
+        uint64_t last = b.state.load(memory_order_relaxed) >> TOKEN_SHIFT;
+        if(now > last && now - last >= b.refill_ms.load(memory_order_relaxed) &&
+                b.key.compare_exchange_strong(current, key))
+        {
+            evictions.fetch_add(1, memory_order_relaxed);
+            return &b;
+        }
+        if(current == key)
+            return &b;
+    }
+
+    // The table is saturated with active clients: share the home bucket rather than
+    // letting the request through unaccounted.
+    overflows.fetch_add(1, memory_order_relaxed);
+    return &buckets[home];
+}
+
+bool rate_limiter::consume(uint64_t key, double rate, unsigned int burst, unsigned int* retry_after)
+{
+    if(burst > MAX_BURST) burst = MAX_BURST;
+    if(burst == 0) burst = 1;
+
+    uint64_t now = now_ms();
+    bucket* b = find(key, now);
+
+    const double capacity = burst * TOKEN_UNIT;
+    uint64_t state = b->state.load(memory_order_relaxed);
+    for(;;)
+    {
+        uint64_t last = state >> TOKEN_SHIFT;
+        double tokens = state & TOKEN_MASK;
+        if(now > last)
+            tokens += (now - last) * rate * TOKEN_UNIT / 1000.0;
+        if(tokens > capacity)
+            tokens = capacity;
+
+        if(tokens < TOKEN_UNIT)
+        {
+            // Nothing is stored: the refill keeps being computed from the last granted request.
+            if(retry_after != 0x0)
+            {
+                double wait = (TOKEN_UNIT - tokens) / (rate * TOKEN_UNIT);
+                *retry_after = wait < 1 ? 1 : (unsigned int) ceil(wait);
+            }
+            limited.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+
+        uint64_t next = (now << TOKEN_SHIFT) | (uint64_t) (tokens - TOKEN_UNIT);
+        if(b->state.compare_exchange_weak(state, next, memory_order_relaxed))
+            break;
+    }
+
+    double full_after = burst * 1000.0 / rate;
+    b->refill_ms.store(full_after > UINT32_MAX ? UINT32_MAX : (uint32_t) full_after, memory_order_relaxed);
+    allowed.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+rate_limit_stats rate_limiter::get_stats() const
+{
+    rate_limit_stats stats;
+    stats.capacity = mask + 1;
+    stats.active_buckets = 0;
+    uint64_t now = now_ms();
+    for(size_t i = 0; i <= mask; i++)
+    {
+        if(buckets[i].key.load(memory_order_relaxed) == 0)
+            continue;
+        uint64_t last = buckets[i].state.load(memory_order_relaxed) >> TOKEN_SHIFT;
+        if(now <= last || now - last < buckets[i].refill_ms.load(memory_order_relaxed))
+            stats.active_buckets++;
+    }
+    stats.allowed = allowed.load(memory_order_relaxed);
+    stats.limited = limited.load(memory_order_relaxed);
+    stats.evictions = evictions.load(memory_order_relaxed);
+    stats.overflows = overflows.load(memory_order_relaxed);
+    return stats;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,633 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include <random>
+#include <stdexcept>
+#include "details/tls_manager.hpp"
+#include "string_utilities.hpp"
+
+#ifdef HAVE_GNUTLS
+#include <gnutls/gnutls.h>
+#include <gnutls/abstract.h>
+#include <gnutls/crypto.h>
+#ifdef HAVE_GNUTLS_KTLS
+#include <gnutls/socket.h>
+#endif //HAVE_GNUTLS_KTLS
+#endif //HAVE_GNUTLS
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+tls_session_cache::tls_session_cache(size_t capacity):
+    capacity(capacity)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+tls_session_cache::~tls_session_cache()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+void tls_session_cache::store(const string& id, const string& data)
+{
+    if(capacity == 0) return;
+
+    pthread_mutex_lock(&lock);
+    unordered_map<string, entries_T::iterator>::iterator it = index.find(id);
+    if(it != index.end())
+    {
+        it->second->second = data;
+        entries.splice(entries.begin(), entries, it->second);
+    }
+    else
+    {
+        if(entries.size() >= capacity)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+        entries.push_front(make_pair(id, data));
+        index[id] = entries.begin();
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+bool tls_session_cache::retrieve(const string& id, string& data)
+{
+    bool found = false;
+    pthread_mutex_lock(&lock);
+    unordered_map<string, entries_T::iterator>::iterator it = index.find(id);
+    if(it != index.end())
+    {
+        entries.splice(entries.begin(), entries, it->second);
+        data = it->second->second;
+        found = true;
+    }
+    pthread_mutex_unlock(&lock);
+    return found;
+}
+
+void tls_session_cache::remove(const string& id)
+{
+    pthread_mutex_lock(&lock);
+    unordered_map<string, entries_T::iterator>::iterator it = index.find(id);
+    if(it != index.end())
+    {
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+size_t tls_session_cache::size() const
+{
+    pthread_mutex_lock(&lock);
+    size_t result = entries.size();
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+namespace
+{
+
+void check_ticket_key(const string& ticket_key)
+{
+    if(ticket_key.size() != tls_manager::TICKET_KEY_SIZE)
+        throw std::invalid_argument("The session ticket key must be 64 bytes long");
+}
+
+string generate_ticket_key()
+{
+    string key(tls_manager::TICKET_KEY_SIZE, '\0');
+#ifdef HAVE_GNUTLS
+    int ret = gnutls_rnd(GNUTLS_RND_KEY, &key[0], key.size());
+    if(ret < 0)
+        throw std::runtime_error(string("Unable to generate a session ticket key: ") + gnutls_strerror(ret));
+#else
+    // Tickets are only issued with GnuTLS: the key is never used.
+    std::random_device rd;
+    for(size_t i = 0; i < key.size(); i++)
+        key[i] = static_cast<char>(rd() & 0xff);
+#endif //HAVE_GNUTLS
+    return key;
+}
+
+string normalize_hostname(const string& hostname)
+{
+    string result = string_utilities::to_lower_copy(hostname);
+    if(result.size() > 0 && result[result.size() - 1] == '.')
+        result.erase(result.size() - 1);
+    return result;
+}
+
+void check_hostname(const string& hostname)
+{
+    // Wildcards are only accepted as the whole leftmost label (as in certificates).
+    if(hostname == "" || hostname.find('*', hostname.compare(0, 2, "*.") == 0 ? 1 : 0) != string::npos ||
+            hostname == "*." || hostname[0] == '.')
+        throw std::invalid_argument("Invalid hostname: " + hostname);
+}
+
+}
+
+#ifdef HAVE_GNUTLS
+
+struct tls_credentials
+{
+    gnutls_certificate_credentials_t cred;
+
+    tls_credentials():
+        cred(0x0)
+    {
+    }
+
+    ~tls_credentials()
+    {
+        if(cred != 0x0)
+            gnutls_certificate_free_credentials(cred);
+    }
+};
+
+struct tls_certificate
+{
+    static const unsigned int MAX_CHAIN = 16;
+
+    gnutls_pcert_st chain[MAX_CHAIN];
+    unsigned int chain_length;
+    gnutls_privkey_t key;
+    string ocsp;
+    gnutls_ocsp_data_st ocsp_data;
+
+    tls_certificate():
+        chain_length(0),
+        key(0x0)
+    {
+    }
+
+    ~tls_certificate()
+    {
+        for(unsigned int i = 0; i < chain_length; i++)
+            gnutls_pcert_deinit(&chain[i]);
+        if(key != 0x0)
+            gnutls_privkey_deinit(key);
+    }
+};
+
+namespace
+{
+
+// State kept for every TLS connection; stored as the session database pointer, which is the
+// only user pointer of a gnutls session not already used by libmicrohttpd.
+struct tls_connection
+{
+    tls_manager* manager;
+    gnutls_session_t session;
+    shared_ptr<tls_credentials> credentials;
+    shared_ptr<tls_certificate> certificate;
+    bool handshaken;
+};
+
+gnutls_datum_t to_datum(const string& s)
+{
+    gnutls_datum_t d;
+    d.data = (unsigned char*) s.data();
+    d.size = static_cast<unsigned int>(s.size());
+    return d;
+}
+
+void check_gnutls(int ret, const char* what)
+{
+    if(ret < 0)
+        throw std::invalid_argument(string(what) + ": " + gnutls_strerror(ret));
+}
+
+shared_ptr<tls_certificate> load_certificate(const string& key,
+        const string& cert, const string& ocsp
+)
+{
+    shared_ptr<tls_certificate> result(new tls_certificate());
+
+    gnutls_datum_t cert_d = to_datum(cert);
+    result->chain_length = tls_certificate::MAX_CHAIN;
+    int ret = gnutls_pcert_list_import_x509_raw(result->chain,
+            &result->chain_length, &cert_d, GNUTLS_X509_FMT_PEM, 0
+    );
+    if(ret < 0)
+        result->chain_length = 0;
+    check_gnutls(ret, "Invalid TLS certificate");
+
+    gnutls_datum_t key_d = to_datum(key);
+    check_gnutls(gnutls_privkey_init(&result->key), "Unable to allocate the TLS key");
+    check_gnutls(gnutls_privkey_import_x509_raw(result->key, &key_d,
+                GNUTLS_X509_FMT_PEM, 0x0, 0),
+            "Invalid TLS key");
+
+    result->ocsp = ocsp;
+    memset(&result->ocsp_data, 0, sizeof(result->ocsp_data));
+    result->ocsp_data.response = to_datum(result->ocsp);
+    return result;
+}
+
+shared_ptr<tls_certificate> select_certificate(gnutls_session_t session)
+{
+    tls_connection* conn = static_cast<tls_connection*>(gnutls_db_get_ptr(session));
+    if(conn == 0x0)
+        return shared_ptr<tls_certificate>();
+
+    char name[256];
+    size_t name_length = sizeof(name);
+    unsigned int type;
+    string hostname;
+    if(gnutls_server_name_get(session, name, &name_length, &type, 0) == GNUTLS_E_SUCCESS &&
+            type == GNUTLS_NAME_DNS)
+        hostname.assign(name, name_length);
+
+    // The connection keeps the certificate alive as long as the session may refer to it.
+    conn->certificate = conn->manager->find_certificate(hostname);
+    return conn->certificate;
+}
+
+int retrieve_certificate(gnutls_session_t session,
+        const struct gnutls_cert_retr_st* info, gnutls_pcert_st** certs,
+        unsigned int* certs_length, gnutls_ocsp_data_st** ocsp,
+        unsigned int* ocsp_length, gnutls_privkey_t* privkey, unsigned int* flags
+)
+{
+    shared_ptr<tls_certificate> certificate = select_certificate(session);
+    if(certificate == 0x0)
+        return -1;
+
+    *certs = certificate->chain;
+    *certs_length = certificate->chain_length;
+    *privkey = certificate->key;
+    *ocsp = certificate->ocsp != "" ? &certificate->ocsp_data : 0x0;
+    *ocsp_length = certificate->ocsp != "" ? 1 : 0;
+    *flags = 0;
+    return 0;
+}
+
+int retrieve_certificate_without_ocsp(gnutls_session_t session,
+        const gnutls_datum_t* req_ca_rdn, int nreqs,
+        const gnutls_pk_algorithm_t* pk_algos, int pk_algos_length,
+        gnutls_pcert_st** certs, unsigned int* certs_length, gnutls_privkey_t* privkey
+)
+{
+    shared_ptr<tls_certificate> certificate = select_certificate(session);
+    if(certificate == 0x0)
+        return -1;
+
+    *certs = certificate->chain;
+    *certs_length = certificate->chain_length;
+    *privkey = certificate->key;
+    return 0;
+}
+
+int store_session(void* ptr, gnutls_datum_t key, gnutls_datum_t data)
+{
+    tls_connection* conn = static_cast<tls_connection*>(ptr);
+    conn->manager->get_session_cache().store(
+            string((const char*) key.data, key.size),
+            string((const char*) data.data, data.size)
+    );
+    return 0;
+}
+
+gnutls_datum_t retrieve_session(void* ptr, gnutls_datum_t key)
+{
+    tls_connection* conn = static_cast<tls_connection*>(ptr);
+    gnutls_datum_t result = { 0x0, 0 };
+    string data;
+    if(!conn->manager->get_session_cache().retrieve(string((const char*) key.data, key.size), data))
+        return result;
+
+    result.data = (unsigned char*) gnutls_malloc(data.size());
+    if(result.data == 0x0)
+        return result;
+    memcpy(result.data, data.data(), data.size());
+    result.size = static_cast<unsigned int>(data.size());
+    return result;
+}
+
+int remove_session(void* ptr, gnutls_datum_t key)
+{
+    tls_connection* conn = static_cast<tls_connection*>(ptr);
+    conn->manager->get_session_cache().remove(string((const char*) key.data, key.size));
+    return 0;
+}
+
+// Called once per handshake: the last Finished message received by the server
+// closes both full and abbreviated handshakes, whatever the protocol version.
+int handshake_finished(gnutls_session_t session, unsigned int htype,
+        unsigned when, unsigned int incoming, const gnutls_datum_t* msg
+)
+{
+    if(!incoming) return 0;
+
+    tls_connection* conn = static_cast<tls_connection*>(gnutls_db_get_ptr(session));
+    if(conn != 0x0)
+    {
+        conn->handshaken = true;
+        conn->manager->handshake_completed(gnutls_session_is_resumed(session) != 0);
+    }
+    return 0;
+}
+
+}
+
+#else //HAVE_GNUTLS
+
+struct tls_credentials
+{
+};
+
+struct tls_certificate
+{
+};
+
+namespace
+{
+
+shared_ptr<tls_certificate> load_certificate(const string&, const string&, const string&)
+{
+    throw std::invalid_argument("TLS certificates require TLS support");
+}
+
+}
+
+#endif //HAVE_GNUTLS
+
+tls_manager::tls_manager(const string& key, const string& cert,
+        const string& trust, const string& ocsp,
+        bool tickets, const string& ticket_key,
+        int ticket_rotation, size_t cache_size
+):
+    tickets(tickets),
+    ticket_rotation(ticket_rotation),
+    generated_key(ticket_key == ""),
+    key_created(time(0)),
+    cache(cache_size),
+    full_handshakes(0),
+    resumed_handshakes(0),
+    credential_reloads(0),
+    ktls_connections(0)
+{
+    if(generated_key)
+    {
+        this->ticket_key.reset(new string(generate_ticket_key()));
+    }
+    else
+    {
+        check_ticket_key(ticket_key);
+        this->ticket_key.reset(new string(ticket_key));
+    }
+
+#ifdef HAVE_GNUTLS
+    credentials.reset(new tls_credentials());
+    check_gnutls(gnutls_certificate_allocate_credentials(&credentials->cred),
+            "Unable to allocate the TLS credentials");
+    if(trust != "")
+    {
+        gnutls_datum_t trust_d = to_datum(trust);
+        check_gnutls(gnutls_certificate_set_x509_trust_mem(credentials->cred,
+                    &trust_d, GNUTLS_X509_FMT_PEM),
+                "Invalid TLS trust certificate");
+    }
+    gnutls_certificate_set_retrieve_function3(credentials->cred, &retrieve_certificate);
+#endif //HAVE_GNUTLS
+
+    if(key != "" || cert != "")
+        default_certificate = load_certificate(key, cert, ocsp);
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_rwlock_init(&certificates_lock, NULL);
+}
+
+tls_manager::~tls_manager()
+{
+    pthread_mutex_destroy(&lock);
+    pthread_rwlock_destroy(&certificates_lock);
+}
+
+void tls_manager::reload(const string& key, const string& cert, const string& ocsp)
+{
+    shared_ptr<tls_certificate> fresh = load_certificate(key, cert, ocsp);
+    pthread_rwlock_wrlock(&certificates_lock);
+    default_certificate.swap(fresh);
+    pthread_rwlock_unlock(&certificates_lock);
+    credential_reloads++;
+}
+
+void tls_manager::add_certificate(const string& hostname, const string& key,
+        const string& cert, const string& ocsp
+)
+{
+    string name = normalize_hostname(hostname);
+    check_hostname(name);
+    shared_ptr<tls_certificate> fresh = load_certificate(key, cert, ocsp);
+    pthread_rwlock_wrlock(&certificates_lock);
+    certificates[name].swap(fresh);
+    pthread_rwlock_unlock(&certificates_lock);
+}
+
+bool tls_manager::remove_certificate(const string& hostname)
+{
+    string name = normalize_hostname(hostname);
+    shared_ptr<tls_certificate> removed;
+    pthread_rwlock_wrlock(&certificates_lock);
+    map<string, shared_ptr<tls_certificate> >::iterator it = certificates.find(name);
+    if(it != certificates.end())
+    {
+        removed.swap(it->second);
+        certificates.erase(it);
+    }
+    pthread_rwlock_unlock(&certificates_lock);
+    return removed != 0x0;
+}
+
+shared_ptr<tls_certificate> tls_manager::find_certificate(const string& hostname) const
+{
+    shared_ptr<tls_certificate> result;
+    string name = normalize_hostname(hostname);
+
+    pthread_rwlock_rdlock(&certificates_lock);
+    if(name != "" && !certificates.empty())
+    {
+        map<string, shared_ptr<tls_certificate> >::const_iterator it = certificates.find(name);
+        if(it == certificates.end())
+        {
+            string::size_type dot = name.find('.');
+            if(dot != string::npos && dot != 0)
+                it = certificates.find("*" + name.substr(dot));
+        }
+        if(it != certificates.end())
+            result = it->second;
+    }
+    if(result == 0x0)
+        result = default_certificate;
+    pthread_rwlock_unlock(&certificates_lock);
+    return result;
+}
+
+bool tls_manager::has_certificate(const string& hostname) const
+{
+    shared_ptr<tls_certificate> found = find_certificate(hostname);
+    return found != 0x0 && found != default_certificate;
+}
+
+void tls_manager::set_ticket_key(const string& ticket_key)
+{
+    check_ticket_key(ticket_key);
+    shared_ptr<string> fresh(new string(ticket_key));
+    pthread_mutex_lock(&lock);
+    this->ticket_key.swap(fresh);
+    generated_key = false;
+    pthread_mutex_unlock(&lock);
+}
+
+shared_ptr<string> tls_manager::current_ticket_key()
+{
+    if(generated_key && ticket_rotation > 0)
+    {
+        time_t now = time(0);
+        if(now - key_created >= ticket_rotation)
+        {
+            // Called when connections are set up, where nothing can be thrown: the current key is kept
+            // until a new one can be generated.
+            try
+            {
+                ticket_key.reset(new string(generate_ticket_key()));
+                key_created = now;
+            }
+            catch(const std::runtime_error&)
+            {
+            }
+        }
+    }
+    return ticket_key;
+}
+
+void* tls_manager::attach(void* session)
+{
+#ifdef HAVE_GNUTLS
+    gnutls_session_t s = static_cast<gnutls_session_t>(session);
+    tls_connection* conn = new tls_connection();
+    conn->manager = this;
+    conn->session = s;
+    conn->credentials = credentials;
+    conn->handshaken = false;
+
+    pthread_mutex_lock(&lock);
+    shared_ptr<string> key = tickets ? current_ticket_key() : shared_ptr<string>();
+    pthread_mutex_unlock(&lock);
+
+    // Only sessions authenticated with certificates (the libmicrohttpd default) are affected.
+    void* current = 0x0;
+    if(gnutls_credentials_get(s, GNUTLS_CRD_CERTIFICATE, &current) == GNUTLS_E_SUCCESS)
+        gnutls_credentials_set(s, GNUTLS_CRD_CERTIFICATE, credentials->cred);
+    if(key != 0x0)
+    {
+        // The key is copied by gnutls.
+        gnutls_datum_t key_d = to_datum(*key);
+        gnutls_session_ticket_enable_server(s, &key_d);
+    }
+    gnutls_db_set_ptr(s, conn);
+    if(cache.is_enabled())
+    {
+        gnutls_db_set_retrieve_function(s, &retrieve_session);
+        gnutls_db_set_store_function(s, &store_session);
+        gnutls_db_set_remove_function(s, &remove_session);
+    }
+    gnutls_handshake_set_hook_function(s, GNUTLS_HANDSHAKE_FINISHED,
+            GNUTLS_HOOK_POST, &handshake_finished
+    );
+    return conn;
+#else
+    return 0x0;
+#endif //HAVE_GNUTLS
+}
+
+void tls_manager::detach(void* context)
+{
+#ifdef HAVE_GNUTLS
+    tls_connection* conn = static_cast<tls_connection*>(context);
+    if(conn == 0x0) return;
+
+    // The keys are handed to the kernel by gnutls only once the handshake is over.
+    conn->manager->connection_closed(conn->handshaken, is_kernel_tls(conn->session));
+
+    // The session is released by libmicrohttpd right after this call, without being used again.
+    gnutls_db_set_ptr(conn->session, 0x0);
+    delete conn;
+#endif //HAVE_GNUTLS
+}
+
+bool tls_manager::is_kernel_tls(void* session)
+{
+#ifdef HAVE_GNUTLS_KTLS
+    return session != 0x0 && (gnutls_transport_is_ktls_enabled(
+                static_cast<gnutls_session_t>(session)) & GNUTLS_KTLS_SEND) != 0;
+#else
+    return false;
+#endif //HAVE_GNUTLS_KTLS
+}
+
+void* tls_manager::get_certificate_callback()
+{
+#ifdef HAVE_GNUTLS
+    return (void*) &retrieve_certificate_without_ocsp;
+#else
+    return 0x0;
+#endif //HAVE_GNUTLS
+}
+
+void tls_manager::handshake_completed(bool resumed)
+{
+    if(resumed)
+        resumed_handshakes++;
+    else
+        full_handshakes++;
+}
+
+void tls_manager::connection_closed(bool handshaken, bool kernel_tls)
+{
+    if(handshaken && kernel_tls)
+        ktls_connections++;
+}
+
+tls_stats tls_manager::get_stats() const
+{
+    tls_stats stats;
+    stats.full_handshakes = full_handshakes.load();
+    stats.resumed_handshakes = resumed_handshakes.load();
+    stats.credential_reloads = credential_reloads.load();
+    stats.ktls_connections = ktls_connections.load();
+    return stats;
+}
+
+}
+
+}
@@ -0,0 +1,112 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdint.h>
+#include <random>
+#include "details/tracing.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+bool is_lower_hex(const string& value, size_t from, size_t length)
+{
+    bool all_zero = true;
+    for(size_t i = from; i < from + length; i++)
+    {
+        char c = value[i];
+        if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return false;
+        all_zero = all_zero && c == '0';
+    }
+    // All zero ids are invalid.
+    return !all_zero || length == 2;
+}
+
+int hex_value(char c)
+{
+    return c <= '9' ? c - '0' : c - 'a' + 10;
+}
+
+} //namespace
+
+bool parse_traceparent(const string& header, trace_context& context)
+{
+    // version "-" trace-id "-" parent-id "-" flags
+    if(header.size() < 55 || header[2] != '-' || header[35] != '-' || header[52] != '-')
+        return false;
+    if(!is_lower_hex(header, 0, 2) || header.compare(0, 2, "ff") == 0)
+        return false;
+    // Version 00 has exactly four fields; later versions can append more.
+    if(header.compare(0, 2, "00") == 0 ? header.size() != 55 : (header.size() > 55 && header[55] != '-'))
+        return false;
+    if(!is_lower_hex(header, 3, 32) || !is_lower_hex(header, 36, 16) || !is_lower_hex(header, 53, 2))
+        return false;
+
+    context.trace_id = header.substr(3, 32);
+    context.parent_id = header.substr(36, 16);
+    context.flags = static_cast<unsigned char>(hex_value(header[53]) * 16 + hex_value(header[54]));
+    return true;
+}
+
+void start_trace(const string& traceparent, const string& tracestate, trace_context& context)
+{
+    if(parse_traceparent(traceparent, context))
+    {
+        context.tracestate = tracestate;
+    }
+    else
+    {
+        context.trace_id = random_hex(16);
+        context.parent_id = "";
+        context.flags = 0;
+        context.tracestate = "";
+    }
+    context.span_id = random_hex(8);
+}
+
+string random_hex(size_t bytes)
+{
+    static thread_local std::mt19937_64 generator(std::random_device{}());
+    static const char digits[] = "0123456789abcdef";
+    string hex;
+    hex.reserve(bytes * 2);
+    while(hex.size() < bytes * 2)
+    {
+        uint64_t value = generator();
+        for(int i = 0; i < 16 && hex.size() < bytes * 2; i++, value >>= 4)
+            hex += digits[value & 0x0f];
+    }
+    // Ids made only of zeros are invalid.
+    if(hex.find_first_not_of('0') == string::npos)
+        hex[hex.size() - 1] = '1';
+    return hex;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,398 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/time.h>
+#ifdef HAVE_EXECINFO
+#include <execinfo.h>
+#endif
+#include <utility>
+#include <vector>
+#include "details/watchdog.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+class watchdog_slots
+{
+    public:
+        explicit watchdog_slots(size_t count):
+            count(count > 0 ? count : 1),
+            slots(new watchdog_slot[this->count])
+        {
+            for(size_t i = 0; i < this->count; i++)
+            {
+                watchdog_slot& slot = slots[i];
+                slot.taken.store(false, std::memory_order_relaxed);
+                slot.sequence.store(0, std::memory_order_relaxed);
+                slot.started.store(0, std::memory_order_relaxed);
+                slot.reported = 0;
+                slot.thread.store(pthread_t(), std::memory_order_relaxed);
+                slot.route[0].store('\0', std::memory_order_relaxed);
+                slot.peer[0].store('\0', std::memory_order_relaxed);
+                slot.frame_count.store(-1, std::memory_order_relaxed);
+                slot.capturing.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        watchdog_slot* claim()
+        {
+            for(size_t i = 0; i < count; i++)
+            {
+                bool expected = false;
+                if(!slots[i].taken.load(std::memory_order_relaxed) &&
+                        slots[i].taken.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                    return &slots[i];
+            }
+            return 0x0;
+        }
+
+        size_t count;
+        std::unique_ptr<watchdog_slot[]> slots;
+};
+
+namespace
+{
+
+// Slots of the current thread, one per watchdog it ran handlers for.
+struct thread_slots
+{
+    vector<pair<shared_ptr<watchdog_slots>, watchdog_slot*> > owned;
+
+    ~thread_slots()
+    {
+        for(size_t i = 0; i < owned.size(); i++)
+        {
+            if(owned[i].second == 0x0)
+                continue;
+            owned[i].second->started.store(0, std::memory_order_relaxed);
+            owned[i].second->taken.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local thread_slots local_slots;
+
+// Slot of the handler running on the current thread, read by the stack capture signal handler.
+// The initial-exec model keeps its access from the signal handler free of __tls_get_addr calls.
+#if defined(__GNUC__)
+thread_local watchdog_slot* current_slot __attribute__((tls_model("initial-exec"))) = 0x0;
+#else
+thread_local watchdog_slot* current_slot = 0x0;
+#endif
+
+uint64_t now_microseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+watchdog_slot* local_slot(const shared_ptr<watchdog_slots>& slots)
+{
+    vector<pair<shared_ptr<watchdog_slots>, watchdog_slot*> >& owned = local_slots.owned;
+    for(size_t i = 0; i < owned.size(); i++)
+    {
+        if(owned[i].first != slots)
+            continue;
+        // Threads that found no free slot try again, since slots are released as threads end.
+        if(owned[i].second == 0x0)
+            owned[i].second = slots->claim();
+        return owned[i].second;
+    }
+
+    // First handler watched on this thread: forget the slots of the watchdogs destroyed since.
+    for(size_t i = owned.size(); i > 0; i--)
+    {
+        if(owned[i - 1].first.use_count() == 1)
+            owned.erase(owned.begin() + (i - 1));
+    }
+
+    watchdog_slot* slot = slots->claim();
+    owned.push_back(make_pair(slots, slot));
+    return slot;
+}
+
+void store_text(std::atomic<char>* text, size_t size, const std::string& value)
+{
+    size_t length = value.size() < size ? value.size() : size - 1;
+    for(size_t i = 0; i < length; i++)
+        text[i].store(value[i], std::memory_order_relaxed);
+    text[length].store('\0', std::memory_order_relaxed);
+}
+
+std::string load_text(const std::atomic<char>* text, size_t size)
+{
+    std::string value;
+    for(size_t i = 0; i < size; i++)
+    {
+        char c = text[i].load(std::memory_order_relaxed);
+        if(c == '\0')
+            break;
+        value += c;
+    }
+    return value;
+}
+
+void capture_own_stack(int)
+{
+#ifdef HAVE_EXECINFO
+    int saved_errno = errno;
+    watchdog_slot* slot = current_slot;
+    // Frames are only written while the watchdog waits for them, and not while it reads the previous ones.
+    if(slot != 0x0 && slot->capturing.load(std::memory_order_acquire))
+    {
+        // A handler that just ended has no stack worth reporting; answering at once spares the watchdog a wait.
+        if(slot->started.load(std::memory_order_acquire) == 0)
+            slot->frame_count.store(0, std::memory_order_release);
+        else
+            slot->frame_count.store(backtrace(slot->frames, watchdog_slot::MAX_FRAMES), std::memory_order_release);
+    }
+    errno = saved_errno;
+#endif
+}
+
+} //namespace
+
+watch_guard::watch_guard(const watched_request* watched):
+    slot(0x0)
+{
+    if(watched == 0x0 || watched->slots == 0x0)
+        return;
+    watchdog_slot* own = local_slot(watched->slots);
+    // Nested handlers (e.g. a deferred callback run from a render method) are watched as a whole.
+    if(own == 0x0 || own->started.load(std::memory_order_relaxed) != 0)
+        return;
+
+    uint64_t sequence = own->sequence.load(std::memory_order_relaxed);
+    own->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    store_text(own->route, watchdog_slot::ROUTE_SIZE, watched->route);
+    store_text(own->peer, watchdog_slot::PEER_SIZE, watched->peer);
+    own->thread.store(pthread_self(), std::memory_order_relaxed);
+    own->sequence.store(sequence + 2, std::memory_order_release);
+
+    current_slot = own;
+    own->started.store(now_microseconds(), std::memory_order_release);
+    slot = own;
+}
+
+watch_guard::~watch_guard()
+{
+    if(slot == 0x0)
+        return;
+    slot->started.store(0, std::memory_order_seq_cst);
+    // The watchdog may be signalling this thread: it must not end (or run another handler) before.
+    while(slot->capturing.load(std::memory_order_seq_cst))
+        sched_yield();
+    current_slot = 0x0;
+}
+
+handler_watchdog::handler_watchdog(handler_watchdog_ptr callback, int threshold, size_t slots, int stack_signal):
+    callback(callback),
+    threshold(static_cast<uint64_t>(threshold > 0 ? threshold : 1) * 1000),
+    stack_signal(stack_signal),
+    slots(new watchdog_slots(slots)),
+    running(false)
+{
+    pthread_mutex_init(&state_lock, NULL);
+    pthread_cond_init(&wakeup, NULL);
+}
+
+handler_watchdog::~handler_watchdog()
+{
+    stop();
+    pthread_cond_destroy(&wakeup);
+    pthread_mutex_destroy(&state_lock);
+}
+
+watched_request* handler_watchdog::watch(const std::string& route, const std::string& peer) const
+{
+    watched_request* watched = new watched_request();
+    watched->slots = slots;
+    watched->route = route;
+    watched->peer = peer;
+    return watched;
+}
+
+size_t handler_watchdog::check()
+{
+    size_t reported = 0;
+    uint64_t now = now_microseconds();
+    for(size_t i = 0; i < slots->count; i++)
+    {
+        watchdog_slot& slot = slots->slots[i];
+        if(!slot.taken.load(std::memory_order_acquire))
+            continue;
+        uint64_t started = slot.started.load(std::memory_order_acquire);
+        if(started == 0 || started > now || now - started < threshold || slot.reported == started)
+            continue;
+
+        stuck_handler report;
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        report.route = load_text(slot.route, watchdog_slot::ROUTE_SIZE);
+        report.peer = load_text(slot.peer, watchdog_slot::PEER_SIZE);
+        report.thread = slot.thread.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Written again meanwhile: the handler ended, the next scan looks at its successor.
+        if((sequence & 1) != 0 || slot.sequence.load(std::memory_order_relaxed) != sequence ||
+                slot.started.load(std::memory_order_acquire) != started)
+            continue;
+
+        slot.reported = started;
+        report.elapsed = now - started;
+        if(stack_signal != 0)
+            capture_stack(slot, started, report);
+        if(callback != 0x0)
+            callback(report);
+        reported++;
+    }
+    return reported;
+}
+
+void handler_watchdog::capture_stack(watchdog_slot& slot, uint64_t started, stuck_handler& report)
+{
+#ifdef HAVE_EXECINFO
+    slot.frame_count.store(-1, std::memory_order_relaxed);
+    // Either the handler is seen still running, and its thread waits for the end of the capture before
+    // leaving it (so it cannot have exited when signalled), or it is seen ended and it is not signalled.
+    slot.capturing.store(true, std::memory_order_seq_cst);
+    if(slot.started.load(std::memory_order_seq_cst) != started ||
+            pthread_kill(report.thread, stack_signal) != 0)
+    {
+        slot.capturing.store(false, std::memory_order_seq_cst);
+        return;
+    }
+
+    // The thread answers as soon as it runs; a thread blocked with the signal masked never does.
+    int frames = -1;
+    for(int i = 0; i < 100 && (frames = slot.frame_count.load(std::memory_order_acquire)) < 0; i++)
+        usleep(1000);
+    void* stack[watchdog_slot::MAX_FRAMES];
+    if(frames > 0)
+        memcpy(stack, slot.frames, frames * sizeof(void*));
+    slot.capturing.store(false, std::memory_order_seq_cst);
+    if(frames <= 0)
+        return;
+
+    char** symbols = backtrace_symbols(stack, frames);
+    if(symbols == 0x0)
+        return;
+    for(int i = 0; i < frames; i++)
+        report.stack.push_back(symbols[i]);
+    free(symbols);
+#else
+    (void) slot;
+    (void) started;
+    (void) report;
+#endif
+}
+
+void* handler_watchdog::watch_loop(void* self)
+{
+    handler_watchdog* watchdog = static_cast<handler_watchdog*>(self);
+    // Scanning four times per threshold reports a handler at most 25% late.
+    uint64_t interval = watchdog->threshold / 4;
+    if(interval < 10000)
+        interval = 10000;
+    if(interval > 1000000)
+        interval = 1000000;
+
+    pthread_mutex_lock(&watchdog->state_lock);
+    while(watchdog->running)
+    {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        long long deadline = (now.tv_sec * 1000000LL + now.tv_usec) + interval;
+        struct timespec until;
+        until.tv_sec = deadline / 1000000;
+        until.tv_nsec = (deadline % 1000000) * 1000;
+        int result = 0;
+        while(watchdog->running && result != ETIMEDOUT)
+            result = pthread_cond_timedwait(&watchdog->wakeup, &watchdog->state_lock, &until);
+
+        pthread_mutex_unlock(&watchdog->state_lock);
+        watchdog->check();
+        pthread_mutex_lock(&watchdog->state_lock);
+    }
+    pthread_mutex_unlock(&watchdog->state_lock);
+    return 0x0;
+}
+
+void handler_watchdog::start()
+{
+    pthread_mutex_lock(&state_lock);
+    if(!running)
+    {
+#ifdef HAVE_EXECINFO
+        if(stack_signal != 0)
+        {
+            // The first call loads the unwinder, which cannot be done from a signal handler.
+            void* frame[1];
+            backtrace(frame, 1);
+
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = &capture_own_stack;
+            action.sa_flags = SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            sigaction(stack_signal, &action, &previous_action);
+        }
+#endif
+        if(pthread_create(&thread, NULL, &watch_loop, this) == 0)
+            running = true;
+#ifdef HAVE_EXECINFO
+        else if(stack_signal != 0)
+            sigaction(stack_signal, &previous_action, NULL);
+#endif
+    }
+    pthread_mutex_unlock(&state_lock);
+}
+
+void handler_watchdog::stop()
+{
+    pthread_mutex_lock(&state_lock);
+    bool was_running = running;
+    running = false;
+    pthread_cond_signal(&wakeup);
+    pthread_mutex_unlock(&state_lock);
+
+    if(!was_running)
+        return;
+    pthread_join(thread, NULL);
+#ifdef HAVE_EXECINFO
+    if(stack_signal != 0)
+        sigaction(stack_signal, &previous_action, NULL);
+#endif
+}
+
+} //details
+
+} //httpserver
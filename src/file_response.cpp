@@ -19,29 +19,463 @@
 */
 
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
 #include "file_response.hpp"
+#include "http_request.hpp"
+#include "details/file_cache.hpp"
+
+#ifndef F_DUPFD_CLOEXEC
+#define F_DUPFD_CLOEXEC F_DUPFD
+#endif
 
 using namespace std;
 
 namespace httpserver
 {
 
+using namespace http;
+
+namespace
+{
+
+struct byteranges_segment
+{
+    uint64_t start;
+    uint64_t length;
+    bool from_file;
+    uint64_t file_offset;
+    std::string text;
+};
+
+struct byteranges_body
+{
+    int fd;
+    uint64_t total;
+    std::vector<byteranges_segment> segments;
+
+    byteranges_body(int fd):
+        fd(fd),
+        total(0)
+    {
+    }
+
+    void append_text(const std::string& text)
+    {
+        byteranges_segment s;
+        s.start = total;
+        s.length = text.size();
+        s.from_file = false;
+        s.file_offset = 0;
+        s.text = text;
+        segments.push_back(s);
+        total += s.length;
+    }
+
+    void append_file(uint64_t offset, uint64_t length)
+    {
+        byteranges_segment s;
+        s.start = total;
+        s.length = length;
+        s.from_file = true;
+        s.file_offset = offset;
+        segments.push_back(s);
+        total += s.length;
+    }
+};
+
+bool segment_before(uint64_t pos, const byteranges_segment& s)
+{
+    return pos < s.start;
+}
+
+ssize_t byteranges_reader(void* cls, uint64_t pos, char* buf, size_t max)
+{
+    byteranges_body* body = static_cast<byteranges_body*>(cls);
+    if(pos >= body->total) return MHD_CONTENT_READER_END_OF_STREAM;
+
+    std::vector<byteranges_segment>::const_iterator it = std::upper_bound(
+            body->segments.begin(), body->segments.end(), pos, segment_before
+    );
+    --it;
+
+    size_t written = 0;
+    while(written < max && it != body->segments.end())
+    {
+        uint64_t skip = pos - it->start;
+        size_t len = (size_t) std::min<uint64_t>(it->length - skip, max - written);
+        if(it->from_file)
+        {
+            ssize_t r = pread(body->fd, buf + written, len, it->file_offset + skip);
+            if(r <= 0)
+            {
+                if(written) break;
+                return MHD_CONTENT_READER_END_WITH_ERROR;
+            }
+            len = r;
+        }
+        else
+        {
+            memcpy(buf + written, it->text.data() + skip, len);
+        }
+        written += len;
+        pos += len;
+        if(pos == it->start + it->length) ++it;
+    }
+    return written;
+}
+
+void byteranges_free(void* cls)
+{
+    byteranges_body* body = static_cast<byteranges_body*>(cls);
+    close(body->fd);
+    delete body;
+}
+
+// Block read from the file at once when the kernel encrypts the connection: with kTLS every
+// block is handed to the kernel in a single send instead of being encrypted record by record.
+const size_t KERNEL_TLS_BLOCK_SIZE = 64 * 1024;
+
+// Response reading length bytes of the file from offset. libmicrohttpd uses sendfile on
+// plain connections; over TLS the file is read in userspace anyway, so bigger blocks are
+// used when the encryption is done by the kernel.
+MHD_Response* file_body_response(const http_request& req, uint64_t length, int fd, uint64_t offset)
+{
+    if(!req.is_kernel_tls())
+        return MHD_create_response_from_fd_at_offset64(length, fd, offset);
+
+    byteranges_body* body = new byteranges_body(fd);
+    body->append_file(offset, length);
+    return MHD_create_response_from_callback(body->total, KERNEL_TLS_BLOCK_SIZE,
+            &byteranges_reader, body, &byteranges_free
+    );
+}
+
+// Returns a descriptor owned by the caller together with the file metadata.
+int acquire_file(const std::string& filename,
+        std::shared_ptr<details::file_cache_entry>& file, details::file_cache* cache
+)
+{
+    if(cache != 0x0)
+    {
+        // The cached descriptor stays open for the next requests; MHD gets a
+        // duplicate sharing the same open file (it reads with explicit offsets).
+        file = cache->get(filename);
+        int fd = fcntl(file->fd, F_DUPFD_CLOEXEC, 0);
+        if(fd == -1)
+        {
+            throw std::runtime_error("Unable to duplicate descriptor of file: " + filename);
+        }
+        return fd;
+    }
+
+    file = details::file_cache::open_file(filename);
+    int fd = file->fd;
+    file->fd = -1;
+    return fd;
+}
+
+MHD_Response* empty_response()
+{
+    return MHD_create_response_from_buffer(0, (void*) "", MHD_RESPMEM_PERSISTENT);
+}
+
+std::string make_etag(const details::file_cache_entry& file)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "\"%llx-%llx-%llx\"",
+            (unsigned long long) file.inode,
+            (unsigned long long) file.size,
+            (unsigned long long) file.mtime
+    );
+    return buf;
+}
+
+std::string strip_weak(const std::string& etag)
+{
+    if(etag.size() > 2 && etag[0] == 'W' && etag[1] == '/')
+        return etag.substr(2);
+    return etag;
+}
+
+// Weak comparison of an If-None-Match list against the current entity tag
+bool etag_list_matches(const std::string& list, const std::string& etag)
+{
+    std::string current = strip_weak(etag);
+    size_t pos = 0;
+    while(pos < list.size())
+    {
+        size_t comma = list.find(',', pos);
+        if(comma == std::string::npos) comma = list.size();
+
+        size_t begin = list.find_first_not_of(" \t", pos);
+        size_t end = comma;
+        while(end > pos && (list[end - 1] == ' ' || list[end - 1] == '\t')) end--;
+        pos = comma + 1;
+
+        if(begin == std::string::npos || begin >= end) continue;
+
+        std::string candidate = list.substr(begin, end - begin);
+        if(candidate == "*" || strip_weak(candidate) == current) return true;
+    }
+    return false;
+}
+
+// Range must be honored only if If-Range (if any) still matches the file
+bool if_range_matches(const std::string& if_range, const std::string& etag,
+        time_t mtime
+)
+{
+    if(if_range.empty()) return true;
+    if(if_range[0] == '"')
+    {
+        // strong comparison: a weak tag never matches
+        return if_range == etag;
+    }
+    if(if_range[0] == 'W' && if_range.size() > 1 && if_range[1] == '/')
+        return false;
+    return parse_http_date(if_range) == mtime;
+}
+
+std::string make_boundary(const details::file_cache_entry& file)
+{
+    static std::atomic<unsigned int> counter(0);
+
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%016llx%08x",
+            (unsigned long long) (file.inode * 0x9E3779B97F4A7C15ULL) ^ (unsigned long long) file.mtime,
+            counter.fetch_add(1)
+    );
+    return buf;
+}
+
+std::string content_range(uint64_t first, uint64_t last, uint64_t size)
+{
+    char buf[80];
+    snprintf(buf, sizeof(buf), "bytes %llu-%llu/%llu",
+            (unsigned long long) first,
+            (unsigned long long) last,
+            (unsigned long long) size
+    );
+    return buf;
+}
+
+}
+
 MHD_Response* file_response::get_raw_response()
 {
-    int fd = open(filename.c_str(), O_RDONLY);
-    size_t size = lseek(fd, 0, SEEK_END);
+    std::shared_ptr<details::file_cache_entry> file;
+    int fd = acquire_file(filename, file, 0x0);
+
+    uint64_t size = file->size;
     if(size)
     {
-        return MHD_create_response_from_fd(size, fd);
+        return MHD_create_response_from_fd_at_offset64(size, fd, 0);
+    }
+    else
+    {
+        close(fd);
+        return empty_response();
+    }
+}
+
+MHD_Response* file_response::get_raw_response_for(const http_request& req, int& status)
+{
+    if(!serves_entity(req)) return get_raw_response();
+    return serve_file(req, filename, status);
+}
+
+MHD_Response* file_response::get_raw_response_encoded(const http_request& req, const std::string& encoding, int& status)
+{
+    if(!serves_entity(req)) return 0x0;
+
+    const char* extension;
+    if(encoding == "gzip") extension = ".gz";
+    else if(encoding == "br") extension = ".br";
+    else if(encoding == "zstd") extension = ".zst";
+    else return 0x0;
+
+    // A precompressed sibling is used only if it is at least as recent as the file itself
+    std::string sibling = filename + extension;
+    struct stat original;
+    struct stat encoded;
+    if(stat(filename.c_str(), &original) == -1 ||
+            stat(sibling.c_str(), &encoded) == -1 ||
+            !S_ISREG(encoded.st_mode) || encoded.st_mtime < original.st_mtime)
+        return 0x0;
+
+    return serve_file(req, sibling, status);
+}
+
+bool file_response::serves_entity(const http_request& req) const
+{
+    const std::string& method = req.get_method();
+    return response_code == http_utils::http_ok &&
+        (method == http_utils::http_method_get || method == http_utils::http_method_head);
+}
+
+MHD_Response* file_response::serve_file(const http_request& req, const std::string& path, int& status)
+{
+    bool is_get = req.get_method() == http_utils::http_method_get;
+
+    std::shared_ptr<details::file_cache_entry> file;
+    int fd = acquire_file(path, file, req.files);
+    uint64_t size = file->size;
+
+    std::vector<std::pair<std::string, std::string> > served_headers;
+
+    std::string etag;
+    map<string, string, header_comparator>::const_iterator it =
+        headers.find(http_utils::http_header_etag);
+    if(it != headers.end())
+    {
+        etag = it->second;
+    }
+    else
+    {
+        etag = make_etag(*file);
+        served_headers.push_back(make_pair(http_utils::http_header_etag, etag));
+    }
+    if(headers.find(http_utils::http_header_last_modified) == headers.end())
+    {
+        served_headers.push_back(make_pair(
+                    http_utils::http_header_last_modified,
+                    format_http_date(file->mtime)
+        ));
+    }
+
+    bool not_modified = false;
+    std::string if_none_match = req.get_header(http_utils::http_header_if_none_match);
+    if(!if_none_match.empty())
+    {
+        not_modified = etag_list_matches(if_none_match, etag);
+    }
+    else
+    {
+        std::string if_modified_since = req.get_header(http_utils::http_header_if_modified_since);
+        if(!if_modified_since.empty())
+        {
+            time_t since = parse_http_date(if_modified_since);
+            not_modified = since != -1 && file->mtime <= since;
+        }
+    }
+
+    MHD_Response* response;
+    if(not_modified)
+    {
+        close(fd);
+        status = http_utils::http_not_modified;
+        response = empty_response();
     }
     else
     {
-        return MHD_create_response_from_buffer(
-                0,
-                (void*) "",
-                MHD_RESPMEM_PERSISTENT
+        if(headers.find(http_utils::http_header_accept_ranges) == headers.end())
+        {
+            served_headers.push_back(make_pair(http_utils::http_header_accept_ranges, "bytes"));
+        }
+
+        std::vector<std::pair<uint64_t, uint64_t> > ranges;
+        std::string range = is_get ? req.get_header(http_utils::http_header_range) : "";
+        bool partial = !range.empty() &&
+            if_range_matches(req.get_header(http_utils::http_header_if_range), etag, file->mtime) &&
+            parse_byte_ranges(range, size, ranges);
+
+        if(partial && ranges.empty())
+        {
+            close(fd);
+            status = http_utils::http_requested_range_not_satisfiable;
+            served_headers.push_back(make_pair(
+                        http_utils::http_header_content_range,
+                        "bytes */" + std::to_string(size)
+            ));
+            response = empty_response();
+        }
+        else if(partial && ranges.size() == 1)
+        {
+            status = http_utils::http_partial_content;
+            served_headers.push_back(make_pair(
+                        http_utils::http_header_content_range,
+                        content_range(ranges[0].first, ranges[0].second, size)
+            ));
+            response = file_body_response(req,
+                    ranges[0].second - ranges[0].first + 1, fd, ranges[0].first
+            );
+        }
+        else if(partial)
+        {
+            status = http_utils::http_partial_content;
+            std::string boundary = make_boundary(*file);
+
+            std::string part_type;
+            it = headers.find(http_utils::http_header_content_type);
+            if(it != headers.end())
+            {
+                part_type = http_utils::http_header_content_type + ": " + it->second + "\r\n";
+            }
+
+            byteranges_body* body = new byteranges_body(fd);
+            for(size_t i = 0; i < ranges.size(); i++)
+            {
+                body->append_text((i ? "\r\n--" : "--") + boundary + "\r\n" + part_type +
+                        http_utils::http_header_content_range + ": " +
+                        content_range(ranges[i].first, ranges[i].second, size) + "\r\n\r\n"
+                );
+                body->append_file(ranges[i].first, ranges[i].second - ranges[i].first + 1);
+            }
+            body->append_text("\r\n--" + boundary + "--\r\n");
+
+            response = MHD_create_response_from_callback(body->total, 32 * 1024,
+                    &byteranges_reader, body, &byteranges_free
+            );
+            // Replaces the content type of the response, in decorate_response.
+            served_headers.push_back(make_pair(
+                        http_utils::http_header_content_type,
+                        "multipart/byteranges; boundary=" + boundary
+            ));
+        }
+        else if(size)
+        {
+            response = file_body_response(req, size, fd, 0);
+        }
+        else
+        {
+            close(fd);
+            response = empty_response();
+        }
+    }
+
+    for(size_t i = 0; i < served_headers.size(); i++)
+    {
+        MHD_add_response_header(response,
+                served_headers[i].first.c_str(),
+                served_headers[i].second.c_str()
         );
     }
+    return response;
+}
+
+void file_response::decorate_response(MHD_Response* response)
+{
+    // A multipart body carries its own content type (set by serve_file), one per part.
+    const char* served_type = MHD_get_response_header(response, http_utils::http_header_content_type.c_str());
+    bool multipart = served_type != 0x0 && strncmp(served_type, "multipart/byteranges", 20) == 0;
+
+    http_response::decorate_response(response);
+
+    if(multipart)
+    {
+        map<string, string, header_comparator>::const_iterator it =
+            headers.find(http_utils::http_header_content_type);
+        if(it != headers.end())
+        {
+            MHD_del_response_header(response, it->first.c_str(), it->second.c_str());
+        }
+    }
 }
 
 }
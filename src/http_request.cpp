@@ -22,6 +22,9 @@
 #include "http_utils.hpp"
 #include "http_request.hpp"
 #include "string_utilities.hpp"
+#include "details/credential_cache.hpp"
+#include "details/tls_manager.hpp"
+#include "request_trace.hpp"
 #include <iostream>
 
 using namespace std;
@@ -228,36 +231,58 @@ int http_request::build_request_querystring(
     return MHD_YES;
 }
 
-const std::string http_request::get_user() const
+void http_request::fetch_basic_auth() const
 {
-    char* username = 0x0;
-    char* password = 0x0;
+    if(basic_auth_fetched) return;
+    basic_auth_fetched = true;
 
-    username = MHD_basic_auth_get_username_password(underlying_connection, &password);
-    if (password != 0x0) free(password);
-
-    std::string user;
-    if (username != 0x0) user = username;
+    char* password = 0x0;
+    char* username = MHD_basic_auth_get_username_password(underlying_connection, &password);
 
-    free(username);
+    if(username != 0x0)
+    {
+        user = username;
+        free(username);
+    }
+    if(password != 0x0)
+    {
+        pass = password;
+        free(password);
+    }
+}
 
+const std::string http_request::get_user() const
+{
+    fetch_basic_auth();
     return user;
 }
 
 const std::string http_request::get_pass() const
 {
-    char* username = 0x0;
-    char* password = 0x0;
+    fetch_basic_auth();
+    return pass;
+}
 
-    username = MHD_basic_auth_get_username_password(underlying_connection, &password);
-    if (username != 0x0) free(username);
+bool http_request::check_basic_auth() const
+{
+    if(credentials == 0x0) return false;
 
-    std::string pass;
-    if (password != 0x0) pass = password;
+    fetch_basic_auth();
+    if(user.empty()) return false;
 
-    free(password);
+    return credentials->check(user, pass);
+}
 
-    return pass;
+const request_timings& http_request::get_timings() const
+{
+    static const request_timings untimed;
+    return span != 0x0 ? span->timings : untimed;
+}
+
+const trace_context& http_request::get_trace_context() const
+{
+    static const trace_context untraced;
+    return span != 0x0 ? span->context : untraced;
 }
 
 const std::string http_request::get_digested_user() const
@@ -295,6 +320,16 @@ unsigned short http_request::get_requestor_port() const
     return http::get_port(conninfo->client_addr);
 }
 
+bool http_request::is_kernel_tls() const
+{
+    const MHD_ConnectionInfo * conninfo = MHD_get_connection_info(
+            underlying_connection,
+            MHD_CONNECTION_INFO_GNUTLS_SESSION
+    );
+
+    return conninfo != 0x0 && details::tls_manager::is_kernel_tls(conninfo->tls_session);
+}
+
 std::ostream &operator<< (std::ostream &os, const http_request &r)
 {
     os << r.get_method() << " Request [user:\"" << r.get_user() << "\" pass:\"" << r.get_pass() << "\"] path:\""
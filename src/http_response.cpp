@@ -38,6 +38,16 @@ MHD_Response* http_response::get_raw_response()
     return MHD_create_response_from_buffer(0, (void*) "", MHD_RESPMEM_PERSISTENT);
 }
 
+MHD_Response* http_response::get_raw_response_for(const http_request& req, int& status)
+{
+    return get_raw_response();
+}
+
+MHD_Response* http_response::get_raw_response_encoded(const http_request& req, const std::string& encoding, int& status)
+{
+    return 0x0;
+}
+
 void http_response::decorate_response(MHD_Response* response)
 {
     map<string, string, http::header_comparator>::iterator it;
@@ -28,6 +28,7 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #else
+#include <strings.h>
 #include <sys/socket.h>
 #include <netdb.h>
 #include <arpa/inet.h>
@@ -103,6 +104,7 @@ const int http_utils::http_failed_dependency = MHD_HTTP_FAILED_DEPENDENCY;
 const int http_utils::http_unordered_collection = MHD_HTTP_UNORDERED_COLLECTION;
 const int http_utils::http_upgrade_required = MHD_HTTP_UPGRADE_REQUIRED;
 const int http_utils::http_retry_with = MHD_HTTP_RETRY_WITH;
+const int http_utils::http_too_many_requests = MHD_HTTP_TOO_MANY_REQUESTS;
 
 const int http_utils::http_internal_server_error =
     MHD_HTTP_INTERNAL_SERVER_ERROR;
@@ -606,5 +608,237 @@ size_t base_unescaper(std::string& s, unescaper_ptr unescaper)
     return http_unescape(s);
 }
 
+static const char* const http_day_names[] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+
+static const char* const http_month_names[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static bool parse_range_offset(const std::string& s, size_t begin,
+        size_t end, uint64_t& value
+)
+{
+    if(begin >= end) return false;
+
+    value = 0;
+    for(size_t i = begin; i < end; i++)
+    {
+        if(s[i] < '0' || s[i] > '9') return false;
+        uint64_t digit = s[i] - '0';
+        // saturate instead of overflowing: a huge offset is unsatisfiable anyway
+        if(value > (UINT64_MAX - digit) / 10)
+            value = UINT64_MAX;
+        else
+            value = value * 10 + digit;
+    }
+    return true;
+}
+
+bool parse_byte_ranges(const std::string& header, uint64_t size,
+        std::vector<std::pair<uint64_t, uint64_t> >& ranges
+)
+{
+    // Requests with too many ranges are served as a whole (RFC 7233, 6.1)
+    static const size_t max_ranges = 64;
+
+    ranges.clear();
+
+    size_t pos = header.find_first_not_of(" \t");
+    if(pos == std::string::npos || header.size() - pos < 6 ||
+            strncasecmp(header.c_str() + pos, "bytes", 5) != 0)
+        return false;
+    pos = header.find_first_not_of(" \t", pos + 5);
+    if(pos == std::string::npos || header[pos] != '=') return false;
+    pos++;
+
+    size_t specs = 0;
+    while(pos <= header.size())
+    {
+        size_t comma = header.find(',', pos);
+        if(comma == std::string::npos) comma = header.size();
+
+        size_t begin = header.find_first_not_of(" \t", pos);
+        size_t end = comma;
+        while(end > pos && (header[end - 1] == ' ' || header[end - 1] == '\t'))
+            end--;
+        pos = comma + 1;
+
+        if(begin == std::string::npos || begin >= end) continue;
+        if(++specs > max_ranges) return false;
+
+        size_t dash = header.find('-', begin);
+        if(dash == std::string::npos || dash >= end) return false;
+
+        uint64_t first;
+        uint64_t last;
+        if(dash == begin)
+        {
+            uint64_t suffix;
+            if(!parse_range_offset(header, dash + 1, end, suffix)) return false;
+            if(suffix == 0 || size == 0) continue;
+            first = suffix >= size ? 0 : size - suffix;
+            last = size - 1;
+        }
+        else
+        {
+            if(!parse_range_offset(header, begin, dash, first)) return false;
+            if(dash + 1 == end)
+            {
+                last = UINT64_MAX;
+            }
+            else
+            {
+                if(!parse_range_offset(header, dash + 1, end, last)) return false;
+                if(last < first) return false;
+            }
+            if(first >= size) continue;
+            if(last >= size) last = size - 1;
+        }
+        ranges.push_back(std::make_pair(first, last));
+    }
+
+    if(specs == 0) return false;
+
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for(size_t i = 1; i < ranges.size(); i++)
+    {
+        if(ranges[i].first <= ranges[merged].second + 1)
+        {
+            ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
+        }
+        else
+        {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    if(!ranges.empty()) ranges.resize(merged + 1);
+
+    return true;
+}
+
+std::string format_http_date(time_t t)
+{
+    struct tm tm;
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+            http_day_names[tm.tm_wday], tm.tm_mday,
+            http_month_names[tm.tm_mon], tm.tm_year + 1900,
+            tm.tm_hour, tm.tm_min, tm.tm_sec
+    );
+    return buf;
+}
+
+time_t parse_http_date(const std::string& date)
+{
+    int day, year, hour, minute, second;
+    char month_name[4];
+    char weekday[4];
+
+    size_t comma = date.find(',');
+    if(comma != std::string::npos)
+    {
+        const char* rest = date.c_str() + comma + 1;
+        // IMF-fixdate, then the obsolete RFC 850 format
+        if(sscanf(rest, " %2d %3s %4d %2d:%2d:%2d GMT", &day, month_name,
+                    &year, &hour, &minute, &second) != 6 &&
+                sscanf(rest, " %2d-%3[a-zA-Z]-%2d %2d:%2d:%2d GMT", &day,
+                    month_name, &year, &hour, &minute, &second) != 6)
+            return -1;
+        if(year < 100) year += year < 70 ? 2000 : 1900;
+    }
+    else
+    {
+        // ANSI C asctime() format
+        if(sscanf(date.c_str(), "%3s %3s %2d %2d:%2d:%2d %4d", weekday,
+                    month_name, &day, &hour, &minute, &second, &year) != 7)
+            return -1;
+    }
+
+    int month = -1;
+    for(int i = 0; i < 12; i++)
+    {
+        if(strncasecmp(month_name, http_month_names[i], 3) == 0)
+        {
+            month = i + 1;
+            break;
+        }
+    }
+    if(month == -1 || day < 1 || day > 31 || hour > 23 || minute > 59 ||
+            second > 60 || year < 1970)
+        return -1;
+
+    // days since the epoch from the civil date (proleptic gregorian calendar)
+    int y = month <= 2 ? year - 1 : year;
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long long days = (long long) era * 146097 + doe - 719468;
+
+    return (time_t) (days * 86400 + hour * 3600 + minute * 60 + second);
+}
+
+std::vector<std::string> accepted_encodings(const std::string& header,
+        const std::vector<std::string>& available
+)
+{
+    std::map<std::string, double, header_comparator> qvalues;
+
+    size_t pos = 0;
+    while(pos < header.size())
+    {
+        size_t comma = header.find(',', pos);
+        if(comma == std::string::npos) comma = header.size();
+        std::string item = header.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        double q = 1.0;
+        size_t semicolon = item.find(';');
+        if(semicolon != std::string::npos)
+        {
+            size_t qpos = item.find("q=", semicolon);
+            if(qpos == std::string::npos) qpos = item.find("Q=", semicolon);
+            if(qpos != std::string::npos) q = strtod(item.c_str() + qpos + 2, NULL);
+            item.erase(semicolon);
+        }
+
+        size_t begin = item.find_first_not_of(" \t");
+        size_t end = item.find_last_not_of(" \t");
+        if(begin == std::string::npos) continue;
+        qvalues[item.substr(begin, end - begin + 1)] = q;
+    }
+
+    std::map<std::string, double, header_comparator>::const_iterator star = qvalues.find("*");
+
+    std::vector<std::pair<double, std::string> > candidates;
+    for(size_t i = 0; i < available.size(); i++)
+    {
+        std::map<std::string, double, header_comparator>::const_iterator it = qvalues.find(available[i]);
+        double q = it != qvalues.end() ? it->second : (star != qvalues.end() ? star->second : 0.0);
+        if(q > 0.0) candidates.push_back(std::make_pair(q, available[i]));
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(),
+        [](const std::pair<double, std::string>& a, const std::pair<double, std::string>& b) {
+            return a.first > b.first;
+        }
+    );
+
+    std::vector<std::string> result;
+    for(size_t i = 0; i < candidates.size(); i++)
+        result.push_back(candidates[i].second);
+    return result;
+}
+
 };
 };
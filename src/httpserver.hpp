@@ -34,6 +34,14 @@
 #include "httpserver/file_response.hpp"
 
 #include "httpserver/http_request.hpp"
+#include "httpserver/nonce_store.hpp"
+#include "httpserver/access_record.hpp"
+#include "httpserver/error_record.hpp"
+#include "httpserver/runtime_config.hpp"
+#include "httpserver/request_trace.hpp"
+#include "httpserver/connection_info.hpp"
+#include "httpserver/stuck_handler.hpp"
+#include "httpserver/socket_handoff.hpp"
 #include "httpserver/webserver.hpp"
 
 #endif
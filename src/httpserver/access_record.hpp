@@ -0,0 +1,61 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ACCESS_RECORD_HPP_
+#define _ACCESS_RECORD_HPP_
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+namespace httpserver
+{
+
+/**
+ * Access log entry of a request, built once the response was sent (see create_webserver::access_log_sink).
+**/
+struct access_record
+{
+    /** Wall clock time at which the request completed **/
+    struct timespec time;
+    /** Address of the client **/
+    std::string peer;
+    std::string method;
+    /** Path and query string as sent by the client **/
+    std::string path;
+    std::string user_agent;
+    int status;
+    /** Size of the request body **/
+    uint64_t bytes_received;
+    /** Microseconds between the reception of the request line and the completion of the response **/
+    uint64_t latency;
+    /** false if the response could not be sent completely (e.g. the client closed the connection) **/
+    bool completed;
+};
+
+typedef void(*access_log_sink_ptr)(const std::vector<access_record>& records);
+
+};
+#endif //_ACCESS_RECORD_HPP_
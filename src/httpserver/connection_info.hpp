@@ -0,0 +1,75 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _CONNECTION_INFO_HPP_
+#define _CONNECTION_INFO_HPP_
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+
+namespace httpserver
+{
+
+/**
+ * State of a live connection, as returned by webserver::get_connections.
+**/
+struct connection_info
+{
+    enum state_T
+    {
+        /** Waiting for a request (or for its request line) **/
+        IDLE,
+        /** The request line was received, the headers are being received **/
+        READING_HEADERS,
+        /** The body of the request is being received **/
+        READING_BODY,
+        /** The request is being filtered, routed or rendered **/
+        HANDLING,
+        /** The response is being sent (deferred responses stay here until their callback ends the stream) **/
+        SENDING
+    };
+
+    /** Identifier of the connection, unique for the lifetime of the server **/
+    uint64_t id;
+    /** Address of the client **/
+    std::string peer;
+    unsigned short peer_port;
+    /** Wall clock time at which the connection was accepted **/
+    struct timespec started;
+    /** Number of requests received on the connection, including the current one **/
+    uint64_t requests;
+    /** Bytes moved on the socket so far (including headers and TLS records), zero where TCP_INFO does not report them **/
+    uint64_t bytes_received;
+    uint64_t bytes_sent;
+    state_T state;
+    /** Microseconds spent in the current state **/
+    uint64_t state_age;
+    /** Thread that last served the connection **/
+    pthread_t thread;
+};
+
+};
+#endif //_CONNECTION_INFO_HPP_
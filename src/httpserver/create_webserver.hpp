@@ -28,6 +28,12 @@
 #include <stdlib.h>
 #include "httpserver/http_utils.hpp"
 #include "httpserver/http_response.hpp"
+#include "httpserver/nonce_store.hpp"
+#include "httpserver/access_record.hpp"
+#include "httpserver/error_record.hpp"
+#include "httpserver/runtime_config.hpp"
+#include "httpserver/request_trace.hpp"
+#include "httpserver/stuck_handler.hpp"
 
 #define DEFAULT_WS_TIMEOUT 180
 #define DEFAULT_WS_PORT 9898
@@ -39,8 +45,8 @@ class http_request;
 
 typedef const std::shared_ptr<http_response>(*render_ptr)(const http_request&);
 typedef bool(*validator_ptr)(const std::string&);
-typedef void(*log_access_ptr)(const std::string&);
-typedef void(*log_error_ptr)(const std::string&);
+typedef bool(*basic_auth_verifier_ptr)(const std::string& user, const std::string& pass);
+typedef bool(*digest_auth_password_ptr)(const std::string& user, const std::string& realm, std::string& password);
 
 class create_webserver
 {
@@ -82,7 +88,51 @@ class create_webserver
             _single_resource(false),
             _not_found_resource(0x0),
             _method_not_allowed_resource(0x0),
-            _internal_error_resource(0x0)
+            _internal_error_resource(0x0),
+            _file_cache_size(0),
+            _file_cache_ttl(1),
+            _compression_enabled(false),
+            _compression_min_size(256),
+            _compression_cache_size(0),
+            _rate_limit_rate(0),
+            _rate_limit_burst(0),
+            _rate_limit_table_size(16384),
+            _auto_ban_auth_failures(0),
+            _auto_ban_not_found(0),
+            _auto_ban_bad_requests(0),
+            _auto_ban_window(60),
+            _auto_ban_duration(600),
+            _basic_auth_verifier(0x0),
+            _basic_auth_cache_size(1024),
+            _basic_auth_cache_ttl(60),
+            _https_session_tickets(true),
+            _https_session_ticket_key(""),
+            _https_session_ticket_rotation(0),
+            _https_session_cache_size(1024),
+            _https_ocsp_response(""),
+            _https_sni_certificates(),
+            _digest_auth_password_lookup(0x0),
+            _digest_auth_nonce_store(std::shared_ptr<nonce_store>()),
+            _digest_auth_nonce_table_size(65536),
+            _digest_auth_nonce_timeout(300),
+            _request_filter(0x0),
+            _metrics(false),
+            _metrics_endpoint(""),
+            _metrics_max_series(1024),
+            _access_log_sink(0x0),
+            _access_log_ring_size(4096),
+            _access_log_flush_interval(100),
+            _request_timing(false),
+            _request_tracer(0x0),
+            _connection_tracking(false),
+            _handler_watchdog(0x0),
+            _handler_watchdog_threshold(5000),
+            _handler_watchdog_slots(0),
+            _handler_watchdog_stack_signal(0),
+            _error_log_sink(0x0),
+            _error_log_burst(10),
+            _error_log_window(1000),
+            _drain_timeout(30000)
         {
         }
 
@@ -123,7 +173,51 @@ class create_webserver
             _single_resource(b._single_resource),
             _not_found_resource(b._not_found_resource),
             _method_not_allowed_resource(b._method_not_allowed_resource),
-            _internal_error_resource(b._internal_error_resource)
+            _internal_error_resource(b._internal_error_resource),
+            _file_cache_size(b._file_cache_size),
+            _file_cache_ttl(b._file_cache_ttl),
+            _compression_enabled(b._compression_enabled),
+            _compression_min_size(b._compression_min_size),
+            _compression_cache_size(b._compression_cache_size),
+            _rate_limit_rate(b._rate_limit_rate),
+            _rate_limit_burst(b._rate_limit_burst),
+            _rate_limit_table_size(b._rate_limit_table_size),
+            _auto_ban_auth_failures(b._auto_ban_auth_failures),
+            _auto_ban_not_found(b._auto_ban_not_found),
+            _auto_ban_bad_requests(b._auto_ban_bad_requests),
+            _auto_ban_window(b._auto_ban_window),
+            _auto_ban_duration(b._auto_ban_duration),
+            _basic_auth_verifier(b._basic_auth_verifier),
+            _basic_auth_cache_size(b._basic_auth_cache_size),
+            _basic_auth_cache_ttl(b._basic_auth_cache_ttl),
+            _https_session_tickets(b._https_session_tickets),
+            _https_session_ticket_key(b._https_session_ticket_key),
+            _https_session_ticket_rotation(b._https_session_ticket_rotation),
+            _https_session_cache_size(b._https_session_cache_size),
+            _https_ocsp_response(b._https_ocsp_response),
+            _https_sni_certificates(b._https_sni_certificates),
+            _digest_auth_password_lookup(b._digest_auth_password_lookup),
+            _digest_auth_nonce_store(b._digest_auth_nonce_store),
+            _digest_auth_nonce_table_size(b._digest_auth_nonce_table_size),
+            _digest_auth_nonce_timeout(b._digest_auth_nonce_timeout),
+            _request_filter(b._request_filter),
+            _metrics(b._metrics),
+            _metrics_endpoint(b._metrics_endpoint),
+            _metrics_max_series(b._metrics_max_series),
+            _access_log_sink(b._access_log_sink),
+            _access_log_ring_size(b._access_log_ring_size),
+            _access_log_flush_interval(b._access_log_flush_interval),
+            _request_timing(b._request_timing),
+            _request_tracer(b._request_tracer),
+            _connection_tracking(b._connection_tracking),
+            _handler_watchdog(b._handler_watchdog),
+            _handler_watchdog_threshold(b._handler_watchdog_threshold),
+            _handler_watchdog_slots(b._handler_watchdog_slots),
+            _handler_watchdog_stack_signal(b._handler_watchdog_stack_signal),
+            _error_log_sink(b._error_log_sink),
+            _error_log_burst(b._error_log_burst),
+            _error_log_window(b._error_log_window),
+            _drain_timeout(b._drain_timeout)
         {
         }
 
@@ -164,7 +258,51 @@ class create_webserver
             _single_resource(b._single_resource),
             _not_found_resource(std::move(b._not_found_resource)),
             _method_not_allowed_resource(std::move(b._method_not_allowed_resource)),
-            _internal_error_resource(std::move(b._internal_error_resource))
+            _internal_error_resource(std::move(b._internal_error_resource)),
+            _file_cache_size(b._file_cache_size),
+            _file_cache_ttl(b._file_cache_ttl),
+            _compression_enabled(b._compression_enabled),
+            _compression_min_size(b._compression_min_size),
+            _compression_cache_size(b._compression_cache_size),
+            _rate_limit_rate(b._rate_limit_rate),
+            _rate_limit_burst(b._rate_limit_burst),
+            _rate_limit_table_size(b._rate_limit_table_size),
+            _auto_ban_auth_failures(b._auto_ban_auth_failures),
+            _auto_ban_not_found(b._auto_ban_not_found),
+            _auto_ban_bad_requests(b._auto_ban_bad_requests),
+            _auto_ban_window(b._auto_ban_window),
+            _auto_ban_duration(b._auto_ban_duration),
+            _basic_auth_verifier(b._basic_auth_verifier),
+            _basic_auth_cache_size(b._basic_auth_cache_size),
+            _basic_auth_cache_ttl(b._basic_auth_cache_ttl),
+            _https_session_tickets(b._https_session_tickets),
+            _https_session_ticket_key(std::move(b._https_session_ticket_key)),
+            _https_session_ticket_rotation(b._https_session_ticket_rotation),
+            _https_session_cache_size(b._https_session_cache_size),
+            _https_ocsp_response(std::move(b._https_ocsp_response)),
+            _https_sni_certificates(std::move(b._https_sni_certificates)),
+            _digest_auth_password_lookup(b._digest_auth_password_lookup),
+            _digest_auth_nonce_store(std::move(b._digest_auth_nonce_store)),
+            _digest_auth_nonce_table_size(b._digest_auth_nonce_table_size),
+            _digest_auth_nonce_timeout(b._digest_auth_nonce_timeout),
+            _request_filter(b._request_filter),
+            _metrics(b._metrics),
+            _metrics_endpoint(std::move(b._metrics_endpoint)),
+            _metrics_max_series(b._metrics_max_series),
+            _access_log_sink(b._access_log_sink),
+            _access_log_ring_size(b._access_log_ring_size),
+            _access_log_flush_interval(b._access_log_flush_interval),
+            _request_timing(b._request_timing),
+            _request_tracer(b._request_tracer),
+            _connection_tracking(b._connection_tracking),
+            _handler_watchdog(b._handler_watchdog),
+            _handler_watchdog_threshold(b._handler_watchdog_threshold),
+            _handler_watchdog_slots(b._handler_watchdog_slots),
+            _handler_watchdog_stack_signal(b._handler_watchdog_stack_signal),
+            _error_log_sink(b._error_log_sink),
+            _error_log_burst(b._error_log_burst),
+            _error_log_window(b._error_log_window),
+            _drain_timeout(b._drain_timeout)
         {
         }
 
@@ -209,6 +347,50 @@ class create_webserver
            this->_not_found_resource = b._not_found_resource;
            this->_method_not_allowed_resource = b._method_not_allowed_resource;
            this->_internal_error_resource = b._internal_error_resource;
+           this->_file_cache_size = b._file_cache_size;
+           this->_file_cache_ttl = b._file_cache_ttl;
+           this->_compression_enabled = b._compression_enabled;
+           this->_compression_min_size = b._compression_min_size;
+           this->_compression_cache_size = b._compression_cache_size;
+           this->_rate_limit_rate = b._rate_limit_rate;
+           this->_rate_limit_burst = b._rate_limit_burst;
+           this->_rate_limit_table_size = b._rate_limit_table_size;
+           this->_auto_ban_auth_failures = b._auto_ban_auth_failures;
+           this->_auto_ban_not_found = b._auto_ban_not_found;
+           this->_auto_ban_bad_requests = b._auto_ban_bad_requests;
+           this->_auto_ban_window = b._auto_ban_window;
+           this->_auto_ban_duration = b._auto_ban_duration;
+           this->_basic_auth_verifier = b._basic_auth_verifier;
+           this->_basic_auth_cache_size = b._basic_auth_cache_size;
+           this->_basic_auth_cache_ttl = b._basic_auth_cache_ttl;
+           this->_https_session_tickets = b._https_session_tickets;
+           this->_https_session_ticket_key = b._https_session_ticket_key;
+           this->_https_session_ticket_rotation = b._https_session_ticket_rotation;
+           this->_https_session_cache_size = b._https_session_cache_size;
+           this->_https_ocsp_response = b._https_ocsp_response;
+           this->_https_sni_certificates = b._https_sni_certificates;
+           this->_digest_auth_password_lookup = b._digest_auth_password_lookup;
+           this->_digest_auth_nonce_store = b._digest_auth_nonce_store;
+           this->_digest_auth_nonce_table_size = b._digest_auth_nonce_table_size;
+           this->_digest_auth_nonce_timeout = b._digest_auth_nonce_timeout;
+           this->_request_filter = b._request_filter;
+           this->_metrics = b._metrics;
+           this->_metrics_endpoint = b._metrics_endpoint;
+           this->_metrics_max_series = b._metrics_max_series;
+           this->_access_log_sink = b._access_log_sink;
+           this->_access_log_ring_size = b._access_log_ring_size;
+           this->_access_log_flush_interval = b._access_log_flush_interval;
+           this->_request_timing = b._request_timing;
+           this->_request_tracer = b._request_tracer;
+           this->_connection_tracking = b._connection_tracking;
+           this->_handler_watchdog = b._handler_watchdog;
+           this->_handler_watchdog_threshold = b._handler_watchdog_threshold;
+           this->_handler_watchdog_slots = b._handler_watchdog_slots;
+           this->_handler_watchdog_stack_signal = b._handler_watchdog_stack_signal;
+           this->_error_log_sink = b._error_log_sink;
+           this->_error_log_burst = b._error_log_burst;
+           this->_error_log_window = b._error_log_window;
+           this->_drain_timeout = b._drain_timeout;
 
            return *this;
        }
@@ -254,6 +436,50 @@ class create_webserver
            this->_not_found_resource = std::move(b._not_found_resource);
            this->_method_not_allowed_resource = std::move(b._method_not_allowed_resource);
            this->_internal_error_resource = std::move(b._internal_error_resource);
+           this->_file_cache_size = b._file_cache_size;
+           this->_file_cache_ttl = b._file_cache_ttl;
+           this->_compression_enabled = b._compression_enabled;
+           this->_compression_min_size = b._compression_min_size;
+           this->_compression_cache_size = b._compression_cache_size;
+           this->_rate_limit_rate = b._rate_limit_rate;
+           this->_rate_limit_burst = b._rate_limit_burst;
+           this->_rate_limit_table_size = b._rate_limit_table_size;
+           this->_auto_ban_auth_failures = b._auto_ban_auth_failures;
+           this->_auto_ban_not_found = b._auto_ban_not_found;
+           this->_auto_ban_bad_requests = b._auto_ban_bad_requests;
+           this->_auto_ban_window = b._auto_ban_window;
+           this->_auto_ban_duration = b._auto_ban_duration;
+           this->_basic_auth_verifier = b._basic_auth_verifier;
+           this->_basic_auth_cache_size = b._basic_auth_cache_size;
+           this->_basic_auth_cache_ttl = b._basic_auth_cache_ttl;
+           this->_https_session_tickets = b._https_session_tickets;
+           this->_https_session_ticket_key = std::move(b._https_session_ticket_key);
+           this->_https_session_ticket_rotation = b._https_session_ticket_rotation;
+           this->_https_session_cache_size = b._https_session_cache_size;
+           this->_https_ocsp_response = std::move(b._https_ocsp_response);
+           this->_https_sni_certificates = std::move(b._https_sni_certificates);
+           this->_digest_auth_password_lookup = b._digest_auth_password_lookup;
+           this->_digest_auth_nonce_store = std::move(b._digest_auth_nonce_store);
+           this->_digest_auth_nonce_table_size = b._digest_auth_nonce_table_size;
+           this->_digest_auth_nonce_timeout = b._digest_auth_nonce_timeout;
+           this->_request_filter = b._request_filter;
+           this->_metrics = b._metrics;
+           this->_metrics_endpoint = std::move(b._metrics_endpoint);
+           this->_metrics_max_series = b._metrics_max_series;
+           this->_access_log_sink = b._access_log_sink;
+           this->_access_log_ring_size = b._access_log_ring_size;
+           this->_access_log_flush_interval = b._access_log_flush_interval;
+           this->_request_timing = b._request_timing;
+           this->_request_tracer = b._request_tracer;
+           this->_connection_tracking = b._connection_tracking;
+           this->_handler_watchdog = b._handler_watchdog;
+           this->_handler_watchdog_threshold = b._handler_watchdog_threshold;
+           this->_handler_watchdog_slots = b._handler_watchdog_slots;
+           this->_handler_watchdog_stack_signal = b._handler_watchdog_stack_signal;
+           this->_error_log_sink = b._error_log_sink;
+           this->_error_log_burst = b._error_log_burst;
+           this->_error_log_window = b._error_log_window;
+           this->_drain_timeout = b._drain_timeout;
 
            return *this;
         }
@@ -295,7 +521,51 @@ class create_webserver
             _single_resource(false),
             _not_found_resource(0x0),
             _method_not_allowed_resource(0x0),
-            _internal_error_resource(0x0)
+            _internal_error_resource(0x0),
+            _file_cache_size(0),
+            _file_cache_ttl(1),
+            _compression_enabled(false),
+            _compression_min_size(256),
+            _compression_cache_size(0),
+            _rate_limit_rate(0),
+            _rate_limit_burst(0),
+            _rate_limit_table_size(16384),
+            _auto_ban_auth_failures(0),
+            _auto_ban_not_found(0),
+            _auto_ban_bad_requests(0),
+            _auto_ban_window(60),
+            _auto_ban_duration(600),
+            _basic_auth_verifier(0x0),
+            _basic_auth_cache_size(1024),
+            _basic_auth_cache_ttl(60),
+            _https_session_tickets(true),
+            _https_session_ticket_key(""),
+            _https_session_ticket_rotation(0),
+            _https_session_cache_size(1024),
+            _https_ocsp_response(""),
+            _https_sni_certificates(),
+            _digest_auth_password_lookup(0x0),
+            _digest_auth_nonce_store(std::shared_ptr<nonce_store>()),
+            _digest_auth_nonce_table_size(65536),
+            _digest_auth_nonce_timeout(300),
+            _request_filter(0x0),
+            _metrics(false),
+            _metrics_endpoint(""),
+            _metrics_max_series(1024),
+            _access_log_sink(0x0),
+            _access_log_ring_size(4096),
+            _access_log_flush_interval(100),
+            _request_timing(false),
+            _request_tracer(0x0),
+            _connection_tracking(false),
+            _handler_watchdog(0x0),
+            _handler_watchdog_threshold(5000),
+            _handler_watchdog_slots(0),
+            _handler_watchdog_stack_signal(0),
+            _error_log_sink(0x0),
+            _error_log_burst(10),
+            _error_log_window(1000),
+            _drain_timeout(30000)
         {
         }
 
@@ -342,6 +612,10 @@ class create_webserver
         {
             _validator = validator; return *this;
         }
+        create_webserver& request_filter(render_ptr request_filter)
+        {
+            _request_filter = request_filter; return *this;
+        }
         create_webserver& unescaper(unescaper_ptr unescaper)
         {
             _unescaper = unescaper; return *this;
@@ -488,6 +762,204 @@ class create_webserver
         {
             _internal_error_resource = internal_error_resource; return *this;
         }
+        create_webserver& file_cache_size(size_t file_cache_size)
+        {
+            _file_cache_size = file_cache_size; return *this;
+        }
+        create_webserver& file_cache_ttl(int file_cache_ttl)
+        {
+            _file_cache_ttl = file_cache_ttl; return *this;
+        }
+        create_webserver& compression()
+        {
+            _compression_enabled = true; return *this;
+        }
+        create_webserver& no_compression()
+        {
+            _compression_enabled = false; return *this;
+        }
+        create_webserver& compression_min_size(size_t compression_min_size)
+        {
+            _compression_min_size = compression_min_size; return *this;
+        }
+        create_webserver& compression_cache_size(size_t compression_cache_size)
+        {
+            _compression_cache_size = compression_cache_size; return *this;
+        }
+        create_webserver& rate_limit(double requests_per_second, unsigned int burst)
+        {
+            _rate_limit_rate = requests_per_second;
+            _rate_limit_burst = burst;
+            return *this;
+        }
+        create_webserver& rate_limit_table_size(size_t rate_limit_table_size)
+        {
+            _rate_limit_table_size = rate_limit_table_size; return *this;
+        }
+        create_webserver& auto_ban_auth_failures(unsigned int auto_ban_auth_failures)
+        {
+            _auto_ban_auth_failures = auto_ban_auth_failures; return *this;
+        }
+        create_webserver& auto_ban_not_found(unsigned int auto_ban_not_found)
+        {
+            _auto_ban_not_found = auto_ban_not_found; return *this;
+        }
+        create_webserver& auto_ban_bad_requests(unsigned int auto_ban_bad_requests)
+        {
+            _auto_ban_bad_requests = auto_ban_bad_requests; return *this;
+        }
+        create_webserver& auto_ban_window(int auto_ban_window)
+        {
+            _auto_ban_window = auto_ban_window; return *this;
+        }
+        create_webserver& auto_ban_duration(int auto_ban_duration)
+        {
+            _auto_ban_duration = auto_ban_duration; return *this;
+        }
+        create_webserver& basic_auth_verifier(basic_auth_verifier_ptr basic_auth_verifier)
+        {
+            _basic_auth_verifier = basic_auth_verifier; return *this;
+        }
+        create_webserver& basic_auth_cache_size(size_t basic_auth_cache_size)
+        {
+            _basic_auth_cache_size = basic_auth_cache_size; return *this;
+        }
+        create_webserver& basic_auth_cache_ttl(int basic_auth_cache_ttl)
+        {
+            _basic_auth_cache_ttl = basic_auth_cache_ttl; return *this;
+        }
+        create_webserver& digest_auth_password_lookup(digest_auth_password_ptr digest_auth_password_lookup)
+        {
+            _digest_auth_password_lookup = digest_auth_password_lookup; return *this;
+        }
+        create_webserver& digest_auth_nonce_store(const std::shared_ptr<nonce_store>& digest_auth_nonce_store)
+        {
+            _digest_auth_nonce_store = digest_auth_nonce_store; return *this;
+        }
+        create_webserver& digest_auth_nonce_table_size(size_t digest_auth_nonce_table_size)
+        {
+            _digest_auth_nonce_table_size = digest_auth_nonce_table_size; return *this;
+        }
+        create_webserver& digest_auth_nonce_timeout(int digest_auth_nonce_timeout)
+        {
+            _digest_auth_nonce_timeout = digest_auth_nonce_timeout; return *this;
+        }
+        create_webserver& connection_tracking()
+        {
+            _connection_tracking = true; return *this;
+        }
+        create_webserver& no_connection_tracking()
+        {
+            _connection_tracking = false; return *this;
+        }
+        create_webserver& access_log_sink(access_log_sink_ptr access_log_sink)
+        {
+            _access_log_sink = access_log_sink; return *this;
+        }
+        create_webserver& error_log_sink(error_log_sink_ptr error_log_sink)
+        {
+            _error_log_sink = error_log_sink; return *this;
+        }
+        create_webserver& error_log_burst(unsigned int error_log_burst)
+        {
+            _error_log_burst = error_log_burst; return *this;
+        }
+        create_webserver& error_log_window(int error_log_window)
+        {
+            _error_log_window = error_log_window; return *this;
+        }
+        create_webserver& drain_timeout(int drain_timeout)
+        {
+            _drain_timeout = drain_timeout; return *this;
+        }
+        create_webserver& access_log_ring_size(size_t access_log_ring_size)
+        {
+            _access_log_ring_size = access_log_ring_size; return *this;
+        }
+        create_webserver& access_log_flush_interval(int access_log_flush_interval)
+        {
+            _access_log_flush_interval = access_log_flush_interval; return *this;
+        }
+        create_webserver& request_timing()
+        {
+            _request_timing = true; return *this;
+        }
+        create_webserver& no_request_timing()
+        {
+            _request_timing = false; return *this;
+        }
+        create_webserver& request_tracer(request_tracer_ptr request_tracer)
+        {
+            _request_tracer = request_tracer; return *this;
+        }
+        create_webserver& handler_watchdog(handler_watchdog_ptr handler_watchdog)
+        {
+            _handler_watchdog = handler_watchdog; return *this;
+        }
+        create_webserver& handler_watchdog_threshold(int handler_watchdog_threshold)
+        {
+            _handler_watchdog_threshold = handler_watchdog_threshold; return *this;
+        }
+        create_webserver& handler_watchdog_slots(size_t handler_watchdog_slots)
+        {
+            _handler_watchdog_slots = handler_watchdog_slots; return *this;
+        }
+        create_webserver& handler_watchdog_stack_signal(int handler_watchdog_stack_signal)
+        {
+            _handler_watchdog_stack_signal = handler_watchdog_stack_signal; return *this;
+        }
+        create_webserver& metrics()
+        {
+            _metrics = true; return *this;
+        }
+        create_webserver& no_metrics()
+        {
+            _metrics = false; return *this;
+        }
+        create_webserver& metrics_endpoint(const std::string& metrics_endpoint)
+        {
+            _metrics = true;
+            _metrics_endpoint = metrics_endpoint; return *this;
+        }
+        create_webserver& metrics_max_series(size_t metrics_max_series)
+        {
+            _metrics_max_series = metrics_max_series; return *this;
+        }
+        create_webserver& https_session_tickets()
+        {
+            _https_session_tickets = true; return *this;
+        }
+        create_webserver& no_https_session_tickets()
+        {
+            _https_session_tickets = false; return *this;
+        }
+        create_webserver& https_session_ticket_key(const std::string& https_session_ticket_key)
+        {
+            _https_session_ticket_key = http::load_file(https_session_ticket_key);
+            return *this;
+        }
+        create_webserver& https_session_ticket_rotation(int https_session_ticket_rotation)
+        {
+            _https_session_ticket_rotation = https_session_ticket_rotation; return *this;
+        }
+        create_webserver& https_session_cache_size(size_t https_session_cache_size)
+        {
+            _https_session_cache_size = https_session_cache_size; return *this;
+        }
+        create_webserver& https_ocsp_response(const std::string& https_ocsp_response)
+        {
+            _https_ocsp_response = http::load_file(https_ocsp_response);
+            return *this;
+        }
+        create_webserver& https_sni_certificate(const std::string& hostname,
+                const std::string& https_mem_key, const std::string& https_mem_cert
+        )
+        {
+            _https_sni_certificates[hostname] = std::make_pair(
+                    http::load_file(https_mem_key), http::load_file(https_mem_cert)
+            );
+            return *this;
+        }
 
     private:
         uint16_t _port;
@@ -527,6 +999,50 @@ class create_webserver
         render_ptr _not_found_resource;
         render_ptr _method_not_allowed_resource;
         render_ptr _internal_error_resource;
+        size_t _file_cache_size;
+        int _file_cache_ttl;
+        bool _compression_enabled;
+        size_t _compression_min_size;
+        size_t _compression_cache_size;
+        double _rate_limit_rate;
+        unsigned int _rate_limit_burst;
+        size_t _rate_limit_table_size;
+        unsigned int _auto_ban_auth_failures;
+        unsigned int _auto_ban_not_found;
+        unsigned int _auto_ban_bad_requests;
+        int _auto_ban_window;
+        int _auto_ban_duration;
+        basic_auth_verifier_ptr _basic_auth_verifier;
+        size_t _basic_auth_cache_size;
+        int _basic_auth_cache_ttl;
+        bool _https_session_tickets;
+        std::string _https_session_ticket_key;
+        int _https_session_ticket_rotation;
+        size_t _https_session_cache_size;
+        std::string _https_ocsp_response;
+        std::map<std::string, std::pair<std::string, std::string> > _https_sni_certificates;
+        digest_auth_password_ptr _digest_auth_password_lookup;
+        std::shared_ptr<nonce_store> _digest_auth_nonce_store;
+        size_t _digest_auth_nonce_table_size;
+        int _digest_auth_nonce_timeout;
+        render_ptr _request_filter;
+        bool _metrics;
+        std::string _metrics_endpoint;
+        size_t _metrics_max_series;
+        access_log_sink_ptr _access_log_sink;
+        size_t _access_log_ring_size;
+        int _access_log_flush_interval;
+        bool _request_timing;
+        request_tracer_ptr _request_tracer;
+        bool _connection_tracking;
+        handler_watchdog_ptr _handler_watchdog;
+        int _handler_watchdog_threshold;
+        size_t _handler_watchdog_slots;
+        int _handler_watchdog_stack_signal;
+        error_log_sink_ptr _error_log_sink;
+        unsigned int _error_log_burst;
+        int _error_log_window;
+        int _drain_timeout;
 
         friend class webserver;
 };
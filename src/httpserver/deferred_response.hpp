@@ -27,13 +27,17 @@
 
 #include <memory>
 #include "httpserver/string_response.hpp"
+#include "httpserver/details/watchdog.hpp"
 
 namespace httpserver
 {
 
 namespace details
 {
-    MHD_Response* get_raw_response_helper(void* cls, ssize_t (*cb)(void*, uint64_t, char*, size_t));
+    MHD_Response* get_raw_response_helper(void* cls, ssize_t (*cb)(void*, uint64_t, char*, size_t), void (*free_cb)(void*));
+    MHD_Response* get_encoded_response_helper(void* cls, ssize_t (*cb)(void*, uint64_t, char*, size_t), void (*free_cb)(void*),
+            const std::string& encoding);
+    const watched_request* request_watch(const http_request& req);
 }
 
 template <class T>
@@ -95,17 +99,50 @@ class deferred_response : public string_response
 
         MHD_Response* get_raw_response()
         {
-            return details::get_raw_response_helper((void*) this, &(this->cb));
+            return details::get_raw_response_helper(new stream(this, 0x0), &(this->cb), &(this->free_stream));
+        }
+
+        MHD_Response* get_raw_response_for(const http_request& req, int& status)
+        {
+            return details::get_raw_response_helper(new stream(this, details::request_watch(req)), &(this->cb), &(this->free_stream));
+        }
+
+        MHD_Response* get_raw_response_encoded(const http_request& req, const std::string& encoding, int& status)
+        {
+            return details::get_encoded_response_helper(new stream(this, details::request_watch(req)), &(this->cb),
+                    &(this->free_stream), encoding
+            );
         }
 
     private:
         ssize_t (*cycle_callback)(std::shared_ptr<T>, char*, size_t);
         std::shared_ptr<T> closure_data;
 
+        // Content produced for one request, watched as the render method that returned the response.
+        struct stream
+        {
+            stream(const deferred_response<T>* dfr, const details::watched_request* watched):
+                cycle_callback(dfr->cycle_callback),
+                closure_data(dfr->closure_data),
+                watched(watched)
+            {
+            }
+
+            ssize_t (*cycle_callback)(std::shared_ptr<T>, char*, size_t);
+            std::shared_ptr<T> closure_data;
+            const details::watched_request* watched;
+        };
+
         static ssize_t cb(void* cls, uint64_t pos, char* buf, size_t max)
         {
-            deferred_response<T>* dfr = static_cast<deferred_response<T>*>(cls);
-            return dfr->cycle_callback(dfr->closure_data, buf, max);
+            stream* s = static_cast<stream*>(cls);
+            details::watch_guard guard(s->watched);
+            return s->cycle_callback(s->closure_data, buf, max);
+        }
+
+        static void free_stream(void* cls)
+        {
+            delete static_cast<stream*>(cls);
         }
 };
 
@@ -0,0 +1,167 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ABUSE_TRACKER_HPP_
+#define _ABUSE_TRACKER_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Approximate count of events per key over a sliding window.
+ * Two count-min sketches hold the current and the previous window; the estimate weights the
+ * previous one by the part of it still covered by the sliding window. Counters are updated
+ * with atomic increments only and never overestimate by more than the sketch error.
+**/
+class sliding_sketch
+{
+    public:
+        /**
+         * @param width Counters per row (rounded up to a power of two)
+         * @param window_ms Length of the sliding window in milliseconds
+        **/
+        sliding_sketch(size_t width, uint64_t window_ms);
+        ~sliding_sketch();
+
+        /**
+         * Method used to count one event for a key.
+         * @param key The key (any well mixed 64 bits value)
+         * @param now Current time in milliseconds
+         * @return the estimated number of events of the key in the last window, this one included
+        **/
+        unsigned int add(uint64_t key, uint64_t now);
+
+    private:
+        static const int DEPTH = 4;
+
+        struct generation
+        {
+            std::atomic<uint64_t> window;
+            std::atomic<uint32_t>* counters;
+        };
+
+        generation generations[2];
+        size_t mask;
+        uint64_t window_ms;
+        uint64_t seeds[DEPTH];
+
+        sliding_sketch(const sliding_sketch&);
+        sliding_sketch& operator=(const sliding_sketch&);
+
+        generation& current(uint64_t window);
+        size_t index(uint64_t key, int row) const;
+        uint32_t estimate(const generation& g, uint64_t key) const;
+};
+
+/**
+ * Set of keys banned until a given time.
+ * Entries are kept in a fixed open-addressing table read and written with atomics only, so that
+ * it can be checked on every accepted connection. Expired entries are reused in place; when no
+ * slot is free the ban expiring first is replaced.
+**/
+class temporary_bans
+{
+    public:
+        explicit temporary_bans(size_t capacity);
+        ~temporary_bans();
+
+        void ban(uint64_t key, uint64_t now, uint64_t until);
+        bool is_banned(uint64_t key, uint64_t now) const;
+        size_t size(uint64_t now) const;
+
+    private:
+        struct entry
+        {
+            std::atomic<uint64_t> key;
+            std::atomic<uint64_t> until;
+        };
+
+        entry* entries;
+        size_t mask;
+
+        temporary_bans(const temporary_bans&);
+        temporary_bans& operator=(const temporary_bans&);
+};
+
+/**
+ * Counters of failed requests per client that ban the clients exceeding a threshold for a while.
+**/
+class abuse_tracker
+{
+    public:
+        enum category_T
+        {
+            AUTH_FAILURE = 0,
+            NOT_FOUND,
+            BAD_REQUEST,
+            CATEGORIES
+        };
+
+        /**
+         * @param thresholds Failures per window, for each category, after which a client is banned (0 disables the category)
+         * @param window_seconds Length of the sliding window
+         * @param ban_seconds Duration of the bans
+        **/
+        abuse_tracker(const unsigned int thresholds[CATEGORIES], int window_seconds, int ban_seconds);
+        ~abuse_tracker();
+
+        bool is_enabled() const;
+
+        /**
+         * Method used to count a failure of a client.
+         * @param category The kind of failure
+         * @param key The client key
+         * @return true if the client got banned
+        **/
+        bool record(category_T category, uint64_t key);
+
+        bool is_banned(uint64_t key) const;
+
+        size_t banned_count() const;
+
+    private:
+        unsigned int thresholds[CATEGORIES];
+        uint64_t ban_ms;
+        uint64_t start;
+        sliding_sketch* sketches[CATEGORIES];
+        temporary_bans bans;
+
+        abuse_tracker(const abuse_tracker&);
+        abuse_tracker& operator=(const abuse_tracker&);
+
+        uint64_t now_ms() const;
+};
+
+} //details
+
+} //httpserver
+
+#endif //_ABUSE_TRACKER_HPP_
@@ -0,0 +1,162 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ACCESS_LOGGER_HPP_
+#define _ACCESS_LOGGER_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "httpserver/access_record.hpp"
+#include "httpserver/error_record.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * State of a ring shared by its producing thread and its logger, whatever the records it holds.
+**/
+struct ring_state
+{
+    ring_state():
+        orphaned(false),
+        closed(false)
+    {
+    }
+
+    /** Set once the producing thread is gone **/
+    std::atomic<bool> orphaned;
+    /** Set once the logger owning the ring is gone **/
+    std::atomic<bool> closed;
+};
+
+/**
+ * Bounded queue with a single producer and a single consumer, neither of which ever waits for the other.
+**/
+template <class T>
+class log_ring : public ring_state
+{
+    public:
+        /**
+         * @param capacity Number of records the ring can hold (rounded up to a power of two)
+        **/
+        explicit log_ring(size_t capacity);
+
+        /**
+         * Method used by the producer to append a record.
+         * @return false if the ring is full (the record is left untouched)
+        **/
+        bool push(T& record);
+
+        /**
+         * Method used by the consumer to move all the records available to the end of a vector.
+         * @return the number of records moved
+        **/
+        size_t drain(std::vector<T>& records);
+
+    private:
+        std::vector<T> slots;
+        size_t mask;
+        std::atomic<size_t> head;
+        std::atomic<size_t> tail;
+
+        log_ring(const log_ring&);
+        log_ring& operator=(const log_ring&);
+};
+
+/**
+ * Asynchronous logger. Each thread logging records gets its own ring, so that logging never
+ * takes a lock nor waits; records not fitting in a full ring are dropped and counted. A background
+ * thread periodically collects the records of all the rings and hands them to the sink in batches.
+ * Instantiated for access_record and error_record.
+**/
+template <class T>
+class async_logger
+{
+    public:
+        typedef void(*sink_ptr)(const std::vector<T>& records);
+
+        async_logger(sink_ptr sink, size_t ring_size, int flush_interval);
+        ~async_logger();
+
+        void log(T& record);
+
+        void start();
+
+        /**
+         * Method used to stop the background thread once the records already logged were delivered.
+        **/
+        void stop();
+
+        /**
+         * Method used to deliver the records logged so far from the calling thread.
+         * @return the number of records delivered
+        **/
+        size_t flush();
+
+        unsigned long long dropped() const
+        {
+            return dropped_records.load(std::memory_order_relaxed);
+        }
+
+    private:
+        sink_ptr sink;
+        size_t ring_size;
+        int flush_interval;
+        uint64_t id;
+        std::atomic<unsigned long long> dropped_records;
+
+        mutable pthread_mutex_t rings_lock;
+        std::vector<std::shared_ptr<log_ring<T> > > rings;
+
+        // Serializes the deliveries to the sink (each ring must have a single consumer).
+        pthread_mutex_t flush_lock;
+        pthread_mutex_t state_lock;
+        pthread_cond_t wakeup;
+        pthread_t thread;
+        bool running;
+
+        log_ring<T>* local_ring();
+
+        static void* drain_loop(void* self);
+
+        async_logger(const async_logger&);
+        async_logger& operator=(const async_logger&);
+};
+
+typedef log_ring<access_record> access_ring;
+typedef async_logger<access_record> access_logger;
+typedef async_logger<error_record> error_logger;
+
+} //details
+
+} //httpserver
+
+#endif //_ACCESS_LOGGER_HPP_
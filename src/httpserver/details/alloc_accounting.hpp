@@ -0,0 +1,120 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ALLOC_ACCOUNTING_HPP_
+#define _ALLOC_ACCOUNTING_HPP_
+
+#include <stdint.h>
+
+#include "details/metrics.hpp"
+
+namespace httpserver
+{
+
+/**
+ * Memory allocations made while serving the requests completed so far (see webserver::get_alloc_stats).
+**/
+struct alloc_stats
+{
+    /** false unless the library was configured with --enable-alloc-accounting **/
+    bool enabled;
+    unsigned long long requests;
+    /** Calls to operator new **/
+    unsigned long long allocations;
+    unsigned long long allocated_bytes;
+};
+
+namespace details
+{
+
+struct alloc_counters
+{
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+/**
+ * Method used to know whether the library counts allocations (--enable-alloc-accounting).
+**/
+bool alloc_accounting_enabled();
+
+/**
+ * Method used to get the allocations made so far by the calling thread, through the global
+ * operator new replaced by the library. Always zero when allocations are not counted.
+**/
+alloc_counters thread_alloc_counters();
+
+/**
+ * Adds to a request the allocations its thread made while the scope was alive.
+**/
+class alloc_scope
+{
+    public:
+        explicit alloc_scope(alloc_counters& into):
+            into(into),
+            start(thread_alloc_counters())
+        {
+        }
+
+        ~alloc_scope()
+        {
+            alloc_counters now = thread_alloc_counters();
+            into.allocations += now.allocations - start.allocations;
+            into.bytes += now.bytes - start.bytes;
+        }
+
+    private:
+        alloc_counters& into;
+        alloc_counters start;
+
+        alloc_scope(const alloc_scope&);
+        alloc_scope& operator=(const alloc_scope&);
+};
+
+/**
+ * Sums of the allocations of the completed requests of a server.
+**/
+class alloc_totals
+{
+    public:
+        void record(const alloc_counters& request)
+        {
+            requests.add(1);
+            allocations.add(request.allocations);
+            bytes.add(request.bytes);
+        }
+
+        alloc_stats get() const;
+
+    private:
+        sharded_counter requests;
+        sharded_counter allocations;
+        sharded_counter bytes;
+};
+
+} //details
+
+} //httpserver
+
+#endif //_ALLOC_ACCOUNTING_HPP_
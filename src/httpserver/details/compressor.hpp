@@ -0,0 +1,148 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _COMPRESSOR_HPP_
+#define _COMPRESSOR_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Incremental encoder producing one of the supported content codings (gzip, br, zstd).
+**/
+class compression_stream
+{
+    public:
+        /**
+         * Method used to create an encoder.
+         * @param encoding The content coding (as used in Content-Encoding)
+         * @return the encoder or NULL if the coding is not supported by this build
+        **/
+        static compression_stream* create(const std::string& encoding);
+
+        virtual ~compression_stream()
+        {
+        }
+
+        /**
+         * Method used to compress a chunk of data. Unless finishing, all the output available
+         * for the data passed so far is flushed so that it can be sent immediately.
+         * @param data The data to compress
+         * @param size The size of the data
+         * @param finish true to terminate the stream after this chunk
+         * @param out string the compressed output is appended to
+         * @return false in case of error
+        **/
+        virtual bool compress(const char* data, size_t size, bool finish, std::string& out) = 0;
+};
+
+/**
+ * Method used to know whether a content coding can be produced on the fly by this build.
+ * @param encoding The content coding
+ * @return true if supported
+**/
+bool compression_supported(const std::string& encoding);
+
+/**
+ * Method used to compress a whole content at once.
+ * @param encoding The content coding
+ * @param content The content to compress
+ * @return the compressed body or an empty pointer if the coding is not supported or compression failed
+**/
+std::shared_ptr<const std::string> compress(const std::string& encoding, const std::string& content);
+
+/**
+ * Cache of compressed bodies of a webserver (LRU bounded in bytes) used by string_response, so that
+ * identical contents are compressed only once. Each body is kept along with its uncompressed content,
+ * both counting in the size of the cache.
+**/
+class compression_cache
+{
+    public:
+        /**
+         * @param max_bytes maximum size of the entries kept in cache
+        **/
+        explicit compression_cache(size_t max_bytes);
+
+        /**
+         * Method used to get the compressed version of a content, compressing it if not cached.
+         * @param encoding The content coding
+         * @param content The content to compress
+         * @return the compressed body or an empty pointer if the content should be sent as is
+         *         (coding not supported or compression failed)
+        **/
+        std::shared_ptr<const std::string> get(const std::string& encoding, const std::string& content);
+
+        void clear();
+
+        ~compression_cache();
+
+    private:
+        struct cache_key
+        {
+            std::string encoding;
+            uint64_t hash;
+            size_t size;
+
+            bool operator<(const cache_key& b) const;
+        };
+
+        typedef std::list<cache_key> lru_list;
+
+        struct cached_value
+        {
+            // The content the body was compressed from, compared on every hit: the key is not collision resistant.
+            std::string content;
+            std::shared_ptr<const std::string> body;
+            lru_list::iterator position;
+        };
+
+        compression_cache(const compression_cache& b);
+        compression_cache& operator=(const compression_cache& b);
+
+        pthread_mutex_t mutex;
+        const size_t max_bytes;
+        size_t used_bytes;
+        lru_list lru;
+        std::map<cache_key, cached_value> entries;
+
+        void evict();
+};
+
+} //details
+
+} //httpserver
+
+#endif //_COMPRESSOR_HPP_
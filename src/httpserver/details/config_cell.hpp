@@ -0,0 +1,76 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _CONFIG_CELL_HPP_
+#define _CONFIG_CELL_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+
+#include "httpserver/runtime_config.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Holder of a runtime_config read on every request. Readers copy the fields under a sequence lock:
+ * they never write shared memory nor wait, and retry in the rare case a writer changed the
+ * configuration while they were copying it, so that they always see one configuration as a whole.
+**/
+class config_cell
+{
+    public:
+        explicit config_cell(const runtime_config& config);
+        ~config_cell();
+
+        runtime_config load() const;
+
+        void store(const runtime_config& config);
+
+    private:
+        /** Odd while the fields are being written **/
+        std::atomic<uint64_t> sequence;
+        std::atomic<int> connection_timeout;
+        std::atomic<int> per_IP_connection_limit;
+        std::atomic<size_t> content_size_limit;
+        std::atomic<int> default_policy;
+        std::atomic<log_access_ptr> log_access;
+        std::atomic<log_error_ptr> log_error;
+
+        // Serializes the writers.
+        pthread_mutex_t write_lock;
+
+        config_cell(const config_cell&);
+        config_cell& operator=(const config_cell&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_CONFIG_CELL_HPP_
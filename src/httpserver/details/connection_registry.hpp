@@ -0,0 +1,122 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _CONNECTION_REGISTRY_HPP_
+#define _CONNECTION_REGISTRY_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+#include "httpserver/connection_info.hpp"
+
+struct sockaddr;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Method used to read the bytes the kernel moved on a TCP socket.
+ * @return false where TCP_INFO does not report them (both counts are then zero)
+**/
+bool socket_bytes(int socket_fd, uint64_t& received, uint64_t& sent);
+
+/**
+ * Live connection, stored as the socket context of the libmicrohttpd connection. Its state is
+ * updated without locks by the thread serving the connection.
+**/
+struct connection_entry
+{
+    uint64_t id;
+    int socket_fd;
+    std::string peer;
+    unsigned short peer_port;
+    struct timespec started;
+    /** TLS context attached to the connection, if any **/
+    void* tls_context;
+
+    std::atomic<uint64_t> requests;
+    std::atomic<int> state;
+    std::atomic<uint64_t> state_since;
+    std::atomic<pthread_t> thread;
+
+    void set_state(connection_info::state_T state);
+
+    private:
+        connection_entry* prev;
+        connection_entry* next;
+
+        friend class connection_registry;
+};
+
+/**
+ * Set of the live connections of a server. Connections are added and removed under a lock when
+ * they open and close; their state is read without stopping the threads serving them.
+**/
+class connection_registry
+{
+    public:
+        connection_registry();
+        ~connection_registry();
+
+        /**
+         * Method used to register a new connection.
+         * @param socket_fd The socket of the connection
+         * @param client_addr The address of the client (can be null)
+         * @return the entry of the connection, to be released with remove
+        **/
+        connection_entry* add(int socket_fd, const struct sockaddr* client_addr);
+
+        void remove(connection_entry* entry);
+
+        std::vector<connection_info> snapshot() const;
+
+        /**
+         * Method used to force a connection to close. Its socket is shut down, so that libmicrohttpd
+         * closes the connection as soon as it tries to use it; a handler running for it is not interrupted.
+         * @return false if no live connection has this id
+        **/
+        bool close(uint64_t id);
+
+        size_t size() const;
+
+    private:
+        mutable pthread_mutex_t lock;
+        connection_entry* first;
+        uint64_t next_id;
+        size_t count;
+
+        connection_registry(const connection_registry&);
+        connection_registry& operator=(const connection_registry&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_CONNECTION_REGISTRY_HPP_
@@ -0,0 +1,118 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _CREDENTIAL_CACHE_HPP_
+#define _CREDENTIAL_CACHE_HPP_
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Cache of the basic authentication credentials that passed the verification of the user.
+ * Credentials are never stored: entries are keyed by a 128 bits SipHash of user and password
+ * computed with a key drawn at random when the cache is created. The cache is split in shards,
+ * each with its own lock and a bounded number of entries that expire after a fixed time.
+**/
+class credential_cache
+{
+    public:
+        typedef bool(*verifier_ptr)(const std::string& user, const std::string& pass);
+
+        /**
+         * @param verifier Function checking a pair of credentials (e.g. against a password hash)
+         * @param max_entries Maximum number of verified credentials kept (0 disables caching)
+         * @param ttl Seconds after which a cached verification has to be done again
+        **/
+        credential_cache(verifier_ptr verifier, size_t max_entries, int ttl);
+        ~credential_cache();
+
+        /**
+         * Method used to check a pair of credentials.
+         * The verifier is called only if the same credentials were not successfully verified in the last ttl seconds.
+         * Failed verifications are never cached.
+         * @return true if the credentials are valid
+        **/
+        bool check(const std::string& user, const std::string& pass);
+
+        void clear();
+
+        size_t size() const;
+
+    private:
+        static const int SHARDS = 16;
+
+        struct key_hash
+        {
+            size_t operator()(const std::pair<uint64_t, uint64_t>& k) const
+            {
+                return static_cast<size_t>(k.first);
+            }
+        };
+
+        typedef std::pair<uint64_t, uint64_t> digest;
+
+        struct shard
+        {
+            mutable pthread_mutex_t lock;
+            std::unordered_map<digest, time_t, key_hash> entries;
+            // Insertion order; with a fixed ttl it is also the expiration order.
+            std::deque<std::pair<digest, time_t> > order;
+        };
+
+        verifier_ptr verifier;
+        size_t shard_capacity;
+        int ttl;
+        uint64_t keys[4];
+        shard shards[SHARDS];
+
+        credential_cache(const credential_cache&);
+        credential_cache& operator=(const credential_cache&);
+
+        digest hash(const std::string& user, const std::string& pass) const;
+        bool lookup(const digest& d, time_t now);
+        void insert(const digest& d, time_t now);
+};
+
+/**
+ * SipHash-2-4 of a buffer.
+ * @param k0 First half of the key
+ * @param k1 Second half of the key
+**/
+uint64_t siphash24(uint64_t k0, uint64_t k1, const void* data, size_t len);
+
+} //details
+
+} //httpserver
+
+#endif //_CREDENTIAL_CACHE_HPP_
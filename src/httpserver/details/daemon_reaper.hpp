@@ -0,0 +1,109 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _DAEMON_REAPER_HPP_
+#define _DAEMON_REAPER_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+struct MHD_Daemon;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Owner of the daemons a webserver replaced. A replaced daemon no longer accepts connections (it was
+ * quiesced) but keeps serving the ones it has; a background thread stops it once they are all closed,
+ * or once its drain deadline passed. Also tells which daemon accepts the connections, the others
+ * closing theirs after each response.
+**/
+class daemon_reaper
+{
+    public:
+        daemon_reaper();
+        ~daemon_reaper();
+
+        /**
+         * Method used to set the daemon accepting the connections (0x0 while the server drains).
+        **/
+        void serve(struct MHD_Daemon* daemon)
+        {
+            accepting.store(daemon, std::memory_order_release);
+        }
+
+        /**
+         * @return false if the connections of the daemon should be closed after their response
+        **/
+        bool serving(struct MHD_Daemon* daemon) const
+        {
+            return daemon != 0x0 && accepting.load(std::memory_order_acquire) == daemon;
+        }
+
+        /**
+         * @param daemon Quiesced daemon
+         * @param timeout Milliseconds after which the daemon is stopped even if connections remain
+        **/
+        void retire(struct MHD_Daemon* daemon, int timeout);
+
+        /**
+         * Method used to stop right away the daemons still draining.
+        **/
+        void stop();
+
+        /**
+         * @return the number of daemons still draining
+        **/
+        size_t size() const;
+
+    private:
+        struct retired_daemon
+        {
+            struct MHD_Daemon* daemon;
+            uint64_t deadline;
+        };
+
+        mutable pthread_mutex_t lock;
+        pthread_cond_t wakeup;
+        pthread_t thread;
+        bool running;
+        std::vector<retired_daemon> daemons;
+        std::atomic<struct MHD_Daemon*> accepting;
+
+        static void* reap_loop(void* self);
+
+        daemon_reaper(const daemon_reaper&);
+        daemon_reaper& operator=(const daemon_reaper&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_DAEMON_REAPER_HPP_
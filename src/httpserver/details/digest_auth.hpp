@@ -0,0 +1,168 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _DIGEST_AUTH_HPP_
+#define _DIGEST_AUTH_HPP_
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include "httpserver/nonce_store.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Hex encoded MD5 of a string.
+**/
+std::string md5_hex(const std::string& data);
+
+/**
+ * Hex encoded SHA-256 of a string.
+**/
+std::string sha256_hex(const std::string& data);
+
+/**
+ * Nonce store split in shards, each with its own lock, so that the threads of the server rarely
+ * wait for each other. Each nonce remembers the last nonce counts it was used with (up to 64
+ * behind the highest one, for requests pipelined out of order). Nonces expire after a fixed
+ * time; the oldest ones are dropped once the capacity is reached.
+**/
+class sharded_nonce_store : public nonce_store
+{
+    public:
+        /**
+         * @param capacity Maximum number of nonces tracked at once
+         * @param timeout Seconds after which a nonce is stale
+        **/
+        sharded_nonce_store(size_t capacity, int timeout);
+        ~sharded_nonce_store();
+
+        std::string issue();
+        status_T check(const std::string& nonce, uint64_t nc);
+        nonce_stats get_stats() const;
+
+    private:
+        static const int SHARDS = 16;
+        static const uint64_t WINDOW = 64;
+
+        struct entry
+        {
+            time_t created;
+            uint64_t max_nc;
+            // bit i set if max_nc - i was used
+            uint64_t seen;
+        };
+
+        struct shard
+        {
+            mutable pthread_mutex_t lock;
+            std::unordered_map<std::string, entry> entries;
+            // Creation order; with a fixed timeout it is also the expiration order.
+            std::deque<std::pair<std::string, time_t> > order;
+        };
+
+        size_t shard_capacity;
+        int timeout;
+        shard shards[SHARDS];
+        std::atomic<unsigned int> next_shard;
+        std::atomic<unsigned long long> issued;
+        std::atomic<unsigned long long> stale;
+        std::atomic<unsigned long long> replays;
+
+        sharded_nonce_store(const sharded_nonce_store&);
+        sharded_nonce_store& operator=(const sharded_nonce_store&);
+
+        void expire(shard& s, time_t now);
+};
+
+/**
+ * Parameters of an Authorization header using the Digest scheme (RFC 7616).
+**/
+struct digest_credentials
+{
+    std::string username;
+    std::string realm;
+    std::string nonce;
+    std::string uri;
+    std::string response;
+    std::string algorithm;
+    std::string cnonce;
+    std::string opaque;
+    std::string qop;
+    std::string nc;
+};
+
+/**
+ * Method used to parse the value of an Authorization header.
+ * @return false if the header does not use the Digest scheme or is malformed
+**/
+bool parse_digest_authorization(const std::string& header, digest_credentials& credentials);
+
+/**
+ * Method used to compute the response expected from a client (qop=auth).
+ * @param algorithm Either MD5 or SHA-256
+ * @param password The password of the user
+ * @param method The method of the request
+ * @return the hex encoded response or an empty string if the algorithm is not supported
+**/
+std::string digest_response(const digest_credentials& credentials,
+        const std::string& algorithm, const std::string& password, const std::string& method
+);
+
+/**
+ * Method used to compare a computed response with the one sent by a client, in a time that does not
+ * depend on where they differ.
+ * @return true if both are equal
+**/
+bool equal_digests(const std::string& expected, const std::string& received);
+
+/**
+ * Method used to fill a buffer with bytes from a cryptographically secure generator (GnuTLS when
+ * available, the system generator otherwise).
+ * @return false if no random bytes could be obtained
+**/
+bool secure_random(unsigned char* buffer, size_t size);
+
+/**
+ * Method used to build the value of a WWW-Authenticate header challenging the client with
+ * both SHA-256 and MD5 (for the clients not supporting SHA-256).
+**/
+std::string digest_challenge(const std::string& realm, const std::string& nonce,
+        const std::string& opaque, bool stale
+);
+
+} //details
+
+} //httpserver
+
+#endif //_DIGEST_AUTH_HPP_
@@ -0,0 +1,103 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ERROR_LOG_HPP_
+#define _ERROR_LOG_HPP_
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "httpserver/error_record.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Method used to format a message into a buffer of the calling thread (the trailing newline is removed).
+ * @param length Set to the length of the message (truncated to the size of the buffer)
+ * @return the message, valid until the calling thread formats another one
+**/
+const char* format_error(const char* fmt, va_list ap, size_t& length);
+
+/**
+ * Method used to guess the severity and the category of a message of libmicrohttpd from its format.
+**/
+void classify_error(const char* fmt, error_record::severity_T& severity, error_record::category_T& category);
+
+/**
+ * Rate limit of identical messages. Messages are hashed into a fixed table of counters updated without
+ * locks; past the burst, the occurrences of a message are suppressed until the end of the window, and
+ * their number is handed over with the first occurrence of the next window. Counts are approximate when
+ * threads race on the same message or two messages share a counter.
+**/
+class message_limiter
+{
+    public:
+        /**
+         * @param burst Occurrences of a message let through in each window (0 not to limit them)
+         * @param window Length of the windows in milliseconds
+        **/
+        message_limiter(unsigned int burst, int window);
+
+        /**
+         * @param now Monotonic time in microseconds
+         * @param suppressed Set to the occurrences suppressed since the last one let through
+         * @return false if the message must be suppressed
+        **/
+        bool allow(const char* message, size_t length, uint64_t now, unsigned long long& suppressed);
+
+        unsigned long long suppressed() const
+        {
+            return total.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static const size_t ENTRIES = 256;
+
+        struct entry
+        {
+            std::atomic<uint64_t> key;
+            std::atomic<uint64_t> window;
+            std::atomic<unsigned int> count;
+            std::atomic<unsigned long long> suppressed;
+        };
+
+        unsigned int burst;
+        uint64_t window;
+        std::atomic<unsigned long long> total;
+        entry entries[ENTRIES];
+
+        message_limiter(const message_limiter&);
+        message_limiter& operator=(const message_limiter&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_ERROR_LOG_HPP_
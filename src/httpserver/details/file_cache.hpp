@@ -0,0 +1,129 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _FILE_CACHE_HPP_
+#define _FILE_CACHE_HPP_
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Open descriptor and metadata of a file served through file_response.
+ * The descriptor is owned by the entry and closed when the last user releases it.
+**/
+struct file_cache_entry
+{
+    int fd;
+    uint64_t size;
+    time_t mtime;
+    ino_t inode;
+    dev_t device;
+    time_t checked_at;
+
+    file_cache_entry():
+        fd(-1),
+        size(0),
+        mtime(0),
+        inode(0),
+        device(0),
+        checked_at(0)
+    {
+    }
+
+    ~file_cache_entry();
+
+    private:
+        file_cache_entry(const file_cache_entry& b);
+        file_cache_entry& operator=(const file_cache_entry& b);
+};
+
+/**
+ * Bounded (LRU) cache of open file descriptors keyed by path, owned by a webserver.
+ * Entries are revalidated through stat once older than the configured ttl, so that
+ * a file replaced or modified on disk is reopened.
+**/
+class file_cache
+{
+    public:
+        /**
+         * @param max_entries maximum number of files kept open
+         * @param ttl number of seconds after which an entry is checked again against the filesystem
+        **/
+        file_cache(size_t max_entries, int ttl);
+
+        /**
+         * Method used to get the (possibly cached) descriptor and metadata of a file.
+         * @param path The path of the file
+         * @return the cache entry
+         * @throws std::invalid_argument if the file cannot be opened or is not a regular file
+        **/
+        std::shared_ptr<file_cache_entry> get(const std::string& path);
+
+        /**
+         * Method used to open a file and read its metadata bypassing the cache.
+         * @param path The path of the file
+         * @return a new entry owning the descriptor
+         * @throws std::invalid_argument if the file cannot be opened or is not a regular file
+        **/
+        static std::shared_ptr<file_cache_entry> open_file(const std::string& path);
+
+        void clear();
+
+        size_t size() const;
+
+        ~file_cache();
+
+    private:
+        typedef std::list<std::string> lru_list;
+        typedef std::pair<std::shared_ptr<file_cache_entry>, lru_list::iterator> cached_value;
+
+        file_cache(const file_cache& b);
+        file_cache& operator=(const file_cache& b);
+
+        void insert(const std::string& path, const std::shared_ptr<file_cache_entry>& entry);
+
+        mutable pthread_mutex_t mutex;
+        const size_t max_entries;
+        const int ttl;
+        lru_list lru;
+        std::map<std::string, cached_value> entries;
+};
+
+} //details
+
+} //httpserver
+
+#endif //_FILE_CACHE_HPP_
@@ -0,0 +1,202 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _IP_FILTER_HPP_
+#define _IP_FILTER_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+struct sockaddr;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Set of IP addresses and networks used by the ban system.
+ * Rules are stored in a path-compressed binary trie over 128 bits keys (IPv4 addresses are
+ * mapped to ::ffff:0:0/96) so that a lookup walks at most one node per bit of the matching
+ * prefix and never allocates.
+**/
+class ip_filter
+{
+    public:
+        ip_filter();
+
+        /**
+         * Method used to add a rule to the filter.
+         * @param rule An address ("10.1.2.3", "2001:db8::1"), a network in CIDR notation ("10.0.0.0/8", "2001:db8::/32")
+         *             or an address with wildcards ("10.1.*.*"). Wildcards are not combinable with CIDR.
+         * @throws std::invalid_argument if the rule is badly formatted
+        **/
+        void insert(const std::string& rule);
+
+        /**
+         * Method used to remove a rule previously added to the filter.
+         * @param rule The rule as passed to insert (equivalent notations are accepted)
+         * @return true if the rule was present
+         * @throws std::invalid_argument if the rule is badly formatted
+        **/
+        bool erase(const std::string& rule);
+
+        /**
+         * Method used to check whether an address is matched by any rule of the filter.
+         * @param addr The address (AF_INET or AF_INET6)
+         * @return true if matched
+        **/
+        bool contains(const struct sockaddr* addr) const;
+
+        /**
+         * Method used to check whether an address is matched by any rule of the filter.
+         * @param ip The address in textual form
+         * @return true if matched
+        **/
+        bool contains(const std::string& ip) const;
+
+        size_t size() const
+        {
+            return entries;
+        }
+
+        bool empty() const
+        {
+            return entries == 0;
+        }
+
+        void clear();
+
+        /**
+         * Method used to preallocate the space needed by a number of rules.
+         * @param rules The number of rules expected
+        **/
+        void reserve(size_t rules);
+
+    private:
+        struct node
+        {
+            uint64_t key[2];
+            uint32_t child[2];
+            uint8_t prefix_len;
+            bool terminal;
+        };
+
+        // Rules with non-trailing wildcards (e.g. "10.*.0.1") cannot be expressed as
+        // prefixes and are checked one by one.
+        struct masked_rule
+        {
+            uint64_t key[2];
+            uint64_t mask[2];
+
+            bool operator==(const masked_rule& b) const
+            {
+                return key[0] == b.key[0] && key[1] == b.key[1] &&
+                    mask[0] == b.mask[0] && mask[1] == b.mask[1];
+            }
+        };
+
+        std::vector<node> nodes;
+        std::vector<masked_rule> masked_rules;
+        size_t entries;
+
+        bool lookup(const uint64_t key[2]) const;
+        uint32_t new_node(const uint64_t key[2], unsigned int prefix_len, bool terminal);
+};
+
+/**
+ * Wrapper publishing immutable ip_filter snapshots to concurrent readers.
+ * Readers never block: they register on one of two counters, read the current snapshot and
+ * leave. Writers build a new snapshot aside, swap it in atomically and free the old one once
+ * every reader that could still be using it has left.
+**/
+class shared_ip_filter
+{
+    public:
+        shared_ip_filter();
+        shared_ip_filter(const shared_ip_filter& other);
+        shared_ip_filter& operator=(const shared_ip_filter& other);
+        ~shared_ip_filter();
+
+        /**
+         * Method used to check whether an address is matched by the current snapshot.
+         * It is safe to call concurrently with any writer and never waits.
+         * @param addr The address (AF_INET or AF_INET6)
+         * @return true if matched
+        **/
+        bool contains(const struct sockaddr* addr) const;
+
+        /**
+         * Method used to add a single rule (copies the current snapshot).
+         * @param rule The rule to add (see ip_filter::insert)
+         * @throws std::invalid_argument if the rule is badly formatted
+        **/
+        void insert(const std::string& rule);
+
+        /**
+         * Method used to remove a single rule (copies the current snapshot).
+         * @param rule The rule to remove
+         * @return true if the rule was present
+         * @throws std::invalid_argument if the rule is badly formatted
+        **/
+        bool erase(const std::string& rule);
+
+        /**
+         * Method used to replace all the rules at once.
+         * The new snapshot is built before being published; if any rule is invalid the current one is kept.
+         * @param rules The rules composing the new snapshot
+         * @throws std::invalid_argument if any rule is badly formatted
+        **/
+        void assign(const std::vector<std::string>& rules);
+
+        /**
+         * Method used to replace all the rules at once with the ones listed in a file.
+         * The file contains one rule per line; blank lines and text following a '#' are ignored.
+         * @param path The path of the file
+         * @throws std::invalid_argument if the file cannot be read or any rule is badly formatted
+        **/
+        void load(const std::string& path);
+
+        size_t size() const;
+
+    private:
+        std::atomic<ip_filter*> current;
+        std::atomic<unsigned int> epoch;
+        mutable std::atomic<unsigned int> readers[2];
+        pthread_mutex_t write_lock;
+
+        ip_filter* copy_current() const;
+
+        void publish(ip_filter* next);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_IP_FILTER_HPP_
@@ -0,0 +1,206 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Counter split in cells updated by different threads so that concurrent increments do not
+ * bounce the same cache line between cores. Reading it sums all the cells.
+**/
+class sharded_counter
+{
+    public:
+        static const int SHARDS = 16;
+
+        sharded_counter();
+
+        void add(uint64_t value)
+        {
+            cells[shard_index() % SHARDS].value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        uint64_t get() const;
+
+        /**
+         * Method used to get a small index, stable for the calling thread, used to pick the cell to update.
+        **/
+        static unsigned int shard_index();
+
+    private:
+        struct cell
+        {
+            std::atomic<uint64_t> value;
+            char padding[64 - sizeof(std::atomic<uint64_t>)];
+        };
+
+        cell cells[SHARDS];
+
+        sharded_counter(const sharded_counter&);
+        sharded_counter& operator=(const sharded_counter&);
+};
+
+/**
+ * Log-linear histogram of microsecond durations in the style of HdrHistogram: every power of
+ * two is split in 8 buckets, so that any recorded value is known within 12.5%, from 1 microsecond
+ * to about 19 hours. Buckets are sharded like sharded_counter.
+**/
+class latency_histogram
+{
+    public:
+        static const int SHARDS = 8;
+        static const int SUB_BUCKETS = 8;
+        static const int MAX_EXPONENT = 36;
+        static const int BUCKETS = (MAX_EXPONENT - 2) * SUB_BUCKETS;
+
+        latency_histogram();
+
+        void record(uint64_t microseconds)
+        {
+            shard& s = shards[sharded_counter::shard_index() % SHARDS];
+            s.buckets[bucket_index(microseconds)].fetch_add(1, std::memory_order_relaxed);
+            s.sum.fetch_add(microseconds, std::memory_order_relaxed);
+        }
+
+        static int bucket_index(uint64_t microseconds);
+
+        /**
+         * Method used to get the smallest value falling in a bucket.
+        **/
+        static uint64_t bucket_lower_bound(int index);
+
+        /**
+         * Method used to get the number of values recorded up to a value (included).
+         * Values sharing a bucket with the limit are counted if the whole bucket is under the limit.
+        **/
+        uint64_t count_up_to(uint64_t microseconds) const;
+
+        uint64_t count() const;
+
+        uint64_t sum() const;
+
+        /**
+         * Method used to estimate a percentile of the recorded values.
+         * @param percentile The percentile (between 0 and 100)
+         * @return the upper bound of the bucket holding the percentile (0 if nothing was recorded)
+        **/
+        uint64_t value_at_percentile(double percentile) const;
+
+    private:
+        struct shard
+        {
+            std::atomic<uint64_t> buckets[BUCKETS];
+            std::atomic<uint64_t> sum;
+        };
+
+        shard shards[SHARDS];
+
+        void totals(uint64_t* buckets) const;
+
+        latency_histogram(const latency_histogram&);
+        latency_histogram& operator=(const latency_histogram&);
+};
+
+/**
+ * Registry of the metrics updated by the webserver, rendered in the Prometheus text format.
+ * Labelled series live in fixed size tables filled without locks: series are created on first
+ * use and never removed, and updates past the capacity are counted as dropped.
+**/
+class metrics_registry
+{
+    public:
+        /**
+         * @param max_series Maximum number of series kept for each labelled metric
+        **/
+        explicit metrics_registry(size_t max_series);
+        ~metrics_registry();
+
+        /**
+         * Method used to count a request answered by the server.
+         * @param method The request method (unknown methods are counted as OTHER)
+         * @param route The endpoint of the resource that matched the request (empty if none did)
+         * @param status The status code of the response
+        **/
+        void record_request(const std::string& method, const std::string& route, int status);
+
+        void record_latency(const std::string& route, uint64_t microseconds);
+
+        void connection_opened();
+
+        /**
+         * Method used to count a closed connection together with the bytes the kernel moved on its socket
+         * (only where TCP_INFO reports them).
+        **/
+        void connection_closed(int socket_fd);
+
+        void connection_rejected();
+
+        std::string render() const;
+
+    private:
+        struct request_series
+        {
+            std::string method;
+            std::string route;
+            int status;
+            sharded_counter requests;
+        };
+
+        struct latency_series
+        {
+            std::string route;
+            latency_histogram latency;
+        };
+
+        size_t capacity;
+        std::atomic<request_series*>* requests;
+        std::atomic<latency_series*>* latencies;
+        sharded_counter active_connections;
+        sharded_counter rejected_connections;
+        sharded_counter received_bytes;
+        sharded_counter sent_bytes;
+        sharded_counter dropped_series;
+
+        request_series* find_request_series(const std::string& method, const std::string& route, int status);
+        latency_series* find_latency_series(const std::string& route);
+
+        metrics_registry(const metrics_registry&);
+        metrics_registry& operator=(const metrics_registry&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_METRICS_HPP_
@@ -25,6 +25,13 @@
 #ifndef _MODDED_REQUEST_HPP_
 #define _MODDED_REQUEST_HPP_
 
+#include <stdint.h>
+#include "httpserver/access_record.hpp"
+#include "httpserver/request_trace.hpp"
+#include "httpserver/details/connection_registry.hpp"
+#include "httpserver/details/alloc_accounting.hpp"
+#include "httpserver/details/watchdog.hpp"
+
 namespace httpserver
 {
 
@@ -43,6 +50,18 @@ struct modded_request
     http_request* dhr;
     std::shared_ptr<http_response> dhrs;
     bool second;
+    // Set when the digest credentials were rejected only because their nonce expired.
+    bool stale_nonce;
+    // Monotonic time (in microseconds) at which the request line was received, 0 if not needed.
+    uint64_t started;
+    access_record* access;
+    request_span* span;
+    // Entry of the connection carrying the request, when connections are tracked.
+    connection_entry* connection;
+    // Allocations made while serving the request (see alloc_scope).
+    alloc_counters allocs;
+    // Route and peer published to the handler watchdog, when handlers are watched.
+    std::shared_ptr<watched_request> watch;
 
     modded_request():
         pp(0x0),
@@ -50,8 +69,15 @@ struct modded_request
         standardized_url(0x0),
         ws(0x0),
         dhr(0x0),
-        second(false)
+        second(false),
+        stale_nonce(false),
+        started(0),
+        access(0x0),
+        span(0x0),
+        connection(0x0)
     {
+        allocs.allocations = 0;
+        allocs.bytes = 0;
     }
 
     modded_request(const modded_request& b):
@@ -60,7 +86,14 @@ struct modded_request
         standardized_url(b.standardized_url),
         ws(b.ws),
         dhr(b.dhr),
-        second(b.second)
+        second(b.second),
+        stale_nonce(b.stale_nonce),
+        started(b.started),
+        access(b.access),
+        span(b.span),
+        connection(b.connection),
+        allocs(b.allocs),
+        watch(b.watch)
     {
     }
 
@@ -70,7 +103,14 @@ struct modded_request
         standardized_url(std::move(b.standardized_url)),
         ws(std::move(b.ws)),
         dhr(std::move(b.dhr)),
-        second(b.second)
+        second(b.second),
+        stale_nonce(b.stale_nonce),
+        started(b.started),
+        access(std::move(b.access)),
+        span(std::move(b.span)),
+        connection(b.connection),
+        allocs(b.allocs),
+        watch(std::move(b.watch))
     {
     }
 
@@ -84,6 +124,13 @@ struct modded_request
         this->ws = b.ws;
         this->dhr = b.dhr;
         this->second = b.second;
+        this->stale_nonce = b.stale_nonce;
+        this->started = b.started;
+        this->access = b.access;
+        this->span = b.span;
+        this->connection = b.connection;
+        this->allocs = b.allocs;
+        this->watch = b.watch;
 
         return *this;
     }
@@ -98,6 +145,13 @@ struct modded_request
         this->ws = std::move(b.ws);
         this->dhr = std::move(b.dhr);
         this->second = b.second;
+        this->stale_nonce = b.stale_nonce;
+        this->started = b.started;
+        this->access = std::move(b.access);
+        this->span = std::move(b.span);
+        this->connection = b.connection;
+        this->allocs = b.allocs;
+        this->watch = std::move(b.watch);
 
         return *this;
     }
@@ -112,6 +166,8 @@ struct modded_request
             delete dhr; //TODO: verify. It could be an error
         delete complete_uri;
         delete standardized_url;
+        delete access;
+        delete span;
     }
 
 };
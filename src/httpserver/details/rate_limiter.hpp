@@ -0,0 +1,116 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _RATE_LIMITER_HPP_
+#define _RATE_LIMITER_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+struct sockaddr;
+
+namespace httpserver
+{
+
+/**
+ * Snapshot of the state of the rate limiter of a webserver.
+**/
+struct rate_limit_stats
+{
+    size_t capacity;        //!< number of buckets the table can hold
+    size_t active_buckets;  //!< buckets currently tracking a client that is not idle
+    uint64_t allowed;       //!< requests let through since start
+    uint64_t limited;       //!< requests answered with 429 since start
+    uint64_t evictions;     //!< idle buckets reassigned to new clients
+    uint64_t overflows;     //!< requests that had to share a bucket because the table was full
+};
+
+namespace details
+{
+
+/**
+ * Table of token buckets keyed by client (and optionally by resource).
+ * Buckets live in a fixed open-addressing table and are updated with compare-and-swap only,
+ * so request threads never wait on each other. A bucket state packs the time of the last
+ * update (40 bits, milliseconds) and the available tokens (24 bits, 1/256 of token).
+**/
+class rate_limiter
+{
+    public:
+        /**
+         * @param capacity Number of buckets (rounded up to a power of two)
+        **/
+        explicit rate_limiter(size_t capacity);
+        ~rate_limiter();
+
+        /**
+         * Method used to compute the bucket key of a client for a given scope.
+         * @param scope Any pointer identifying the scope (0x0 for the server-wide limit)
+         * @param addr The client address
+         * @return a non-zero key
+        **/
+        static uint64_t make_key(const void* scope, const struct sockaddr* addr);
+
+        /**
+         * Method used to take one token from a bucket.
+         * @param key Key of the bucket (see make_key)
+         * @param rate Tokens added per second
+         * @param burst Maximum number of tokens the bucket can hold (at most 65535)
+         * @param retry_after Filled, when the request is limited, with the seconds to wait for a token
+         * @return true if the request can proceed
+        **/
+        bool consume(uint64_t key, double rate, unsigned int burst, unsigned int* retry_after);
+
+        rate_limit_stats get_stats() const;
+
+    private:
+        struct bucket
+        {
+            std::atomic<uint64_t> key;
+            std::atomic<uint64_t> state;
+            std::atomic<uint32_t> refill_ms;
+        };
+
+        bucket* buckets;
+        size_t mask;
+        uint64_t start;
+
+        std::atomic<uint64_t> allowed;
+        std::atomic<uint64_t> limited;
+        std::atomic<uint64_t> evictions;
+        std::atomic<uint64_t> overflows;
+
+        rate_limiter(const rate_limiter&);
+        rate_limiter& operator=(const rate_limiter&);
+
+        uint64_t now_ms() const;
+        bucket* find(uint64_t key, uint64_t now);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_RATE_LIMITER_HPP_
@@ -0,0 +1,220 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _TLS_MANAGER_HPP_
+#define _TLS_MANAGER_HPP_
+
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace httpserver
+{
+
+/**
+ * Counters of the TLS handshakes completed by the server.
+**/
+struct tls_stats
+{
+    unsigned long long full_handshakes;
+    unsigned long long resumed_handshakes;
+    unsigned long long credential_reloads;
+    unsigned long long ktls_connections;
+};
+
+namespace details
+{
+
+/**
+ * Server side cache of TLS sessions (used by clients resuming TLS 1.2 sessions by id).
+ * Entries are evicted in least recently used order once the capacity is reached.
+**/
+class tls_session_cache
+{
+    public:
+        /**
+         * @param capacity Maximum number of sessions kept (0 disables the cache)
+        **/
+        explicit tls_session_cache(size_t capacity);
+        ~tls_session_cache();
+
+        void store(const std::string& id, const std::string& data);
+        bool retrieve(const std::string& id, std::string& data);
+        void remove(const std::string& id);
+
+        size_t size() const;
+
+        bool is_enabled() const
+        {
+            return capacity != 0;
+        }
+
+    private:
+        typedef std::list<std::pair<std::string, std::string> > entries_T;
+
+        size_t capacity;
+        mutable pthread_mutex_t lock;
+        entries_T entries;
+        std::unordered_map<std::string, entries_T::iterator> index;
+
+        tls_session_cache(const tls_session_cache&);
+        tls_session_cache& operator=(const tls_session_cache&);
+};
+
+struct tls_credentials;
+struct tls_certificate;
+
+/**
+ * Owner of the TLS state shared by the connections of a server: the certificates, the session
+ * ticket key, the session cache and the handshake counters.
+ * Every new TLS session is attached to the manager before its handshake starts; the certificate
+ * is then chosen during the handshake according to the name requested by the client (SNI).
+ * Certificates are reference counted, so replacing or removing one only affects the handshakes
+ * that follow.
+**/
+class tls_manager
+{
+    public:
+        static const size_t TICKET_KEY_SIZE = 64;
+
+        /**
+         * @param key The PEM private key used when no certificate matches the requested name (can be empty)
+         * @param cert The PEM certificate (chain) going with key (can be empty)
+         * @param trust The PEM CA used to verify client certificates (can be empty)
+         * @param ocsp A DER encoded OCSP response to staple with cert (can be empty)
+         * @param tickets Whether session tickets are issued
+         * @param ticket_key The ticket key (TICKET_KEY_SIZE bytes); if empty a random one is generated
+         * @param ticket_rotation Seconds after which a generated ticket key is replaced (0 never)
+         * @param cache_size Maximum number of sessions kept in the session cache (0 disables it)
+         * @throws std::invalid_argument if the ticket key or the credentials are not valid
+         * @throws std::runtime_error if no ticket key is given and none can be generated
+        **/
+        tls_manager(const std::string& key, const std::string& cert,
+                const std::string& trust, const std::string& ocsp,
+                bool tickets, const std::string& ticket_key,
+                int ticket_rotation, size_t cache_size
+        );
+        ~tls_manager();
+
+        /**
+         * Method used to replace the certificate used when no other matches the requested name.
+         * @throws std::invalid_argument if the key, the certificate or the OCSP response are not valid
+        **/
+        void reload(const std::string& key, const std::string& cert, const std::string& ocsp);
+
+        /**
+         * Method used to add (or replace) the certificate served to the clients requesting a name.
+         * @param hostname The name (e.g. www.example.com) or a wildcard covering one label (e.g. *.example.com)
+         * @throws std::invalid_argument if the name, the key, the certificate or the OCSP response are not valid
+        **/
+        void add_certificate(const std::string& hostname, const std::string& key,
+                const std::string& cert, const std::string& ocsp
+        );
+
+        /**
+         * Method used to stop serving a certificate for a name.
+         * @return true if a certificate was registered for the name
+        **/
+        bool remove_certificate(const std::string& hostname);
+
+        /**
+         * Method used to know whether a certificate other than the default one is served for a name.
+        **/
+        bool has_certificate(const std::string& hostname) const;
+
+        /**
+         * Method used to replace the session ticket key (e.g. with one shared by several processes).
+         * Tickets issued with the previous key can no longer be used to resume sessions.
+         * @throws std::invalid_argument if the key is not TICKET_KEY_SIZE bytes long
+        **/
+        void set_ticket_key(const std::string& ticket_key);
+
+        /**
+         * Method used to configure a TLS session that is about to perform its handshake.
+         * @param session The gnutls_session_t of the connection
+         * @return the context of the connection, to be released with detach
+        **/
+        void* attach(void* session);
+
+        static void detach(void* context);
+
+        /**
+         * Method used to know whether the records sent on a session are encrypted by the kernel (kTLS).
+         * @param session The gnutls_session_t of the connection
+        **/
+        static bool is_kernel_tls(void* session);
+
+        /**
+         * Method returning the gnutls_certificate_retrieve_function2 selecting the certificate of a session,
+         * for the daemons started without a default certificate.
+        **/
+        static void* get_certificate_callback();
+
+        void handshake_completed(bool resumed);
+
+        void connection_closed(bool handshaken, bool kernel_tls);
+
+        tls_stats get_stats() const;
+
+        tls_session_cache& get_session_cache()
+        {
+            return cache;
+        }
+
+        std::shared_ptr<tls_certificate> find_certificate(const std::string& hostname) const;
+
+    private:
+        bool tickets;
+        int ticket_rotation;
+        bool generated_key;
+        time_t key_created;
+        std::shared_ptr<std::string> ticket_key;
+        std::shared_ptr<tls_credentials> credentials;
+        std::shared_ptr<tls_certificate> default_certificate;
+        std::map<std::string, std::shared_ptr<tls_certificate> > certificates;
+        mutable pthread_mutex_t lock;
+        mutable pthread_rwlock_t certificates_lock;
+        tls_session_cache cache;
+
+        std::atomic<unsigned long long> full_handshakes;
+        std::atomic<unsigned long long> resumed_handshakes;
+        std::atomic<unsigned long long> credential_reloads;
+        std::atomic<unsigned long long> ktls_connections;
+
+        tls_manager(const tls_manager&);
+        tls_manager& operator=(const tls_manager&);
+
+        std::shared_ptr<std::string> current_ticket_key();
+};
+
+} //details
+
+} //httpserver
+
+#endif //_TLS_MANAGER_HPP_
@@ -0,0 +1,59 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _TRACING_HPP_
+#define _TRACING_HPP_
+
+#include <string>
+
+#include "httpserver/request_trace.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Method used to parse a traceparent header (version 00, or a later version read as 00).
+ * @return false if the header is not valid (the context is left untouched)
+**/
+bool parse_traceparent(const std::string& header, trace_context& context);
+
+/**
+ * Method used to set up the context of a request: the trace is continued if the traceparent
+ * is valid, or started otherwise, and a new span id is drawn.
+**/
+void start_trace(const std::string& traceparent, const std::string& tracestate, trace_context& context);
+
+/**
+ * Method used to draw random bytes (from a generator private to the calling thread) as lowercase hex.
+**/
+std::string random_hex(size_t bytes);
+
+} //details
+
+} //httpserver
+
+#endif //_TRACING_HPP_
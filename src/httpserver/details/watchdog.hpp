@@ -0,0 +1,152 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _WATCHDOG_HPP_
+#define _WATCHDOG_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <signal.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "httpserver/stuck_handler.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Handler run watched by a thread. Written by that thread only, read by the watchdog
+ * (the route and peer under a sequence lock).
+**/
+struct watchdog_slot
+{
+    static const size_t ROUTE_SIZE = 128;
+    static const size_t PEER_SIZE = 64;
+    static const int MAX_FRAMES = 32;
+
+    std::atomic<bool> taken;
+    /** Odd while the route and peer are being written **/
+    std::atomic<uint64_t> sequence;
+    /** Monotonic time (in microseconds) at which the current handler started, 0 if none is running **/
+    std::atomic<uint64_t> started;
+    /** Start time of the last run reported, so that each run is reported once **/
+    uint64_t reported;
+    std::atomic<pthread_t> thread;
+    std::atomic<char> route[ROUTE_SIZE];
+    std::atomic<char> peer[PEER_SIZE];
+
+    // Filled by the thread itself from the stack capture signal handler.
+    void* frames[MAX_FRAMES];
+    std::atomic<int> frame_count;
+    /** Set by the watchdog while it signals the thread, which does not leave its handler meanwhile **/
+    std::atomic<bool> capturing;
+};
+
+class watchdog_slots;
+
+/**
+ * Request being handled, as watched by a handler_watchdog.
+**/
+struct watched_request
+{
+    std::shared_ptr<watchdog_slots> slots;
+    std::string route;
+    std::string peer;
+};
+
+/**
+ * Watches a handler for the lifetime of the object (does nothing if the request is not watched).
+**/
+class watch_guard
+{
+    public:
+        explicit watch_guard(const watched_request* watched);
+        ~watch_guard();
+
+    private:
+        watchdog_slot* slot;
+
+        watch_guard(const watch_guard&);
+        watch_guard& operator=(const watch_guard&);
+};
+
+/**
+ * Watchdog of the handlers running on the threads of a server. Each thread running a handler owns
+ * a slot (released when the thread ends) in which it publishes, without locks, what it is running
+ * and since when. A background thread periodically scans the slots and reports the handlers running
+ * for longer than the threshold, optionally along with the stack of their thread.
+**/
+class handler_watchdog
+{
+    public:
+        /**
+         * @param callback Function receiving the reports
+         * @param threshold Milliseconds after which a handler is reported
+         * @param slots Maximum number of threads watched at once
+         * @param stack_signal Signal used to capture the stacks of the threads reported (0 not to capture them)
+        **/
+        handler_watchdog(handler_watchdog_ptr callback, int threshold, size_t slots, int stack_signal);
+        ~handler_watchdog();
+
+        void start();
+        void stop();
+
+        /**
+         * Method used to scan the slots once.
+         * @return the number of handlers reported
+        **/
+        size_t check();
+
+        watched_request* watch(const std::string& route, const std::string& peer) const;
+
+    private:
+        handler_watchdog_ptr callback;
+        uint64_t threshold;
+        int stack_signal;
+        std::shared_ptr<watchdog_slots> slots;
+
+        pthread_mutex_t state_lock;
+        pthread_cond_t wakeup;
+        pthread_t thread;
+        bool running;
+        struct sigaction previous_action;
+
+        void capture_stack(watchdog_slot& slot, uint64_t started, stuck_handler& report);
+
+        static void* watch_loop(void* self);
+
+        handler_watchdog(const handler_watchdog&);
+        handler_watchdog& operator=(const handler_watchdog&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_WATCHDOG_HPP_
@@ -106,6 +106,8 @@ class digest_auth_fail_response : public string_response
         std::string realm;
         std::string opaque;
         bool reload_nonce;
+
+        friend class webserver;
 };
 
 }
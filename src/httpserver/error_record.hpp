@@ -0,0 +1,79 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ERROR_RECORD_HPP_
+#define _ERROR_RECORD_HPP_
+
+#include <time.h>
+#include <string>
+#include <vector>
+
+namespace httpserver
+{
+
+/**
+ * Error reported by libmicrohttpd, formatted with its arguments (see create_webserver::error_log_sink).
+**/
+struct error_record
+{
+    enum severity_T
+    {
+        /** The server cannot serve (e.g. it failed to bind its socket or to start its threads) **/
+        CRITICAL,
+        /** A connection or a request failed because of the server (e.g. out of memory or descriptors) **/
+        ERROR,
+        /** A connection or a request failed because of the client or the network **/
+        WARNING
+    };
+
+    enum category_T
+    {
+        /** Sockets, threads and event loops of the daemon **/
+        SYSTEM,
+        /** Memory, descriptors or connections exhausted **/
+        RESOURCES,
+        /** Connections accepted, read, written or closed **/
+        CONNECTION,
+        /** Malformed or oversized requests **/
+        PROTOCOL,
+        /** TLS handshakes, certificates and records **/
+        TLS,
+        /** Callbacks of the library and the application **/
+        APPLICATION,
+        OTHER
+    };
+
+    /** Wall clock time at which the error was reported **/
+    struct timespec time;
+    severity_T severity;
+    category_T category;
+    std::string message;
+    /** Identical messages suppressed by the rate limit since the last one delivered **/
+    unsigned long long suppressed;
+};
+
+typedef void(*error_log_sink_ptr)(const std::vector<error_record>& records);
+
+};
+#endif //_ERROR_RECORD_HPP_
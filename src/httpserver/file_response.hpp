@@ -86,9 +86,31 @@ class file_response : public http_response
         }
 
         MHD_Response* get_raw_response();
+        /**
+         * Method used to build the response honoring the conditional (If-None-Match, If-Modified-Since)
+         * and range (Range, If-Range) headers of the request. ETag and Last-Modified are generated from
+         * the file metadata unless explicitly set on the response.
+         * @param req The request being answered
+         * @param status Set to 304, 206 or 416 when applicable
+         * @return the response to send
+        **/
+        MHD_Response* get_raw_response_for(const http_request& req, int& status);
+        /**
+         * Method used to serve a precompressed sibling of the file (filename.gz, filename.br or filename.zst)
+         * when present and not older than the file itself.
+         * @param req The request being answered
+         * @param encoding The content coding negotiated with the client
+         * @param status Set to 304 when applicable
+         * @return the response or NULL if no suitable sibling exists
+        **/
+        MHD_Response* get_raw_response_encoded(const http_request& req, const std::string& encoding, int& status);
+        void decorate_response(MHD_Response* response);
 
     private:
         std::string filename;
+
+        bool serves_entity(const http_request& req) const;
+        MHD_Response* serve_file(const http_request& req, const std::string& path, int& status);
 };
 
 }
@@ -44,6 +44,25 @@ namespace http
     class arg_comparator;
 };
 
+namespace details
+{
+    class credential_cache;
+    class file_cache;
+    class compression_cache;
+    struct watched_request;
+};
+
+class http_request;
+
+namespace details
+{
+    const watched_request* request_watch(const http_request& req);
+};
+
+struct request_span;
+struct request_timings;
+struct trace_context;
+
 /**
  * Class representing an abstraction for an Http Request. It is used from classes using these apis to receive information through http protocol.
 **/
@@ -204,11 +223,42 @@ class http_request
         **/
         unsigned short get_requestor_port() const;
 
+        /**
+         * Method used to know whether the response is encrypted by the kernel (kTLS) rather than by the library.
+         * This is the case for HTTPS connections when gnutls is configured to use kTLS and the kernel supports the negotiated cipher.
+         * @return true if the connection uses kTLS for sending
+        **/
+        bool is_kernel_tls() const;
+
         bool check_digest_auth(const std::string& realm,
                 const std::string& password,
                 int nonce_timeout, bool& reload_nonce
         ) const;
 
+        /**
+         * Method used to check the basic authentication credentials of the request through the verifier
+         * set with create_webserver::basic_auth_verifier.
+         * Successful verifications are cached for a while, so that the verifier (e.g. a slow password hash)
+         * runs once for a series of requests carrying the same credentials.
+         * @return true if the request carries credentials accepted by the verifier
+        **/
+        bool check_basic_auth() const;
+
+        /**
+         * Method used to get the monotonic timestamps of the phases the request went through so far.
+         * Phases are only timed when the server has request_timing (or a request_tracer) enabled;
+         * otherwise all of them read zero.
+         * @return the timings of the request
+        **/
+        const request_timings& get_timings() const;
+
+        /**
+         * Method used to get the W3C trace context of the request. It continues the trace of the
+         * traceparent header sent by the client, if any, and is empty unless a request_tracer is set.
+         * @return the trace context of the request
+        **/
+        const trace_context& get_trace_context() const;
+
         friend std::ostream &operator<< (std::ostream &os, http_request &r);
 
     private:
@@ -219,15 +269,32 @@ class http_request
             content(""),
             content_size_limit(static_cast<size_t>(-1)),
             underlying_connection(0x0),
-            unescaper(0x0)
+            unescaper(0x0),
+            credentials(0x0),
+            files(0x0),
+            compressed(0x0),
+            compression_min_size(0),
+            span(0x0),
+            watched(0x0),
+            basic_auth_fetched(false)
         {
         }
 
-        http_request(MHD_Connection* underlying_connection, unescaper_ptr unescaper):
+        http_request(MHD_Connection* underlying_connection, unescaper_ptr unescaper,
+                details::credential_cache* credentials = 0x0, details::file_cache* files = 0x0,
+                details::compression_cache* compressed = 0x0, size_t compression_min_size = 0
+        ):
             content(""),
             content_size_limit(static_cast<size_t>(-1)),
             underlying_connection(underlying_connection),
-            unescaper(unescaper)
+            unescaper(unescaper),
+            credentials(credentials),
+            files(files),
+            compressed(compressed),
+            compression_min_size(compression_min_size),
+            span(0x0),
+            watched(0x0),
+            basic_auth_fetched(false)
         {
         }
 
@@ -244,7 +311,16 @@ class http_request
             content_size_limit(b.content_size_limit),
             version(b.version),
             underlying_connection(b.underlying_connection),
-            unescaper(b.unescaper)
+            unescaper(b.unescaper),
+            credentials(b.credentials),
+            files(b.files),
+            compressed(b.compressed),
+            compression_min_size(b.compression_min_size),
+            span(b.span),
+            watched(b.watched),
+            basic_auth_fetched(b.basic_auth_fetched),
+            user(b.user),
+            pass(b.pass)
         {
         }
 
@@ -256,7 +332,17 @@ class http_request
             content(std::move(b.content)),
             content_size_limit(b.content_size_limit),
             version(std::move(b.version)),
-            underlying_connection(std::move(b.underlying_connection))
+            underlying_connection(std::move(b.underlying_connection)),
+            unescaper(b.unescaper),
+            credentials(b.credentials),
+            files(b.files),
+            compressed(b.compressed),
+            compression_min_size(b.compression_min_size),
+            span(b.span),
+            watched(b.watched),
+            basic_auth_fetched(b.basic_auth_fetched),
+            user(std::move(b.user)),
+            pass(std::move(b.pass))
         {
         }
 
@@ -272,6 +358,16 @@ class http_request
             this->content_size_limit = b.content_size_limit;
             this->version = b.version;
             this->underlying_connection = b.underlying_connection;
+            this->unescaper = b.unescaper;
+            this->credentials = b.credentials;
+            this->files = b.files;
+            this->compressed = b.compressed;
+            this->compression_min_size = b.compression_min_size;
+            this->span = b.span;
+            this->watched = b.watched;
+            this->basic_auth_fetched = b.basic_auth_fetched;
+            this->user = b.user;
+            this->pass = b.pass;
 
             return *this;
         }
@@ -288,6 +384,16 @@ class http_request
             this->content_size_limit = b.content_size_limit;
             this->version = std::move(b.version);
             this->underlying_connection = std::move(b.underlying_connection);
+            this->unescaper = b.unescaper;
+            this->credentials = b.credentials;
+            this->files = b.files;
+            this->compressed = b.compressed;
+            this->compression_min_size = b.compression_min_size;
+            this->span = b.span;
+            this->watched = b.watched;
+            this->basic_auth_fetched = b.basic_auth_fetched;
+            this->user = std::move(b.user);
+            this->pass = std::move(b.pass);
 
             return *this;
         }
@@ -304,6 +410,26 @@ class http_request
 
         unescaper_ptr unescaper;
 
+        details::credential_cache* credentials;
+        // Cache of open files of the webserver (0x0 when disabled), used by file_response.
+        details::file_cache* files;
+        // Cache of compressed bodies of the webserver (0x0 when disabled) and size under which they are not
+        // compressed, used by string_response.
+        details::compression_cache* compressed;
+        size_t compression_min_size;
+
+        // Owned by the modded_request; null when timing is disabled.
+        const request_span* span;
+        // Owned by the modded_request; null when handlers are not watched. Used by deferred_response.
+        const details::watched_request* watched;
+
+        // Basic authentication credentials, decoded on first use.
+        mutable bool basic_auth_fetched;
+        mutable std::string user;
+        mutable std::string pass;
+
+        void fetch_basic_auth() const;
+
         static int build_request_header(void *cls, enum MHD_ValueKind kind,
                 const char *key, const char *value
         );
@@ -414,6 +540,9 @@ class http_request
         const std::map<std::string, std::string, http::header_comparator> get_headerlike_values(enum MHD_ValueKind kind) const;
 
         friend class webserver;
+        friend class file_response;
+        friend class string_response;
+        friend const details::watched_request* details::request_watch(const http_request& req);
 };
 
 std::ostream &operator<< (std::ostream &os, const http_request &r);
@@ -198,11 +198,57 @@ class http_resource
                 return false;
             }
         }
+        /**
+         * Method used to limit the rate at which each client can call this resource.
+         * The limit applies in addition to the server-wide one (see create_webserver::rate_limit).
+         * Requests exceeding it are answered with 429 Too Many Requests before reaching the resource.
+         * @param requests_per_second Rate at which each client recovers the right to send a request (0 disables the limit)
+         * @param burst Number of requests a client can send in a row (at most 65535)
+        **/
+        void set_rate_limit(double requests_per_second, unsigned int burst)
+        {
+            this->rate_limit_rate = requests_per_second;
+            this->rate_limit_burst = burst;
+        }
+        /**
+         * Method used to check whether a per-client rate limit is set on this resource.
+         * @return true if limited
+        **/
+        bool is_rate_limited() const
+        {
+            return this->rate_limit_rate > 0 && this->rate_limit_burst > 0;
+        }
+        /**
+         * Method used to protect this resource with basic authentication.
+         * Requests are checked through the verifier set with create_webserver::basic_auth_verifier
+         * (see http_request::check_basic_auth) and the ones without valid credentials are answered with
+         * 401 Unauthorized before reaching the resource.
+         * @param realm The realm sent to the clients (an empty realm removes the protection)
+        **/
+        void require_basic_auth(const std::string& realm)
+        {
+            this->basic_auth_realm = realm;
+        }
+        /**
+         * Method used to protect this resource with digest authentication (RFC 7616, SHA-256 and MD5).
+         * The passwords are obtained through the lookup set with create_webserver::digest_auth_password_lookup
+         * and the nonces are tracked by the server nonce store. Requests without valid credentials are answered
+         * with a 401 Unauthorized carrying a fresh challenge before reaching the resource.
+         * @param realm The realm sent to the clients (an empty realm removes the protection)
+        **/
+        void require_digest_auth(const std::string& realm)
+        {
+            this->digest_auth_realm = realm;
+        }
     protected:
         /**
          * Constructor of the class
         **/
-        http_resource()
+        http_resource():
+            rate_limit_rate(0),
+            rate_limit_burst(0),
+            basic_auth_realm(""),
+            digest_auth_realm("")
         {
             resource_init(allowed_methods);
         }
@@ -210,15 +256,33 @@ class http_resource
         /**
          * Copy constructor
         **/
-        http_resource(const http_resource& b) : allowed_methods(b.allowed_methods) { }
+        http_resource(const http_resource& b):
+            allowed_methods(b.allowed_methods),
+            rate_limit_rate(b.rate_limit_rate),
+            rate_limit_burst(b.rate_limit_burst),
+            basic_auth_realm(b.basic_auth_realm),
+            digest_auth_realm(b.digest_auth_realm)
+        {
+        }
 
-        http_resource(http_resource&& b) noexcept: allowed_methods(std::move(b.allowed_methods)) { }
+        http_resource(http_resource&& b) noexcept:
+            allowed_methods(std::move(b.allowed_methods)),
+            rate_limit_rate(b.rate_limit_rate),
+            rate_limit_burst(b.rate_limit_burst),
+            basic_auth_realm(std::move(b.basic_auth_realm)),
+            digest_auth_realm(std::move(b.digest_auth_realm))
+        {
+        }
 
         http_resource& operator=(const http_resource& b)
         {
             if (this == &b) return *this;
 
             allowed_methods = b.allowed_methods;
+            rate_limit_rate = b.rate_limit_rate;
+            rate_limit_burst = b.rate_limit_burst;
+            basic_auth_realm = b.basic_auth_realm;
+            digest_auth_realm = b.digest_auth_realm;
             return (*this);
         }
 
@@ -227,6 +291,10 @@ class http_resource
             if (this == &b) return *this;
 
             allowed_methods = std::move(b.allowed_methods);
+            rate_limit_rate = b.rate_limit_rate;
+            rate_limit_burst = b.rate_limit_burst;
+            basic_auth_realm = std::move(b.basic_auth_realm);
+            digest_auth_realm = std::move(b.digest_auth_realm);
             return (*this);
         }
 
@@ -234,6 +302,10 @@ class http_resource
         friend class webserver;
         friend void resource_init(std::map<std::string, bool>& res);
         std::map<std::string, bool> allowed_methods;
+        double rate_limit_rate;
+        unsigned int rate_limit_burst;
+        std::string basic_auth_realm;
+        std::string digest_auth_realm;
 };
 
 };
@@ -39,6 +39,8 @@ struct MHD_Response;
 namespace httpserver
 {
 
+class http_request;
+
 /**
  * Class representing an abstraction for an Http Response. It is used from classes using these apis to send information through http protocol.
 **/
@@ -179,6 +181,23 @@ class http_response
         void shoutCAST();
 
         virtual MHD_Response* get_raw_response();
+        /**
+         * Method used to build the response for a specific request. Responses that can take advantage of
+         * the request (e.g. honoring conditional or range headers) override it; by default get_raw_response is used.
+         * @param req The request being answered
+         * @param status Set to the status to send when it differs from the response code (e.g. 304 or 206
+         *        for a file), left untouched otherwise
+         * @return the response to send
+        **/
+        virtual MHD_Response* get_raw_response_for(const http_request& req, int& status);
+        /**
+         * Method used to build the response encoded with a content coding negotiated with the client.
+         * @param req The request being answered
+         * @param encoding The content coding to use (e.g. "gzip", "br", "zstd")
+         * @param status Set to the status to send when it differs from the response code, as for get_raw_response_for
+         * @return the encoded response or NULL if the response cannot (or should not) be encoded that way
+        **/
+        virtual MHD_Response* get_raw_response_encoded(const http_request& req, const std::string& encoding, int& status);
         virtual void decorate_response(MHD_Response* response);
         virtual int enqueue_response(MHD_Connection* connection, MHD_Response* response);
 
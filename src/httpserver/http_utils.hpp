@@ -26,7 +26,10 @@
 #define _HTTPUTILS_H_
 
 #include <microhttpd.h>
+#include <stdint.h>
+#include <ctime>
 #include <string>
+#include <utility>
 #include <cctype>
 #include <vector>
 #include <map>
@@ -76,6 +79,11 @@ class http_utils
         INTERNAL_SELECT = MHD_USE_SELECT_INTERNALLY,
     #endif
 #endif
+#if !defined(__MINGW32__) && !defined(__CYGWIN32__) && defined(ENABLE_EPOLL)
+        EXTERNAL_SELECT = MHD_USE_EPOLL | MHD_USE_EPOLL_TURBO,
+#else
+        EXTERNAL_SELECT = MHD_NO_FLAG,
+#endif
 #ifdef ENABLE_POLL
         THREAD_PER_CONNECTION = MHD_USE_THREAD_PER_CONNECTION | MHD_USE_POLL
 #else
@@ -150,6 +158,7 @@ class http_utils
     static const int http_unordered_collection;
     static const int http_upgrade_required;
     static const int http_retry_with;
+    static const int http_too_many_requests;
 
     static const int http_internal_server_error;
     static const int http_not_implemented;
@@ -364,6 +373,43 @@ const std::string load_file (const std::string& filename);
 
 size_t base_unescaper(std::string&, unescaper_ptr unescaper);
 
+/**
+ * Method used to parse the value of a Range header (RFC 7233) against a resource of the given size.
+ * Unsatisfiable ranges are discarded; overlapping or adjacent ranges are coalesced.
+ * @param header The value of the Range header
+ * @param size The size of the resource
+ * @param ranges Filled with the satisfiable ranges as inclusive (first, last) offsets sorted by offset
+ * @return false if the header is not a valid byte ranges specifier (and has to be ignored)
+**/
+bool parse_byte_ranges(const std::string& header, uint64_t size,
+        std::vector<std::pair<uint64_t, uint64_t> >& ranges
+);
+
+/**
+ * Method used to format a timestamp as an HTTP date (e.g. "Sun, 06 Nov 1994 08:49:37 GMT")
+ * @param t The timestamp
+ * @return string containing the date
+**/
+std::string format_http_date(time_t t);
+
+/**
+ * Method used to parse an HTTP date in any of the formats accepted by RFC 7231.
+ * @param date The date to parse
+ * @return the timestamp represented by the date or -1 if the date is not valid
+**/
+time_t parse_http_date(const std::string& date);
+
+/**
+ * Method used to negotiate the content coding of a response from the value of an Accept-Encoding header.
+ * @param header The value of the Accept-Encoding header
+ * @param available The codings the server can produce in order of preference
+ * @return the acceptable codings among the available ones, sorted by the client preference (qvalue)
+ *         and then by the server preference
+**/
+std::vector<std::string> accepted_encodings(const std::string& header,
+        const std::vector<std::string>& available
+);
+
 };
 };
 #endif
@@ -0,0 +1,87 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _NONCE_STORE_HPP_
+#define _NONCE_STORE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace httpserver
+{
+
+/**
+ * Occupancy and counters of a nonce store.
+**/
+struct nonce_stats
+{
+    size_t capacity;
+    size_t size;
+    unsigned long long issued;
+    unsigned long long stale;
+    unsigned long long replays;
+};
+
+/**
+ * Interface of the stores keeping track of the nonces issued to the clients using digest authentication
+ * (see http_resource::require_digest_auth). A store can be shared by several servers (for instance to
+ * share the nonces among processes). Implementations have to be thread safe.
+**/
+class nonce_store
+{
+    public:
+        enum status_T
+        {
+            /** The nonce is known and the nonce count was never used with it **/
+            VALID,
+            /** The nonce is unknown or expired: the client has to retry with a new one **/
+            STALE,
+            /** The nonce count was already used with the nonce (replay) **/
+            INVALID
+        };
+
+        virtual ~nonce_store()
+        {
+        }
+
+        /**
+         * Method used to create a new nonce.
+         * @return the nonce, made of characters that can be sent unescaped in a quoted string
+        **/
+        virtual std::string issue() = 0;
+
+        /**
+         * Method used to check a nonce received from a client and to record its use.
+         * @param nonce The nonce
+         * @param nc The nonce count sent together with the nonce
+         * @return the status of the nonce
+        **/
+        virtual status_T check(const std::string& nonce, uint64_t nc) = 0;
+
+        virtual nonce_stats get_stats() const = 0;
+};
+
+};
+#endif //_NONCE_STORE_HPP_
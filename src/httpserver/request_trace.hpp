@@ -0,0 +1,145 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _REQUEST_TRACE_HPP_
+#define _REQUEST_TRACE_HPP_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+namespace httpserver
+{
+
+/**
+ * Monotonic timestamps (in microseconds) of the phases a request goes through.
+ * A phase not reached (e.g. a request rejected before routing) has a zero timestamp.
+**/
+struct request_timings
+{
+    enum phase_T
+    {
+        /** The request line was received **/
+        RECEIVED,
+        /** The headers were received **/
+        HEADERS,
+        /** The body was received **/
+        BODY,
+        /** The resource was looked up **/
+        ROUTED,
+        /** The render method of the resource returned **/
+        HANDLED,
+        /** The response was handed to libmicrohttpd **/
+        QUEUED,
+        /** The response was sent (or the connection was closed) **/
+        COMPLETED,
+        PHASES
+    };
+
+    uint64_t at[PHASES];
+
+    request_timings()
+    {
+        for(int i = 0; i < PHASES; i++)
+            at[i] = 0;
+    }
+
+    /**
+     * Method used to get the time elapsed between two phases.
+     * @return the microseconds elapsed (0 if one of the phases was not reached)
+    **/
+    uint64_t elapsed(phase_T from, phase_T to) const
+    {
+        if(at[from] == 0 || at[to] < at[from])
+            return 0;
+        return at[to] - at[from];
+    }
+};
+
+/**
+ * W3C trace context (https://www.w3.org/TR/trace-context/) of a request. The trace and parent ids
+ * come from the traceparent header of the request when it carries a valid one; otherwise a new trace
+ * is started. The span id identifies the handling of the request by the server.
+**/
+struct trace_context
+{
+    /** 32 lowercase hex characters **/
+    std::string trace_id;
+    /** 16 lowercase hex characters, empty if the request did not carry a traceparent **/
+    std::string parent_id;
+    /** 16 lowercase hex characters **/
+    std::string span_id;
+    unsigned char flags;
+    /** The tracestate header of the request, to forward as is **/
+    std::string tracestate;
+
+    trace_context():
+        flags(0)
+    {
+    }
+
+    bool is_sampled() const
+    {
+        return (flags & 0x01) != 0;
+    }
+
+    /**
+     * Method used to get the traceparent header to send along with the requests made while handling this one.
+     * @return the header value (empty if the request is not traced)
+    **/
+    std::string get_traceparent() const
+    {
+        if(trace_id.empty())
+            return "";
+        char hex_flags[3];
+        snprintf(hex_flags, sizeof(hex_flags), "%02x", flags);
+        return "00-" + trace_id + "-" + span_id + "-" + hex_flags;
+    }
+};
+
+/**
+ * Span reported to the tracer once a request completed (see create_webserver::request_tracer).
+**/
+struct request_span
+{
+    trace_context context;
+    std::string method;
+    /** Path and query string as sent by the client **/
+    std::string path;
+    int status;
+    /** false if the response could not be sent completely **/
+    bool completed;
+    request_timings timings;
+
+    request_span():
+        status(0),
+        completed(false)
+    {
+    }
+};
+
+typedef void(*request_tracer_ptr)(const request_span& span);
+
+};
+#endif //_REQUEST_TRACE_HPP_
@@ -0,0 +1,57 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _RUNTIME_CONFIG_HPP_
+#define _RUNTIME_CONFIG_HPP_
+
+#include <stddef.h>
+#include <string>
+
+#include "httpserver/http_utils.hpp"
+
+namespace httpserver
+{
+
+typedef void(*log_access_ptr)(const std::string&);
+typedef void(*log_error_ptr)(const std::string&);
+
+/**
+ * Settings of a webserver that can be changed while it runs (see webserver::update_runtime_config).
+ * Their initial values are the ones of create_webserver.
+**/
+struct runtime_config
+{
+    /** Seconds of inactivity after which a connection is closed (0 for none), for the connections accepted afterwards **/
+    int connection_timeout;
+    /** Maximum number of connections from a single address (0 for no limit) **/
+    int per_IP_connection_limit;
+    /** Maximum size of the content and arguments of the requests received afterwards **/
+    size_t content_size_limit;
+    http::http_utils::policy_T default_policy;
+    log_access_ptr log_access;
+    log_error_ptr log_error;
+};
+
+};
+#endif //_RUNTIME_CONFIG_HPP_
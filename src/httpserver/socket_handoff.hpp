@@ -0,0 +1,52 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _SOCKET_HANDOFF_HPP_
+#define _SOCKET_HANDOFF_HPP_
+
+#include <microhttpd.h>
+
+namespace httpserver
+{
+
+/**
+ * Function used to pass a listen socket to another process through a unix domain socket (SCM_RIGHTS),
+ * e.g. from a server being upgraded to the binary replacing it. The receiver starts its webserver with
+ * create_webserver::bind_socket on the socket it got; the sender then drains its own. The socket stays
+ * open in the sender. Not available on Windows, where the function always fails.
+ * @param channel connected unix domain socket shared with the receiving process
+ * @param socket listen socket to pass, as returned by webserver::get_listen_socket
+ * @return true if the socket was sent.
+**/
+bool send_listen_socket(int channel, MHD_socket socket);
+
+/**
+ * Function used to receive a listen socket sent with send_listen_socket. Blocks until it arrives.
+ * @param channel connected unix domain socket shared with the sending process
+ * @return the socket, or MHD_INVALID_SOCKET if none was received.
+**/
+MHD_socket receive_listen_socket(int channel);
+
+};
+#endif
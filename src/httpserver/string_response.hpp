@@ -86,6 +86,7 @@ class string_response : public http_response
         }
 
         MHD_Response* get_raw_response();
+        MHD_Response* get_raw_response_encoded(const http_request& req, const std::string& encoding, int& status);
 
     private:
         std::string content;
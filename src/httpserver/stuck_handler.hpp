@@ -0,0 +1,57 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _STUCK_HANDLER_HPP_
+#define _STUCK_HANDLER_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace httpserver
+{
+
+/**
+ * Report of a render method (or deferred response callback) running for longer than the threshold
+ * of the handler watchdog (see create_webserver::handler_watchdog).
+**/
+struct stuck_handler
+{
+    /** Endpoint the resource was registered with (empty for requests not reaching a resource) **/
+    std::string route;
+    /** Address of the client **/
+    std::string peer;
+    /** Microseconds the handler has been running for **/
+    uint64_t elapsed;
+    /** Thread running the handler **/
+    pthread_t thread;
+    /** Frames of the thread, when stacks are captured (see create_webserver::handler_watchdog_stack_signal) **/
+    std::vector<std::string> stack;
+};
+
+typedef void(*handler_watchdog_ptr)(const stuck_handler& report);
+
+};
+#endif //_STUCK_HANDLER_HPP_
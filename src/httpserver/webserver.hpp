@@ -29,6 +29,9 @@
 #define METHOD_ERROR "Method not Allowed"
 #define NOT_METHOD_ERROR "Method not Acceptable"
 #define GENERIC_ERROR "Internal Error"
+#define TOO_MANY_REQUESTS_ERROR "Too Many Requests"
+#define UNAUTHORIZED_ERROR "Unauthorized"
+#define BAD_REQUEST_ERROR "Bad Request"
 
 #include <cstring>
 #include <map>
@@ -47,6 +50,20 @@
 #include "httpserver/http_response.hpp"
 
 #include "details/http_endpoint.hpp"
+#include "details/ip_filter.hpp"
+#include "details/rate_limiter.hpp"
+#include "details/abuse_tracker.hpp"
+#include "details/credential_cache.hpp"
+#include "details/tls_manager.hpp"
+#include "details/metrics.hpp"
+#include "details/access_logger.hpp"
+#include "details/error_log.hpp"
+#include "details/config_cell.hpp"
+#include "details/daemon_reaper.hpp"
+#include "details/connection_registry.hpp"
+#include "details/alloc_accounting.hpp"
+#include "details/watchdog.hpp"
+#include "httpserver/connection_info.hpp"
 
 namespace httpserver {
 
@@ -60,6 +77,8 @@ struct httpserver_ska;
 
 namespace details {
     struct modded_request;
+    class file_cache;
+    class compression_cache;
 }
 
 /**
@@ -85,11 +104,64 @@ class webserver
          * @return true if the webserver is stopped.
         **/
         bool stop();
+        /**
+         * Method used to stop the webserver gracefully. The webserver stops accepting connections, answers
+         * the requests still coming on its connections with "Connection: close" and waits until they end,
+         * deferred responses included; idle keep-alive connections are closed right away when tracking
+         * connections. A socket given with bind_socket is left open for the process replacing this one.
+         * @param timeout milliseconds after which the remaining connections are dropped
+         * @return true if all the connections ended before the timeout.
+        **/
+        bool drain(int timeout);
+        /**
+         * Method used to get the socket the webserver accepts connections on, e.g. to hand it to the
+         * process replacing this one (see send_listen_socket).
+         * @return the listen socket, or MHD_INVALID_SOCKET if the webserver is not running.
+        **/
+        MHD_socket get_listen_socket() const;
         /**
          * Method used to evaluate if the server is running or not.
          * @return true if the webserver is running
         **/
         bool is_running();
+        /**
+         * Method used to get the file descriptors the server is interested in when started with the EXTERNAL_SELECT method.
+         * When the library is built with epoll support the only descriptor added to the read set is the epoll one.
+         * @param read_fd_set set that will be filled with the descriptors to watch for reading
+         * @param write_fd_set set that will be filled with the descriptors to watch for writing
+         * @param except_fd_set set that will be filled with the descriptors to watch for exceptions
+         * @param max_fd updated with the highest descriptor added to the sets
+         * @return true if the sets were filled
+        **/
+        bool get_fdset(fd_set* read_fd_set, fd_set* write_fd_set,
+                fd_set* except_fd_set, MHD_socket* max_fd
+        );
+        /**
+         * Method used to get the epoll descriptor of the server when started with the EXTERNAL_SELECT method.
+         * @return the epoll file descriptor or -1 if the library was not built with epoll support
+        **/
+        int get_epoll_fd();
+        /**
+         * Method used to get how long the external loop can wait before calling run_once.
+         * @param timeout filled with the timeout in milliseconds
+         * @return false if no timeout is needed (wait until some descriptor is ready)
+        **/
+        bool get_timeout(unsigned long long* timeout);
+        /**
+         * Method used to process all the events that are ready without blocking when started with the EXTERNAL_SELECT method.
+         * @return true on success
+        **/
+        bool run_once();
+        /**
+         * Method used to process the events signaled by a select performed by the external loop.
+         * @param read_fd_set descriptors ready for reading
+         * @param write_fd_set descriptors ready for writing
+         * @param except_fd_set descriptors with exceptions
+         * @return true on success
+        **/
+        bool run_from_select(const fd_set* read_fd_set,
+                const fd_set* write_fd_set, const fd_set* except_fd_set
+        );
         /**
          * Method used to register a resource with the webserver.
          * @param resource The url pointing to the resource. This url could be also parametrized in the form /path/to/url/{par1}/and/{par2}
@@ -107,15 +179,170 @@ class webserver
         void allow_ip(const std::string& ip);
         void unban_ip(const std::string& ip);
         void disallow_ip(const std::string& ip);
+        /**
+         * Method used to replace the whole list of banned IPs at once.
+         * The new list is compiled before being published atomically; requests are never stalled.
+         * @param ips The IPs or ranges (wildcards or CIDR) composing the new list
+         * @throws std::invalid_argument if any of the entries is badly formatted (the current list is kept)
+        **/
+        void set_bans(const std::vector<std::string>& ips);
+        /**
+         * Method used to replace the whole list of allowed IPs at once.
+         * @param ips The IPs or ranges (wildcards or CIDR) composing the new list
+         * @throws std::invalid_argument if any of the entries is badly formatted (the current list is kept)
+        **/
+        void set_allowances(const std::vector<std::string>& ips);
+        /**
+         * Method used to replace the whole list of banned IPs with the content of a file.
+         * The file lists one IP or range per line; empty lines and text following '#' are ignored.
+         * @param path The path of the file
+         * @throws std::invalid_argument if the file cannot be read or an entry is badly formatted (the current list is kept)
+        **/
+        void load_bans(const std::string& path);
+        /**
+         * Method used to replace the whole list of allowed IPs with the content of a file.
+         * @param path The path of the file (same format as load_bans)
+         * @throws std::invalid_argument if the file cannot be read or an entry is badly formatted (the current list is kept)
+        **/
+        void load_allowances(const std::string& path);
+
+        /**
+         * Method used to inspect the state of the rate limiter.
+         * @return the number of buckets in use and the counters of allowed and limited requests
+        **/
+        rate_limit_stats get_rate_limit_stats() const;
+
+        /**
+         * Method used to get the number of clients currently banned by the automatic ban system.
+         * @return the number of clients temporarily banned
+        **/
+        size_t get_auto_banned_count() const;
+
+        /**
+         * Method used to drop all the cached basic authentication verifications (e.g. after changing passwords).
+        **/
+        void clear_basic_auth_cache();
+
+        /**
+         * Method used to replace the default certificate of a running HTTPS server.
+         * Connections accepted from now on use the new certificate; established ones keep the previous one.
+         * @param key_path The path of the PEM private key
+         * @param cert_path The path of the PEM certificate
+         * @param ocsp_path The path of a DER encoded OCSP response to staple (optional)
+         * @throws std::invalid_argument if the server does not use TLS or the files cannot be read or are not valid
+        **/
+        void reload_https_credentials(const std::string& key_path,
+                const std::string& cert_path, const std::string& ocsp_path = ""
+        );
+
+        /**
+         * Method used to add (or replace) the certificate presented to the clients asking for a hostname through SNI.
+         * Clients asking for other names (or not using SNI) get the default certificate.
+         * @param hostname The hostname (e.g. www.example.com) or a wildcard covering a single label (e.g. *.example.com)
+         * @param key_path The path of the PEM private key
+         * @param cert_path The path of the PEM certificate (chain)
+         * @param ocsp_path The path of a DER encoded OCSP response to staple (optional)
+         * @throws std::invalid_argument if the server does not use TLS or the hostname or the files are not valid
+        **/
+        void add_https_certificate(const std::string& hostname,
+                const std::string& key_path, const std::string& cert_path,
+                const std::string& ocsp_path = ""
+        );
+
+        /**
+         * Method used to stop presenting a specific certificate for a hostname.
+         * @return true if a certificate was registered for the hostname
+        **/
+        bool remove_https_certificate(const std::string& hostname);
+
+        /**
+         * Method used to replace the key protecting the TLS session tickets (e.g. after it was rotated for all the processes sharing it).
+         * @param path The path of the file containing the 64 bytes key
+         * @throws std::invalid_argument if the server does not use TLS or the key cannot be read or has the wrong size
+        **/
+        void set_https_session_ticket_key(const std::string& path);
+
+        /**
+         * Method used to get the number of TLS handshakes completed, split between full and resumed ones.
+         * @return the handshake counters (all zero if the server does not use TLS)
+        **/
+        tls_stats get_tls_stats() const;
+
+        /**
+         * Method used to get the occupancy and the counters of the store tracking the digest authentication nonces.
+         * @return the statistics of the nonce store
+        **/
+        nonce_stats get_nonce_stats() const;
+
+        /**
+         * Method used to get the metrics collected by the server (see create_webserver::metrics) in the Prometheus text format.
+         * @return the metrics (empty if the server does not collect them)
+        **/
+        std::string get_metrics() const;
+
+        /**
+         * Method used to get the number of access records lost because the ring of the thread logging them was full
+         * (see create_webserver::access_log_ring_size).
+        **/
+        unsigned long long get_dropped_access_records() const;
+
+        /**
+         * Method used to get the number of error messages suppressed by the rate limit of identical messages
+         * (see create_webserver::error_log_burst).
+        **/
+        unsigned long long get_suppressed_errors() const;
+
+        /**
+         * Method used to get the number of error records lost because the ring of the thread logging them was full.
+        **/
+        unsigned long long get_dropped_error_records() const;
+
+        /**
+         * Method used to list the live connections of the server (see create_webserver::connection_tracking).
+         * @return the state of each connection (empty if connections are not tracked)
+        **/
+        std::vector<connection_info> get_connections() const;
+
+        /**
+         * Method used to force a connection to close, e.g. a client sending its headers too slowly.
+         * The socket is shut down: libmicrohttpd drops the connection as soon as it next reads or writes it.
+         * @param id The id of the connection, as reported by get_connections
+         * @return false if no live connection has this id (or connections are not tracked)
+        **/
+        bool close_connection(uint64_t id);
+
+        /**
+         * Method used to get the memory allocations made while serving the requests completed so far.
+         * Allocations are only counted when the library is configured with --enable-alloc-accounting.
+         * @return the allocation counters (with enabled set to false when they are not counted)
+        **/
+        alloc_stats get_alloc_stats() const;
+
+        /**
+         * Method used to get the settings currently applied (see update_runtime_config).
+        **/
+        runtime_config get_runtime_config() const;
+
+        /**
+         * Method used to change settings while the server runs. Each request reads the settings once and
+         * as a whole, so it sees either the previous or the new ones. The connection timeout applies to the
+         * connections accepted afterwards. Changing a setting libmicrohttpd fixes at start (the connection
+         * limit per address, or whether errors are reported) starts a new daemon on the same listen socket;
+         * the previous one stops accepting and is stopped once its connections are closed, or after
+         * create_webserver::drain_timeout.
+         * @param config The new settings
+         * @throws std::invalid_argument if a setting is invalid, or would need a new daemon while using an external event loop
+        **/
+        void update_runtime_config(const runtime_config& config);
 
         log_access_ptr get_access_logger() const
         {
-            return this->log_access;
+            return this->settings->load().log_access;
         }
 
         log_error_ptr get_error_logger() const
         {
-            return this->log_error;
+            return this->settings->load().log_error;
         }
 
         validator_ptr get_request_validator() const
@@ -142,11 +369,8 @@ class webserver
         const int max_threads;
         const int max_connections;
         const int memory_limit;
-        const size_t content_size_limit;
+        // Timeout the daemons are started with, the current one being part of the settings.
         const int connection_timeout;
-        const int per_IP_connection_limit;
-        log_access_ptr log_access;
-        log_error_ptr log_error;
         validator_ptr validator;
         unescaper_ptr unescaper;
         const struct sockaddr* bind_address;
@@ -166,7 +390,6 @@ class webserver
         const std::string digest_auth_random;
         const int nonce_nc_size;
         bool running;
-        const http::http_utils::policy_T default_policy;
         const bool basic_auth_enabled;
         const bool digest_auth_enabled;
         const bool regex_checking;
@@ -180,24 +403,78 @@ class webserver
         render_ptr not_found_resource;
         render_ptr method_not_allowed_resource;
         render_ptr internal_error_resource;
+        const size_t file_cache_size;
+        const int file_cache_ttl;
+        const bool compression_enabled;
+        const size_t compression_min_size;
+        const size_t compression_cache_size;
+        const double rate_limit_rate;
+        const unsigned int rate_limit_burst;
+        const size_t rate_limit_table_size;
+        render_ptr request_filter;
+        const request_tracer_ptr request_tracer;
+        const bool request_timing;
+        const int drain_timeout;
+        std::shared_ptr<details::config_cell> settings;
+        std::shared_ptr<details::daemon_reaper> retired;
+        // Serializes the replacements of the daemon.
+        mutable pthread_mutex_t daemon_lock;
+        std::shared_ptr<details::rate_limiter> limiter;
+        std::shared_ptr<details::abuse_tracker> abuse;
+        std::shared_ptr<details::credential_cache> credentials;
+        std::shared_ptr<details::file_cache> files;
+        std::shared_ptr<details::compression_cache> compressed;
+        std::shared_ptr<details::tls_manager> tls;
+        const digest_auth_password_ptr digest_auth_password_lookup;
+        std::shared_ptr<nonce_store> nonces;
+        std::string digest_auth_opaque;
+        std::shared_ptr<details::metrics_registry> metrics;
+        std::shared_ptr<http_resource> metrics_resource;
+        std::shared_ptr<details::access_logger> access_logger;
+        std::shared_ptr<details::error_logger> error_logger;
+        std::shared_ptr<details::message_limiter> error_limiter;
+        std::shared_ptr<details::connection_registry> connections;
+        std::shared_ptr<details::alloc_totals> allocations;
+        std::shared_ptr<details::handler_watchdog> watchdog;
         std::map<details::http_endpoint, http_resource*> registered_resources;
         std::map<std::string, http_resource*> registered_resources_str;
 
         int next_to_choose;
-        std::set<http::ip_representation> bans;
-        std::set<http::ip_representation> allowances;
+        details::shared_ip_filter bans;
+        details::shared_ip_filter allowances;
 
         struct MHD_Daemon* daemon;
 
+        bool halt(bool keep_listen_socket);
+        struct MHD_Daemon* start_daemon(MHD_socket listen_socket, const runtime_config& config);
+        bool reports_errors(const runtime_config& config) const;
+
         const std::shared_ptr<http_response> method_not_allowed_page(details::modded_request* mr) const;
         const std::shared_ptr<http_response> internal_error_page(details::modded_request* mr, bool force_our = false) const;
         const std::shared_ptr<http_response> not_found_page(details::modded_request* mr) const;
+        const std::shared_ptr<http_response> too_many_requests_page(unsigned int retry_after) const;
+        const std::shared_ptr<http_response> bad_request_page() const;
+        const std::shared_ptr<http_response> digest_auth_challenge(const std::string& realm, bool stale) const;
+
+        bool check_digest_auth(details::modded_request* mr, const std::string& realm, bool* stale) const;
+
+        bool rate_limit_allows(MHD_Connection* connection, const void* scope,
+                double rate, unsigned int burst, unsigned int* retry_after
+        );
+
+        bool is_auto_banned(MHD_Connection* connection) const;
+        void track_abuse(MHD_Connection* connection, const details::modded_request* mr);
 
         static void request_completed(void *cls,
                 struct MHD_Connection *connection, void **con_cls,
                 enum MHD_RequestTerminationCode toe
         );
 
+        static void connection_notified(void* cls,
+                MHD_Connection* connection, void** socket_context,
+                enum MHD_ConnectionNotificationCode toe
+        );
+
         static int answer_to_connection
         (
             void* cls, MHD_Connection* connection,
@@ -236,10 +513,22 @@ class webserver
             size_t* upload_data_size, struct details::modded_request* mr
         );
 
+        bool filter_request(MHD_Connection* connection, const char* method,
+                const char* version, struct details::modded_request* mr, int* to_ret
+        );
+        int send_answer(MHD_Connection* connection, struct details::modded_request* mr);
         int finalize_answer(MHD_Connection* connection,
                 struct details::modded_request* mr, const char* method
         );
 
+        MHD_Response* get_encoded_response(details::modded_request* mr,
+                std::string& content_encoding, int& served_code
+        );
+
+        void decorate_encoding(details::modded_request* mr,
+                MHD_Response* raw_response, const std::string& content_encoding
+        );
+
         int complete_request(MHD_Connection* connection,
                 struct details::modded_request* mr,
                 const char* version, const char* method
@@ -250,7 +539,7 @@ class webserver
         );
         friend void error_log(void* cls, const char* fmt, va_list ap);
         friend void access_log(webserver* cls, std::string uri);
-        friend void* uri_log(void* cls, const char* uri);
+        friend void* uri_log(void* cls, const char* uri, struct MHD_Connection* con);
         friend size_t unescaper_func(void * cls,
                 struct MHD_Connection *c, char *s
         );
@@ -0,0 +1,132 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include <errno.h>
+
+#if !defined(__MINGW32__) && !defined(__CYGWIN32__)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#include "socket_handoff.hpp"
+
+namespace httpserver
+{
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+
+bool send_listen_socket(int, MHD_socket)
+{
+    return false;
+}
+
+MHD_socket receive_listen_socket(int)
+{
+    return MHD_INVALID_SOCKET;
+}
+
+#else
+
+bool send_listen_socket(int channel, MHD_socket socket)
+{
+    if(socket == MHD_INVALID_SOCKET)
+        return false;
+
+    // At least one byte of data has to go along with the descriptor.
+    char tag = 'L';
+    struct iovec payload;
+    payload.iov_base = &tag;
+    payload.iov_len = 1;
+
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &socket, sizeof(int));
+
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(channel, &message, 0);
+    } while(sent < 0 && errno == EINTR);
+    return sent == 1;
+}
+
+MHD_socket receive_listen_socket(int channel)
+{
+    char tag;
+    struct iovec payload;
+    payload.iov_base = &tag;
+    payload.iov_len = 1;
+
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t received;
+    do
+    {
+        received = recvmsg(channel, &message, 0);
+    } while(received < 0 && errno == EINTR);
+    if(received != 1 || (message.msg_flags & MSG_CTRUNC))
+        return MHD_INVALID_SOCKET;
+
+    for(struct cmsghdr* header = CMSG_FIRSTHDR(&message); header != 0x0; header = CMSG_NXTHDR(&message, header))
+    {
+        if(header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS &&
+                header->cmsg_len == CMSG_LEN(sizeof(int)))
+        {
+            int socket;
+            memcpy(&socket, CMSG_DATA(header), sizeof(int));
+            return socket;
+        }
+    }
+    return MHD_INVALID_SOCKET;
+}
+
+#endif
+
+};
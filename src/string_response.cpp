@@ -19,6 +19,8 @@
 */
 
 #include "string_response.hpp"
+#include "http_request.hpp"
+#include "details/compressor.hpp"
 
 using namespace std;
 
@@ -35,4 +37,19 @@ MHD_Response* string_response::get_raw_response()
     );
 }
 
+MHD_Response* string_response::get_raw_response_encoded(const http_request& req, const std::string& encoding, int& status)
+{
+    if(content.size() < req.compression_min_size) return 0x0;
+
+    std::shared_ptr<const std::string> body = req.compressed != 0x0 ?
+        req.compressed->get(encoding, content) : details::compress(encoding, content);
+    if(!body) return 0x0;
+
+    return MHD_create_response_from_buffer(
+            body->size(),
+            (void*) body->data(),
+            MHD_RESPMEM_MUST_COPY
+    );
+}
+
 }
@@ -28,6 +28,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <time.h>
 #include <stdexcept>
 
 #if defined(__MINGW32__) || defined(__CYGWIN32__)
@@ -40,6 +41,7 @@
 #include <signal.h>
 #include <fcntl.h>
 #include <algorithm>
+#include <random>
 
 #include <microhttpd.h>
 
@@ -48,12 +50,20 @@
 #include "http_resource.hpp"
 #include "http_response.hpp"
 #include "string_response.hpp"
+#include "basic_auth_fail_response.hpp"
+#include "digest_auth_fail_response.hpp"
 #include "http_request.hpp"
 #include "details/http_endpoint.hpp"
 #include "string_utilities.hpp"
 #include "create_webserver.hpp"
 #include "webserver.hpp"
 #include "details/modded_request.hpp"
+#include "details/file_cache.hpp"
+#include "details/compressor.hpp"
+#include "details/tls_manager.hpp"
+#include "details/digest_auth.hpp"
+#include "details/metrics.hpp"
+#include "details/tracing.hpp"
 
 #define _REENTRANT 1
 
@@ -70,10 +80,55 @@ using namespace http;
 
 int policy_callback (void *, const struct sockaddr*, socklen_t);
 void error_log(void*, const char*, va_list);
-void* uri_log(void*, const char*);
+void* uri_log(void*, const char*, struct MHD_Connection*);
 void access_log(webserver*, string);
 size_t unescaper_func(void*, struct MHD_Connection*, char*);
 
+namespace
+{
+
+class metrics_resource : public http_resource
+{
+    public:
+        explicit metrics_resource(const std::shared_ptr<details::metrics_registry>& metrics):
+            metrics(metrics)
+        {
+            disallow_all();
+            set_allowing(http_utils::http_method_get, true);
+        }
+
+        const std::shared_ptr<http_response> render_GET(const http_request&)
+        {
+            return std::shared_ptr<http_response>(new string_response(metrics->render(),
+                        http_utils::http_ok, "text/plain; version=0.0.4"
+            ));
+        }
+
+    private:
+        std::shared_ptr<details::metrics_registry> metrics;
+};
+
+uint64_t monotonic_microseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+void mark_phase(details::modded_request* mr, request_timings::phase_T phase)
+{
+    if(mr->span != 0x0)
+        mr->span->timings.at[phase] = monotonic_microseconds();
+}
+
+void set_connection_state(details::modded_request* mr, connection_info::state_T state)
+{
+    if(mr->connection != 0x0)
+        mr->connection->set_state(state);
+}
+
+} //namespace
+
 struct compare_value
 {
     bool operator() (const std::pair<int, int>& left,
@@ -119,11 +174,7 @@ webserver::webserver(const create_webserver& params):
     max_threads(params._max_threads),
     max_connections(params._max_connections),
     memory_limit(params._memory_limit),
-    content_size_limit(params._content_size_limit),
     connection_timeout(params._connection_timeout),
-    per_IP_connection_limit(params._per_IP_connection_limit),
-    log_access(params._log_access),
-    log_error(params._log_error),
     validator(params._validator),
     unescaper(params._unescaper),
     bind_address(params._bind_address),
@@ -141,7 +192,6 @@ webserver::webserver(const create_webserver& params):
     digest_auth_random(params._digest_auth_random),
     nonce_nc_size(params._nonce_nc_size),
     running(false),
-    default_policy(params._default_policy),
     basic_auth_enabled(params._basic_auth_enabled),
     digest_auth_enabled(params._digest_auth_enabled),
     regex_checking(params._regex_checking),
@@ -152,12 +202,129 @@ webserver::webserver(const create_webserver& params):
     not_found_resource(params._not_found_resource),
     method_not_allowed_resource(params._method_not_allowed_resource),
     internal_error_resource(params._internal_error_resource),
+    file_cache_size(params._file_cache_size),
+    file_cache_ttl(params._file_cache_ttl),
+    compression_enabled(params._compression_enabled),
+    compression_min_size(params._compression_min_size),
+    compression_cache_size(params._compression_cache_size),
+    rate_limit_rate(params._rate_limit_rate),
+    rate_limit_burst(params._rate_limit_burst),
+    rate_limit_table_size(params._rate_limit_table_size),
+    request_filter(params._request_filter),
+    request_tracer(params._request_tracer),
+    request_timing(params._request_timing || params._request_tracer != 0x0),
+    drain_timeout(params._drain_timeout),
+    limiter(new details::rate_limiter(params._rate_limit_table_size)),
+    digest_auth_password_lookup(params._digest_auth_password_lookup),
+    nonces(params._digest_auth_nonce_store),
     next_to_choose(0)
 {
+    runtime_config config;
+    config.connection_timeout = params._connection_timeout;
+    config.per_IP_connection_limit = params._per_IP_connection_limit;
+    config.content_size_limit = params._content_size_limit;
+    config.default_policy = params._default_policy;
+    config.log_access = params._log_access;
+    config.log_error = params._log_error;
+    settings.reset(new details::config_cell(config));
+    retired.reset(new details::daemon_reaper());
+    if(use_ssl)
+    {
+        tls.reset(new details::tls_manager(
+                https_mem_key, https_mem_cert, https_mem_trust,
+                params._https_ocsp_response,
+                params._https_session_tickets,
+                params._https_session_ticket_key,
+                params._https_session_ticket_rotation,
+                params._https_session_cache_size
+        ));
+        std::map<std::string, std::pair<std::string, std::string> >::const_iterator it;
+        for(it = params._https_sni_certificates.begin(); it != params._https_sni_certificates.end(); ++it)
+            tls->add_certificate(it->first, it->second.first, it->second.second, "");
+    }
     ignore_sigpipe();
     pthread_mutex_init(&mutexwait, NULL);
     pthread_rwlock_init(&runguard, NULL);
     pthread_cond_init(&mutexcond, NULL);
+    pthread_mutex_init(&daemon_lock, NULL);
+    if(file_cache_size != 0)
+        files.reset(new details::file_cache(file_cache_size, file_cache_ttl));
+    if(compression_enabled && compression_cache_size != 0)
+        compressed.reset(new details::compression_cache(compression_cache_size));
+    unsigned int auto_ban_thresholds[details::abuse_tracker::CATEGORIES];
+    auto_ban_thresholds[details::abuse_tracker::AUTH_FAILURE] = params._auto_ban_auth_failures;
+    auto_ban_thresholds[details::abuse_tracker::NOT_FOUND] = params._auto_ban_not_found;
+    auto_ban_thresholds[details::abuse_tracker::BAD_REQUEST] = params._auto_ban_bad_requests;
+    details::abuse_tracker* tracker = new details::abuse_tracker(
+            auto_ban_thresholds, params._auto_ban_window, params._auto_ban_duration
+    );
+    if(tracker->is_enabled())
+        abuse.reset(tracker);
+    else
+        delete tracker;
+    if(nonces == 0x0)
+    {
+        nonces.reset(new details::sharded_nonce_store(
+                params._digest_auth_nonce_table_size,
+                params._digest_auth_nonce_timeout
+        ));
+    }
+    std::random_device random;
+    for(int i = 0; i < 4; i++)
+        digest_auth_opaque += std::to_string(random());
+    digest_auth_opaque = details::sha256_hex(digest_auth_opaque);
+    if(params._basic_auth_verifier != 0x0)
+    {
+        credentials.reset(new details::credential_cache(
+                params._basic_auth_verifier,
+                params._basic_auth_cache_size,
+                params._basic_auth_cache_ttl
+        ));
+    }
+    if(params._metrics)
+        metrics.reset(new details::metrics_registry(params._metrics_max_series));
+    if(params._connection_tracking)
+        connections.reset(new details::connection_registry());
+    if(details::alloc_accounting_enabled())
+        allocations.reset(new details::alloc_totals());
+    if(params._handler_watchdog != 0x0)
+    {
+        // By default, one slot per thread able to run handlers at once.
+        size_t slots = params._handler_watchdog_slots;
+        if(slots == 0 && start_method == http_utils::THREAD_PER_CONNECTION)
+            slots = max_connections > 0 ? max_connections : 256;
+        else if(slots == 0)
+            slots = max_threads > 0 ? max_threads : 1;
+        watchdog.reset(new details::handler_watchdog(
+                params._handler_watchdog,
+                params._handler_watchdog_threshold,
+                slots,
+                params._handler_watchdog_stack_signal
+        ));
+    }
+    if(params._access_log_sink != 0x0)
+    {
+        access_logger.reset(new details::access_logger(
+                params._access_log_sink,
+                params._access_log_ring_size,
+                params._access_log_flush_interval
+        ));
+    }
+    if(params._error_log_sink != 0x0)
+    {
+        error_logger.reset(new details::error_logger(
+                params._error_log_sink,
+                params._access_log_ring_size,
+                params._access_log_flush_interval
+        ));
+    }
+    // The error logging callback can be set while the server runs.
+    error_limiter.reset(new details::message_limiter(params._error_log_burst, params._error_log_window));
+    if(params._metrics_endpoint != "")
+    {
+        metrics_resource.reset(new httpserver::metrics_resource(metrics));
+        register_resource(params._metrics_endpoint, metrics_resource.get());
+    }
 }
 
 webserver::~webserver()
@@ -166,6 +333,7 @@ webserver::~webserver()
     pthread_mutex_destroy(&mutexwait);
     pthread_rwlock_destroy(&runguard);
     pthread_cond_destroy(&mutexcond);
+    pthread_mutex_destroy(&daemon_lock);
 }
 
 void webserver::sweet_kill()
@@ -183,6 +351,28 @@ void webserver::request_completed (
     details::modded_request* mr = static_cast<details::modded_request*>(*con_cls);
     if (mr == 0x0) return;
 
+    webserver* dws = static_cast<webserver*>(cls);
+    set_connection_state(mr, connection_info::IDLE);
+    {
+        details::alloc_scope scope(mr->allocs);
+        if(mr->span != 0x0)
+        {
+            mark_phase(mr, request_timings::COMPLETED);
+            mr->span->completed = toe == MHD_REQUEST_TERMINATED_COMPLETED_OK;
+            if(dws->request_tracer != 0x0)
+                dws->request_tracer(*mr->span);
+        }
+        if(mr->access != 0x0 && dws->access_logger != 0x0)
+        {
+            mr->access->latency = monotonic_microseconds() - mr->started;
+            mr->access->completed = toe == MHD_REQUEST_TERMINATED_COMPLETED_OK;
+            clock_gettime(CLOCK_REALTIME, &mr->access->time);
+            dws->access_logger->log(*mr->access);
+        }
+    }
+    if(dws->allocations != 0x0)
+        dws->allocations->record(mr->allocs);
+
     delete mr;
     mr = 0x0;
 }
@@ -210,7 +400,7 @@ bool webserver::register_resource(const std::string& resource, http_resource* hr
     return result.second;
 }
 
-bool webserver::start(bool blocking)
+struct MHD_Daemon* webserver::start_daemon(MHD_socket listen_socket, const runtime_config& config)
 {
 
     struct {
@@ -228,7 +418,7 @@ bool webserver::start(bool blocking)
 
     iov.push_back(gen(MHD_OPTION_NOTIFY_COMPLETED,
                 (intptr_t) &request_completed,
-                NULL
+                this
     ));
     iov.push_back(gen(MHD_OPTION_URI_LOG_CALLBACK, (intptr_t) &uri_log, this));
     iov.push_back(gen(MHD_OPTION_EXTERNAL_LOGGER, (intptr_t) &error_log, this));
@@ -237,12 +427,8 @@ bool webserver::start(bool blocking)
                 this)
     );
     iov.push_back(gen(MHD_OPTION_CONNECTION_TIMEOUT, connection_timeout));
-    if(bind_socket != 0)
-        iov.push_back(gen(MHD_OPTION_LISTEN_SOCKET, bind_socket));
-    if(start_method == http_utils::THREAD_PER_CONNECTION && (max_threads != 0 || max_thread_stack_size != 0))
-    {
-        throw std::invalid_argument("Cannot specify maximum number of threads when using a thread per connection");
-    }
+    if(listen_socket != 0)
+        iov.push_back(gen(MHD_OPTION_LISTEN_SOCKET, listen_socket));
 
     if(max_threads != 0)
         iov.push_back(gen(MHD_OPTION_THREAD_POOL_SIZE, max_threads));
@@ -250,24 +436,32 @@ bool webserver::start(bool blocking)
         iov.push_back(gen(MHD_OPTION_CONNECTION_LIMIT, max_connections));
     if(memory_limit != 0)
         iov.push_back(gen(MHD_OPTION_CONNECTION_MEMORY_LIMIT, memory_limit));
-    if(per_IP_connection_limit != 0)
+    if(config.per_IP_connection_limit != 0)
         iov.push_back(gen(MHD_OPTION_PER_IP_CONNECTION_LIMIT,
-                    per_IP_connection_limit)
+                    config.per_IP_connection_limit)
         );
     if(max_thread_stack_size != 0)
         iov.push_back(gen(MHD_OPTION_THREAD_STACK_SIZE, max_thread_stack_size));
     if(nonce_nc_size != 0)
         iov.push_back(gen(MHD_OPTION_NONCE_NC_SIZE, nonce_nc_size));
-    if(use_ssl)
+    // A server only using per-hostname certificates has no key for the daemon.
+    bool sni_only = use_ssl && https_mem_key == "" && https_mem_cert == "" && tls != 0x0 &&
+        tls->get_certificate_callback() != 0x0;
+    if(use_ssl && !sni_only)
         iov.push_back(gen(MHD_OPTION_HTTPS_MEM_KEY,
                     0,
                     (void*)https_mem_key.c_str())
         );
-    if(use_ssl)
+    if(use_ssl && !sni_only)
         iov.push_back(gen(MHD_OPTION_HTTPS_MEM_CERT,
                     0,
                     (void*)https_mem_cert.c_str())
         );
+    if(sni_only)
+        iov.push_back(gen(MHD_OPTION_HTTPS_CERT_CALLBACK,
+                    0,
+                    tls->get_certificate_callback())
+        );
     if(https_mem_trust != "" && use_ssl)
         iov.push_back(gen(MHD_OPTION_HTTPS_MEM_TRUST,
                     0,
@@ -287,6 +481,11 @@ bool webserver::start(bool blocking)
     if(cred_type != http_utils::NONE)
         iov.push_back(gen(MHD_OPTION_HTTPS_CRED_TYPE, cred_type));
 #endif //HAVE_GNUTLS
+    // Also applies the current connection timeout to the new connections.
+    iov.push_back(gen(MHD_OPTION_NOTIFY_CONNECTION,
+                (intptr_t) &connection_notified,
+                this)
+    );
 
     iov.push_back(gen(MHD_OPTION_END, 0, NULL ));
 
@@ -295,8 +494,12 @@ bool webserver::start(bool blocking)
         start_conf |= MHD_USE_SSL;
     if(use_ipv6)
         start_conf |= MHD_USE_IPv6;
-    if(debug)
+    // libmicrohttpd only reports its errors in debug mode.
+    if(reports_errors(config))
         start_conf |= MHD_USE_DEBUG;
+    // Needed to quiesce the daemon when it is replaced.
+    if(start_method != http_utils::EXTERNAL_SELECT)
+        start_conf |= MHD_USE_PIPE_FOR_SHUTDOWN;
     if(pedantic)
         start_conf |= MHD_USE_PEDANTIC_CHECKS;
     if(deferred_enabled)
@@ -306,16 +509,16 @@ bool webserver::start(bool blocking)
     start_conf |= MHD_USE_TCP_FASTOPEN;
 #endif
 
-    this->daemon = NULL;
+    struct MHD_Daemon* started = NULL;
     if(bind_address == 0x0) {
-        this->daemon = MHD_start_daemon
+        started = MHD_start_daemon
         (
                 start_conf, this->port, &policy_callback, this,
                 &answer_to_connection, this, MHD_OPTION_ARRAY,
                 &iov[0], MHD_OPTION_END
         );
     } else {
-        this->daemon = MHD_start_daemon
+        started = MHD_start_daemon
         (
                 start_conf, 1, &policy_callback, this,
                 &answer_to_connection, this, MHD_OPTION_ARRAY,
@@ -323,15 +526,48 @@ bool webserver::start(bool blocking)
         );
     }
 
+    return started;
+}
+
+bool webserver::reports_errors(const runtime_config& config) const
+{
+    return debug || error_logger != 0x0 || config.log_error != 0x0;
+}
+
+bool webserver::start(bool blocking)
+{
+    if(start_method == http_utils::THREAD_PER_CONNECTION && (max_threads != 0 || max_thread_stack_size != 0))
+    {
+        throw std::invalid_argument("Cannot specify maximum number of threads when using a thread per connection");
+    }
+    if(start_method == http_utils::EXTERNAL_SELECT && (max_threads != 0 || max_thread_stack_size != 0))
+    {
+        throw std::invalid_argument("Cannot specify threading options when using an external event loop");
+    }
+    if(start_method == http_utils::EXTERNAL_SELECT && blocking)
+    {
+        throw std::invalid_argument("Cannot start in blocking mode when using an external event loop");
+    }
+
+    this->daemon = start_daemon(bind_socket, settings->load());
+
     if(this->daemon == NULL)
     {
         throw std::invalid_argument("Unable to connect daemon to port: " + this->port);
     }
+    retired->serve(this->daemon);
 
     bool value_onclose = false;
 
     this->running = true;
 
+    if(access_logger != 0x0)
+        access_logger->start();
+    if(error_logger != 0x0)
+        error_logger->start();
+    if(watchdog != 0x0)
+        watchdog->start();
+
     if(blocking)
     {
         pthread_mutex_lock(&mutexwait);
@@ -348,7 +584,65 @@ bool webserver::is_running()
     return this->running;
 }
 
+bool webserver::get_fdset(fd_set* read_fd_set, fd_set* write_fd_set,
+        fd_set* except_fd_set, MHD_socket* max_fd
+)
+{
+    if(!this->running) return false;
+
+    return MHD_get_fdset2(this->daemon, read_fd_set, write_fd_set,
+            except_fd_set, max_fd, FD_SETSIZE) == MHD_YES;
+}
+
+int webserver::get_epoll_fd()
+{
+#ifdef ENABLE_EPOLL
+    if(!this->running) return -1;
+
+    const union MHD_DaemonInfo* info = MHD_get_daemon_info(
+            this->daemon,
+            MHD_DAEMON_INFO_EPOLL_FD
+    );
+    return info == 0x0 ? -1 : info->epoll_fd;
+#else
+    return -1;
+#endif
+}
+
+bool webserver::get_timeout(unsigned long long* timeout)
+{
+    if(!this->running) return false;
+
+    MHD_UNSIGNED_LONG_LONG mhd_timeout;
+    if(MHD_get_timeout(this->daemon, &mhd_timeout) != MHD_YES) return false;
+
+    *timeout = mhd_timeout;
+    return true;
+}
+
+bool webserver::run_once()
+{
+    if(!this->running) return false;
+
+    return MHD_run(this->daemon) == MHD_YES;
+}
+
+bool webserver::run_from_select(const fd_set* read_fd_set,
+        const fd_set* write_fd_set, const fd_set* except_fd_set
+)
+{
+    if(!this->running) return false;
+
+    return MHD_run_from_select(this->daemon, read_fd_set, write_fd_set,
+            except_fd_set) == MHD_YES;
+}
+
 bool webserver::stop()
+{
+    return halt(false);
+}
+
+bool webserver::halt(bool keep_listen_socket)
 {
     if(!this->running) return false;
 
@@ -357,13 +651,95 @@ bool webserver::stop()
     pthread_cond_signal(&mutexcond);
     pthread_mutex_unlock(&mutexwait);
 
+    pthread_mutex_lock(&daemon_lock);
+    retired->serve(0x0);
     MHD_stop_daemon(this->daemon);
+    retired->stop();
+    pthread_mutex_unlock(&daemon_lock);
+
+    if(!keep_listen_socket)
+        shutdown(bind_socket, 2);
 
-    shutdown(bind_socket, 2);
+    // Delivers the records of the requests completed before the daemon stopped.
+    if(access_logger != 0x0)
+        access_logger->stop();
+    if(error_logger != 0x0)
+        error_logger->stop();
+    if(watchdog != 0x0)
+        watchdog->stop();
 
     return true;
 }
 
+bool webserver::drain(int timeout)
+{
+    if(timeout < 0)
+        throw std::invalid_argument("The drain timeout cannot be negative");
+    if(start_method == http_utils::EXTERNAL_SELECT)
+        throw std::invalid_argument("Cannot drain a server using an external event loop");
+
+    pthread_mutex_lock(&daemon_lock);
+    if(!this->running)
+    {
+        pthread_mutex_unlock(&daemon_lock);
+        return false;
+    }
+    retired->serve(0x0);
+    MHD_socket listen_socket = MHD_quiesce_daemon(this->daemon);
+    pthread_mutex_unlock(&daemon_lock);
+    // A socket given by the application stays open: another process may be accepting on it.
+    if(listen_socket != MHD_INVALID_SOCKET && listen_socket != bind_socket)
+    {
+#ifdef _WINDOWS
+        closesocket(listen_socket);
+#else
+        close(listen_socket);
+#endif
+    }
+
+    bool drained = false;
+    uint64_t deadline = monotonic_microseconds() + static_cast<uint64_t>(timeout) * 1000;
+    while(!drained && this->running && monotonic_microseconds() < deadline)
+    {
+        pthread_mutex_lock(&daemon_lock);
+        const union MHD_DaemonInfo* info = this->running ?
+            MHD_get_daemon_info(this->daemon, MHD_DAEMON_INFO_CURRENT_CONNECTIONS) : 0x0;
+        drained = info != 0x0 && info->num_connections == 0 && retired->size() == 0;
+        pthread_mutex_unlock(&daemon_lock);
+        if(drained)
+            break;
+
+        // Keep-alive connections waiting for a request would otherwise hold the drain until they time out.
+        if(connections != 0x0)
+        {
+            std::vector<connection_info> open = connections->snapshot();
+            for(std::vector<connection_info>::const_iterator it = open.begin(); it != open.end(); ++it)
+            {
+                if(it->state == connection_info::IDLE)
+                    connections->close(it->id);
+            }
+        }
+        usleep(10000);
+    }
+
+    halt(true);
+    return drained;
+}
+
+MHD_socket webserver::get_listen_socket() const
+{
+    MHD_socket listen_socket = MHD_INVALID_SOCKET;
+    pthread_mutex_lock(&daemon_lock);
+    if(this->running)
+    {
+        const union MHD_DaemonInfo* info = MHD_get_daemon_info(this->daemon, MHD_DAEMON_INFO_LISTEN_FD);
+        if(info != 0x0)
+            listen_socket = info->listen_fd;
+    }
+    pthread_mutex_unlock(&daemon_lock);
+    return listen_socket;
+}
+
 void webserver::unregister_resource(const string& resource)
 {
     details::http_endpoint he(resource);
@@ -374,28 +750,12 @@ void webserver::unregister_resource(const string& resource)
 
 void webserver::ban_ip(const string& ip)
 {
-    ip_representation t_ip(ip);
-    set<ip_representation>::iterator it = this->bans.find(t_ip);
-    if(it != this->bans.end() && (t_ip.weight() < (*it).weight()))
-    {
-        this->bans.erase(it);
-        this->bans.insert(t_ip);
-    }
-    else
-        this->bans.insert(t_ip);
+    this->bans.insert(ip);
 }
 
 void webserver::allow_ip(const string& ip)
 {
-    ip_representation t_ip(ip);
-    set<ip_representation>::iterator it = this->allowances.find(t_ip);
-    if(it != this->allowances.end() && (t_ip.weight() < (*it).weight()))
-    {
-        this->allowances.erase(it);
-        this->allowances.insert(t_ip);
-    }
-    else
-        this->allowances.insert(t_ip);
+    this->allowances.insert(ip);
 }
 
 void webserver::unban_ip(const string& ip)
@@ -408,42 +768,116 @@ void webserver::disallow_ip(const string& ip)
     this->allowances.erase(ip);
 }
 
+void webserver::set_bans(const vector<string>& ips)
+{
+    this->bans.assign(ips);
+}
+
+void webserver::set_allowances(const vector<string>& ips)
+{
+    this->allowances.assign(ips);
+}
+
+void webserver::load_bans(const string& path)
+{
+    this->bans.load(path);
+}
+
+void webserver::load_allowances(const string& path)
+{
+    this->allowances.load(path);
+}
+
 int policy_callback (void *cls, const struct sockaddr* addr, socklen_t addrlen)
 {
     if(!(static_cast<webserver*>(cls))->ban_system_enabled) return MHD_YES;
 
-    if((((static_cast<webserver*>(cls))->default_policy == http_utils::ACCEPT) &&
-       ((static_cast<webserver*>(cls))->bans.count(addr)) &&
-       (!(static_cast<webserver*>(cls))->allowances.count(addr))
+    const http_utils::policy_T default_policy = (static_cast<webserver*>(cls))->settings->load().default_policy;
+
+    bool banned = (static_cast<webserver*>(cls))->bans.contains(addr) ||
+        ((static_cast<webserver*>(cls))->abuse != 0x0 &&
+         (static_cast<webserver*>(cls))->abuse->is_banned(details::rate_limiter::make_key(0x0, addr)));
+
+    if(((default_policy == http_utils::ACCEPT) &&
+       banned &&
+       (!(static_cast<webserver*>(cls))->allowances.contains(addr))
     ) ||
-    (((static_cast<webserver*>(cls))->default_policy == http_utils::REJECT)
-       && ((!(static_cast<webserver*>(cls))->allowances.count(addr)) ||
-       ((static_cast<webserver*>(cls))->bans.count(addr)))
+    ((default_policy == http_utils::REJECT)
+       && ((!(static_cast<webserver*>(cls))->allowances.contains(addr)) || banned)
     ))
     {
+        if((static_cast<webserver*>(cls))->metrics != 0x0)
+            (static_cast<webserver*>(cls))->metrics->connection_rejected();
         return MHD_NO;
     }
 
     return MHD_YES;
 }
 
-void* uri_log(void* cls, const char* uri)
+void* uri_log(void* cls, const char* uri, struct MHD_Connection* con)
 {
+    details::alloc_counters before = details::thread_alloc_counters();
     struct details::modded_request* mr = new details::modded_request();
     mr->complete_uri = new string(uri);
     mr->second = false;
+    webserver* dws = static_cast<webserver*>(cls);
+    if(dws->access_logger != 0x0 || dws->request_timing)
+        mr->started = monotonic_microseconds();
+    if(dws->request_timing)
+    {
+        mr->span = new request_span();
+        mr->span->timings.at[request_timings::RECEIVED] = mr->started;
+    }
+    if(dws->connections != 0x0)
+    {
+        const MHD_ConnectionInfo* conninfo = MHD_get_connection_info(
+                con,
+                MHD_CONNECTION_INFO_SOCKET_CONTEXT
+        );
+        if(conninfo != 0x0 && conninfo->socket_context != 0x0)
+        {
+            mr->connection = static_cast<details::connection_entry*>(conninfo->socket_context);
+            mr->connection->requests.fetch_add(1, std::memory_order_relaxed);
+            mr->connection->set_state(connection_info::READING_HEADERS);
+        }
+    }
+    details::alloc_counters after = details::thread_alloc_counters();
+    mr->allocs.allocations = after.allocations - before.allocations;
+    mr->allocs.bytes = after.bytes - before.bytes;
     return ((void*)mr);
 }
 
 void error_log(void* cls, const char* fmt, va_list ap)
 {
     webserver* dws = static_cast<webserver*>(cls);
-    if(dws->log_error != 0x0) dws->log_error(fmt);
+    log_error_ptr log_error = dws->settings->load().log_error;
+    if(log_error == 0x0 && dws->error_logger == 0x0)
+        return;
+
+    // Suppressed messages cost a format and a hash, without allocating.
+    size_t length;
+    const char* message = details::format_error(fmt, ap, length);
+    unsigned long long suppressed;
+    if(!dws->error_limiter->allow(message, length, monotonic_microseconds(), suppressed))
+        return;
+
+    if(log_error != 0x0)
+        log_error(std::string(message, length));
+    if(dws->error_logger != 0x0)
+    {
+        static thread_local error_record record;
+        clock_gettime(CLOCK_REALTIME, &record.time);
+        details::classify_error(fmt, record.severity, record.category);
+        record.message.assign(message, length);
+        record.suppressed = suppressed;
+        dws->error_logger->log(record);
+    }
 }
 
 void access_log(webserver* dws, string uri)
 {
-    if(dws->log_access != 0x0) dws->log_access(uri);
+    log_access_ptr log_access = dws->settings->load().log_access;
+    if(log_access != 0x0) log_access(uri);
 }
 
 size_t unescaper_func(void * cls, struct MHD_Connection *c, char *s)
@@ -485,6 +919,346 @@ const std::shared_ptr<http_response> webserver::not_found_page(details::modded_r
     }
 }
 
+const std::shared_ptr<http_response> webserver::bad_request_page() const
+{
+    return std::shared_ptr<http_response>(new string_response(BAD_REQUEST_ERROR, http_utils::http_bad_request));
+}
+
+const std::shared_ptr<http_response> webserver::too_many_requests_page(unsigned int retry_after) const
+{
+    std::shared_ptr<http_response> res(new string_response(TOO_MANY_REQUESTS_ERROR, http_utils::http_too_many_requests));
+    res->with_header(http_utils::http_header_retry_after, std::to_string(retry_after));
+    return res;
+}
+
+bool webserver::rate_limit_allows(MHD_Connection* connection, const void* scope,
+        double rate, unsigned int burst, unsigned int* retry_after
+)
+{
+    if(rate <= 0 || burst == 0)
+        return true;
+
+    const MHD_ConnectionInfo* conninfo = MHD_get_connection_info(
+            connection,
+            MHD_CONNECTION_INFO_CLIENT_ADDRESS
+    );
+    if(conninfo == 0x0 || conninfo->client_addr == 0x0)
+        return true;
+
+    return limiter->consume(
+            details::rate_limiter::make_key(scope, conninfo->client_addr),
+            rate, burst, retry_after
+    );
+}
+
+rate_limit_stats webserver::get_rate_limit_stats() const
+{
+    return limiter->get_stats();
+}
+
+bool webserver::is_auto_banned(MHD_Connection* connection) const
+{
+    const MHD_ConnectionInfo* conninfo = MHD_get_connection_info(
+            connection,
+            MHD_CONNECTION_INFO_CLIENT_ADDRESS
+    );
+    if(conninfo == 0x0 || conninfo->client_addr == 0x0)
+        return false;
+
+    if(!abuse->is_banned(details::rate_limiter::make_key(0x0, conninfo->client_addr)))
+        return false;
+
+    return settings->load().default_policy == http_utils::REJECT || !allowances.contains(conninfo->client_addr);
+}
+
+void webserver::track_abuse(MHD_Connection* connection, const details::modded_request* mr)
+{
+    const http_response* response = mr->dhrs.get();
+    int response_code = response->get_response_code();
+    details::abuse_tracker::category_T category;
+    // Authentication failure responses are sent as 401 by libmicrohttpd whatever their code.
+    const digest_auth_fail_response* digest_fail = dynamic_cast<const digest_auth_fail_response*>(response);
+    if(response_code == http_utils::http_unauthorized || digest_fail != 0x0 ||
+            dynamic_cast<const basic_auth_fail_response*>(response) != 0x0)
+    {
+        // Challenges are part of the handshake: only credentials presented and rejected count,
+        // and a valid digest on an expired nonce is renewed rather than rejected.
+        if(mr->stale_nonce || (digest_fail != 0x0 && digest_fail->reload_nonce) ||
+                mr->dhr->get_header(http_utils::http_header_authorization).empty())
+            return;
+        category = details::abuse_tracker::AUTH_FAILURE;
+    }
+    else if(response_code == http_utils::http_not_found)
+        category = details::abuse_tracker::NOT_FOUND;
+    else if(response_code == http_utils::http_bad_request)
+        category = details::abuse_tracker::BAD_REQUEST;
+    else
+        return;
+
+    const MHD_ConnectionInfo* conninfo = MHD_get_connection_info(
+            connection,
+            MHD_CONNECTION_INFO_CLIENT_ADDRESS
+    );
+    if(conninfo == 0x0 || conninfo->client_addr == 0x0)
+        return;
+
+    abuse->record(category, details::rate_limiter::make_key(0x0, conninfo->client_addr));
+}
+
+size_t webserver::get_auto_banned_count() const
+{
+    return abuse != 0x0 ? abuse->banned_count() : 0;
+}
+
+bool webserver::check_digest_auth(details::modded_request* mr, const std::string& realm, bool* stale) const
+{
+    *stale = false;
+    details::digest_credentials credentials;
+    if(digest_auth_password_lookup == 0x0 ||
+            !details::parse_digest_authorization(mr->dhr->get_header(http_utils::http_header_authorization), credentials))
+        return false;
+
+    // Only qop=auth is offered, which also makes the nonce count mandatory.
+    if(credentials.realm != realm || credentials.opaque != digest_auth_opaque ||
+            credentials.qop != "auth" || credentials.nc.size() != 8 || credentials.cnonce.empty())
+        return false;
+
+    // The digest covers the request-target as sent, query string included (RFC 7616, section 3.4).
+    if(credentials.uri != *mr->complete_uri)
+        return false;
+
+    char* end = 0x0;
+    uint64_t nc = strtoull(credentials.nc.c_str(), &end, 16);
+    if(*end != '\0')
+        return false;
+
+    std::string password;
+    if(!digest_auth_password_lookup(credentials.username, realm, password))
+        return false;
+
+    std::string expected = details::digest_response(credentials, credentials.algorithm, password, mr->dhr->get_method());
+    if(expected.empty() || !details::equal_digests(expected, string_utilities::to_lower_copy(credentials.response)))
+        return false;
+
+    // The nonce is consumed only once the response is proven valid so that guesses cannot burn nonce counts.
+    nonce_store::status_T status = nonces->check(credentials.nonce, nc);
+    *stale = status == nonce_store::STALE;
+    return status == nonce_store::VALID;
+}
+
+const std::shared_ptr<http_response> webserver::digest_auth_challenge(const std::string& realm, bool stale) const
+{
+    std::shared_ptr<http_response> res(new string_response(UNAUTHORIZED_ERROR, http_utils::http_unauthorized));
+    res->with_header(http_utils::http_header_www_authenticate,
+            details::digest_challenge(realm, nonces->issue(), digest_auth_opaque, stale)
+    );
+    return res;
+}
+
+nonce_stats webserver::get_nonce_stats() const
+{
+    return nonces->get_stats();
+}
+
+std::string webserver::get_metrics() const
+{
+    return metrics != 0x0 ? metrics->render() : "";
+}
+
+unsigned long long webserver::get_dropped_access_records() const
+{
+    return access_logger != 0x0 ? access_logger->dropped() : 0;
+}
+
+runtime_config webserver::get_runtime_config() const
+{
+    return settings->load();
+}
+
+void webserver::update_runtime_config(const runtime_config& config)
+{
+    if(config.connection_timeout < 0 || config.per_IP_connection_limit < 0)
+        throw std::invalid_argument("The connection timeout and the connection limit per address cannot be negative");
+
+    pthread_mutex_lock(&daemon_lock);
+    runtime_config previous = settings->load();
+    // A draining server no longer accepts connections: the new settings only apply to the ones it has.
+    bool handover = running && retired->serving(this->daemon) &&
+            (config.per_IP_connection_limit != previous.per_IP_connection_limit ||
+            reports_errors(config) != reports_errors(previous));
+    if(!handover)
+    {
+        settings->store(config);
+        pthread_mutex_unlock(&daemon_lock);
+        return;
+    }
+    if(start_method == http_utils::EXTERNAL_SELECT)
+    {
+        pthread_mutex_unlock(&daemon_lock);
+        throw std::invalid_argument("Cannot replace the daemon of a server using an external event loop");
+    }
+
+    // The new daemon accepts on the listen socket before the previous one stops, so no connection is refused.
+    const union MHD_DaemonInfo* info = MHD_get_daemon_info(this->daemon, MHD_DAEMON_INFO_LISTEN_FD);
+    struct MHD_Daemon* replacement = info != 0x0 ? start_daemon(info->listen_fd, config) : 0x0;
+    if(replacement == 0x0)
+    {
+        pthread_mutex_unlock(&daemon_lock);
+        throw std::invalid_argument("Unable to start a daemon with the new settings");
+    }
+    settings->store(config);
+    MHD_quiesce_daemon(this->daemon);
+    retired->retire(this->daemon, drain_timeout);
+    retired->serve(replacement);
+    this->daemon = replacement;
+    pthread_mutex_unlock(&daemon_lock);
+}
+
+unsigned long long webserver::get_suppressed_errors() const
+{
+    return error_limiter != 0x0 ? error_limiter->suppressed() : 0;
+}
+
+unsigned long long webserver::get_dropped_error_records() const
+{
+    return error_logger != 0x0 ? error_logger->dropped() : 0;
+}
+
+std::vector<connection_info> webserver::get_connections() const
+{
+    return connections != 0x0 ? connections->snapshot() : std::vector<connection_info>();
+}
+
+bool webserver::close_connection(uint64_t id)
+{
+    return connections != 0x0 && connections->close(id);
+}
+
+alloc_stats webserver::get_alloc_stats() const
+{
+    if(allocations != 0x0)
+        return allocations->get();
+    alloc_stats none = { false, 0, 0, 0 };
+    return none;
+}
+
+void webserver::clear_basic_auth_cache()
+{
+    if(credentials != 0x0)
+        credentials->clear();
+}
+
+void webserver::reload_https_credentials(const std::string& key_path,
+        const std::string& cert_path, const std::string& ocsp_path
+)
+{
+    if(tls == 0x0)
+        throw std::invalid_argument("The webserver is not using TLS");
+
+    tls->reload(http::load_file(key_path), http::load_file(cert_path),
+            ocsp_path != "" ? http::load_file(ocsp_path) : ""
+    );
+}
+
+void webserver::add_https_certificate(const std::string& hostname,
+        const std::string& key_path, const std::string& cert_path,
+        const std::string& ocsp_path
+)
+{
+    if(tls == 0x0)
+        throw std::invalid_argument("The webserver is not using TLS");
+
+    tls->add_certificate(hostname, http::load_file(key_path), http::load_file(cert_path),
+            ocsp_path != "" ? http::load_file(ocsp_path) : ""
+    );
+}
+
+bool webserver::remove_https_certificate(const std::string& hostname)
+{
+    return tls != 0x0 && tls->remove_certificate(hostname);
+}
+
+void webserver::set_https_session_ticket_key(const std::string& path)
+{
+    if(tls == 0x0)
+        throw std::invalid_argument("The webserver is not using TLS");
+
+    tls->set_ticket_key(http::load_file(path));
+}
+
+tls_stats webserver::get_tls_stats() const
+{
+    if(tls != 0x0)
+        return tls->get_stats();
+
+    tls_stats stats = { 0, 0, 0, 0 };
+    return stats;
+}
+
+void webserver::connection_notified(void* cls, MHD_Connection* connection,
+        void** socket_context, enum MHD_ConnectionNotificationCode toe
+)
+{
+    webserver* dws = static_cast<webserver*>(cls);
+    if(toe == MHD_CONNECTION_NOTIFY_STARTED)
+    {
+        int timeout = dws->settings->load().connection_timeout;
+        if(timeout != dws->connection_timeout)
+            MHD_set_connection_option(connection, MHD_CONNECTION_OPTION_TIMEOUT, static_cast<unsigned int>(timeout));
+        if(dws->metrics != 0x0)
+            dws->metrics->connection_opened();
+        // With tracked connections, the socket context is their entry and holds the TLS context.
+        void** tls_context = socket_context;
+        if(dws->connections != 0x0)
+        {
+            const MHD_ConnectionInfo* fdinfo = MHD_get_connection_info(
+                    connection,
+                    MHD_CONNECTION_INFO_CONNECTION_FD
+            );
+            const MHD_ConnectionInfo* addrinfo = MHD_get_connection_info(
+                    connection,
+                    MHD_CONNECTION_INFO_CLIENT_ADDRESS
+            );
+            details::connection_entry* entry = dws->connections->add(
+                    fdinfo != 0x0 ? fdinfo->connect_fd : -1,
+                    addrinfo != 0x0 ? addrinfo->client_addr : 0x0
+            );
+            *socket_context = entry;
+            tls_context = &entry->tls_context;
+        }
+        if(dws->tls == 0x0)
+            return;
+        // The TLS session is ready but its handshake has not started yet.
+        const MHD_ConnectionInfo* conninfo = MHD_get_connection_info(
+                connection,
+                MHD_CONNECTION_INFO_GNUTLS_SESSION
+        );
+        if(conninfo != 0x0 && conninfo->tls_session != 0x0)
+            *tls_context = dws->tls->attach(conninfo->tls_session);
+        return;
+    }
+
+    if(dws->metrics != 0x0)
+    {
+        // The socket is still open at this point.
+        const MHD_ConnectionInfo* conninfo = MHD_get_connection_info(
+                connection,
+                MHD_CONNECTION_INFO_CONNECTION_FD
+        );
+        dws->metrics->connection_closed(conninfo != 0x0 ? conninfo->connect_fd : -1);
+    }
+    void* tls_context = *socket_context;
+    if(dws->connections != 0x0 && *socket_context != 0x0)
+    {
+        details::connection_entry* entry = static_cast<details::connection_entry*>(*socket_context);
+        tls_context = entry->tls_context;
+        dws->connections->remove(entry);
+    }
+    if(tls_context != 0x0)
+        details::tls_manager::detach(tls_context);
+    *socket_context = 0x0;
+}
+
 const std::shared_ptr<http_response> webserver::method_not_allowed_page(details::modded_request* mr) const
 {
     if(method_not_allowed_resource != 0x0)
@@ -514,7 +1288,8 @@ int webserver::bodyless_requests_answer(
     const char* version, struct details::modded_request* mr
     )
 {
-    http_request req(connection, unescaper);
+    http_request req(connection, unescaper, credentials.get(), files.get(),
+            compressed.get(), compression_min_size);
     mr->dhr = &(req);
     return complete_request(connection, mr, version, method);
 }
@@ -525,8 +1300,9 @@ int webserver::bodyfull_requests_answer_first_step(
 )
 {
     mr->second = true;
-    mr->dhr = new http_request(connection, unescaper);
-    mr->dhr->set_content_size_limit(content_size_limit);
+    mr->dhr = new http_request(connection, unescaper, credentials.get(), files.get(),
+            compressed.get(), compression_min_size);
+    mr->dhr->set_content_size_limit(settings->load().content_size_limit);
     const char *encoding = MHD_lookup_connection_value (
             connection,
             MHD_HEADER_KIND,
@@ -583,20 +1359,73 @@ int webserver::bodyfull_requests_answer_second_step(
     return MHD_YES;
 }
 
+bool webserver::filter_request(MHD_Connection* connection, const char* method,
+        const char* version, struct details::modded_request* mr, int* to_ret
+)
+{
+    // Cheapest checks first: none of them needs the headers.
+    unsigned int retry_after = 0;
+    bool valid = validator == 0x0 || validator(*mr->complete_uri);
+    bool limited = valid && !rate_limit_allows(connection, 0x0, rate_limit_rate, rate_limit_burst, &retry_after);
+    if(valid && !limited && request_filter == 0x0)
+        return false;
+
+    http_request req(connection, unescaper, credentials.get(), files.get(),
+            compressed.get(), compression_min_size);
+    req.set_path(mr->standardized_url->c_str());
+    req.set_method(method);
+    req.set_version(version);
+    req.span = mr->span;
+    mr->dhr = &req;
+    mr->ws = this;
+
+    if(!valid)
+    {
+        mr->dhrs = bad_request_page();
+    }
+    else if(limited)
+    {
+        mr->dhrs = too_many_requests_page(retry_after);
+    }
+    else
+    {
+        try
+        {
+            mr->dhrs = request_filter(req);
+        }
+        catch(...)
+        {
+            mr->dhrs = internal_error_page(mr);
+        }
+        if(mr->dhrs == 0x0)
+        {
+            mr->dhr = 0x0;
+            return false;
+        }
+    }
+
+    *to_ret = send_answer(connection, mr);
+    if(metrics != 0x0)
+        metrics->record_request(method, "", mr->dhrs->get_response_code());
+    mr->dhr = 0x0;
+    return true;
+}
+
 int webserver::finalize_answer(
         MHD_Connection* connection,
         struct details::modded_request* mr,
         const char* method
 )
 {
-    int to_ret = MHD_NO;
-
     map<string, http_resource*>::iterator fe;
 
     http_resource* hrm;
 
     bool found = false;
-    struct MHD_Response* raw_response;
+    unsigned int retry_after = 0;
+    bool stale = false;
+    static const std::string no_route;
+    const std::string* route = &no_route;
     if(!single_resource)
     {
         const char* st_url = mr->standardized_url->c_str();
@@ -641,28 +1470,65 @@ int webserver::finalize_answer(
                     }
 
                     hrm = found_endpoint->second;
+                    route = &found_endpoint->first.get_url_complete();
                 }
             }
         }
         else
         {
             hrm = fe->second;
+            route = &fe->first;
             found = true;
         }
     }
     else
     {
         hrm = registered_resources.begin()->second;
+        route = &registered_resources.begin()->first.get_url_complete();
         found = true;
     }
+    mark_phase(mr, request_timings::ROUTED);
 
-    if(found)
+    // The server wide rate limit was already applied by filter_request.
+    bool limited = found && hrm->is_rate_limited() &&
+        !rate_limit_allows(connection, hrm, hrm->rate_limit_rate, hrm->rate_limit_burst, &retry_after);
+
+    if(limited)
+    {
+        mr->dhrs = too_many_requests_page(retry_after);
+    }
+    else if(found)
     {
         try
         {
-            if(hrm->is_allowed(method))
+            if(!hrm->basic_auth_realm.empty() && !mr->dhr->check_basic_auth())
+            {
+                mr->dhrs = std::shared_ptr<http_response>(new basic_auth_fail_response(
+                        UNAUTHORIZED_ERROR, hrm->basic_auth_realm, http_utils::http_unauthorized
+                ));
+            }
+            else if(!hrm->digest_auth_realm.empty() &&
+                    !check_digest_auth(mr, hrm->digest_auth_realm, &stale))
+            {
+                mr->stale_nonce = stale;
+                mr->dhrs = digest_auth_challenge(hrm->digest_auth_realm, stale);
+            }
+            else if(hrm->is_allowed(method))
             {
-                mr->dhrs = ((hrm)->*(mr->callback))(*mr->dhr); //copy in memory (move in case)
+                uint64_t started = metrics != 0x0 ? monotonic_microseconds() : 0;
+                if(watchdog != 0x0)
+                {
+                    mr->watch.reset(watchdog->watch(*route, mr->dhr->get_requestor()));
+                    // Deferred responses produce their content later, watched as the render method was.
+                    mr->dhr->watched = mr->watch.get();
+                }
+                {
+                    details::watch_guard guard(mr->watch.get());
+                    mr->dhrs = ((hrm)->*(mr->callback))(*mr->dhr); //copy in memory (move in case)
+                }
+                mark_phase(mr, request_timings::HANDLED);
+                if(metrics != 0x0)
+                    metrics->record_latency(*route, monotonic_microseconds() - started);
                 if (mr->dhrs->get_response_code() == -1)
                 {
                     mr->dhrs = internal_error_page(mr);
@@ -687,39 +1553,163 @@ int webserver::finalize_answer(
         mr->dhrs = not_found_page(mr);
     }
 
+    int to_ret = send_answer(connection, mr);
+    if(metrics != 0x0)
+        metrics->record_request(method, *route, mr->dhrs->get_response_code());
+    return to_ret;
+}
+
+int webserver::send_answer(MHD_Connection* connection, struct details::modded_request* mr)
+{
+    int to_ret = MHD_NO;
+    struct MHD_Response* raw_response;
+    std::string content_encoding;
+    // Status of this answer when it is not the response code (e.g. 304 for a file).
+    int served_code = -1;
+
     try
     {
         try
         {
-            raw_response = mr->dhrs->get_raw_response();
+            raw_response = 0x0;
+            if(compression_enabled)
+                raw_response = get_encoded_response(mr, content_encoding, served_code);
+            if(raw_response == 0x0)
+                raw_response = mr->dhrs->get_raw_response_for(*mr->dhr, served_code);
         }
         catch(const std::invalid_argument& iae)
         {
             mr->dhrs = not_found_page(mr);
+            served_code = -1;
             raw_response = mr->dhrs->get_raw_response();
         }
         catch(const std::exception& e)
         {
             mr->dhrs = internal_error_page(mr);
+            served_code = -1;
             raw_response = mr->dhrs->get_raw_response();
         }
         catch(...)
         {
             mr->dhrs = internal_error_page(mr);
+            served_code = -1;
             raw_response = mr->dhrs->get_raw_response();
         }
     }
     catch(...) // catches errors in internal error page
     {
         mr->dhrs = internal_error_page(mr, true);
+        served_code = -1;
         raw_response = mr->dhrs->get_raw_response();
     }
+    if(abuse != 0x0)
+        track_abuse(connection, mr);
     mr->dhrs->decorate_response(raw_response);
-    to_ret = mr->dhrs->enqueue_response(connection, raw_response);
+    // Keep-alive clients reconnect to the daemon accepting connections, or learn the server is going away.
+    const union MHD_ConnectionInfo* served_by = MHD_get_connection_info(connection, MHD_CONNECTION_INFO_DAEMON);
+    if(served_by != 0x0 && !retired->serving(served_by->daemon))
+        MHD_add_response_header(raw_response, http_utils::http_header_connection.c_str(), "close");
+    if(compression_enabled)
+        decorate_encoding(mr, raw_response, content_encoding);
+    if(served_code == -1)
+    {
+        to_ret = mr->dhrs->enqueue_response(connection, raw_response);
+        served_code = mr->dhrs->get_response_code();
+    }
+    else
+    {
+        to_ret = MHD_queue_response(connection, served_code, raw_response);
+    }
     MHD_destroy_response(raw_response);
+    set_connection_state(mr, connection_info::SENDING);
+    if(mr->span != 0x0)
+    {
+        mark_phase(mr, request_timings::QUEUED);
+        mr->span->status = served_code;
+    }
+    if(access_logger != 0x0)
+    {
+        // Completed (latency and time) once the response is sent, in request_completed.
+        delete mr->access;
+        mr->access = new access_record();
+        mr->access->peer = mr->dhr->get_requestor();
+        mr->access->method = mr->dhr->get_method();
+        mr->access->path = *mr->complete_uri;
+        mr->access->user_agent = mr->dhr->get_header(http_utils::http_header_user_agent);
+        mr->access->status = served_code;
+        mr->access->bytes_received = mr->dhr->get_content().size();
+    }
     return to_ret;
 }
 
+MHD_Response* webserver::get_encoded_response(
+        details::modded_request* mr,
+        std::string& content_encoding,
+        int& served_code
+)
+{
+    static const char* const preferred[] = { "br", "zstd", "gzip" };
+    static const vector<string> available(preferred, preferred + 3);
+
+    string accept_encoding = mr->dhr->get_header(http_utils::http_header_accept_encoding);
+    // partial responses are computed on the identity of the resource
+    if(accept_encoding.empty() ||
+            !mr->dhr->get_header(http_utils::http_header_range).empty())
+        return 0x0;
+
+    const map<string, string, header_comparator>& headers = mr->dhrs->get_headers();
+    if(headers.find(http_utils::http_header_content_encoding) != headers.end())
+        return 0x0;
+
+    vector<string> encodings = http::accepted_encodings(accept_encoding, available);
+    for(vector<string>::const_iterator it = encodings.begin(); it != encodings.end(); ++it)
+    {
+        MHD_Response* raw_response = mr->dhrs->get_raw_response_encoded(*mr->dhr, *it, served_code);
+        if(raw_response != 0x0)
+        {
+            content_encoding = *it;
+            return raw_response;
+        }
+    }
+    return 0x0;
+}
+
+void webserver::decorate_encoding(
+        details::modded_request* mr,
+        MHD_Response* raw_response,
+        const std::string& content_encoding
+)
+{
+    if(!content_encoding.empty())
+    {
+        MHD_add_response_header(raw_response,
+                http_utils::http_header_content_encoding.c_str(),
+                content_encoding.c_str()
+        );
+    }
+
+    // The representation depends on Accept-Encoding whether or not it has
+    // been encoded this time; caches need to know it.
+    const map<string, string, header_comparator>& headers = mr->dhrs->get_headers();
+    map<string, string, header_comparator>::const_iterator vary =
+        headers.find(http_utils::http_header_vary);
+    if(vary == headers.end())
+    {
+        MHD_add_response_header(raw_response,
+                http_utils::http_header_vary.c_str(),
+                http_utils::http_header_accept_encoding.c_str()
+        );
+    }
+    else if(vary->second != "*" && string_utilities::to_upper_copy(vary->second).find("ACCEPT-ENCODING") == string::npos)
+    {
+        MHD_del_response_header(raw_response, vary->first.c_str(), vary->second.c_str());
+        MHD_add_response_header(raw_response,
+                http_utils::http_header_vary.c_str(),
+                (vary->second + ", " + http_utils::http_header_accept_encoding).c_str()
+        );
+    }
+}
+
 int webserver::complete_request(
         MHD_Connection* connection,
         struct details::modded_request* mr,
@@ -732,6 +1722,9 @@ int webserver::complete_request(
     mr->dhr->set_path(mr->standardized_url->c_str());
     mr->dhr->set_method(method);
     mr->dhr->set_version(version);
+    mr->dhr->span = mr->span;
+    mark_phase(mr, request_timings::BODY);
+    set_connection_state(mr, connection_info::HANDLING);
 
     return finalize_answer(connection, mr, method);
 }
@@ -744,6 +1737,7 @@ int webserver::answer_to_connection(void* cls, MHD_Connection* connection,
 {
     struct details::modded_request* mr =
         static_cast<struct details::modded_request*>(*con_cls);
+    details::alloc_scope scope(mr->allocs);
 
     if(mr->second != false)
     {
@@ -758,6 +1752,29 @@ int webserver::answer_to_connection(void* cls, MHD_Connection* connection,
             );
     }
 
+    // Clients banned while their connection was open are cut off at their next request.
+    if(static_cast<webserver*>(cls)->abuse != 0x0 &&
+            static_cast<webserver*>(cls)->ban_system_enabled &&
+            static_cast<webserver*>(cls)->is_auto_banned(connection))
+    {
+        return MHD_NO;
+    }
+
+    if(mr->span != 0x0)
+    {
+        mark_phase(mr, request_timings::HEADERS);
+        mr->span->method = method;
+        mr->span->path = *mr->complete_uri;
+        if(static_cast<webserver*>(cls)->request_tracer != 0x0)
+        {
+            const char* traceparent = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "traceparent");
+            const char* tracestate = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "tracestate");
+            details::start_trace(traceparent != 0x0 ? traceparent : "",
+                    tracestate != 0x0 ? tracestate : "", mr->span->context
+            );
+        }
+    }
+
     std::string t_url = url;
 
     base_unescaper(t_url, static_cast<webserver*>(cls)->unescaper);
@@ -805,6 +1822,13 @@ int webserver::answer_to_connection(void* cls, MHD_Connection* connection,
         mr->callback = &http_resource::render_OPTIONS;
     }
 
+    set_connection_state(mr, body ? connection_info::READING_BODY : connection_info::HANDLING);
+
+    // Requests rejected here are answered before their body is read or buffered.
+    int to_ret = MHD_NO;
+    if(static_cast<webserver*>(cls)->filter_request(connection, method, version, mr, &to_ret))
+        return to_ret;
+
     return body ? static_cast<webserver*>(cls)->bodyfull_requests_answer_first_step(connection, mr) : static_cast<webserver*>(cls)->bodyless_requests_answer(connection, method, version, mr);
 }
 
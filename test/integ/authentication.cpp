@@ -32,6 +32,7 @@
 #include <curl/curl.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <unistd.h>
 #include "httpserver.hpp"
 
 #define MY_OPAQUE "11733b200778ce33060f31c9af70a870ba96ddd4"
@@ -78,6 +79,50 @@ class digest_resource : public httpserver::http_resource
         }
 };
 
+int verifier_calls = 0;
+
+bool count_verifications(const std::string& user, const std::string& pass)
+{
+    verifier_calls++;
+    return user == "myuser" && pass == "mypass";
+}
+
+class protected_resource : public httpserver::http_resource
+{
+    public:
+        protected_resource()
+        {
+            require_basic_auth("test@example.com");
+        }
+
+        const shared_ptr<http_response> render_GET(const http_request& req)
+        {
+            return shared_ptr<string_response>(new string_response("SUCCESS", 200, "text/plain"));
+        }
+};
+
+bool lookup_password(const std::string& user, const std::string& realm, std::string& password)
+{
+    if(user != "myuser" || realm != "test@example.com")
+        return false;
+    password = "mypass";
+    return true;
+}
+
+class digest_protected_resource : public httpserver::http_resource
+{
+    public:
+        digest_protected_resource()
+        {
+            require_digest_auth("test@example.com");
+        }
+
+        const shared_ptr<http_response> render_GET(const http_request& req)
+        {
+            return shared_ptr<string_response>(new string_response("SUCCESS", 200, "text/plain"));
+        }
+};
+
 LT_BEGIN_SUITE(authentication_suite)
     void set_up()
     {
@@ -200,6 +245,182 @@ LT_BEGIN_AUTO_TEST(authentication_suite, digest_auth_wrong_pass)
     ws.stop();
 LT_END_AUTO_TEST(digest_auth_wrong_pass)
 
+LT_BEGIN_AUTO_TEST(authentication_suite, base_auth_verifier_cached)
+    webserver ws = create_webserver(8080).basic_auth_verifier(&count_verifications);
+
+    protected_resource resource;
+    ws.register_resource("base", &resource);
+    ws.start(false);
+    verifier_calls = 0;
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    for(int i = 0; i < 3; i++)
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_USERNAME, "myuser");
+        curl_easy_setopt(curl, CURLOPT_PASSWORD, "mypass");
+        curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        LT_CHECK_EQ(s, "SUCCESS");
+        curl_easy_cleanup(curl);
+    }
+    LT_CHECK_EQ(verifier_calls, 1);
+
+    {
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_USERNAME, "myuser");
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, "wrongpass");
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_CHECK_EQ(http_code, 401);
+    curl_easy_cleanup(curl);
+    }
+    LT_CHECK_EQ(verifier_calls, 2);
+
+    ws.stop();
+LT_END_AUTO_TEST(base_auth_verifier_cached)
+
+LT_BEGIN_AUTO_TEST(authentication_suite, digest_auth_required)
+    webserver ws = create_webserver(8080).digest_auth_password_lookup(&lookup_password);
+
+    digest_protected_resource resource;
+    ws.register_resource("base", &resource);
+    ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    const char* passwords[] = {"mypass", "wrongpass"};
+    for(int i = 0; i < 2; i++)
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_DIGEST);
+        curl_easy_setopt(curl, CURLOPT_USERNAME, "myuser");
+        curl_easy_setopt(curl, CURLOPT_PASSWORD, passwords[i]);
+        curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base?x=1");
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        long http_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        LT_CHECK_EQ(http_code, i == 0 ? 200 : 401);
+        if(i == 0)
+            LT_CHECK_EQ(s, "SUCCESS");
+        curl_easy_cleanup(curl);
+    }
+
+    nonce_stats stats = ws.get_nonce_stats();
+    LT_CHECK_EQ(stats.issued >= 2, true);
+    LT_CHECK_EQ(stats.replays, 0);
+
+    ws.stop();
+LT_END_AUTO_TEST(digest_auth_required)
+
+LT_BEGIN_AUTO_TEST(authentication_suite, digest_auth_uri_with_query)
+    webserver ws = create_webserver(8080).digest_auth_password_lookup(&lookup_password);
+
+    digest_protected_resource resource;
+    ws.register_resource("base", &resource);
+    ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_DIGEST);
+    curl_easy_setopt(curl, CURLOPT_USERNAME, "myuser");
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, "mypass");
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base?a=b");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_CHECK_EQ(http_code, 200);
+    LT_CHECK_EQ(s, "SUCCESS");
+    curl_easy_cleanup(curl);
+
+    ws.stop();
+LT_END_AUTO_TEST(digest_auth_uri_with_query)
+
+long digest_get(CURL* curl, const char* password)
+{
+    std::string s;
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_DIGEST);
+    curl_easy_setopt(curl, CURLOPT_USERNAME, "myuser");
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, password);
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    long http_code = 0;
+    if(curl_easy_perform(curl) == CURLE_OK)
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    return http_code;
+}
+
+LT_BEGIN_AUTO_TEST(authentication_suite, digest_auth_handshakes_not_banned)
+    webserver ws = create_webserver(8080)
+        .digest_auth_password_lookup(&lookup_password)
+        .digest_auth_nonce_timeout(1)
+        .auto_ban_auth_failures(3);
+
+    digest_protected_resource resource;
+    ws.register_resource("base", &resource);
+    ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    // Every new client is first challenged, with a new nonce each time.
+    for(int i = 0; i < 6; i++)
+    {
+        CURL *curl = curl_easy_init();
+        LT_CHECK_EQ(digest_get(curl, "mypass"), 200);
+        curl_easy_cleanup(curl);
+    }
+
+    // A client reusing its nonce past the timeout is challenged again with stale=true.
+    CURL *curl = curl_easy_init();
+    for(int i = 0; i < 4; i++)
+    {
+        if(i > 0)
+            sleep(2);
+        LT_CHECK_EQ(digest_get(curl, "mypass"), 200);
+    }
+    curl_easy_cleanup(curl);
+
+    LT_CHECK_EQ(ws.get_nonce_stats().stale > 0, true);
+    LT_CHECK_EQ(ws.get_auto_banned_count(), 0);
+
+    // Credentials presented and rejected still count.
+    for(int i = 0; i < 4; i++)
+    {
+        CURL *curl = curl_easy_init();
+        digest_get(curl, "wrongpass");
+        curl_easy_cleanup(curl);
+    }
+    LT_CHECK_EQ(ws.get_auto_banned_count(), 1);
+
+    ws.stop();
+LT_END_AUTO_TEST(digest_auth_handshakes_not_banned)
+
 LT_BEGIN_AUTO_TEST_ENV()
     AUTORUN_TESTS()
 LT_END_AUTO_TEST_ENV()
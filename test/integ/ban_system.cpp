@@ -22,6 +22,7 @@
 #include <curl/curl.h>
 #include <string>
 #include <map>
+#include <vector>
 #include "httpserver.hpp"
 #include "http_utils.hpp"
 
@@ -160,6 +161,94 @@ LT_BEGIN_AUTO_TEST(ban_system_suite, reject_default_allow_passes)
     ws.stop();
 LT_END_AUTO_TEST(reject_default_allow_passes)
 
+LT_BEGIN_AUTO_TEST(ban_system_suite, accept_default_bulk_ban_blocks)
+    webserver ws = create_webserver(8080).default_policy(http_utils::ACCEPT);
+    ws.start(false);
+
+    ok_resource resource;
+    ws.register_resource("base", &resource);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    {
+    std::vector<std::string> bans;
+    bans.push_back("10.0.0.0/8");
+    bans.push_back("127.0.0.0/8");
+    ws.set_bans(bans);
+
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_NEQ(res, 0);
+    curl_easy_cleanup(curl);
+    }
+
+    {
+    std::vector<std::string> bans;
+    bans.push_back("10.0.0.0/8");
+    ws.set_bans(bans);
+
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "OK");
+    curl_easy_cleanup(curl);
+    }
+
+    curl_global_cleanup();
+    ws.stop();
+LT_END_AUTO_TEST(accept_default_bulk_ban_blocks)
+
+LT_BEGIN_AUTO_TEST(ban_system_suite, auto_ban_after_not_found)
+    webserver ws = create_webserver(8080).auto_ban_not_found(3).auto_ban_duration(60);
+    ws.start(false);
+
+    ok_resource resource;
+    ws.register_resource("base", &resource);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    for(int i = 0; i < 3; i++)
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/missing");
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        long http_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        LT_CHECK_EQ(http_code, 404);
+        curl_easy_cleanup(curl);
+    }
+
+    LT_CHECK_EQ(ws.get_auto_banned_count(), 1);
+
+    {
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_NEQ(res, 0);
+    curl_easy_cleanup(curl);
+    }
+
+    curl_global_cleanup();
+    ws.stop();
+LT_END_AUTO_TEST(auto_ban_after_not_found)
+
 LT_BEGIN_AUTO_TEST_ENV()
     AUTORUN_TESTS()
 LT_END_AUTO_TEST_ENV()
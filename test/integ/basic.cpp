@@ -19,9 +19,11 @@
 */
 
 #include "littletest.hpp"
+#include <unistd.h>
 #include <curl/curl.h>
 #include <string>
 #include <map>
+#include <pthread.h>
 #include "string_utilities.hpp"
 #include "httpserver.hpp"
 
@@ -205,6 +207,32 @@ class file_response_resource : public http_resource
         }
 };
 
+class shared_file_response_resource : public http_resource
+{
+    public:
+        shared_file_response_resource():
+            response(new file_response("test_content", 200, "text/plain"))
+        {
+        }
+
+        const shared_ptr<http_response> render_GET(const http_request& req)
+        {
+            return response;
+        }
+
+    private:
+        shared_ptr<file_response> response;
+};
+
+class missing_file_response_resource : public http_resource
+{
+    public:
+        const shared_ptr<http_response> render_GET(const http_request& req)
+        {
+            return shared_ptr<file_response>(new file_response("missing_test_content", 200, "text/plain"));
+        }
+};
+
 class exception_resource : public http_resource
 {
     public:
@@ -357,6 +385,40 @@ LT_BEGIN_AUTO_TEST(basic_suite, read_long_body)
     curl_easy_cleanup(curl);
 LT_END_AUTO_TEST(read_long_body)
 
+#ifdef HAVE_ZLIB
+LT_BEGIN_AUTO_TEST(basic_suite, read_long_body_compressed)
+    webserver cws = create_webserver(8081).compression();
+    long_content_resource resource;
+    cws.register_resource("base", &resource);
+    cws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    map<string, string> ss;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "gzip");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &ss);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, lorem_ipsum);
+    LT_CHECK_EQ(ss["Content-Encoding"], "gzip");
+    LT_CHECK_EQ(ss["Vary"], "Accept-Encoding");
+
+    double downloaded = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &downloaded);
+    LT_CHECK_EQ(downloaded < lorem_ipsum.size(), true);
+    curl_easy_cleanup(curl);
+
+    cws.stop();
+LT_END_AUTO_TEST(read_long_body_compressed)
+#endif
+
 LT_BEGIN_AUTO_TEST(basic_suite, resource_setting_header)
     header_set_test_resource resource;
     ws->register_resource("base", &resource);
@@ -833,6 +895,233 @@ LT_BEGIN_AUTO_TEST(basic_suite, file_serving_resource)
     curl_easy_cleanup(curl);
 LT_END_AUTO_TEST(file_serving_resource)
 
+LT_BEGIN_AUTO_TEST(basic_suite, file_serving_missing_file)
+    missing_file_response_resource resource;
+    ws->register_resource("base", &resource);
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "Not Found");
+
+    long http_code = 0;
+    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_ASSERT_EQ(http_code, 404);
+
+    curl_easy_cleanup(curl);
+LT_END_AUTO_TEST(file_serving_missing_file)
+
+LT_BEGIN_AUTO_TEST(basic_suite, file_serving_range)
+    file_response_resource resource;
+    ws->register_resource("base", &resource);
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    std::string s;
+    map<string, string> ss;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_RANGE, "5-11");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &ss);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "content");
+    LT_CHECK_EQ(ss["Content-Range"], "bytes 5-11/21");
+
+    long http_code = 0;
+    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_ASSERT_EQ(http_code, 206);
+
+    curl_easy_cleanup(curl);
+LT_END_AUTO_TEST(file_serving_range)
+
+LT_BEGIN_AUTO_TEST(basic_suite, file_serving_unsatisfiable_range)
+    file_response_resource resource;
+    ws->register_resource("base", &resource);
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    std::string s;
+    map<string, string> ss;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_RANGE, "100-200");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &ss);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(ss["Content-Range"], "bytes */21");
+
+    long http_code = 0;
+    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_ASSERT_EQ(http_code, 416);
+
+    curl_easy_cleanup(curl);
+LT_END_AUTO_TEST(file_serving_unsatisfiable_range)
+
+LT_BEGIN_AUTO_TEST(basic_suite, file_serving_not_modified)
+    file_response_resource resource;
+    ws->register_resource("base", &resource);
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    std::string s;
+    map<string, string> ss;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &ss);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "test content of file\n");
+    LT_CHECK_EQ(ss["Accept-Ranges"], "bytes");
+    LT_ASSERT_EQ(ss["ETag"].empty(), false);
+    curl_easy_cleanup(curl);
+
+    std::string etag = ss["ETag"];
+    s = "";
+    curl = curl_easy_init();
+    struct curl_slist *list = NULL;
+    list = curl_slist_append(list, ("If-None-Match: " + etag).c_str());
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "");
+
+    long http_code = 0;
+    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_ASSERT_EQ(http_code, 304);
+
+    curl_slist_free_all(list);
+    curl_easy_cleanup(curl);
+LT_END_AUTO_TEST(file_serving_not_modified)
+
+struct shared_file_client
+{
+    const char* range;
+    long expected_code;
+    int mismatches;
+};
+
+void* request_shared_file(void* par)
+{
+    shared_file_client* client = (shared_file_client*) par;
+    for(int i = 0; i < 50; i++)
+    {
+        std::string s;
+        map<string, string> ss;
+        CURL *curl = curl_easy_init();
+        curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        if(client->range != 0x0)
+            curl_easy_setopt(curl, CURLOPT_RANGE, client->range);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &ss);
+        long http_code = 0;
+        if(curl_easy_perform(curl) == 0)
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        bool multipart = ss["Content-Type"].find("multipart/byteranges") == 0;
+        if(http_code != client->expected_code || multipart != (client->range != 0x0))
+            client->mismatches++;
+        curl_easy_cleanup(curl);
+    }
+    return 0x0;
+}
+
+LT_BEGIN_AUTO_TEST(basic_suite, file_serving_shared_response)
+    // The same response object answers concurrent requests with different outcomes.
+    webserver tws = create_webserver(8081).start_method(http::http_utils::THREAD_PER_CONNECTION);
+    shared_file_response_resource resource;
+    tws.register_resource("base", &resource);
+    tws.start(false);
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    shared_file_client clients[4] = {
+        { "0-3,5-11", 206, 0 },
+        { 0x0, 200, 0 },
+        { "0-3,5-11", 206, 0 },
+        { 0x0, 200, 0 }
+    };
+    pthread_t threads[4];
+    for(int i = 0; i < 4; i++)
+        pthread_create(&threads[i], NULL, request_shared_file, (void*) &clients[i]);
+    for(int i = 0; i < 4; i++)
+    {
+        pthread_join(threads[i], NULL);
+        LT_CHECK_EQ(clients[i].mismatches, 0);
+    }
+
+    tws.stop();
+LT_END_AUTO_TEST(file_serving_shared_response)
+
+LT_BEGIN_AUTO_TEST(basic_suite, rate_limited_resource)
+    simple_resource resource;
+    resource.set_rate_limit(0.5, 2);
+    ws->register_resource("base", &resource);
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    for(int i = 0; i < 2; i++)
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        LT_CHECK_EQ(s, "OK");
+        curl_easy_cleanup(curl);
+    }
+
+    std::string s;
+    map<string, string> ss;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &ss);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "Too Many Requests");
+    LT_CHECK_EQ(ss["Retry-After"], "2");
+
+    long http_code = 0;
+    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_ASSERT_EQ(http_code, 429);
+    curl_easy_cleanup(curl);
+
+    rate_limit_stats stats = ws->get_rate_limit_stats();
+    LT_CHECK_EQ(stats.limited, 1);
+LT_END_AUTO_TEST(rate_limited_resource)
+
 LT_BEGIN_AUTO_TEST(basic_suite, exception_forces_500)
     exception_resource resource;
     ws->register_resource("base", &resource);
@@ -947,6 +1236,375 @@ LT_BEGIN_AUTO_TEST(basic_suite, response_is_printable)
     curl_easy_cleanup(curl);
 LT_END_AUTO_TEST(response_is_printable)
 
+bool reject_dot_segments(const std::string& url)
+{
+    return url.find("/../") == string::npos;
+}
+
+const shared_ptr<http_response> reject_missing_token(const http_request& req)
+{
+    if(req.get_header("X-Token") == "secret")
+        return shared_ptr<http_response>();
+    return shared_ptr<string_response>(new string_response("Forbidden", 403, "text/plain"));
+}
+
+LT_BEGIN_AUTO_TEST(basic_suite, requests_filtered_before_body)
+    webserver fws = create_webserver(8081)
+        .validator(&reject_dot_segments)
+        .request_filter(&reject_missing_token);
+    simple_resource resource;
+    fws.register_resource("base", &resource, true);
+    fws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    const char* tokens[] = {"X-Token: secret", "X-Token: wrong", "X-Token: secret"};
+    const char* urls[] = {"localhost:8081/base", "localhost:8081/base", "localhost:8081/base/../base"};
+    const long codes[] = {200, 403, 400};
+    for(int i = 0; i < 3; i++)
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        struct curl_slist *list = curl_slist_append(NULL, tokens[i]);
+        curl_easy_setopt(curl, CURLOPT_URL, urls[i]);
+        curl_easy_setopt(curl, CURLOPT_PATH_AS_IS, 1L);
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "arg1=lib&arg2=httpserver");
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        curl_slist_free_all(list);
+        LT_ASSERT_EQ(res, 0);
+        long http_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        LT_CHECK_EQ(http_code, codes[i]);
+        if(i == 0)
+            LT_CHECK_EQ(s, "libhttpserver");
+        curl_easy_cleanup(curl);
+    }
+
+    fws.stop();
+LT_END_AUTO_TEST(requests_filtered_before_body)
+
+LT_BEGIN_AUTO_TEST(basic_suite, metrics_endpoint)
+    webserver mws = create_webserver(8081).metrics_endpoint("/metrics");
+    simple_resource resource;
+    mws.register_resource("base", &resource);
+    mws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    const char* urls[] = {"localhost:8081/base", "localhost:8081/base", "localhost:8081/missing", "localhost:8081/metrics"};
+    std::string s;
+    for(int i = 0; i < 4; i++)
+    {
+        s = "";
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_URL, urls[i]);
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        curl_easy_cleanup(curl);
+    }
+
+    LT_CHECK_EQ(s.find("httpserver_requests_total{method=\"GET\",route=\"/base\",status=\"200\"} 2\n") != string::npos, true);
+    LT_CHECK_EQ(s.find("httpserver_requests_total{method=\"GET\",route=\"\",status=\"404\"} 1\n") != string::npos, true);
+    LT_CHECK_EQ(s.find("httpserver_request_duration_seconds_count{route=\"/base\"} 2\n") != string::npos, true);
+    LT_CHECK_EQ(s.find("httpserver_connections_active ") != string::npos, true);
+    LT_CHECK_EQ(mws.get_metrics().find("route=\"/metrics\",status=\"200\"} 1\n") != string::npos, true);
+
+    mws.stop();
+LT_END_AUTO_TEST(metrics_endpoint)
+
+vector<access_record> access_records;
+
+void collect_access_records(const vector<access_record>& records)
+{
+    access_records.insert(access_records.end(), records.begin(), records.end());
+}
+
+LT_BEGIN_AUTO_TEST(basic_suite, structured_access_log)
+    access_records.clear();
+    webserver aws = create_webserver(8081).access_log_sink(&collect_access_records);
+    simple_resource resource;
+    aws.register_resource("base", &resource);
+    aws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    const char* urls[] = {"localhost:8081/base?x=1", "localhost:8081/missing"};
+    for(int i = 0; i < 2; i++)
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_URL, urls[i]);
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "littletest");
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        curl_easy_cleanup(curl);
+    }
+
+    // Stopping the server delivers the pending records.
+    aws.stop();
+    LT_ASSERT_EQ(access_records.size(), 2);
+    LT_CHECK_EQ(access_records[0].method, "GET");
+    LT_CHECK_EQ(access_records[0].path, "/base?x=1");
+    LT_CHECK_EQ(access_records[0].status, 200);
+    LT_CHECK_EQ(access_records[0].peer, "127.0.0.1");
+    LT_CHECK_EQ(access_records[0].user_agent, "littletest");
+    LT_CHECK_EQ(access_records[0].completed, true);
+    LT_CHECK_EQ(access_records[1].status, 404);
+    LT_CHECK_EQ(aws.get_dropped_access_records(), 0);
+LT_END_AUTO_TEST(structured_access_log)
+
+vector<request_span> request_spans;
+
+void collect_request_span(const request_span& span)
+{
+    request_spans.push_back(span);
+}
+
+class traceparent_resource : public http_resource
+{
+    public:
+        const shared_ptr<http_response> render_GET(const http_request& req)
+        {
+            if(req.get_timings().at[request_timings::ROUTED] == 0)
+                return shared_ptr<string_response>(new string_response("untimed", 500, "text/plain"));
+            return shared_ptr<string_response>(new string_response(req.get_trace_context().get_traceparent(), 200, "text/plain"));
+        }
+};
+
+LT_BEGIN_AUTO_TEST(basic_suite, request_tracing)
+    request_spans.clear();
+    webserver tws = create_webserver(8081).request_tracer(&collect_request_span);
+    traceparent_resource resource;
+    tws.register_resource("base", &resource);
+    tws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    struct curl_slist *list = curl_slist_append(NULL,
+            "traceparent: 00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01");
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    curl_slist_free_all(list);
+    LT_ASSERT_EQ(res, 0);
+    curl_easy_cleanup(curl);
+
+    tws.stop();
+    LT_ASSERT_EQ(request_spans.size(), 1);
+    const request_span& span = request_spans[0];
+    LT_CHECK_EQ(span.context.trace_id, "0af7651916cd43dd8448eb211c80319c");
+    LT_CHECK_EQ(span.context.parent_id, "b7ad6b7169203331");
+    LT_CHECK_EQ(span.context.is_sampled(), true);
+    LT_CHECK_EQ(s, span.context.get_traceparent());
+    LT_CHECK_EQ(span.method, "GET");
+    LT_CHECK_EQ(span.path, "/base");
+    LT_CHECK_EQ(span.status, 200);
+    LT_CHECK_EQ(span.completed, true);
+    for(int i = request_timings::HEADERS; i < request_timings::PHASES; i++)
+        LT_CHECK_EQ(span.timings.at[i] >= span.timings.at[i - 1], true);
+    LT_CHECK_EQ(span.timings.at[request_timings::RECEIVED] != 0, true);
+LT_END_AUTO_TEST(request_tracing)
+
+LT_BEGIN_AUTO_TEST(basic_suite, connections_listed_and_closed)
+    webserver cws = create_webserver(8081).connection_tracking();
+    simple_resource resource;
+    cws.register_resource("base", &resource);
+    cws.start(false);
+    LT_CHECK_EQ(cws.get_connections().size(), 0);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+
+    // The connection is kept alive by curl.
+    vector<connection_info> connections = cws.get_connections();
+    LT_ASSERT_EQ(connections.size(), 1);
+    LT_CHECK_EQ(connections[0].peer, "127.0.0.1");
+    LT_CHECK_EQ(connections[0].requests, 1);
+    LT_CHECK_EQ(connections[0].state, connection_info::IDLE);
+
+    LT_CHECK_EQ(cws.close_connection(connections[0].id + 1), false);
+    LT_CHECK_EQ(cws.close_connection(connections[0].id), true);
+    for(int i = 0; i < 100 && cws.get_connections().size() != 0; i++)
+        usleep(10000);
+    LT_CHECK_EQ(cws.get_connections().size(), 0);
+
+    curl_easy_cleanup(curl);
+    cws.stop();
+LT_END_AUTO_TEST(connections_listed_and_closed)
+
+LT_BEGIN_AUTO_TEST(basic_suite, allocations_counted)
+    webserver aws = create_webserver(8081);
+    simple_resource resource;
+    aws.register_resource("base", &resource);
+    aws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    curl_easy_cleanup(curl);
+    aws.stop();
+
+    alloc_stats stats = aws.get_alloc_stats();
+#ifdef HTTPSERVER_ALLOC_ACCOUNTING
+    LT_CHECK_EQ(stats.enabled, true);
+    LT_CHECK_EQ(stats.requests, 1);
+    LT_CHECK_EQ(stats.allocations > 0, true);
+    LT_CHECK_EQ(stats.allocated_bytes > 0, true);
+#else
+    LT_CHECK_EQ(stats.enabled, false);
+    LT_CHECK_EQ(stats.requests, 0);
+#endif
+LT_END_AUTO_TEST(allocations_counted)
+
+vector<stuck_handler> stuck_handlers;
+
+void collect_stuck_handler(const stuck_handler& report)
+{
+    stuck_handlers.push_back(report);
+}
+
+class slow_resource : public http_resource
+{
+    public:
+        const shared_ptr<http_response> render_GET(const http_request& req)
+        {
+            usleep(300000);
+            return shared_ptr<string_response>(new string_response("OK", 200, "text/plain"));
+        }
+};
+
+LT_BEGIN_AUTO_TEST(basic_suite, slow_handler_reported)
+    stuck_handlers.clear();
+    webserver sws = create_webserver(8081)
+        .handler_watchdog(&collect_stuck_handler)
+        .handler_watchdog_threshold(50);
+    slow_resource slow;
+    simple_resource fast;
+    sws.register_resource("slow/{id}", &slow);
+    sws.register_resource("fast", &fast);
+    sws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    const char* urls[] = { "localhost:8081/fast", "localhost:8081/slow/1" };
+    for(int i = 0; i < 2; i++)
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_URL, urls[i]);
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        LT_CHECK_EQ(s, "OK");
+        curl_easy_cleanup(curl);
+    }
+
+    // Reports are delivered by the watchdog thread, joined when the server stops.
+    sws.stop();
+    LT_ASSERT_EQ(stuck_handlers.size(), 1);
+    LT_CHECK_EQ(stuck_handlers[0].route, "/slow/{id}");
+    LT_CHECK_EQ(stuck_handlers[0].peer, "127.0.0.1");
+    LT_CHECK_EQ(stuck_handlers[0].elapsed >= 50000, true);
+LT_END_AUTO_TEST(slow_handler_reported)
+
+class content_echo_resource : public http_resource
+{
+    public:
+        const shared_ptr<http_response> render_POST(const http_request& req)
+        {
+            return shared_ptr<string_response>(new string_response(req.get_content(), 200, "text/plain"));
+        }
+};
+
+LT_BEGIN_AUTO_TEST(basic_suite, runtime_config_updated)
+    webserver rws = create_webserver(8081).drain_timeout(1000);
+    content_echo_resource resource;
+    rws.register_resource("echo", &resource);
+    rws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    std::string s;
+    struct curl_slist *list = curl_slist_append(NULL, "Content-Type: text/plain");
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/echo");
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "0123456789");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "0123456789");
+
+    // Read by the next request, on the same connection.
+    runtime_config config = rws.get_runtime_config();
+    config.content_size_limit = 4;
+    rws.update_runtime_config(config);
+    s = "";
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "0123");
+
+    // Handed over to a new daemon, while curl keeps its connection to the previous one.
+    config.per_IP_connection_limit = 5;
+    rws.update_runtime_config(config);
+    LT_CHECK_EQ(rws.get_runtime_config().per_IP_connection_limit, 5);
+    s = "";
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "0123");
+
+    CURL *other = curl_easy_init();
+    std::string t;
+    curl_easy_setopt(other, CURLOPT_URL, "localhost:8081/echo");
+    curl_easy_setopt(other, CURLOPT_POSTFIELDS, "abcdef");
+    curl_easy_setopt(other, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(other, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(other, CURLOPT_WRITEDATA, &t);
+    res = curl_easy_perform(other);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(t, "abcd");
+    curl_easy_cleanup(other);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(list);
+
+    config.connection_timeout = -1;
+    LT_CHECK_THROW(rws.update_runtime_config(config));
+    rws.stop();
+LT_END_AUTO_TEST(runtime_config_updated)
+
 LT_BEGIN_AUTO_TEST_ENV()
     AUTORUN_TESTS()
 LT_END_AUTO_TEST_ENV()
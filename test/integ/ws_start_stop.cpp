@@ -323,6 +323,32 @@ LT_BEGIN_AUTO_TEST(ws_start_stop_suite, thread_per_connection_fails_with_max_thr
     }
 LT_END_AUTO_TEST(thread_per_connection_fails_with_max_threads_stack_size)
 
+vector<error_record> error_records;
+
+void collect_error_records(const vector<error_record>& records)
+{
+    error_records.insert(error_records.end(), records.begin(), records.end());
+}
+
+LT_BEGIN_AUTO_TEST(ws_start_stop_suite, bind_failure_logged)
+    error_records.clear();
+    webserver ws1 = create_webserver(8080);
+    ws1.start(false);
+    {
+    // Records logged before the server fails to start are delivered when it is destroyed.
+    webserver ws2 = create_webserver(8080).error_log_sink(&collect_error_records);
+    LT_CHECK_THROW(ws2.start(false));
+    }
+    ws1.stop();
+
+    LT_ASSERT_EQ(error_records.empty(), false);
+    LT_CHECK_EQ(error_records[0].message.find("8080") != string::npos, true);
+    LT_CHECK_EQ(error_records[0].message[error_records[0].message.size() - 1] != '\n', true);
+    LT_CHECK_EQ(error_records[0].severity, error_record::CRITICAL);
+    LT_CHECK_EQ(error_records[0].category, error_record::SYSTEM);
+    LT_CHECK_EQ(error_records[0].suppressed, 0);
+LT_END_AUTO_TEST(bind_failure_logged)
+
 LT_BEGIN_AUTO_TEST(ws_start_stop_suite, tuning_options)
     webserver ws = create_webserver(8080)
         .max_connections(10)
@@ -382,6 +408,49 @@ LT_BEGIN_AUTO_TEST(ws_start_stop_suite, ssl_base)
     ws.stop();
 LT_END_AUTO_TEST(ssl_base)
 
+LT_BEGIN_AUTO_TEST(ws_start_stop_suite, ssl_session_resumption_and_reload)
+    webserver ws = create_webserver(8080)
+        .use_ssl()
+        .https_mem_key("key.pem")
+        .https_mem_cert("cert.pem")
+        .https_session_cache_size(16);
+
+    ok_resource ok;
+    ws.register_resource("base", &ok);
+    ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L); // avoid verifying ssl
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L); // avoid verifying ssl
+    curl_easy_setopt(curl, CURLOPT_URL, "https://localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L); // new connection (and handshake) each time
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+
+    for(int i = 0; i < 2; i++)
+    {
+        std::string s;
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+        LT_CHECK_EQ(s, "OK");
+    }
+    LT_CHECK_EQ(ws.get_tls_stats().full_handshakes, 1);
+    LT_CHECK_EQ(ws.get_tls_stats().resumed_handshakes, 1);
+
+    ws.reload_https_credentials("key.pem", "cert.pem");
+    LT_CHECK_EQ(ws.get_tls_stats().credential_reloads, 1);
+    std::string s;
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    LT_CHECK_EQ(s, "OK");
+
+    LT_CHECK_THROW(ws.reload_https_credentials("cert.pem", "cert.pem"));
+    curl_easy_cleanup(curl);
+
+    ws.stop();
+LT_END_AUTO_TEST(ssl_session_resumption_and_reload)
+
 LT_BEGIN_AUTO_TEST(ws_start_stop_suite, ssl_with_protocol_priorities)
     webserver ws = create_webserver(8080)
         .use_ssl()
@@ -478,6 +547,71 @@ LT_BEGIN_AUTO_TEST(ws_start_stop_suite, blocking_server)
     free(b);
 LT_END_AUTO_TEST(blocking_server)
 
+struct external_loop_state
+{
+    webserver* ws;
+    volatile bool done;
+};
+
+void* drive_external_loop(void* par)
+{
+    external_loop_state* state = (external_loop_state*) par;
+    while(!state->done)
+    {
+        fd_set rs, ws, es;
+        MHD_socket max_fd = 0;
+        FD_ZERO(&rs);
+        FD_ZERO(&ws);
+        FD_ZERO(&es);
+        state->ws->get_fdset(&rs, &ws, &es, &max_fd);
+
+        struct timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 10000;
+        select(max_fd + 1, &rs, &ws, &es, &tv);
+        state->ws->run_from_select(&rs, &ws, &es);
+    }
+
+    return 0x0;
+}
+
+LT_BEGIN_AUTO_TEST(ws_start_stop_suite, external_select)
+    webserver ws = create_webserver(8080).start_method(http::http_utils::EXTERNAL_SELECT);
+    ok_resource ok;
+    ws.register_resource("base", &ok);
+    ws.start(false);
+
+    external_loop_state state;
+    state.ws = &ws;
+    state.done = false;
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, drive_external_loop, (void *) &state);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "OK");
+    curl_easy_cleanup(curl);
+
+    state.done = true;
+    pthread_join(tid, NULL);
+
+    ws.stop();
+LT_END_AUTO_TEST(external_select)
+
+LT_BEGIN_AUTO_TEST(ws_start_stop_suite, external_select_fails_blocking)
+    webserver ws = create_webserver(8080).start_method(http::http_utils::EXTERNAL_SELECT);
+    LT_CHECK_THROW(ws.start(true));
+LT_END_AUTO_TEST(external_select_fails_blocking)
+
 LT_BEGIN_AUTO_TEST(ws_start_stop_suite, custom_error_resources)
     webserver ws = create_webserver(8080)
         .not_found_resource(not_found_custom)
@@ -547,6 +681,118 @@ LT_BEGIN_AUTO_TEST(ws_start_stop_suite, custom_error_resources)
     ws.stop();
 LT_END_AUTO_TEST(custom_error_resources)
 
+class slow_ok_resource : public http_resource
+{
+    public:
+        const shared_ptr<http_response> render_GET(const http_request& req)
+        {
+            usleep(300000);
+            return shared_ptr<string_response>(new string_response("OK", 200, "text/plain"));
+        }
+};
+
+size_t headerfunc(void *ptr, size_t size, size_t nmemb, map<string, string>* ss)
+{
+    string s_ptr((char*)ptr, size*nmemb);
+    size_t pos = s_ptr.find(":");
+    if(pos != string::npos)
+        (*ss)[s_ptr.substr(0, pos)] =
+            s_ptr.substr(pos + 2, s_ptr.size() - pos - 4);
+    return size*nmemb;
+}
+
+struct inflight_request
+{
+    std::string body;
+    map<string, string> headers;
+    CURLcode res;
+};
+
+void* perform_slow_request(void* par)
+{
+    inflight_request* request = (inflight_request*) par;
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/slow");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &request->body);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &request->headers);
+    request->res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    return 0x0;
+}
+
+LT_BEGIN_AUTO_TEST(ws_start_stop_suite, drain_completes_inflight_requests)
+    webserver ws = create_webserver(8080).connection_tracking();
+    slow_ok_resource slow;
+    ws.register_resource("slow", &slow);
+    ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    inflight_request request;
+    pthread_t tid;
+    pthread_create(&tid, NULL, perform_slow_request, (void *) &request);
+    usleep(100000);
+
+    LT_CHECK_EQ(ws.drain(2000), true);
+    LT_CHECK_EQ(ws.is_running(), false);
+    pthread_join(tid, NULL);
+    LT_ASSERT_EQ(request.res, 0);
+    LT_CHECK_EQ(request.body, "OK");
+    LT_CHECK_EQ(request.headers["Connection"], "close");
+
+    std::string s;
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/slow");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    LT_CHECK_NEQ(curl_easy_perform(curl), 0);
+    curl_easy_cleanup(curl);
+LT_END_AUTO_TEST(drain_completes_inflight_requests)
+
+LT_BEGIN_AUTO_TEST(ws_start_stop_suite, listen_socket_handed_over)
+#ifndef DARWIN
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    address.sin_port = htons(8182);
+    bind(fd, (struct sockaddr*) &address, sizeof(address));
+    listen(fd, 10000);
+
+    webserver previous = create_webserver(-1).bind_socket(fd);
+    ok_resource ok;
+    previous.register_resource("base", &ok);
+    previous.start(false);
+    LT_CHECK_EQ(previous.get_listen_socket(), fd);
+
+    // What a new binary does with the socket it inherited or received with receive_listen_socket.
+    webserver next = create_webserver(-1).bind_socket(previous.get_listen_socket());
+    next.register_resource("base", &ok);
+    next.start(false);
+    LT_CHECK_EQ(previous.drain(1000), true);
+    LT_CHECK_EQ(previous.get_listen_socket(), MHD_INVALID_SOCKET);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8182/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "OK");
+    curl_easy_cleanup(curl);
+
+    next.stop();
+#endif
+LT_END_AUTO_TEST(listen_socket_handed_over)
+
 LT_BEGIN_AUTO_TEST_ENV()
     AUTORUN_TESTS()
 LT_END_AUTO_TEST_ENV()
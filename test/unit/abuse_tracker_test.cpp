@@ -0,0 +1,118 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "details/abuse_tracker.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+LT_BEGIN_SUITE(abuse_tracker_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(abuse_tracker_suite)
+
+LT_BEGIN_AUTO_TEST(abuse_tracker_suite, sketch_counts_per_key)
+    sliding_sketch sketch(1024, 1000);
+    uint64_t now = 10000;
+    LT_CHECK_EQ(sketch.add(0x1234567887654321ULL, now), 1);
+    LT_CHECK_EQ(sketch.add(0x1234567887654321ULL, now), 2);
+    LT_CHECK_EQ(sketch.add(0x1234567887654321ULL, now + 10), 3);
+    LT_CHECK_EQ(sketch.add(0x0fedcba987654321ULL, now), 1);
+LT_END_AUTO_TEST(sketch_counts_per_key)
+
+LT_BEGIN_AUTO_TEST(abuse_tracker_suite, sketch_window_slides)
+    sliding_sketch sketch(1024, 1000);
+    uint64_t key = 0xabcdef0123456789ULL;
+    for(int i = 0; i < 10; i++)
+        sketch.add(key, 10000);
+
+    // Half way through the next window half of the previous one is still counted.
+    LT_CHECK_EQ(sketch.add(key, 11500), 6);
+    // Two windows later nothing is left.
+    LT_CHECK_EQ(sketch.add(key, 13000), 1);
+LT_END_AUTO_TEST(sketch_window_slides)
+
+LT_BEGIN_AUTO_TEST(abuse_tracker_suite, sketch_spares_keys_sharing_a_counter)
+    // One heavy key among many light ones: a light key is only overestimated if it shares the heavy
+    // key's counter in every row, which independent rows make negligible.
+    sliding_sketch sketch(4096, 1000);
+    uint64_t now = 10000;
+    uint64_t heavy = 0x5bd1e9955bd1e995ULL;
+    for(int i = 0; i < 10000; i++)
+        sketch.add(heavy, now);
+
+    int false_positives = 0;
+    uint64_t key = 0x0123456789abcdefULL;
+    for(int i = 0; i < 100000; i++)
+    {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        if(sketch.add(key, now) >= 1000)
+            false_positives++;
+    }
+    LT_CHECK_EQ(false_positives, 0);
+    LT_CHECK_GTE(sketch.add(heavy, now), 10001);
+LT_END_AUTO_TEST(sketch_spares_keys_sharing_a_counter)
+
+LT_BEGIN_AUTO_TEST(abuse_tracker_suite, temporary_bans_expire)
+    temporary_bans bans(64);
+    bans.ban(42, 1000, 2000);
+    LT_CHECK_EQ(bans.is_banned(42, 1500), true);
+    LT_CHECK_EQ(bans.is_banned(43, 1500), false);
+    LT_CHECK_EQ(bans.size(1500), 1);
+    LT_CHECK_EQ(bans.is_banned(42, 2000), false);
+    LT_CHECK_EQ(bans.size(2000), 0);
+
+    bans.ban(42, 2500, 3000);
+    LT_CHECK_EQ(bans.is_banned(42, 2600), true);
+LT_END_AUTO_TEST(temporary_bans_expire)
+
+LT_BEGIN_AUTO_TEST(abuse_tracker_suite, threshold_bans)
+    unsigned int thresholds[abuse_tracker::CATEGORIES] = { 3, 0, 0 };
+    abuse_tracker tracker(thresholds, 60, 60);
+    LT_CHECK_EQ(tracker.is_enabled(), true);
+
+    uint64_t key = 0x1122334455667788ULL;
+    LT_CHECK_EQ(tracker.record(abuse_tracker::NOT_FOUND, key), false);
+    LT_CHECK_EQ(tracker.record(abuse_tracker::AUTH_FAILURE, key), false);
+    LT_CHECK_EQ(tracker.record(abuse_tracker::AUTH_FAILURE, key), false);
+    LT_CHECK_EQ(tracker.is_banned(key), false);
+    LT_CHECK_EQ(tracker.record(abuse_tracker::AUTH_FAILURE, key), true);
+    LT_CHECK_EQ(tracker.is_banned(key), true);
+    LT_CHECK_EQ(tracker.is_banned(key + 1), false);
+    LT_CHECK_EQ(tracker.banned_count(), 1);
+LT_END_AUTO_TEST(threshold_bans)
+
+LT_BEGIN_AUTO_TEST(abuse_tracker_suite, disabled)
+    unsigned int thresholds[abuse_tracker::CATEGORIES] = { 0, 0, 0 };
+    abuse_tracker tracker(thresholds, 60, 60);
+    LT_CHECK_EQ(tracker.is_enabled(), false);
+    LT_CHECK_EQ(tracker.record(abuse_tracker::AUTH_FAILURE, 1), false);
+LT_END_AUTO_TEST(disabled)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,121 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <pthread.h>
+#include "littletest.hpp"
+#include "details/access_logger.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+vector<access_record> delivered;
+int batches = 0;
+
+void collect(const vector<access_record>& records)
+{
+    delivered.insert(delivered.end(), records.begin(), records.end());
+    batches++;
+}
+
+access_record make_record(int status, const string& path)
+{
+    access_record record;
+    record.status = status;
+    record.path = path;
+    record.bytes_received = 0;
+    record.latency = 0;
+    record.completed = true;
+    return record;
+}
+
+LT_BEGIN_SUITE(access_logger_suite)
+    void set_up()
+    {
+        delivered.clear();
+        batches = 0;
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(access_logger_suite)
+
+LT_BEGIN_AUTO_TEST(access_logger_suite, ring_is_bounded)
+    access_ring ring(3);
+    for(int i = 0; i < 4; i++)
+    {
+        access_record record = make_record(200 + i, "/" + to_string(i));
+        LT_CHECK_EQ(ring.push(record), true);
+    }
+    access_record extra = make_record(500, "/extra");
+    LT_CHECK_EQ(ring.push(extra), false);
+    LT_CHECK_EQ(extra.path, "/extra");
+
+    vector<access_record> records;
+    LT_CHECK_EQ(ring.drain(records), 4);
+    LT_CHECK_EQ(records[0].path, "/0");
+    LT_CHECK_EQ(records[3].status, 203);
+    LT_CHECK_EQ(ring.push(extra), true);
+    LT_CHECK_EQ(ring.drain(records), 1);
+    LT_CHECK_EQ(records[4].path, "/extra");
+LT_END_AUTO_TEST(ring_is_bounded)
+
+LT_BEGIN_AUTO_TEST(access_logger_suite, full_rings_drop_records)
+    access_logger logger(&collect, 2, 1000);
+    for(int i = 0; i < 5; i++)
+    {
+        access_record record = make_record(200, "/a");
+        logger.log(record);
+    }
+    LT_CHECK_EQ(logger.dropped(), 3);
+    LT_CHECK_EQ(logger.flush(), 2);
+    LT_CHECK_EQ(delivered.size(), 2);
+    LT_CHECK_EQ(logger.flush(), 0);
+    LT_CHECK_EQ(batches, 1);
+LT_END_AUTO_TEST(full_rings_drop_records)
+
+void* log_in_thread(void* logger)
+{
+    for(int i = 0; i < 1000; i++)
+    {
+        access_record record = make_record(200, "/thread");
+        static_cast<access_logger*>(logger)->log(record);
+    }
+    return 0x0;
+}
+
+LT_BEGIN_AUTO_TEST(access_logger_suite, records_of_all_threads_delivered)
+    access_logger logger(&collect, 4096, 5);
+    logger.start();
+    pthread_t threads[4];
+    for(int i = 0; i < 4; i++)
+        pthread_create(&threads[i], 0x0, &log_in_thread, &logger);
+    for(int i = 0; i < 4; i++)
+        pthread_join(threads[i], 0x0);
+    logger.stop();
+    LT_CHECK_EQ(delivered.size(), 4000);
+    LT_CHECK_EQ(logger.dropped(), 0);
+    LT_CHECK_EQ(delivered[0].path, "/thread");
+LT_END_AUTO_TEST(records_of_all_threads_delivered)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
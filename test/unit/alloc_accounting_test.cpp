@@ -0,0 +1,92 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <pthread.h>
+#include <vector>
+#include "littletest.hpp"
+#include "details/alloc_accounting.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+void* volatile sink;
+
+void* allocate_elsewhere(void*)
+{
+    vector<char>* v = new vector<char>(4096);
+    delete v;
+    return 0x0;
+}
+
+LT_BEGIN_SUITE(alloc_accounting_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(alloc_accounting_suite)
+
+LT_BEGIN_AUTO_TEST(alloc_accounting_suite, allocations_of_the_thread_counted)
+    alloc_counters request = { 0, 0 };
+    {
+        alloc_scope scope(request);
+        // Kept through a volatile pointer so that the compiler cannot elide the allocations.
+        int* i = new int(1);
+        sink = i;
+        char* buffer = new char[100];
+        sink = buffer;
+        delete[] buffer;
+        delete i;
+
+        // Allocations of other threads are not attributed to the scope.
+        pthread_t other;
+        pthread_create(&other, 0x0, &allocate_elsewhere, 0x0);
+        pthread_join(other, 0x0);
+    }
+#ifdef HTTPSERVER_ALLOC_ACCOUNTING
+    LT_CHECK_EQ(alloc_accounting_enabled(), true);
+    LT_CHECK_EQ(request.allocations, 2);
+    LT_CHECK_EQ(request.bytes, sizeof(int) + 100);
+#else
+    LT_CHECK_EQ(alloc_accounting_enabled(), false);
+    LT_CHECK_EQ(request.allocations, 0);
+    LT_CHECK_EQ(request.bytes, 0);
+#endif
+LT_END_AUTO_TEST(allocations_of_the_thread_counted)
+
+LT_BEGIN_AUTO_TEST(alloc_accounting_suite, totals_summed)
+    alloc_totals totals;
+    alloc_counters first = { 3, 300 };
+    alloc_counters second = { 1, 50 };
+    totals.record(first);
+    totals.record(second);
+    alloc_stats stats = totals.get();
+    LT_CHECK_EQ(stats.enabled, alloc_accounting_enabled());
+    LT_CHECK_EQ(stats.requests, 2);
+    LT_CHECK_EQ(stats.allocations, 4);
+    LT_CHECK_EQ(stats.allocated_bytes, 350);
+LT_END_AUTO_TEST(totals_summed)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
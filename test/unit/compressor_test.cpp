@@ -0,0 +1,96 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string>
+#include "littletest.hpp"
+#include "details/compressor.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+LT_BEGIN_SUITE(compressor_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(compressor_suite)
+
+LT_BEGIN_AUTO_TEST(compressor_suite, identical_contents_compressed_once)
+    if(!compression_supported("gzip"))
+        return;
+    compression_cache cache(1 << 20);
+    string content(4096, 'a');
+    shared_ptr<const string> first = cache.get("gzip", content);
+    shared_ptr<const string> second = cache.get("gzip", content);
+    LT_ASSERT_EQ(first != 0x0, true);
+    LT_CHECK_EQ(first == second, true);
+LT_END_AUTO_TEST(identical_contents_compressed_once)
+
+LT_BEGIN_AUTO_TEST(compressor_suite, contents_of_same_size_not_confused)
+    if(!compression_supported("gzip"))
+        return;
+    compression_cache cache(1 << 20);
+    string first_content(4096, 'a');
+    string second_content(4096, 'b');
+    shared_ptr<const string> first = cache.get("gzip", first_content);
+    shared_ptr<const string> second = cache.get("gzip", second_content);
+    LT_ASSERT_EQ(first != 0x0, true);
+    LT_ASSERT_EQ(second != 0x0, true);
+    LT_CHECK_EQ(*first != *second, true);
+    LT_CHECK_EQ(cache.get("gzip", second_content) == second, true);
+LT_END_AUTO_TEST(contents_of_same_size_not_confused)
+
+LT_BEGIN_AUTO_TEST(compressor_suite, unsupported_coding_not_compressed)
+    compression_cache cache(1 << 20);
+    string content(4096, 'a');
+    LT_CHECK_EQ(compress("unknown", content) == 0x0, true);
+    LT_CHECK_EQ(cache.get("unknown", content) == 0x0, true);
+LT_END_AUTO_TEST(unsupported_coding_not_compressed)
+
+LT_BEGIN_AUTO_TEST(compressor_suite, cache_bounded_by_contents_and_bodies)
+    if(!compression_supported("gzip"))
+        return;
+    // Only room for one content and its body: caching the second evicts the first.
+    compression_cache cache(6000);
+    string first_content(4096, 'a');
+    string second_content(4096, 'b');
+    shared_ptr<const string> first = cache.get("gzip", first_content);
+    cache.get("gzip", second_content);
+    LT_CHECK_EQ(cache.get("gzip", first_content) != first, true);
+LT_END_AUTO_TEST(cache_bounded_by_contents_and_bodies)
+
+LT_BEGIN_AUTO_TEST(compressor_suite, caches_not_shared)
+    if(!compression_supported("gzip"))
+        return;
+    compression_cache first_cache(1 << 20);
+    compression_cache second_cache(1 << 20);
+    string content(4096, 'a');
+    shared_ptr<const string> first = first_cache.get("gzip", content);
+    LT_CHECK_EQ(second_cache.get("gzip", content) != first, true);
+    LT_CHECK_EQ(first_cache.get("gzip", content) == first, true);
+LT_END_AUTO_TEST(caches_not_shared)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,122 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <pthread.h>
+#include "littletest.hpp"
+#include "details/config_cell.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+void log_first(const std::string&)
+{
+}
+
+void log_second(const std::string&)
+{
+}
+
+runtime_config make_config(int value, http::http_utils::policy_T policy, log_access_ptr logger)
+{
+    runtime_config config;
+    config.connection_timeout = value;
+    config.per_IP_connection_limit = value;
+    config.content_size_limit = value;
+    config.default_policy = policy;
+    config.log_access = logger;
+    config.log_error = logger;
+    return config;
+}
+
+struct reader_state
+{
+    config_cell* cell;
+    int torn;
+};
+
+void* read_configs(void* arg)
+{
+    reader_state* state = static_cast<reader_state*>(arg);
+    for(int i = 0; i < 200000; i++)
+    {
+        runtime_config config = state->cell->load();
+        bool first = config.connection_timeout == 1 && config.default_policy == http::http_utils::ACCEPT &&
+            config.log_access == &log_first;
+        bool second = config.connection_timeout == 2 && config.default_policy == http::http_utils::REJECT &&
+            config.log_access == &log_second;
+        if(!(first || second) || config.per_IP_connection_limit != config.connection_timeout ||
+                config.content_size_limit != static_cast<size_t>(config.connection_timeout) ||
+                config.log_error != config.log_access)
+            state->torn++;
+    }
+    return 0x0;
+}
+
+LT_BEGIN_SUITE(config_cell_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(config_cell_suite)
+
+LT_BEGIN_AUTO_TEST(config_cell_suite, stored_config_loaded)
+    config_cell cell(make_config(1, http::http_utils::ACCEPT, &log_first));
+    LT_CHECK_EQ(cell.load().connection_timeout, 1);
+    cell.store(make_config(2, http::http_utils::REJECT, &log_second));
+    runtime_config config = cell.load();
+    LT_CHECK_EQ(config.connection_timeout, 2);
+    LT_CHECK_EQ(config.per_IP_connection_limit, 2);
+    LT_CHECK_EQ(config.content_size_limit, 2);
+    LT_CHECK_EQ(config.default_policy, http::http_utils::REJECT);
+    LT_CHECK_EQ(config.log_access == &log_second, true);
+    LT_CHECK_EQ(config.log_error == &log_second, true);
+LT_END_AUTO_TEST(stored_config_loaded)
+
+LT_BEGIN_AUTO_TEST(config_cell_suite, readers_never_see_partial_configs)
+    config_cell cell(make_config(1, http::http_utils::ACCEPT, &log_first));
+    reader_state states[4];
+    pthread_t readers[4];
+    for(int i = 0; i < 4; i++)
+    {
+        states[i].cell = &cell;
+        states[i].torn = 0;
+        pthread_create(&readers[i], 0x0, &read_configs, &states[i]);
+    }
+    for(int i = 0; i < 20000; i++)
+    {
+        if(i % 2 == 0)
+            cell.store(make_config(2, http::http_utils::REJECT, &log_second));
+        else
+            cell.store(make_config(1, http::http_utils::ACCEPT, &log_first));
+    }
+    for(int i = 0; i < 4; i++)
+    {
+        pthread_join(readers[i], 0x0);
+        LT_CHECK_EQ(states[i].torn, 0);
+    }
+LT_END_AUTO_TEST(readers_never_see_partial_configs)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,97 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "littletest.hpp"
+#include "details/connection_registry.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+LT_BEGIN_SUITE(connection_registry_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(connection_registry_suite)
+
+LT_BEGIN_AUTO_TEST(connection_registry_suite, connections_listed)
+    connection_registry registry;
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(8080);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    connection_entry* first = registry.add(-1, (struct sockaddr*) &addr);
+    connection_entry* second = registry.add(-1, 0x0);
+    first->requests.fetch_add(1);
+    first->set_state(connection_info::READING_BODY);
+    LT_CHECK_EQ(registry.size(), 2);
+
+    vector<connection_info> connections = registry.snapshot();
+    LT_ASSERT_EQ(connections.size(), 2);
+    // The most recent connection comes first.
+    LT_CHECK_EQ(connections[0].id, second->id);
+    LT_CHECK_EQ(connections[0].state, connection_info::IDLE);
+    LT_CHECK_EQ(connections[0].peer, "");
+    LT_CHECK_EQ(connections[1].id, first->id);
+    LT_CHECK_EQ(connections[1].peer, "127.0.0.1");
+    LT_CHECK_EQ(connections[1].requests, 1);
+    LT_CHECK_EQ(connections[1].state, connection_info::READING_BODY);
+    LT_CHECK_EQ(pthread_equal(connections[1].thread, pthread_self()) != 0, true);
+    LT_CHECK_EQ(connections[1].id != connections[0].id, true);
+
+    registry.remove(second);
+    connections = registry.snapshot();
+    LT_ASSERT_EQ(connections.size(), 1);
+    LT_CHECK_EQ(connections[0].id, first->id);
+    registry.remove(first);
+    LT_CHECK_EQ(registry.size(), 0);
+LT_END_AUTO_TEST(connections_listed)
+
+LT_BEGIN_AUTO_TEST(connection_registry_suite, connection_closed_on_demand)
+    connection_registry registry;
+    int fds[2];
+    LT_ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    connection_entry* entry = registry.add(fds[0], 0x0);
+    LT_CHECK_EQ(registry.close(entry->id + 1), false);
+    LT_CHECK_EQ(registry.close(entry->id), true);
+
+    // The peer sees the connection closed while the descriptor is still open.
+    char c;
+    LT_CHECK_EQ(read(fds[1], &c, 1), 0);
+    LT_CHECK_EQ(send(fds[0], "x", 1, MSG_NOSIGNAL), -1);
+
+    registry.remove(entry);
+    close(fds[0]);
+    close(fds[1]);
+LT_END_AUTO_TEST(connection_closed_on_demand)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,90 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <unistd.h>
+#include "littletest.hpp"
+#include "details/credential_cache.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+int calls = 0;
+
+bool verify(const std::string& user, const std::string& pass)
+{
+    calls++;
+    return user == "user" && pass == "secret";
+}
+
+LT_BEGIN_SUITE(credential_cache_suite)
+    void set_up()
+    {
+        calls = 0;
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(credential_cache_suite)
+
+LT_BEGIN_AUTO_TEST(credential_cache_suite, siphash_reference_vector)
+    // Reference vector from the SipHash paper: key 00..0f, message 00..0e.
+    unsigned char message[15];
+    for(int i = 0; i < 15; i++) message[i] = i;
+    LT_CHECK_EQ(siphash24(0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, message, 15), 0xa129ca6149be45e5ULL);
+LT_END_AUTO_TEST(siphash_reference_vector)
+
+LT_BEGIN_AUTO_TEST(credential_cache_suite, successful_checks_are_cached)
+    credential_cache cache(&verify, 16, 60);
+    LT_CHECK_EQ(cache.check("user", "secret"), true);
+    LT_CHECK_EQ(cache.check("user", "secret"), true);
+    LT_CHECK_EQ(calls, 1);
+    LT_CHECK_EQ(cache.size(), 1);
+
+    LT_CHECK_EQ(cache.check("user", "wrong"), false);
+    LT_CHECK_EQ(cache.check("user", "wrong"), false);
+    LT_CHECK_EQ(calls, 3);
+    LT_CHECK_EQ(cache.size(), 1);
+
+    cache.clear();
+    LT_CHECK_EQ(cache.check("user", "secret"), true);
+    LT_CHECK_EQ(calls, 4);
+LT_END_AUTO_TEST(successful_checks_are_cached)
+
+LT_BEGIN_AUTO_TEST(credential_cache_suite, entries_expire)
+    credential_cache cache(&verify, 16, 1);
+    LT_CHECK_EQ(cache.check("user", "secret"), true);
+    sleep(2);
+    LT_CHECK_EQ(cache.check("user", "secret"), true);
+    LT_CHECK_EQ(calls, 2);
+LT_END_AUTO_TEST(entries_expire)
+
+LT_BEGIN_AUTO_TEST(credential_cache_suite, disabled_cache)
+    credential_cache cache(&verify, 0, 60);
+    LT_CHECK_EQ(cache.check("user", "secret"), true);
+    LT_CHECK_EQ(cache.check("user", "secret"), true);
+    LT_CHECK_EQ(calls, 2);
+    LT_CHECK_EQ(cache.size(), 0);
+LT_END_AUTO_TEST(disabled_cache)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,138 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <unistd.h>
+#include "littletest.hpp"
+#include "details/digest_auth.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+LT_BEGIN_SUITE(digest_auth_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(digest_auth_suite)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, md5_vectors)
+    LT_CHECK_EQ(md5_hex(""), "d41d8cd98f00b204e9800998ecf8427e");
+    LT_CHECK_EQ(md5_hex("abc"), "900150983cd24fb0d6963f7d28e17f72");
+    LT_CHECK_EQ(md5_hex("12345678901234567890123456789012345678901234567890123456789012345678901234567890"),
+            "57edf4a22be3c955ac49da2e2107b67a");
+LT_END_AUTO_TEST(md5_vectors)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, sha256_vectors)
+    LT_CHECK_EQ(sha256_hex(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    LT_CHECK_EQ(sha256_hex("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    LT_CHECK_EQ(sha256_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+LT_END_AUTO_TEST(sha256_vectors)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, rfc7616_example)
+    digest_credentials credentials;
+    LT_ASSERT_EQ(parse_digest_authorization("Digest username=\"Mufasa\", realm=\"http-auth@example.org\", "
+                "uri=\"/dir/index.html\", algorithm=SHA-256, "
+                "nonce=\"7ypf/xlj9XXwfDPEoM4URrv/xwf94BcCAzFZH4GiTo0v\", nc=00000001, "
+                "cnonce=\"f2/wE4q74E6zIJEtWaHKaf5wv/H5QzzpXusqGemxURZJ\", qop=auth, "
+                "response=\"753927fa0e85d155564e2e272a28d1802ca10daf4496794697cf8db5856cb6c1\", "
+                "opaque=\"FQhe/qaU925kfnzjCev0ciny7QMkPqMAFRtzCUYo5tdS\"", credentials), true);
+    LT_CHECK_EQ(credentials.username, "Mufasa");
+    LT_CHECK_EQ(credentials.algorithm, "SHA-256");
+    LT_CHECK_EQ(credentials.nc, "00000001");
+    LT_CHECK_EQ(credentials.opaque, "FQhe/qaU925kfnzjCev0ciny7QMkPqMAFRtzCUYo5tdS");
+    LT_CHECK_EQ(digest_response(credentials, "SHA-256", "Circle of Life", "GET"), credentials.response);
+    LT_CHECK_EQ(digest_response(credentials, "MD5", "Circle of Life", "GET"), "8ca523f5e9506fed4657c9700eebdbec");
+    LT_CHECK_EQ(digest_response(credentials, "SHA-512-256", "Circle of Life", "GET"), "");
+LT_END_AUTO_TEST(rfc7616_example)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, malformed_authorization)
+    digest_credentials credentials;
+    LT_CHECK_EQ(parse_digest_authorization("Basic dXNlcjpwYXNz", credentials), false);
+    LT_CHECK_EQ(parse_digest_authorization("Digest username=\"user", credentials), false);
+    LT_CHECK_EQ(parse_digest_authorization("Digest username=\"user\", nonce=\"n\"", credentials), false);
+    LT_CHECK_EQ(parse_digest_authorization("Digest =x", credentials), false);
+LT_END_AUTO_TEST(malformed_authorization)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, nonce_counts_cannot_be_replayed)
+    sharded_nonce_store store(64, 60);
+    string nonce = store.issue();
+    LT_CHECK_EQ(store.check(nonce, 1), nonce_store::VALID);
+    LT_CHECK_EQ(store.check(nonce, 1), nonce_store::INVALID);
+    LT_CHECK_EQ(store.check(nonce, 3), nonce_store::VALID);
+    // pipelined requests can arrive out of order
+    LT_CHECK_EQ(store.check(nonce, 2), nonce_store::VALID);
+    LT_CHECK_EQ(store.check(nonce, 2), nonce_store::INVALID);
+    LT_CHECK_EQ(store.check(nonce, 100), nonce_store::VALID);
+    LT_CHECK_EQ(store.check(nonce, 3), nonce_store::INVALID);
+    LT_CHECK_EQ(store.check(nonce, 0), nonce_store::INVALID);
+    LT_CHECK_EQ(store.get_stats().replays, 3);
+LT_END_AUTO_TEST(nonce_counts_cannot_be_replayed)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, unknown_and_expired_nonces_are_stale)
+    sharded_nonce_store store(64, 0);
+    LT_CHECK_EQ(store.check("0123", 1), nonce_store::STALE);
+    LT_CHECK_EQ(store.check("zz", 1), nonce_store::STALE);
+    string nonce = store.issue();
+    sleep(1);
+    LT_CHECK_EQ(store.check(nonce, 1), nonce_store::STALE);
+    LT_CHECK_EQ(store.get_stats().stale, 3);
+LT_END_AUTO_TEST(unknown_and_expired_nonces_are_stale)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, capacity_is_bounded)
+    sharded_nonce_store store(32, 60);
+    string first = store.issue();
+    for(int i = 0; i < 100; i++)
+        store.issue();
+    nonce_stats stats = store.get_stats();
+    LT_CHECK_EQ(stats.capacity, 32);
+    LT_CHECK_EQ(stats.size, 32);
+    LT_CHECK_EQ(stats.issued, 101);
+    LT_CHECK_EQ(store.check(first, 1), nonce_store::STALE);
+LT_END_AUTO_TEST(capacity_is_bounded)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, challenge_offers_both_algorithms)
+    string challenge = digest_challenge("te\"st", "abc", "xyz", true);
+    LT_CHECK_EQ(challenge, "Digest realm=\"te\\\"st\", qop=\"auth\", nonce=\"abc\", opaque=\"xyz\", stale=true, algorithm=SHA-256, "
+            "Digest realm=\"te\\\"st\", qop=\"auth\", nonce=\"abc\", opaque=\"xyz\", stale=true, algorithm=MD5");
+LT_END_AUTO_TEST(challenge_offers_both_algorithms)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, digests_compared_whole)
+    LT_CHECK_EQ(equal_digests("0123abcd", "0123abcd"), true);
+    LT_CHECK_EQ(equal_digests("0123abcd", "0123abce"), false);
+    LT_CHECK_EQ(equal_digests("0123abcd", "0123abc"), false);
+    LT_CHECK_EQ(equal_digests("", ""), true);
+LT_END_AUTO_TEST(digests_compared_whole)
+
+LT_BEGIN_AUTO_TEST(digest_auth_suite, nonces_not_repeated)
+    sharded_nonce_store store(1024, 300);
+    std::string first = store.issue();
+    std::string second = store.issue();
+    LT_CHECK_EQ(first.size(), 33);
+    LT_CHECK_NEQ(first.substr(1), second.substr(1));
+LT_END_AUTO_TEST(nonces_not_repeated)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,137 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "littletest.hpp"
+#include "details/error_log.hpp"
+#include "details/access_logger.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+string format(const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    size_t length;
+    const char* message = format_error(fmt, ap, length);
+    va_end(ap);
+    return string(message, length);
+}
+
+vector<error_record> delivered;
+
+void collect(const vector<error_record>& records)
+{
+    delivered.insert(delivered.end(), records.begin(), records.end());
+}
+
+LT_BEGIN_SUITE(error_log_suite)
+    void set_up()
+    {
+        delivered.clear();
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(error_log_suite)
+
+LT_BEGIN_AUTO_TEST(error_log_suite, messages_formatted_with_arguments)
+    LT_CHECK_EQ(format("Failed to bind to port %u: %s\n", 8080, "Address already in use"),
+            "Failed to bind to port 8080: Address already in use");
+    LT_CHECK_EQ(format("no arguments"), "no arguments");
+    LT_CHECK_EQ(format("%s\r\n", ""), "");
+    LT_CHECK_EQ(format("%s", string(5000, 'x').c_str()).size(), 1023);
+LT_END_AUTO_TEST(messages_formatted_with_arguments)
+
+LT_BEGIN_AUTO_TEST(error_log_suite, messages_classified)
+    error_record::severity_T severity;
+    error_record::category_T category;
+    classify_error("Failed to bind to port %u: %s\n", severity, category);
+    LT_CHECK_EQ(severity, error_record::CRITICAL);
+    LT_CHECK_EQ(category, error_record::SYSTEM);
+    classify_error("Server reached connection limit. Closing inbound connection.\n", severity, category);
+    LT_CHECK_EQ(severity, error_record::ERROR);
+    LT_CHECK_EQ(category, error_record::RESOURCES);
+    classify_error("Error accepting connection: %s\n", severity, category);
+    LT_CHECK_EQ(severity, error_record::WARNING);
+    LT_CHECK_EQ(category, error_record::CONNECTION);
+    classify_error("Received malformed HTTP request (bad chunked encoding). Closing connection.\n", severity, category);
+    LT_CHECK_EQ(category, error_record::PROTOCOL);
+    classify_error("Error: received handshake message out of context.\n", severity, category);
+    LT_CHECK_EQ(category, error_record::TLS);
+    classify_error("Application reported internal error, closing connection.\n", severity, category);
+    LT_CHECK_EQ(category, error_record::APPLICATION);
+    classify_error("Something else", severity, category);
+    LT_CHECK_EQ(severity, error_record::ERROR);
+    LT_CHECK_EQ(category, error_record::OTHER);
+LT_END_AUTO_TEST(messages_classified)
+
+LT_BEGIN_AUTO_TEST(error_log_suite, identical_messages_limited)
+    message_limiter limiter(2, 1000);
+    unsigned long long suppressed;
+    const char* flood = "Error accepting connection: Too many open files";
+    const char* other = "Failed to receive data: Connection reset by peer";
+    LT_CHECK_EQ(limiter.allow(flood, strlen(flood), 0, suppressed), true);
+    LT_CHECK_EQ(limiter.allow(flood, strlen(flood), 10, suppressed), true);
+    for(int i = 0; i < 5; i++)
+        LT_CHECK_EQ(limiter.allow(flood, strlen(flood), 20, suppressed), false);
+    LT_CHECK_EQ(limiter.allow(other, strlen(other), 30, suppressed), true);
+    LT_CHECK_EQ(suppressed, 0);
+    LT_CHECK_EQ(limiter.suppressed(), 5);
+
+    // The first occurrence of the next window carries the count of the suppressed ones.
+    LT_CHECK_EQ(limiter.allow(flood, strlen(flood), 1000000, suppressed), true);
+    LT_CHECK_EQ(suppressed, 5);
+    LT_CHECK_EQ(limiter.allow(flood, strlen(flood), 1000010, suppressed), true);
+    LT_CHECK_EQ(suppressed, 0);
+LT_END_AUTO_TEST(identical_messages_limited)
+
+LT_BEGIN_AUTO_TEST(error_log_suite, unlimited_without_burst)
+    message_limiter limiter(0, 1000);
+    unsigned long long suppressed;
+    for(int i = 0; i < 100; i++)
+        LT_CHECK_EQ(limiter.allow("same", 4, 0, suppressed), true);
+    LT_CHECK_EQ(limiter.suppressed(), 0);
+LT_END_AUTO_TEST(unlimited_without_burst)
+
+LT_BEGIN_AUTO_TEST(error_log_suite, records_delivered_through_ring)
+    error_logger logger(&collect, 16, 1000);
+    error_record record;
+    record.severity = error_record::WARNING;
+    record.category = error_record::CONNECTION;
+    record.message = "Failed to receive data";
+    record.suppressed = 3;
+    logger.log(record);
+    LT_CHECK_EQ(logger.flush(), 1);
+    LT_ASSERT_EQ(delivered.size(), 1);
+    LT_CHECK_EQ(delivered[0].message, "Failed to receive data");
+    LT_CHECK_EQ(delivered[0].suppressed, 3);
+    LT_CHECK_EQ(delivered[0].category, error_record::CONNECTION);
+LT_END_AUTO_TEST(records_delivered_through_ring)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
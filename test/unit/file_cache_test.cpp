@@ -0,0 +1,134 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include "littletest.hpp"
+#include "details/file_cache.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+void write_file(const string& path, const string& content)
+{
+    FILE* f = fopen(path.c_str(), "w");
+    fwrite(content.data(), 1, content.size(), f);
+    fclose(f);
+}
+
+LT_BEGIN_SUITE(file_cache_suite)
+    string first;
+    string second;
+    string third;
+
+    void set_up()
+    {
+        char dir[] = "/tmp/file_cache_testXXXXXX";
+        string base = mkdtemp(dir);
+        first = base + "/first";
+        second = base + "/second";
+        third = base + "/third";
+        write_file(first, "first");
+        write_file(second, "second");
+        write_file(third, "third");
+    }
+
+    void tear_down()
+    {
+        unlink(first.c_str());
+        unlink(second.c_str());
+        unlink(third.c_str());
+        rmdir(first.substr(0, first.rfind('/')).c_str());
+    }
+LT_END_SUITE(file_cache_suite)
+
+LT_BEGIN_AUTO_TEST(file_cache_suite, cached_entry_reused)
+    file_cache cache(4, 3600);
+    shared_ptr<file_cache_entry> entry = cache.get(first);
+    LT_CHECK_EQ(entry->size, 5);
+    LT_CHECK_EQ(cache.get(first) == entry, true);
+    LT_CHECK_EQ(cache.size(), 1);
+LT_END_AUTO_TEST(cached_entry_reused)
+
+LT_BEGIN_AUTO_TEST(file_cache_suite, least_recently_used_evicted)
+    file_cache cache(2, 3600);
+    shared_ptr<file_cache_entry> a = cache.get(first);
+    shared_ptr<file_cache_entry> b = cache.get(second);
+    cache.get(first);
+    cache.get(third);
+    LT_CHECK_EQ(cache.size(), 2);
+    LT_CHECK_EQ(cache.get(first) == a, true);
+    LT_CHECK_EQ(cache.get(second) == b, false);
+LT_END_AUTO_TEST(least_recently_used_evicted)
+
+LT_BEGIN_AUTO_TEST(file_cache_suite, fresh_entries_not_revalidated)
+    file_cache cache(4, 3600);
+    shared_ptr<file_cache_entry> entry = cache.get(first);
+    write_file(first, "first, rewritten");
+    LT_CHECK_EQ(cache.get(first) == entry, true);
+LT_END_AUTO_TEST(fresh_entries_not_revalidated)
+
+LT_BEGIN_AUTO_TEST(file_cache_suite, unchanged_file_revalidated)
+    file_cache cache(4, 0);
+    shared_ptr<file_cache_entry> entry = cache.get(first);
+    LT_CHECK_EQ(cache.get(first) == entry, true);
+LT_END_AUTO_TEST(unchanged_file_revalidated)
+
+LT_BEGIN_AUTO_TEST(file_cache_suite, modified_file_reopened)
+    file_cache cache(4, 0);
+    shared_ptr<file_cache_entry> entry = cache.get(first);
+    write_file(first, "first, rewritten");
+    shared_ptr<file_cache_entry> reopened = cache.get(first);
+    LT_CHECK_EQ(reopened == entry, false);
+    LT_CHECK_EQ(reopened->size, 16);
+    LT_CHECK_EQ(cache.size(), 1);
+LT_END_AUTO_TEST(modified_file_reopened)
+
+LT_BEGIN_AUTO_TEST(file_cache_suite, replaced_file_reopened)
+    file_cache cache(4, 0);
+    shared_ptr<file_cache_entry> entry = cache.get(first);
+    // Same size, different inode.
+    write_file(third, "FIRST");
+    rename(third.c_str(), first.c_str());
+    shared_ptr<file_cache_entry> reopened = cache.get(first);
+    LT_CHECK_EQ(reopened == entry, false);
+    LT_CHECK_EQ(reopened->inode == entry->inode, false);
+LT_END_AUTO_TEST(replaced_file_reopened)
+
+LT_BEGIN_AUTO_TEST(file_cache_suite, deleted_file_dropped)
+    file_cache cache(4, 0);
+    cache.get(first);
+    unlink(first.c_str());
+    LT_CHECK_THROW(cache.get(first));
+    LT_CHECK_EQ(cache.size(), 0);
+LT_END_AUTO_TEST(deleted_file_dropped)
+
+LT_BEGIN_AUTO_TEST(file_cache_suite, disabled_cache_keeps_nothing)
+    file_cache cache(0, 3600);
+    shared_ptr<file_cache_entry> entry = cache.get(first);
+    LT_CHECK_EQ(entry->size, 5);
+    LT_CHECK_EQ(cache.size(), 0);
+LT_END_AUTO_TEST(disabled_cache_keeps_nothing)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
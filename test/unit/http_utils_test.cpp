@@ -602,6 +602,96 @@ LT_BEGIN_AUTO_TEST(http_utils_suite, dump_arg_map_no_prefix)
     LT_CHECK_EQ(ss.str(), "     [ARG_ONE:\"VALUE_ONE\" ARG_TWO:\"VALUE_TWO\" ARG_THREE:\"VALUE_THREE\" ]\n");
 LT_END_AUTO_TEST(dump_arg_map_no_prefix)
 
+LT_BEGIN_AUTO_TEST(http_utils_suite, parse_byte_ranges)
+    std::vector<std::pair<uint64_t, uint64_t> > ranges;
+
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=0-9", 100, ranges), true);
+    LT_CHECK_EQ(ranges.size(), 1);
+    LT_CHECK_EQ(ranges[0].first, 0);
+    LT_CHECK_EQ(ranges[0].second, 9);
+
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=90-", 100, ranges), true);
+    LT_CHECK_EQ(ranges.size(), 1);
+    LT_CHECK_EQ(ranges[0].first, 90);
+    LT_CHECK_EQ(ranges[0].second, 99);
+
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=-20", 100, ranges), true);
+    LT_CHECK_EQ(ranges.size(), 1);
+    LT_CHECK_EQ(ranges[0].first, 80);
+    LT_CHECK_EQ(ranges[0].second, 99);
+
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=50-150", 100, ranges), true);
+    LT_CHECK_EQ(ranges.size(), 1);
+    LT_CHECK_EQ(ranges[0].second, 99);
+LT_END_AUTO_TEST(parse_byte_ranges)
+
+LT_BEGIN_AUTO_TEST(http_utils_suite, parse_byte_ranges_multiple)
+    std::vector<std::pair<uint64_t, uint64_t> > ranges;
+
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=50-59, 0-9", 100, ranges), true);
+    LT_CHECK_EQ(ranges.size(), 2);
+    LT_CHECK_EQ(ranges[0].first, 0);
+    LT_CHECK_EQ(ranges[1].first, 50);
+
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=0-9,10-19,15-30", 100, ranges), true);
+    LT_CHECK_EQ(ranges.size(), 1);
+    LT_CHECK_EQ(ranges[0].first, 0);
+    LT_CHECK_EQ(ranges[0].second, 30);
+LT_END_AUTO_TEST(parse_byte_ranges_multiple)
+
+LT_BEGIN_AUTO_TEST(http_utils_suite, parse_byte_ranges_unsatisfiable)
+    std::vector<std::pair<uint64_t, uint64_t> > ranges;
+
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=100-200", 100, ranges), true);
+    LT_CHECK_EQ(ranges.size(), 0);
+
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=-0", 100, ranges), true);
+    LT_CHECK_EQ(ranges.size(), 0);
+LT_END_AUTO_TEST(parse_byte_ranges_unsatisfiable)
+
+LT_BEGIN_AUTO_TEST(http_utils_suite, parse_byte_ranges_invalid)
+    std::vector<std::pair<uint64_t, uint64_t> > ranges;
+
+    LT_CHECK_EQ(http::parse_byte_ranges("items=0-9", 100, ranges), false);
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=9-0", 100, ranges), false);
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=a-b", 100, ranges), false);
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=", 100, ranges), false);
+    LT_CHECK_EQ(http::parse_byte_ranges("bytes=10", 100, ranges), false);
+LT_END_AUTO_TEST(parse_byte_ranges_invalid)
+
+LT_BEGIN_AUTO_TEST(http_utils_suite, http_date)
+    LT_CHECK_EQ(http::format_http_date(784111777), "Sun, 06 Nov 1994 08:49:37 GMT");
+    LT_CHECK_EQ(http::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT"), 784111777);
+    LT_CHECK_EQ(http::parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT"), 784111777);
+    LT_CHECK_EQ(http::parse_http_date("Sun Nov  6 08:49:37 1994"), 784111777);
+    LT_CHECK_EQ(http::parse_http_date("not a date"), -1);
+LT_END_AUTO_TEST(http_date)
+
+LT_BEGIN_AUTO_TEST(http_utils_suite, accepted_encodings)
+    std::vector<std::string> available;
+    available.push_back("br");
+    available.push_back("gzip");
+
+    std::vector<std::string> result = http::accepted_encodings("gzip, deflate", available);
+    LT_CHECK_EQ(result.size(), 1);
+    LT_CHECK_EQ(result[0], "gzip");
+
+    result = http::accepted_encodings("gzip, br", available);
+    LT_CHECK_EQ(result.size(), 2);
+    LT_CHECK_EQ(result[0], "br");
+
+    result = http::accepted_encodings("br;q=0.5, gzip", available);
+    LT_CHECK_EQ(result.size(), 2);
+    LT_CHECK_EQ(result[0], "gzip");
+
+    result = http::accepted_encodings("*;q=0.1, br;q=0", available);
+    LT_CHECK_EQ(result.size(), 1);
+    LT_CHECK_EQ(result[0], "gzip");
+
+    result = http::accepted_encodings("identity", available);
+    LT_CHECK_EQ(result.size(), 0);
+LT_END_AUTO_TEST(accepted_encodings)
+
 LT_BEGIN_AUTO_TEST_ENV()
     AUTORUN_TESTS()
 LT_END_AUTO_TEST_ENV()
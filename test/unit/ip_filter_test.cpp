@@ -0,0 +1,261 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#define _WINDOWS
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x600
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+#include <stdexcept>
+
+#include "littletest.hpp"
+#include "details/ip_filter.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+LT_BEGIN_SUITE(ip_filter_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(ip_filter_suite)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, single_address)
+    ip_filter filter;
+    filter.insert("192.168.1.10");
+
+    LT_CHECK_EQ(filter.size(), 1);
+    LT_CHECK_EQ(filter.contains("192.168.1.10"), true);
+    LT_CHECK_EQ(filter.contains("192.168.1.11"), false);
+    LT_CHECK_EQ(filter.contains("10.0.0.1"), false);
+LT_END_AUTO_TEST(single_address)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, ipv4_cidr)
+    ip_filter filter;
+    filter.insert("10.0.0.0/8");
+    filter.insert("172.16.0.0/12");
+
+    LT_CHECK_EQ(filter.contains("10.255.1.2"), true);
+    LT_CHECK_EQ(filter.contains("11.0.0.1"), false);
+    LT_CHECK_EQ(filter.contains("172.31.255.255"), true);
+    LT_CHECK_EQ(filter.contains("172.32.0.0"), false);
+LT_END_AUTO_TEST(ipv4_cidr)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, ipv6_cidr)
+    ip_filter filter;
+    filter.insert("2001:db8::/32");
+
+    LT_CHECK_EQ(filter.contains("2001:db8:1234::1"), true);
+    LT_CHECK_EQ(filter.contains("2001:db9::1"), false);
+    LT_CHECK_EQ(filter.contains("10.0.0.1"), false);
+LT_END_AUTO_TEST(ipv6_cidr)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, ipv4_mapped_addresses)
+    ip_filter filter;
+    filter.insert("10.0.0.0/8");
+
+    LT_CHECK_EQ(filter.contains("::ffff:10.1.2.3"), true);
+LT_END_AUTO_TEST(ipv4_mapped_addresses)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, nested_prefixes)
+    ip_filter filter;
+    filter.insert("10.1.2.3");
+    filter.insert("10.1.0.0/16");
+    filter.insert("10.1.2.0/24");
+
+    LT_CHECK_EQ(filter.size(), 3);
+    LT_CHECK_EQ(filter.contains("10.1.200.1"), true);
+
+    LT_CHECK_EQ(filter.erase("10.1.0.0/16"), true);
+    LT_CHECK_EQ(filter.contains("10.1.200.1"), false);
+    LT_CHECK_EQ(filter.contains("10.1.2.200"), true);
+    LT_CHECK_EQ(filter.erase("10.1.0.0/16"), false);
+    LT_CHECK_EQ(filter.size(), 2);
+LT_END_AUTO_TEST(nested_prefixes)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, wildcards)
+    ip_filter filter;
+    filter.insert("192.168.*.*");
+    filter.insert("10.*.0.1");
+
+    LT_CHECK_EQ(filter.contains("192.168.7.7"), true);
+    LT_CHECK_EQ(filter.contains("192.169.7.7"), false);
+    LT_CHECK_EQ(filter.contains("10.20.0.1"), true);
+    LT_CHECK_EQ(filter.contains("10.20.0.2"), false);
+
+    LT_CHECK_EQ(filter.erase("10.*.0.1"), true);
+    LT_CHECK_EQ(filter.contains("10.20.0.1"), false);
+LT_END_AUTO_TEST(wildcards)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, sockaddr_lookup)
+    ip_filter filter;
+    filter.insert("127.0.0.0/8");
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &addr), true);
+
+    inet_pton(AF_INET, "128.0.0.1", &addr.sin_addr);
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &addr), false);
+LT_END_AUTO_TEST(sockaddr_lookup)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, invalid_rules)
+    ip_filter filter;
+    LT_CHECK_THROW(filter.insert("10.0.0.0/33"));
+    LT_CHECK_THROW(filter.insert("10.0.*.0/16"));
+    LT_CHECK_THROW(filter.insert("10.0.0"));
+    LT_CHECK_EQ(filter.size(), 0);
+LT_END_AUTO_TEST(invalid_rules)
+
+struct sockaddr_in make_addr(const char* ip)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, shared_assign)
+    shared_ip_filter filter;
+    struct sockaddr_in a = make_addr("10.1.2.3");
+    struct sockaddr_in b = make_addr("192.168.1.1");
+
+    filter.insert("10.0.0.0/8");
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &a), true);
+
+    std::vector<std::string> rules;
+    rules.push_back("192.168.0.0/16");
+    rules.push_back("172.16.0.0/12");
+    filter.assign(rules);
+    LT_CHECK_EQ(filter.size(), 2);
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &a), false);
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &b), true);
+
+    rules.push_back("not an ip");
+    LT_CHECK_THROW(filter.assign(rules));
+    LT_CHECK_EQ(filter.size(), 2);
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &b), true);
+
+    LT_CHECK_EQ(filter.erase("192.168.0.0/16"), true);
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &b), false);
+LT_END_AUTO_TEST(shared_assign)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, shared_load_file)
+    char path[] = "/tmp/ip_filter_test_XXXXXX";
+    int fd = mkstemp(path);
+    LT_ASSERT_NEQ(fd, -1);
+    FILE* fp = fdopen(fd, "w");
+    fprintf(fp, "# threat feed\n\n10.0.0.0/8\n  192.168.1.1  # single host\r\n");
+    fclose(fp);
+
+    shared_ip_filter filter;
+    filter.load(path);
+    LT_CHECK_EQ(filter.size(), 2);
+    struct sockaddr_in a = make_addr("10.200.0.1");
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &a), true);
+    struct sockaddr_in b = make_addr("192.168.1.1");
+    LT_CHECK_EQ(filter.contains((struct sockaddr*) &b), true);
+
+    fp = fopen(path, "w");
+    fprintf(fp, "10.0.0.0/8\n10.0.0.0/99\n");
+    fclose(fp);
+    LT_CHECK_THROW(filter.load(path));
+    LT_CHECK_EQ(filter.size(), 2);
+
+    unlink(path);
+    LT_CHECK_THROW(filter.load(path));
+LT_END_AUTO_TEST(shared_load_file)
+
+struct reader_args
+{
+    shared_ip_filter* filter;
+    std::atomic<bool>* stop;
+    long mismatches;
+};
+
+void* reader_thread(void* arg)
+{
+    reader_args* args = static_cast<reader_args*>(arg);
+    struct sockaddr_in always = make_addr("10.0.0.1");
+    while(!args->stop->load())
+    {
+        if(!args->filter->contains((struct sockaddr*) &always))
+            args->mismatches++;
+    }
+    return 0x0;
+}
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, shared_concurrent_swaps)
+    shared_ip_filter filter;
+    filter.insert("10.0.0.0/8");
+    std::atomic<bool> stop(false);
+
+    reader_args args[2];
+    pthread_t threads[2];
+    for(int i = 0; i < 2; i++)
+    {
+        args[i].filter = &filter;
+        args[i].stop = &stop;
+        args[i].mismatches = 0;
+        pthread_create(&threads[i], NULL, reader_thread, &args[i]);
+    }
+
+    std::vector<std::string> rules;
+    rules.push_back("10.0.0.0/8");
+    for(int i = 0; i < 50; i++)
+    {
+        char rule[32];
+        snprintf(rule, sizeof(rule), "172.%d.0.0/16", i);
+        rules.push_back(rule);
+        filter.assign(rules);
+    }
+
+    stop = true;
+    long mismatches = 0;
+    for(int i = 0; i < 2; i++)
+    {
+        pthread_join(threads[i], NULL);
+        mismatches += args[i].mismatches;
+    }
+    LT_CHECK_EQ(mismatches, 0);
+    LT_CHECK_EQ(filter.size(), 51);
+LT_END_AUTO_TEST(shared_concurrent_swaps)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,124 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <pthread.h>
+#include "littletest.hpp"
+#include "details/metrics.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+LT_BEGIN_SUITE(metrics_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(metrics_suite)
+
+void* count_in_thread(void* counter)
+{
+    for(int i = 0; i < 100000; i++)
+        static_cast<sharded_counter*>(counter)->add(1);
+    return 0x0;
+}
+
+LT_BEGIN_AUTO_TEST(metrics_suite, counter_sums_threads)
+    sharded_counter counter;
+    pthread_t threads[4];
+    for(int i = 0; i < 4; i++)
+        pthread_create(&threads[i], 0x0, &count_in_thread, &counter);
+    for(int i = 0; i < 4; i++)
+        pthread_join(threads[i], 0x0);
+    LT_CHECK_EQ(counter.get(), 400000);
+    counter.add(static_cast<uint64_t>(-1));
+    LT_CHECK_EQ(counter.get(), 399999);
+LT_END_AUTO_TEST(counter_sums_threads)
+
+LT_BEGIN_AUTO_TEST(metrics_suite, histogram_buckets)
+    for(uint64_t v = 0; v < 8; v++)
+        LT_CHECK_EQ(latency_histogram::bucket_index(v), v);
+    LT_CHECK_EQ(latency_histogram::bucket_index(8), 8);
+    LT_CHECK_EQ(latency_histogram::bucket_index(15), 15);
+    LT_CHECK_EQ(latency_histogram::bucket_index(16), 16);
+    LT_CHECK_EQ(latency_histogram::bucket_index(17), 16);
+    LT_CHECK_EQ(latency_histogram::bucket_index(18), 17);
+    LT_CHECK_EQ(latency_histogram::bucket_index(~0ULL), latency_histogram::BUCKETS - 1);
+    for(int i = 0; i < latency_histogram::BUCKETS; i++)
+        LT_CHECK_EQ(latency_histogram::bucket_index(latency_histogram::bucket_lower_bound(i)), i);
+LT_END_AUTO_TEST(histogram_buckets)
+
+LT_BEGIN_AUTO_TEST(metrics_suite, histogram_percentiles)
+    latency_histogram histogram;
+    LT_CHECK_EQ(histogram.value_at_percentile(50), 0);
+    for(uint64_t v = 1; v <= 1000; v++)
+        histogram.record(v);
+    LT_CHECK_EQ(histogram.count(), 1000);
+    LT_CHECK_EQ(histogram.sum(), 500500);
+    uint64_t median = histogram.value_at_percentile(50);
+    LT_CHECK_EQ(median >= 500 && median <= 500 * 1.125, true);
+    uint64_t p99 = histogram.value_at_percentile(99);
+    LT_CHECK_EQ(p99 >= 990 && p99 <= 990 * 1.125, true);
+    LT_CHECK_EQ(histogram.count_up_to(7), 7);
+    LT_CHECK_EQ(histogram.count_up_to(1023), 1000);
+LT_END_AUTO_TEST(histogram_percentiles)
+
+LT_BEGIN_AUTO_TEST(metrics_suite, registry_renders_series)
+    metrics_registry registry(16);
+    registry.record_request("GET", "/base", 200);
+    registry.record_request("GET", "/base", 200);
+    registry.record_request("BREW", "/base", 405);
+    registry.record_request("GET", "", 404);
+    registry.record_latency("/base", 150);
+    registry.connection_opened();
+    registry.connection_opened();
+    registry.connection_closed(-1);
+    registry.connection_rejected();
+
+    string text = registry.render();
+    LT_CHECK_EQ(text.find("httpserver_requests_total{method=\"GET\",route=\"/base\",status=\"200\"} 2\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_requests_total{method=\"OTHER\",route=\"/base\",status=\"405\"} 1\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_requests_total{method=\"GET\",route=\"\",status=\"404\"} 1\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_request_duration_seconds_bucket{route=\"/base\",le=\"0.000100\"} 0\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_request_duration_seconds_bucket{route=\"/base\",le=\"0.000250\"} 1\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_request_duration_seconds_sum{route=\"/base\"} 0.000150\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_connections_active 1\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_connections_rejected_total 1\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_metrics_dropped_total 0\n") != string::npos, true);
+LT_END_AUTO_TEST(registry_renders_series)
+
+LT_BEGIN_AUTO_TEST(metrics_suite, full_tables_drop_updates)
+    metrics_registry registry(2);
+    registry.record_request("GET", "/a", 200);
+    registry.record_request("GET", "/b", 200);
+    registry.record_request("GET", "/c", 200);
+    registry.record_request("GET", "/a", 200);
+    string text = registry.render();
+    LT_CHECK_EQ(text.find("route=\"/a\",status=\"200\"} 2\n") != string::npos, true);
+    LT_CHECK_EQ(text.find("route=\"/c\"") == string::npos, true);
+    LT_CHECK_EQ(text.find("httpserver_metrics_dropped_total 1\n") != string::npos, true);
+LT_END_AUTO_TEST(full_tables_drop_updates)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
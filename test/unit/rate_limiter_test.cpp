@@ -0,0 +1,125 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#define _WINDOWS
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x600
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "littletest.hpp"
+#include "details/rate_limiter.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+struct sockaddr_in make_addr(const char* ip)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+LT_BEGIN_SUITE(rate_limiter_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(rate_limiter_suite)
+
+LT_BEGIN_AUTO_TEST(rate_limiter_suite, burst_then_limit)
+    rate_limiter limiter(64);
+    struct sockaddr_in addr = make_addr("10.0.0.1");
+    uint64_t key = rate_limiter::make_key(0x0, (struct sockaddr*) &addr);
+
+    unsigned int retry_after = 0;
+    LT_CHECK_EQ(limiter.consume(key, 0.5, 3, &retry_after), true);
+    LT_CHECK_EQ(limiter.consume(key, 0.5, 3, &retry_after), true);
+    LT_CHECK_EQ(limiter.consume(key, 0.5, 3, &retry_after), true);
+    LT_CHECK_EQ(limiter.consume(key, 0.5, 3, &retry_after), false);
+    LT_CHECK_EQ(retry_after, 2);
+
+    rate_limit_stats stats = limiter.get_stats();
+    LT_CHECK_EQ(stats.allowed, 3);
+    LT_CHECK_EQ(stats.limited, 1);
+    LT_CHECK_EQ(stats.active_buckets, 1);
+LT_END_AUTO_TEST(burst_then_limit)
+
+LT_BEGIN_AUTO_TEST(rate_limiter_suite, refill)
+    rate_limiter limiter(64);
+    struct sockaddr_in addr = make_addr("10.0.0.1");
+    uint64_t key = rate_limiter::make_key(0x0, (struct sockaddr*) &addr);
+
+    LT_CHECK_EQ(limiter.consume(key, 20, 1, 0x0), true);
+    LT_CHECK_EQ(limiter.consume(key, 20, 1, 0x0), false);
+    usleep(100000);
+    LT_CHECK_EQ(limiter.consume(key, 20, 1, 0x0), true);
+LT_END_AUTO_TEST(refill)
+
+LT_BEGIN_AUTO_TEST(rate_limiter_suite, keys_are_independent)
+    rate_limiter limiter(64);
+    struct sockaddr_in a = make_addr("10.0.0.1");
+    struct sockaddr_in b = make_addr("10.0.0.2");
+    int scope;
+    uint64_t key_a = rate_limiter::make_key(0x0, (struct sockaddr*) &a);
+    uint64_t key_b = rate_limiter::make_key(0x0, (struct sockaddr*) &b);
+    uint64_t key_a_scoped = rate_limiter::make_key(&scope, (struct sockaddr*) &a);
+    LT_CHECK_NEQ(key_a, key_b);
+    LT_CHECK_NEQ(key_a, key_a_scoped);
+
+    LT_CHECK_EQ(limiter.consume(key_a, 1, 1, 0x0), true);
+    LT_CHECK_EQ(limiter.consume(key_a, 1, 1, 0x0), false);
+    LT_CHECK_EQ(limiter.consume(key_b, 1, 1, 0x0), true);
+    LT_CHECK_EQ(limiter.consume(key_a_scoped, 1, 1, 0x0), true);
+LT_END_AUTO_TEST(keys_are_independent)
+
+LT_BEGIN_AUTO_TEST(rate_limiter_suite, saturated_table)
+    rate_limiter limiter(8);
+    char ip[32];
+    for(int i = 0; i < 64; i++)
+    {
+        snprintf(ip, sizeof(ip), "10.0.0.%d", i);
+        struct sockaddr_in addr = make_addr(ip);
+        limiter.consume(rate_limiter::make_key(0x0, (struct sockaddr*) &addr), 1, 100, 0x0);
+    }
+    rate_limit_stats stats = limiter.get_stats();
+    LT_CHECK_EQ(stats.capacity, 8);
+    LT_CHECK_EQ(stats.active_buckets, 8);
+    LT_CHECK_EQ(stats.allowed, 64);
+    LT_CHECK_EQ(stats.overflows, 56);
+LT_END_AUTO_TEST(saturated_table)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
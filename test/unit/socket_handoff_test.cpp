@@ -0,0 +1,102 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "littletest.hpp"
+#include "socket_handoff.hpp"
+
+using namespace httpserver;
+using namespace std;
+
+LT_BEGIN_SUITE(socket_handoff_suite)
+    int channel[2];
+    int listener;
+    struct sockaddr_in address;
+
+    void set_up()
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, channel);
+
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        socklen_t length = sizeof(address);
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        bind(listener, (struct sockaddr*) &address, sizeof(address));
+        listen(listener, 4);
+        getsockname(listener, (struct sockaddr*) &address, &length);
+    }
+
+    void tear_down()
+    {
+        close(listener);
+        close(channel[0]);
+        close(channel[1]);
+    }
+LT_END_SUITE(socket_handoff_suite)
+
+LT_BEGIN_AUTO_TEST(socket_handoff_suite, received_socket_accepts_connections)
+    LT_CHECK_EQ(send_listen_socket(channel[0], listener), true);
+    MHD_socket received = receive_listen_socket(channel[1]);
+    LT_CHECK_NEQ(received, MHD_INVALID_SOCKET);
+    LT_CHECK_NEQ(received, listener);
+
+    struct sockaddr_in bound;
+    socklen_t length = sizeof(bound);
+    getsockname(received, (struct sockaddr*) &bound, &length);
+    LT_CHECK_EQ(bound.sin_port, address.sin_port);
+
+    // The original socket can go away: the received one keeps the port open.
+    close(listener);
+    listener = received;
+
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    LT_CHECK_EQ(connect(client, (struct sockaddr*) &address, sizeof(address)), 0);
+    int accepted = accept(received, 0x0, 0x0);
+    LT_CHECK_GT(accepted, 0);
+    close(accepted);
+    close(client);
+LT_END_AUTO_TEST(received_socket_accepts_connections)
+
+LT_BEGIN_AUTO_TEST(socket_handoff_suite, invalid_socket_not_sent)
+    LT_CHECK_EQ(send_listen_socket(channel[0], MHD_INVALID_SOCKET), false);
+LT_END_AUTO_TEST(invalid_socket_not_sent)
+
+LT_BEGIN_AUTO_TEST(socket_handoff_suite, nothing_received_without_descriptor)
+    char data = 'x';
+    LT_CHECK_EQ(write(channel[0], &data, 1), 1);
+    LT_CHECK_EQ(receive_listen_socket(channel[1]), MHD_INVALID_SOCKET);
+LT_END_AUTO_TEST(nothing_received_without_descriptor)
+
+LT_BEGIN_AUTO_TEST(socket_handoff_suite, closed_channel_receives_nothing)
+    close(channel[0]);
+    channel[0] = -1;
+    LT_CHECK_EQ(receive_listen_socket(channel[1]), MHD_INVALID_SOCKET);
+LT_END_AUTO_TEST(closed_channel_receives_nothing)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,126 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdexcept>
+#include "littletest.hpp"
+#include "details/tls_manager.hpp"
+#include "http_utils.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+LT_BEGIN_SUITE(tls_manager_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(tls_manager_suite)
+
+LT_BEGIN_AUTO_TEST(tls_manager_suite, session_cache_store_retrieve)
+    tls_session_cache cache(4);
+    cache.store("id1", "session1");
+    string data;
+    LT_CHECK_EQ(cache.retrieve("id1", data), true);
+    LT_CHECK_EQ(data, "session1");
+    LT_CHECK_EQ(cache.retrieve("id2", data), false);
+    cache.remove("id1");
+    LT_CHECK_EQ(cache.retrieve("id1", data), false);
+    LT_CHECK_EQ(cache.size(), 0);
+LT_END_AUTO_TEST(session_cache_store_retrieve)
+
+LT_BEGIN_AUTO_TEST(tls_manager_suite, session_cache_evicts_least_recently_used)
+    tls_session_cache cache(2);
+    cache.store("id1", "session1");
+    cache.store("id2", "session2");
+    string data;
+    cache.retrieve("id1", data);
+    cache.store("id3", "session3");
+    LT_CHECK_EQ(cache.size(), 2);
+    LT_CHECK_EQ(cache.retrieve("id1", data), true);
+    LT_CHECK_EQ(cache.retrieve("id2", data), false);
+    LT_CHECK_EQ(cache.retrieve("id3", data), true);
+LT_END_AUTO_TEST(session_cache_evicts_least_recently_used)
+
+LT_BEGIN_AUTO_TEST(tls_manager_suite, session_cache_disabled)
+    tls_session_cache cache(0);
+    cache.store("id1", "session1");
+    string data;
+    LT_CHECK_EQ(cache.is_enabled(), false);
+    LT_CHECK_EQ(cache.retrieve("id1", data), false);
+LT_END_AUTO_TEST(session_cache_disabled)
+
+LT_BEGIN_AUTO_TEST(tls_manager_suite, ticket_key_size_checked)
+    LT_CHECK_THROW(tls_manager("", "", "", "", true, "short", 0, 16));
+    tls_manager manager("", "", "", "", true, string(tls_manager::TICKET_KEY_SIZE, 'k'), 0, 16);
+    LT_CHECK_THROW(manager.set_ticket_key(string(tls_manager::TICKET_KEY_SIZE + 1, 'k')));
+    manager.set_ticket_key(string(tls_manager::TICKET_KEY_SIZE, 'j'));
+    LT_CHECK_EQ(manager.get_stats().full_handshakes, 0);
+    LT_CHECK_EQ(manager.get_stats().resumed_handshakes, 0);
+LT_END_AUTO_TEST(ticket_key_size_checked)
+
+LT_BEGIN_AUTO_TEST(tls_manager_suite, no_kernel_tls_without_session)
+    tls_manager manager("", "", "", "", true, "", 0, 16);
+    LT_CHECK_EQ(tls_manager::is_kernel_tls(0x0), false);
+    manager.connection_closed(true, false);
+    manager.connection_closed(false, true);
+    LT_CHECK_EQ(manager.get_stats().ktls_connections, 0);
+    manager.connection_closed(true, true);
+    LT_CHECK_EQ(manager.get_stats().ktls_connections, 1);
+LT_END_AUTO_TEST(no_kernel_tls_without_session)
+
+#ifdef HAVE_GNUTLS
+LT_BEGIN_AUTO_TEST(tls_manager_suite, certificates_by_hostname)
+    string key = http::load_file("key.pem");
+    string cert = http::load_file("cert.pem");
+    tls_manager manager(key, cert, "", "", true, "", 0, 16);
+    manager.add_certificate("www.example.com", key, cert, "");
+    manager.add_certificate("*.Example.org", key, cert, "");
+    LT_CHECK_EQ(manager.has_certificate("www.example.com"), true);
+    LT_CHECK_EQ(manager.has_certificate("WWW.EXAMPLE.COM."), true);
+    LT_CHECK_EQ(manager.has_certificate("example.com"), false);
+    LT_CHECK_EQ(manager.has_certificate("api.example.org"), true);
+    LT_CHECK_EQ(manager.has_certificate("example.org"), false);
+    LT_CHECK_EQ(manager.has_certificate("a.api.example.org"), false);
+    LT_CHECK_EQ(manager.find_certificate("unknown.net") != 0x0, true);
+
+    LT_CHECK_EQ(manager.remove_certificate("*.example.org"), true);
+    LT_CHECK_EQ(manager.remove_certificate("*.example.org"), false);
+    LT_CHECK_EQ(manager.has_certificate("api.example.org"), false);
+LT_END_AUTO_TEST(certificates_by_hostname)
+
+LT_BEGIN_AUTO_TEST(tls_manager_suite, invalid_certificates_rejected)
+    string key = http::load_file("key.pem");
+    string cert = http::load_file("cert.pem");
+    tls_manager manager("", "", "", "", true, "", 0, 16);
+    LT_CHECK_EQ(manager.find_certificate("www.example.com") == 0x0, true);
+    LT_CHECK_THROW(manager.add_certificate("www.*.com", key, cert, ""));
+    LT_CHECK_THROW(manager.add_certificate("", key, cert, ""));
+    LT_CHECK_THROW(manager.add_certificate("www.example.com", cert, cert, ""));
+    LT_CHECK_EQ(manager.has_certificate("www.example.com"), false);
+LT_END_AUTO_TEST(invalid_certificates_rejected)
+#endif
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
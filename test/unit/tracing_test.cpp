@@ -0,0 +1,96 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "details/tracing.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+LT_BEGIN_SUITE(tracing_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(tracing_suite)
+
+LT_BEGIN_AUTO_TEST(tracing_suite, valid_traceparent)
+    trace_context context;
+    LT_ASSERT_EQ(parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", context), true);
+    LT_CHECK_EQ(context.trace_id, "4bf92f3577b34da6a3ce929d0e0e4736");
+    LT_CHECK_EQ(context.parent_id, "00f067aa0ba902b7");
+    LT_CHECK_EQ(context.flags, 1);
+    LT_CHECK_EQ(context.is_sampled(), true);
+
+    // Later versions may append fields.
+    LT_CHECK_EQ(parse_traceparent("cc-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00-what", context), true);
+    LT_CHECK_EQ(context.is_sampled(), false);
+LT_END_AUTO_TEST(valid_traceparent)
+
+LT_BEGIN_AUTO_TEST(tracing_suite, invalid_traceparent)
+    trace_context context;
+    LT_CHECK_EQ(parse_traceparent("", context), false);
+    LT_CHECK_EQ(parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-x", context), false);
+    LT_CHECK_EQ(parse_traceparent("ff-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", context), false);
+    LT_CHECK_EQ(parse_traceparent("00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01", context), false);
+    LT_CHECK_EQ(parse_traceparent("00-00000000000000000000000000000000-00f067aa0ba902b7-01", context), false);
+    LT_CHECK_EQ(parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01", context), false);
+    LT_CHECK_EQ(parse_traceparent("00_4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", context), false);
+    LT_CHECK_EQ(context.trace_id, "");
+LT_END_AUTO_TEST(invalid_traceparent)
+
+LT_BEGIN_AUTO_TEST(tracing_suite, trace_continued_or_started)
+    trace_context continued;
+    start_trace("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", "vendor=value", continued);
+    LT_CHECK_EQ(continued.trace_id, "4bf92f3577b34da6a3ce929d0e0e4736");
+    LT_CHECK_EQ(continued.tracestate, "vendor=value");
+    LT_CHECK_EQ(continued.span_id.size(), 16);
+    LT_CHECK_EQ(continued.span_id != "00f067aa0ba902b7", true);
+    LT_CHECK_EQ(continued.get_traceparent(), "00-4bf92f3577b34da6a3ce929d0e0e4736-" + continued.span_id + "-01");
+
+    trace_context started;
+    start_trace("garbage", "vendor=value", started);
+    LT_CHECK_EQ(started.trace_id.size(), 32);
+    LT_CHECK_EQ(started.parent_id, "");
+    LT_CHECK_EQ(started.tracestate, "");
+    trace_context other;
+    parse_traceparent(started.get_traceparent(), other);
+    LT_CHECK_EQ(other.trace_id, started.trace_id);
+    LT_CHECK_EQ(other.parent_id, started.span_id);
+
+    LT_CHECK_EQ(trace_context().get_traceparent(), "");
+LT_END_AUTO_TEST(trace_continued_or_started)
+
+LT_BEGIN_AUTO_TEST(tracing_suite, timings_elapsed)
+    request_timings timings;
+    timings.at[request_timings::RECEIVED] = 100;
+    timings.at[request_timings::HANDLED] = 350;
+    LT_CHECK_EQ(timings.elapsed(request_timings::RECEIVED, request_timings::HANDLED), 250);
+    LT_CHECK_EQ(timings.elapsed(request_timings::RECEIVED, request_timings::QUEUED), 0);
+    LT_CHECK_EQ(timings.elapsed(request_timings::ROUTED, request_timings::HANDLED), 0);
+LT_END_AUTO_TEST(timings_elapsed)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
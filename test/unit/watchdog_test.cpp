@@ -0,0 +1,174 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011-2019 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <memory>
+#include "littletest.hpp"
+#include "details/watchdog.hpp"
+
+using namespace httpserver;
+using namespace std;
+using namespace details;
+
+vector<stuck_handler> reports;
+pthread_mutex_t reports_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void collect(const stuck_handler& report)
+{
+    pthread_mutex_lock(&reports_lock);
+    reports.push_back(report);
+    pthread_mutex_unlock(&reports_lock);
+}
+
+size_t reported()
+{
+    pthread_mutex_lock(&reports_lock);
+    size_t count = reports.size();
+    pthread_mutex_unlock(&reports_lock);
+    return count;
+}
+
+struct slow_handler
+{
+    const watched_request* watched;
+    int duration;
+};
+
+void* run_handler(void* arg)
+{
+    slow_handler* handler = static_cast<slow_handler*>(arg);
+    watch_guard guard(handler->watched);
+    usleep(handler->duration * 1000);
+    return 0x0;
+}
+
+LT_BEGIN_SUITE(watchdog_suite)
+    void set_up()
+    {
+        reports.clear();
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(watchdog_suite)
+
+LT_BEGIN_AUTO_TEST(watchdog_suite, slow_handler_reported_once)
+    handler_watchdog watchdog(&collect, 20, 4, 0);
+    unique_ptr<watched_request> watched(watchdog.watch("/slow/{id}", "127.0.0.1"));
+    slow_handler handler = { watched.get(), 200 };
+    pthread_t thread;
+    pthread_create(&thread, 0x0, &run_handler, &handler);
+
+    usleep(5000);
+    LT_CHECK_EQ(watchdog.check(), 0);
+    usleep(50000);
+    LT_CHECK_EQ(watchdog.check(), 1);
+    LT_CHECK_EQ(watchdog.check(), 0);
+    pthread_join(thread, 0x0);
+    LT_CHECK_EQ(watchdog.check(), 0);
+
+    LT_ASSERT_EQ(reports.size(), 1);
+    LT_CHECK_EQ(reports[0].route, "/slow/{id}");
+    LT_CHECK_EQ(reports[0].peer, "127.0.0.1");
+    LT_CHECK_EQ(reports[0].elapsed >= 20000, true);
+    LT_CHECK_EQ(pthread_equal(reports[0].thread, thread) != 0, true);
+    LT_CHECK_EQ(reports[0].stack.empty(), true);
+LT_END_AUTO_TEST(slow_handler_reported_once)
+
+LT_BEGIN_AUTO_TEST(watchdog_suite, unwatched_requests_ignored)
+    handler_watchdog watchdog(&collect, 1, 4, 0);
+    {
+        watch_guard guard(0x0);
+        usleep(5000);
+        LT_CHECK_EQ(watchdog.check(), 0);
+    }
+LT_END_AUTO_TEST(unwatched_requests_ignored)
+
+LT_BEGIN_AUTO_TEST(watchdog_suite, slots_released_with_threads)
+    handler_watchdog watchdog(&collect, 10, 1, 0);
+    unique_ptr<watched_request> watched(watchdog.watch("/", "10.0.0.1"));
+    slow_handler handler = { watched.get(), 30 };
+
+    // Two threads at once: only the one owning the single slot is watched.
+    pthread_t first, second;
+    pthread_create(&first, 0x0, &run_handler, &handler);
+    pthread_create(&second, 0x0, &run_handler, &handler);
+    usleep(20000);
+    LT_CHECK_EQ(watchdog.check(), 1);
+    pthread_join(first, 0x0);
+    pthread_join(second, 0x0);
+
+    // Both threads ended, so the slot is free again.
+    pthread_t third;
+    pthread_create(&third, 0x0, &run_handler, &handler);
+    usleep(20000);
+    LT_CHECK_EQ(watchdog.check(), 1);
+    pthread_join(third, 0x0);
+LT_END_AUTO_TEST(slots_released_with_threads)
+
+LT_BEGIN_AUTO_TEST(watchdog_suite, reports_delivered_by_background_thread)
+    handler_watchdog watchdog(&collect, 20, 4, SIGUSR2);
+    watchdog.start();
+    unique_ptr<watched_request> watched(watchdog.watch("/stuck", "::1"));
+    slow_handler handler = { watched.get(), 300 };
+    pthread_t thread;
+    pthread_create(&thread, 0x0, &run_handler, &handler);
+    for(int i = 0; i < 100 && reported() == 0; i++)
+        usleep(5000);
+    pthread_join(thread, 0x0);
+    watchdog.stop();
+
+    LT_ASSERT_EQ(reports.size(), 1);
+    LT_CHECK_EQ(reports[0].route, "/stuck");
+#ifdef HAVE_EXECINFO
+    LT_CHECK_EQ(reports[0].stack.empty(), false);
+#endif
+LT_END_AUTO_TEST(reports_delivered_by_background_thread)
+
+LT_BEGIN_AUTO_TEST(watchdog_suite, stacks_captured_from_ending_threads)
+    // Handlers ending (and their threads exiting) while the watchdog captures their stack.
+    handler_watchdog watchdog(&collect, 1, 64, SIGUSR2);
+    watchdog.start();
+    unique_ptr<watched_request> watched(watchdog.watch("/short", "127.0.0.1"));
+
+    for(int round = 0; round < 20; round++)
+    {
+        slow_handler handlers[8];
+        pthread_t threads[8];
+        for(int i = 0; i < 8; i++)
+        {
+            handlers[i].watched = watched.get();
+            handlers[i].duration = 5 + (round + i) % 20;
+            pthread_create(&threads[i], 0x0, &run_handler, &handlers[i]);
+        }
+        for(int i = 0; i < 8; i++)
+            pthread_join(threads[i], 0x0);
+    }
+
+    watchdog.stop();
+    LT_CHECK_EQ(reported() > 0, true);
+LT_END_AUTO_TEST(stacks_captured_from_ending_threads)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()